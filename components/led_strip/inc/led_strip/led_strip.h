@@ -19,6 +19,7 @@ extern "C" {
 #include <driver/gpio.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
+#include "freertos/task.h"
 
 #include <stddef.h>
 
@@ -54,6 +55,11 @@ struct led_strip_t {
     struct led_color_t *led_strip_buf_2; 
 
     SemaphoreHandle_t access_semaphore;
+
+    // Set by led_strip_init, notified by led_strip_show
+    TaskHandle_t task_handle;
+    // Count of frames sent to the strip
+    uint32_t refresh_count;
 };
 
 bool led_strip_init(struct led_strip_t *led_strip);
@@ -75,6 +81,7 @@ bool led_strip_get_pixel_color(struct led_strip_t *led_strip, uint32_t pixel_num
 
 /**
  * Updates the led buffer to be shown using double buffering.
+ * The strip is refreshed by the led strip task, which is woken up here.
  */
 bool led_strip_show(struct led_strip_t *led_strip);
 
@@ -12,7 +12,9 @@
     refers to buffer 1. 
     When led_strip_show is called, it will switch to displaying the pixels
     from buffer 2 and will clear buffer 1. Any writes will now happen on buffer 1 
-    and the task will look at buffer 2 for refreshing the LEDs
+    and the task will look at buffer 2 for refreshing the LEDs.
+    The refresh task sleeps until led_strip_show notifies it, refreshes are
+    limited to one per LED_STRIP_REFRESH_PERIOD_MS.
     ------------------------------------------------------------------------- */
 
 #include "led_strip/led_strip.h"
@@ -21,9 +23,17 @@
 #include <string.h>
 
 #define LED_STRIP_TASK_SIZE             (1024)
-#define LED_STRIP_TASK_PRIORITY         (configMAX_PRIORITIES - 1)
-
-#define LED_STRIP_REFRESH_PERIOD_MS     (30U) // TODO: add as parameter to led_strip_init
+// Refreshing is not time critical, keep it below any input processing
+#ifndef LED_STRIP_TASK_PRIORITY
+#define LED_STRIP_TASK_PRIORITY         (tskIDLE_PRIORITY + 2)
+#endif
+// Keep refreshing on the PRO_CPU, the APP_CPU is reserved for input processing
+#ifndef LED_STRIP_TASK_CORE
+#define LED_STRIP_TASK_CORE             (0)
+#endif
+
+// Minimum time between two refreshes, faster calls of led_strip_show are coalesced
+#define LED_STRIP_REFRESH_PERIOD_MS     (10U)
 
 #define LED_STRIP_NUM_RMT_ITEMS_PER_LED (24U) // Assumes 24 bit color for each led
 
@@ -207,8 +217,6 @@ static void led_strip_task(void *arg)
 {
     struct led_strip_t *led_strip = (struct led_strip_t *)arg;
     led_fill_rmt_items_fn led_make_waveform = NULL;
-    bool make_new_rmt_items = true;
-    bool prev_showing_buf_1 = !led_strip->showing_buf_1;
 
     size_t num_items_malloc = (LED_STRIP_NUM_RMT_ITEMS_PER_LED * led_strip->led_strip_length);
     rmt_item32_t *rmt_items = (rmt_item32_t*) malloc(sizeof(rmt_item32_t) * num_items_malloc);
@@ -235,35 +243,33 @@ static void led_strip_task(void *arg)
             break;
     };
 
+    TickType_t last_refresh = xTaskGetTickCount() - (LED_STRIP_REFRESH_PERIOD_MS / portTICK_PERIOD_MS);
+
     for(;;) {
+        // Sleep until led_strip_show publishes a new frame
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        // Bound the refresh rate, frames shown in the meantime are coalesced
+        TickType_t elapsed = xTaskGetTickCount() - last_refresh;
+        if (elapsed < (LED_STRIP_REFRESH_PERIOD_MS / portTICK_PERIOD_MS)) {
+            vTaskDelay((LED_STRIP_REFRESH_PERIOD_MS / portTICK_PERIOD_MS) - elapsed);
+            ulTaskNotifyTake(pdTRUE, 0);
+        }
+
         rmt_wait_tx_done(led_strip->rmt_channel,portMAX_DELAY);
         xSemaphoreTake(led_strip->access_semaphore, portMAX_DELAY);
 
-        /*
-         * If buf 1 was previously being shown and now buf 2 is being shown,
-         * it should update the new rmt items array. If buf 2 was previous being shown
-         * and now buf 1 is being shown, it should update the new rmt items array.
-         * Otherwise, no need to update the array
-         */
-        if ((prev_showing_buf_1 == true) && (led_strip->showing_buf_1 == false)) {
-            make_new_rmt_items = true;
-        } else if ((prev_showing_buf_1 == false) && (led_strip->showing_buf_1 == true)) {
-            make_new_rmt_items = true;
+        // Always send the buffer which is currently shown
+        if (led_strip->showing_buf_1) {
+            led_make_waveform(led_strip->led_strip_buf_1, rmt_items, led_strip->led_strip_length);
         } else {
-            make_new_rmt_items = false;
+            led_make_waveform(led_strip->led_strip_buf_2, rmt_items, led_strip->led_strip_length);
         }
+        rmt_write_items(led_strip->rmt_channel, rmt_items, num_items_malloc, false);
+        led_strip->refresh_count++;
 
-        if (make_new_rmt_items) {
-            if (led_strip->showing_buf_1) {
-                led_make_waveform(led_strip->led_strip_buf_1, rmt_items, led_strip->led_strip_length);
-            } else {
-                led_make_waveform(led_strip->led_strip_buf_2, rmt_items, led_strip->led_strip_length);
-            }
-            rmt_write_items(led_strip->rmt_channel, rmt_items, num_items_malloc, false);
-            prev_showing_buf_1 = led_strip->showing_buf_1;
-        }
         xSemaphoreGive(led_strip->access_semaphore);
-        vTaskDelay(LED_STRIP_REFRESH_PERIOD_MS / portTICK_PERIOD_MS);
+        last_refresh = xTaskGetTickCount();
     }
 
     if (rmt_items) {
@@ -305,8 +311,6 @@ static bool led_strip_init_rmt(struct led_strip_t *led_strip)
 
 bool led_strip_init(struct led_strip_t *led_strip)
 {
-    TaskHandle_t led_strip_task_handle;
-
     if ((led_strip == NULL) ||
         (led_strip->rmt_channel == RMT_CHANNEL_MAX) ||
         (led_strip->gpio > GPIO_NUM_33) ||  // only inputs above 33
@@ -323,6 +327,7 @@ bool led_strip_init(struct led_strip_t *led_strip)
 
     memset(led_strip->led_strip_buf_1, 0, sizeof(struct led_color_t) * led_strip->led_strip_length);
     memset(led_strip->led_strip_buf_2, 0, sizeof(struct led_color_t) * led_strip->led_strip_length);
+    led_strip->refresh_count = 0;
 
     bool init_rmt = led_strip_init_rmt(led_strip);
     if (!init_rmt) {
@@ -330,18 +335,22 @@ bool led_strip_init(struct led_strip_t *led_strip)
     }
 
     xSemaphoreGive(led_strip->access_semaphore);
-    BaseType_t task_created = xTaskCreate(led_strip_task,
+    BaseType_t task_created = xTaskCreatePinnedToCore(led_strip_task,
                                             "led_strip_task",
                                             LED_STRIP_TASK_SIZE,
                                             led_strip,
                                             LED_STRIP_TASK_PRIORITY,
-                                            &led_strip_task_handle
+                                            &led_strip->task_handle,
+                                            LED_STRIP_TASK_CORE
                                          );
 
     if (!task_created) {
         return false;
     }
 
+    // Send the cleared buffer once
+    xTaskNotifyGive(led_strip->task_handle);
+
     return true;
 }
 
@@ -424,6 +433,11 @@ bool led_strip_show(struct led_strip_t *led_strip)
     }
     xSemaphoreGive(led_strip->access_semaphore);
 
+    // Wake up the refresh task
+    if (led_strip->task_handle) {
+        xTaskNotifyGive(led_strip->task_handle);
+    }
+
     return success;
 }
 
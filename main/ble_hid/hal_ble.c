@@ -213,8 +213,15 @@ void halBLETask(void * params)
 	  //pend on MQ, if timeout triggers, just wait again.
 	  if(xQueueReceive(hid_ble,&rx,portMAX_DELAY))
 	  {
+		METRICS_QUEUE_HWM(METRIC_HWM_HID_BLE,hid_ble);
 		//if we are not connected, discard.
 		if(sec_conn == false) continue;
+		if(metricsGet(METRIC_FIRST_HID_US) == 0) 
+		{
+		  metricsSet(METRIC_FIRST_HID_US,(uint32_t)esp_timer_get_time());
+		  metricsBootPhase("first_hid_ble");
+		}
+		metricsInc(METRIC_HID_BLE);
 		
 		//parse command (similar to usb_bridge controller)
 		switch(rx.cmd[0] & 0xF0)
@@ -637,7 +644,7 @@ esp_err_t halBLEInit(uint8_t enableKeyboard, uint8_t enableMouse, uint8_t enable
   esp_ble_gap_set_security_param(ESP_BLE_SM_SET_RSP_KEY, &rsp_key, sizeof(uint8_t));
   
   //create BLE task
-  xTaskCreate(&halBLETask, "ble_task", TASK_BLE_STACKSIZE, NULL, HAL_BLE_TASK_PRIORITY_BASE, NULL);
+  RTOS_TASK_CREATE(&halBLETask, "ble_task", TASK_BLE_STACKSIZE, NULL, HAL_BLE_TASK_PRIORITY_BASE, NULL, TASK_CORE_INPUT);
   
   //set log level according to define
   esp_log_level_set(HID_LE_PRF_TAG,LOG_LEVEL_BLE);
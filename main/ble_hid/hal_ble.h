@@ -29,6 +29,7 @@
 #include <esp_log.h>
 #include <keyboard.h>
 #include "common.h"
+#include "metrics.h"
 
 #include "esp_bt.h"
 #include "esp_bt_defs.h"
@@ -18,6 +18,10 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include "esp_log.h"
+#include "deferred_log.h"
+
+/** @brief Log level of this module, DLOGx calls with a higher level are removed */
+#define LOG_LEVEL_HID_DEV ESP_LOG_INFO
 
 static hid_report_map_t *hid_dev_rpt_tbl;
 static uint8_t hid_dev_rpt_tbl_Len;
@@ -50,7 +54,7 @@ void hid_dev_send_report(esp_gatt_if_t gatts_if, uint16_t conn_id,
     // get att handle for report
     if ((p_rpt = hid_dev_rpt_by_id(id, type)) != NULL) {
         // if notifications are enabled
-        ESP_LOGD(HID_LE_PRF_TAG, "%s(), send the report, handle = %d", __func__, p_rpt->handle);
+        DLOGD(LOG_LEVEL_HID_DEV, HID_LE_PRF_TAG, "%s(), send the report, handle = %d", __func__, p_rpt->handle);
         esp_ble_gatts_send_indicate(gatts_if, conn_id, p_rpt->handle, length, data, false);
     }
     
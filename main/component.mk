@@ -21,3 +21,14 @@ COMPONENT_ADD_INCLUDEDIRS += \
 CFLAGS += -D LOG_LOCAL_LEVEL=ESP_LOG_DEBUG
 
 # include $(IDF_PATH)/make/component_common.mk
+
+#embedded web GUI assets, generated from the precompressed files
+#see webgui/makeassets.py & helper/webgui_assets.c
+WEBGUI_ASSETS_SRC := $(PROJECT_PATH)/webgui/minified_gz
+COMPONENT_EXTRA_INCLUDES += $(COMPONENT_BUILD_DIR)
+COMPONENT_EXTRA_CLEAN := webgui_assets_data.h
+
+helper/webgui_assets.o: webgui_assets_data.h
+
+webgui_assets_data.h: $(PROJECT_PATH)/webgui/makeassets.py $(shell find $(WEBGUI_ASSETS_SRC) -name '*.gz')
+	$(PYTHON) $< $(WEBGUI_ASSETS_SRC) $@
@@ -153,6 +153,7 @@ void configSwitcherTask(void * params)
   
   uint32_t tid = 0;
   uint8_t justupdate = 0;
+  uint8_t firstload = 1;
   esp_err_t ret;
   
   if(config_switcher == 0)
@@ -166,6 +167,7 @@ void configSwitcherTask(void * params)
     //wait for a command.
     if(xQueueReceive(config_switcher,command,1000/portTICK_PERIOD_MS) == pdTRUE)
     {
+      int64_t switchstart = esp_timer_get_time();
       //still commands to be processed, wait for queue to get empty...
       if((xEventGroupWaitBits(systemStatus,SYSTEM_EMPTY_CMD_QUEUE,pdFALSE, \
         pdFALSE,1000/portTICK_PERIOD_MS) & SYSTEM_EMPTY_CMD_QUEUE) == 0)
@@ -221,19 +223,30 @@ void configSwitcherTask(void * params)
       }
       
       //make one or more config tones (depending on slot number)
+      //one melody: a tone and a pause (values are from original firmware),
+      //repeated slot number times
+      int64_t feedbackstart = esp_timer_get_time();
       uint8_t slotnr = halStorageGetCurrentSlotNumber() + 1;
-      for(uint8_t i = 0; i<slotnr; i++)
-      {
-        //create a tone and a pause (values are from original firmware)
-        TONE(TONE_CHANGESLOT_FREQ_BASE + slotnr*TONE_CHANGESLOT_FREQ_SLOTNR, \
-          TONE_CHANGESLOT_DURATION);
-        TONE(0,TONE_CHANGESLOT_DURATION_PAUSE);
-      }
+      halIOMelody_t slottones = {
+        .priority = HAL_IO_TONE_PRIO_HIGH,
+        .count = 2,
+        .repeat = slotnr,
+        .notes = {
+          { .frequency = TONE_CHANGESLOT_FREQ_BASE + slotnr*TONE_CHANGESLOT_FREQ_SLOTNR, 
+            .duration = TONE_CHANGESLOT_DURATION },
+          { .frequency = 0, .duration = TONE_CHANGESLOT_DURATION_PAUSE }
+        }
+      };
+      MELODY(&slottones);
       
-      //LED output on slot switch (steady color on Neopixel, short fading on RGB)
-      LED((slotnr%2)*0xFF,((slotnr/2)%2)*0xFF,((slotnr/4)%2)*0xFF,0);
+      //LED output on slot switch: blink slot number in sync with the tones,
+      //afterwards steady color
+      LEDANIM(LED_ANIM_BLINK,(slotnr%2)*0xFF,((slotnr/2)%2)*0xFF,((slotnr/4)%2)*0xFF, \
+        TONE_CHANGESLOT_DURATION + TONE_CHANGESLOT_DURATION_PAUSE, slotnr, \
+        (TONE_CHANGESLOT_DURATION*256)/(TONE_CHANGESLOT_DURATION + TONE_CHANGESLOT_DURATION_PAUSE));
       
-      ESP_LOGD(LOG_TAG,"LED");
+      ESP_LOGD(LOG_TAG,"LED, feedback queued in %lldus", \
+        (long long)(esp_timer_get_time() - feedbackstart));
       
       //clean up
       halStorageFinishTransaction(tid);
@@ -266,6 +279,14 @@ void configSwitcherTask(void * params)
       
       ESP_LOGD(LOG_TAG,"cfg update");
       
+      //save slot switch duration
+      uint32_t switchtime = (uint32_t)(esp_timer_get_time() - switchstart);
+      metricsSet(METRIC_SLOTSWITCH_US,switchtime);
+      metricsMax(METRIC_SLOTSWITCH_MAX_US,switchtime);
+      //first slot switch is the default slot on boot
+      if(firstload) metricsBootPhase("default_slot");
+      firstload = 0;
+      
       if(justupdate)
       {
         xSemaphoreGive(configUpdatePending);
@@ -295,12 +316,12 @@ esp_err_t configSwitcherInit(void)
   }
   
   //init update semaphore
-  configUpdatePending = xSemaphoreCreateBinary();
+  configUpdatePending = RTOS_BINARY_CREATE();
   xSemaphoreGive(configUpdatePending);
   
   //start configSwitcherTask
-  if(xTaskCreate(configSwitcherTask,"configswitcher",CONFIGSWITCHERTASK_PERMANENT_STACKSIZE,(void *)NULL,
-    HAL_CONFIG_TASK_PRIORITY,configswitcher_handle) != pdPASS)
+  if(RTOS_TASK_CREATE(configSwitcherTask,"configswitcher",CONFIGSWITCHERTASK_PERMANENT_STACKSIZE,(void *)NULL,
+    HAL_CONFIG_TASK_PRIORITY,configswitcher_handle,TASK_CORE_SYSTEM) != pdPASS)
   {
     ESP_LOGE(LOG_TAG,"error creating config switcher task, cannot proceed.");
     return ESP_FAIL;
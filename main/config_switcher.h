@@ -36,6 +36,7 @@
 
 #include "esp_log.h"
 #include "common.h"
+#include "metrics.h"
 #include "tones.h"
 
 //include all hal tasks, making config structs available
@@ -64,10 +64,99 @@ QueueHandle_t config_switcher;
 QueueHandle_t debouncer_in;
 QueueHandle_t hid_usb;
 QueueHandle_t hid_ble;
+/** @brief Bytes used by static RTOS objects
+ * @see rtos_alloc.h */
+uint32_t rtosStaticBytes = 0;
 
 /** @brief Flag for active wifi */
 uint8_t isWifiOn = 0;
 
+/** @brief Boot gate: storage (SPIFFS + NVS) is mounted */
+#define BOOT_STORAGE_READY  (1<<0)
+/** @brief Boot gate: BLE stack is initialized */
+#define BOOT_BLE_READY      (1<<1)
+/** @brief Boot gate: WiFi/webgui & MQTT control are prepared */
+#define BOOT_WIFI_READY     (1<<2)
+/** @brief All boot gates */
+#define BOOT_ALL_READY      (BOOT_STORAGE_READY | BOOT_BLE_READY | BOOT_WIFI_READY)
+/** @brief Timeout for all boot gates [ms] */
+#define BOOT_TIMEOUT_MS     10000
+/** @brief Stack size of the parallel boot tasks */
+#define BOOT_TASK_STACKSIZE 4096
+
+/** @brief Dependency gates between parallel init tasks
+ * @see BOOT_STORAGE_READY */
+static EventGroupHandle_t bootStatus = NULL;
+
+/** @brief Boot task: mount storage (SPIFFS + NVS) 
+ * 
+ * Opening a storage transaction mounts SPIFFS and initializes NVS, the
+ * default slot is loaded by the config switcher afterwards.
+ * @param param Unused */
+static void boot_storage(void *param)
+{
+    uint32_t tid;
+    char idletimeout[16];
+    if(halStorageStartTransaction(&tid,1000/portTICK_PERIOD_MS,"boot") == ESP_OK)
+    {
+        halStorageFinishTransaction(tid);
+    } else {
+        ESP_LOGE(LOG_TAG,"error mounting storage");
+    }
+    //ADC idle timeout ("AT SI"), default is used if not stored
+    if(halStorageNVSLoadString(NVS_ADC_IDLETIMEOUT,idletimeout) == ESP_OK && idletimeout[0] != '\0')
+    {
+        halAdcSetIdleTimeout(strtoul(idletimeout,NULL,10) * 1000);
+    }
+    metricsBootPhase("storage");
+    xEventGroupSetBits(bootStatus,BOOT_STORAGE_READY);
+    vTaskDelete(NULL);
+}
+
+/** @brief Boot task: init BLE stack, after storage (NVS) is ready
+ * @param param Unused */
+static void boot_ble(void *param)
+{
+    xEventGroupWaitBits(bootStatus,BOOT_STORAGE_READY,pdFALSE,pdTRUE,portMAX_DELAY);
+    //start BLE (mouse/keyboard interfaces active)
+    if(halBLEInit(1,1,0) == ESP_OK)
+    {
+        ESP_LOGD(LOG_TAG,"initialized halBle");
+    } else {
+        ESP_LOGE(LOG_TAG,"error initializing halBle");
+    }
+    metricsBootPhase("ble");
+    xEventGroupSetBits(bootStatus,BOOT_BLE_READY);
+    vTaskDelete(NULL);
+}
+
+/** @brief Boot task: prepare WiFi/webgui & MQTT control
+ * 
+ * Waits for the BLE stack, WiFi & BT init are not done at the same time
+ * (both are hungry for RAM & current).
+ * @param param Unused */
+static void boot_wifi(void *param)
+{
+    xEventGroupWaitBits(bootStatus,BOOT_STORAGE_READY | BOOT_BLE_READY,pdFALSE,pdTRUE,portMAX_DELAY);
+    if(taskWebGUIInit() == ESP_OK)
+    {
+        ESP_LOGD(LOG_TAG,"initialized webserver/DNS server/webgui");
+    } else {
+        ESP_LOGE(LOG_TAG,"error initializing webserver/DNS server/webgui");
+    }
+    
+    //MQTT remote control, only active if a control topic is set (AT MC)
+    if(taskMQTTControlInit() == ESP_OK)
+    {
+        ESP_LOGD(LOG_TAG,"initialized MQTT control");
+    } else {
+        ESP_LOGE(LOG_TAG,"error initializing MQTT control");
+    }
+    metricsBootPhase("wifi");
+    xEventGroupSetBits(bootStatus,BOOT_WIFI_READY);
+    vTaskDelete(NULL);
+}
+
 /** @brief Switch radio mode
  * 
  * This method is used to switch wifi on or off.
@@ -93,12 +182,13 @@ void switch_radio(void)
     if(isWifiOn == 0)
     {
         isWifiOn = 1;
-        LED(255,0,255,0);
+        //pulse while WiFi is on
+        LEDANIM(LED_ANIM_PULSE,255,0,255,2000,0,0);
         taskWebGUIEnDisable(1,true);
     } else {
         uint8_t slotnr = halStorageGetCurrentSlotNumber();
         slotnr++;
-        LED((slotnr%2)*0xFF,((slotnr/2)%2)*0xFF,((slotnr/4)%2)*0xFF,0);
+        LEDANIM(LED_ANIM_FADE,(slotnr%2)*0xFF,((slotnr/2)%2)*0xFF,((slotnr/4)%2)*0xFF,500,0,0);
         isWifiOn = 0;
         taskWebGUIEnDisable(0,true);
     }
@@ -120,7 +210,10 @@ static heap_trace_record_t trace_record[NUM_RECORDS];
  * 
  * This task is used to initialize all queues & flags.
  * In addition, all necessary tasks are created
- * After initialisation, this task deletes itself.
+ * Storage, BLE and WiFi are initialized in parallel tasks, ordered by
+ * the gates in bootStatus.
+ * After initialisation, the boot phases are printed and this task
+ * deletes itself.
  * */    
 void app_main()
 {
@@ -131,18 +224,43 @@ void app_main()
     vTaskSuspendAll();
         //init all remaining rtos stuff
         //eventgroups
-        connectionRoutingStatus = xEventGroupCreate();
-        systemStatus = xEventGroupCreate();
+        connectionRoutingStatus = RTOS_EVENTGROUP_CREATE();
+        systemStatus = RTOS_EVENTGROUP_CREATE();
         xEventGroupSetBits(systemStatus, SYSTEM_STABLECONFIG | SYSTEM_EMPTY_CMD_QUEUE);
         //queues
-        config_switcher = xQueueCreate(5,sizeof(char)*SLOTNAME_LENGTH);
-        hid_ble = xQueueCreate(32,sizeof(hid_cmd_t));
-        hid_usb = xQueueCreate(32,sizeof(hid_cmd_t));
-        debouncer_in = xQueueCreate(32,sizeof(raw_action_t));
+        config_switcher = RTOS_QUEUE_CREATE(RTOS_QLEN_CONFIG_SWITCHER,sizeof(char)*SLOTNAME_LENGTH);
+        hid_ble = RTOS_QUEUE_CREATE(RTOS_QLEN_HID_BLE,sizeof(hid_cmd_t));
+        hid_usb = RTOS_QUEUE_CREATE(RTOS_QLEN_HID_USB,sizeof(hid_cmd_t));
+        debouncer_in = RTOS_QUEUE_CREATE(RTOS_QLEN_DEBOUNCER_IN,sizeof(raw_action_t));
         
     //exit critical section & resume all tasks for initialising
     xTaskResumeAll();
     
+    //reset performance counters & measure their update cost
+    metricsInit();
+    //start printing deferred log entries (DLOGx)
+    dlogInit();
+    metricsBootPhase("rtos");
+    
+    //storage mutex is created before any task can start a transaction
+    if(halStorageMutexInit() != ESP_OK)
+    {
+        ESP_LOGE(LOG_TAG,"error creating storage mutex");
+    }
+    
+    //start independent subsystems in parallel
+    bootStatus = xEventGroupCreate();
+    if(bootStatus == NULL || \
+      xTaskCreatePinnedToCore(boot_storage,"boot_storage",BOOT_TASK_STACKSIZE,NULL,tskIDLE_PRIORITY+2,NULL,TASK_CORE_SYSTEM) != pdPASS || \
+      xTaskCreatePinnedToCore(boot_ble,"boot_ble",BOOT_TASK_STACKSIZE,NULL,tskIDLE_PRIORITY+1,NULL,TASK_CORE_SYSTEM) != pdPASS || \
+      xTaskCreatePinnedToCore(boot_wifi,"boot_wifi",BOOT_TASK_STACKSIZE,NULL,tskIDLE_PRIORITY+1,NULL,TASK_CORE_SYSTEM) != pdPASS)
+    {
+        ESP_LOGE(LOG_TAG,"error creating boot tasks");
+    }
+    
+    //event loop is used by the handlers & the calibration
+    esp_event_loop_create_default();
+    
     //start IO continous task
     if(halIOInit() == ESP_OK)
     {
@@ -152,6 +270,7 @@ void app_main()
     } else {
         ESP_LOGE(LOG_TAG,"error initializing halIOInit");
     }
+    metricsBootPhase("io");
         
     //initialize serial communication task
     //(USB-HID & USB Serial for commands)
@@ -161,6 +280,7 @@ void app_main()
     } else {
         ESP_LOGE(LOG_TAG,"error initializing halSerial");
     }
+    metricsBootPhase("serial");
         
     //start adc continous task
     if(halAdcInit(NULL) == ESP_OK)
@@ -171,8 +291,7 @@ void app_main()
     }
     //we need to calibrate here, otherwise sip/puff is not 512 in idle...
     halAdcCalibrate();
-    
-    esp_event_loop_create_default();
+    metricsBootPhase("adc");
 
     //init HID handler
     if(handler_hid_init() == ESP_OK)
@@ -190,6 +309,14 @@ void app_main()
         ESP_LOGE(LOG_TAG,"error adding VB handler");
     }
 
+    //IR functions (waveform cache)
+    if(fct_infrared_init() == ESP_OK)
+    {
+        ESP_LOGD(LOG_TAG,"IR functions initialized");
+    } else {
+        ESP_LOGE(LOG_TAG,"error initializing IR functions");
+    }
+
     //command parser
     if(taskCommandsInit() == ESP_OK)
     {
@@ -199,8 +326,8 @@ void app_main()
     }
     
     //start debouncer
-    if(xTaskCreate(task_debouncer,"debouncer",TASK_DEBOUNCER_STACKSIZE, 
-        (void*)NULL,DEBOUNCER_TASK_PRIORITY, NULL) == pdPASS)
+    if(RTOS_TASK_CREATE(task_debouncer,"debouncer",TASK_DEBOUNCER_STACKSIZE, 
+        (void*)NULL,DEBOUNCER_TASK_PRIORITY, NULL, TASK_CORE_INPUT) == pdPASS)
     {
         ESP_LOGD(LOG_TAG,"created new debouncer task");
     } else {
@@ -221,26 +348,21 @@ void app_main()
     } else {
         ESP_LOGE(LOG_TAG,"error initializing configSwitcherInit");
     }
+    metricsBootPhase("tasks");
     
-    //delete this task after initializing.
-    ESP_LOGI(LOG_TAG,"Finished initializing!");
-    
-    //we wait 0.75s to activate WiFi+BT, seems to be hungry :-)
-    vTaskDelay(750/portTICK_PERIOD_MS);
-    //start BLE (mouse/keyboard interfaces active)
-    if(halBLEInit(1,1,0) == ESP_OK)
+    //wait for the parallel init tasks (instead of a fixed delay)
+    if(bootStatus == NULL || (xEventGroupWaitBits(bootStatus,BOOT_ALL_READY,pdFALSE,pdTRUE, \
+      BOOT_TIMEOUT_MS/portTICK_PERIOD_MS) & BOOT_ALL_READY) != BOOT_ALL_READY)
     {
-        ESP_LOGD(LOG_TAG,"initialized halBle");
-    } else {
-        ESP_LOGE(LOG_TAG,"error initializing halBle");
+        ESP_LOGE(LOG_TAG,"Timeout waiting for storage/BLE/WiFi init");
     }
+    ESP_LOGI(LOG_TAG,"Finished initializing!");
     
-    if(taskWebGUIInit() == ESP_OK)
-    {
-        ESP_LOGD(LOG_TAG,"initialized webserver/DNS server/webgui");
-    } else {
-        ESP_LOGE(LOG_TAG,"error initializing webserver/DNS server/webgui");
-    }
+    //boot time (since start of the application) & RAM of RTOS objects
+    metricsSet(METRIC_BOOT_US,(uint32_t)esp_timer_get_time());
+    metricsBootPrint();
+    ESP_LOGI(LOG_TAG,"init done after %"PRIu32"ms, %"PRIu32"B static RTOS objects, %dB free heap", \
+        metricsGet(METRIC_BOOT_US)/1000,rtosStaticBytes,xPortGetFreeHeapSize());
     
     //TESTING
     #if 0
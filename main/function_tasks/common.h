@@ -77,6 +77,21 @@
  * */
 #define LED_NEOPIXEL_COUNT  1
 
+/** @brief Allocate all long-lived RTOS objects statically
+ * 
+ * If defined, all queues, tasks, timers, semaphores and event groups
+ * which live until reset are allocated statically instead of the heap.
+ * This reduces heap fragmentation, but the RAM is used even if a feature
+ * is not active. Needs CONFIG_SUPPORT_STATIC_ALLOCATION in menuconfig.
+ * @see rtos_alloc.h
+ * */
+//#define RTOS_STATIC_ALLOCATION
+
+//allocation of long-lived RTOS objects (depends on RTOS_STATIC_ALLOCATION)
+#include "rtos_alloc.h"
+//deferred logging for hot paths (DLOGx)
+#include "deferred_log.h"
+
 
 /** @brief Maximum length for a slot name */
 #define SLOTNAME_LENGTH   32
@@ -321,17 +336,88 @@ typedef enum {
 /** @brief Declaring a new event base for VB actions */
 ESP_EVENT_DECLARE_BASE(VB_EVENT);
 
-/*++++ TASK PRIORITY ASSIGNMENT ++++*/
-/** @brief ADC task priority. Not high. */
-#define HAL_ADC_TASK_PRIORITY     (tskIDLE_PRIORITY + 5)
-/** @brief Debouncer task priority. Highest priority (for short response time) */
-#define DEBOUNCER_TASK_PRIORITY  (configMAX_PRIORITIES)
-/** @brief BLE task priority. Not high. */
-#define HAL_BLE_TASK_PRIORITY_BASE  (tskIDLE_PRIORITY + 2)
-/** @brief Config switcher task priority. Higher than basic tasks. */
-#define HAL_CONFIG_TASK_PRIORITY  (tskIDLE_PRIORITY + 5)
+/*++++ TASK PRIORITY & CORE ASSIGNMENT ++++*/
+/* Central task table. All long-lived tasks are pinned to a core:
+ *
+ * TASK_CORE_INPUT (APP_CPU, core 1) runs only the real-time input
+ * pipeline, sensor -> debouncer -> HID transport:
+ * | Task           | Priority | Period/Trigger                |
+ * |----------------|----------|-------------------------------|
+ * | debouncer      | idle+12  | VB events, debounce timers    |
+ * | serialHID      | idle+11  | hid_usb queue                 |
+ * | ble_task       | idle+11  | hid_ble queue                 |
+ * | ADC_TASK       | idle+10  | 10/20ms (vTaskDelayUntil)     |
+ *
+ * TASK_CORE_SYSTEM (PRO_CPU, core 0) runs everything else, together
+ * with the WiFi & BT controller/host tasks and the default event loop
+ * (all created by ESP-IDF on core 0, priorities 18-23):
+ * | Task           | Priority | Notes                         |
+ * |----------------|----------|-------------------------------|
+ * | cmdtask        | idle+6   | AT command parser             |
+ * | cim            | idle+6   | CIM protocol (instead of AT)  |
+ * | serialRX       | idle+6   | AT commands via USB bridge    |
+ * | configswitcher | idle+5   | slot loading (storage)        |
+ * | webgui/ws/dns  | idle+3-5 | only when WiFi is enabled     |
+ * | LED/IR/buzzer  | idle+2   | user feedback                 |
+ * | boot tasks     | idle+1-2 | parallel init, end after boot |
+ * | rest           | idle+1   | REST calls, not time critical |
+ * | dlog           | idle+1   | prints deferred log entries   |
+ *
+ * WiFi/BLE bursts, webserver and storage work are on core 0 and cannot
+ * preempt the input tasks anymore. Flash writes still stall both cores
+ * (cache disabled), this is not changed by pinning.
+ * The input priorities are well above all other application tasks, but
+ * below the ESP-IDF system tasks (which are on core 0 anyway).
+ * Sampling jitter of the ADC task is recorded as METRIC_ADC_JITTER_US
+ * ("AT PC").
+ * @note Event handlers (task_hid/task_vb) and esp_timer callbacks (e.g.
+ * debouncer timers) run in ESP-IDF tasks on core 0.
+ */
+/** @brief Core for the real-time input pipeline (APP_CPU)
+ * @note Single core builds run everything on core 0 */
+#if CONFIG_FREERTOS_UNICORE
+#define TASK_CORE_INPUT   0
+#else
+#define TASK_CORE_INPUT   1
+#endif
+/** @brief Core for radio, web, storage & feedback tasks (PRO_CPU) */
+#define TASK_CORE_SYSTEM  0
+
+/** @brief Debouncer task priority. Highest input priority (for short response time) */
+#define DEBOUNCER_TASK_PRIORITY  (tskIDLE_PRIORITY + 12)
+/** @brief Serial HID task priority (sends HID reports to the USB bridge). */
+#define HAL_SERIAL_HID_TASK_PRIORITY  (tskIDLE_PRIORITY + 11)
+/** @brief BLE task priority (sends HID reports via BLE). */
+#define HAL_BLE_TASK_PRIORITY_BASE  (tskIDLE_PRIORITY + 11)
+/** @brief ADC task priority. Lower than the consumers of its events. */
+#define HAL_ADC_TASK_PRIORITY     (tskIDLE_PRIORITY + 10)
+
 /** @brief Command parser task priority. Higher than basic tasks. */
 #define TASK_COMMANDS_PRIORITY  (tskIDLE_PRIORITY + 6)
+/** @brief CIM task priority, replaces the command parser in CIM mode. */
+#define TASK_CIM_PRIORITY  (tskIDLE_PRIORITY + 6)
+/** @brief Serial RX task priority (AT commands via USB bridge), same as parser. */
+#define HAL_SERIAL_RX_TASK_PRIORITY  (tskIDLE_PRIORITY + 6)
+/** @brief Config switcher task priority. Higher than basic tasks. */
+#define HAL_CONFIG_TASK_PRIORITY  (tskIDLE_PRIORITY + 5)
+/** @brief Webserver & websocket server task priority (WiFi enabled). */
+#define TASK_WEBGUI_PRIORITY  (tskIDLE_PRIORITY + 5)
+/** @brief Captive portal DNS task priority (WiFi enabled). */
+#define TASK_DNS_PRIORITY  (tskIDLE_PRIORITY + 3)
+/** @brief Task priority for LED update task */
+#define TASK_HAL_LED_PRIORITY (tskIDLE_PRIORITY + 2)
+/** @brief Task priority for IR send task */
+#define TASK_HAL_IR_SEND_PRIORITY (tskIDLE_PRIORITY + 2)
+/** @brief Task priority for IR receive task */
+#define TASK_HAL_IR_RECV_PRIORITY (tskIDLE_PRIORITY + 2)
+/** @brief Task priority for buzzer update task */
+#define TASK_HAL_BUZZER_PRIORITY (tskIDLE_PRIORITY + 2)
+/** @brief Priority of the REST dispatcher task
+ * @note Lower than the VB handling, REST calls are never time critical
+ * for the input path. */
+#define TASK_REST_PRIORITY (tskIDLE_PRIORITY + 1)
+/** @brief Deferred log drain task priority. Lowest, logging is never time critical. */
+#define TASK_DLOG_PRIORITY (tskIDLE_PRIORITY + 1)
 
 /*++++ MAIN CONFIG STRUCT ++++*/
 
@@ -419,6 +505,7 @@ typedef enum {
   T_CONFIGCHANGE = 1, /** @brief Config change request */
   T_CALIBRATE, /** @brief Calibrationrequest */
   T_SENDIR, /** @brief Send an IR command */
+  T_SENDIR_HOLD, /** @brief Send an IR command, repeat while VB is held */
   T_MACRO, /** @brief Trigger macro execution */
   T_MQTT, /** @brief Trigger a MQTT publish */
   T_REST /** @brief Trigger a REST call */
@@ -447,6 +534,9 @@ typedef struct generalConfig {
   uint8_t locale;
   /** @brief Timeout between IR edges before command is declared as finished */
   uint8_t irtimeout;
+  /** @brief Interval for repeating a held IR command [ms].
+   * @note 0 uses the frame period of the decoded protocol */
+  uint16_t irrepeat;
   /** @brief Global anti-tremor time for press */
   uint16_t debounce_press;
   /** @brief Global anti-tremor time for release */
@@ -496,7 +586,9 @@ typedef struct vb_cmd {
    * @note This value is used to store a command. If it is NULL,
    * this command cannot be stored. */
   char *atoriginal;
-  /** @brief Parameter string, e.g. for slot names. Might be NULL if not necessary */
+  /** @brief Parameter string, e.g. for slot names. Might be NULL if not necessary
+   * @note For T_MQTT, this is a pre-parsed mqtt_action_t (one allocation,
+   * released by free() as all other parameters). */
   char *cmdparam;
   /** @brief Pointer to next VB command element, might be NULL. 
    * @note This pointer is set to NULL as long as it is not added to the command chain. */
@@ -551,6 +643,52 @@ typedef enum irstate {
   IR_OVERFLOW
 } irstate_t;
 
+/** @brief Protocol of an IR command
+ *
+ * If a recorded command matches one of these protocols, it is stored
+ * as a compact code (see irCode_t) instead of raw RMT edges.
+ * @see irCode_t
+ * @see ir_protocol_decode
+ * @see ir_protocol_encode */
+typedef enum irprotocol {
+  /** @brief Unknown protocol, raw edges are used */
+  IR_PROTO_RAW = 0,
+  /** @brief NEC (8bit address + inverted or 16bit extended address, 8bit command) */
+  IR_PROTO_NEC,
+  /** @brief Philips RC5 (5bit address, 6bit command, toggle bit) */
+  IR_PROTO_RC5,
+  /** @brief Philips RC6 mode 0 (8bit address, 8bit command, toggle bit) */
+  IR_PROTO_RC6,
+  /** @brief Sony SIRC (12, 15 or 20 bit) */
+  IR_PROTO_SIRC,
+  /** @brief Samsung (16bit address, 8bit command + inverted) */
+  IR_PROTO_SAMSUNG
+} irprotocol_t;
+
+/** @brief Compact representation of a decoded IR command
+ *
+ * This struct is stored to flash instead of the raw edges if a
+ * recorded command was recognized. The waveform is synthesized again
+ * on sending.
+ * @note Do not reorder these fields, this struct is written to flash.
+ * @see halStorageStoreIR
+ * @see halStorageLoadIR */
+typedef struct irCode {
+  /** @brief Protocol of this command, see irprotocol_t */
+  uint8_t protocol;
+  /** @brief Count of data bits (only used by SIRC: 12, 15 or 20) */
+  uint8_t bits;
+  /** @brief Count of repeated frames which were recorded after the first frame
+   * @note For NEC, these are repeat codes; for all others full frames. */
+  uint8_t repeats;
+  /** @brief Toggle bit (RC5/RC6) */
+  uint8_t toggle;
+  /** @brief Device address (NEC/Samsung: both address bytes as received) */
+  uint16_t address;
+  /** @brief Command */
+  uint16_t command;
+} irCode_t;
+
 /** @brief Struct for sending/receiving an IR command */
 typedef struct halIOIR {
   /** @brief Buffer for IR signal
@@ -561,6 +699,8 @@ typedef struct halIOIR {
   uint16_t count;
   /** @brief Status of receiver */
   irstate_t status;
+  /** @brief Decoded command. If protocol is IR_PROTO_RAW, the buffer is used. */
+  irCode_t code;
 } halIOIR_t;
 
 /** @brief RAW VB action type, sent to debouncer_in queue.
@@ -595,6 +735,17 @@ void strip(char *s);
 /** @brief NVS key for the MQTT broker */
 #define NVS_MQTT_BROKER  "nvsmqbroker"
 
+/** @brief NVS key for the MQTT inbound control base topic (empty: disabled) */
+#define NVS_MQTT_CONTROL  "nvsmqctrl"
+
+/** @brief NVS key for the MQTT inbound control permissions
+ * @see MQTT_CTRL_DEFAULT */
+#define NVS_MQTT_CTRLPERM  "nvsmqperm"
+
+/** @brief NVS key for the idle timeout of the ADC sampling [s]
+ * @see halAdcSetIdleTimeout */
+#define NVS_ADC_IDLETIMEOUT  "nvsadcidle"
+
 /** @brief Minutes between last client disconnected and WiFi is switched off */
 #define WIFI_OFF_TIME 5
 
@@ -34,10 +34,170 @@
 #define LOG_TAG "fct_IR"
 
 
+/** @brief One entry of the IR waveform cache */
+typedef struct irCacheEntry {
+  /** @brief Name of the IR command, empty if unused */
+  char name[SLOTNAME_LENGTH+1];
+  /** @brief Ready-to-send waveform */
+  rmt_item32_t *buffer;
+  /** @brief Count of rmt_item32_t items */
+  uint16_t count;
+  /** @brief Decoded command, used for repeat frames */
+  irCode_t code;
+  /** @brief Usage timestamp, least recently used entry is replaced */
+  uint32_t lastused;
+} irCacheEntry_t;
+
+/** @brief Cache of loaded IR waveforms
+ * @see IR_CACHE_ENTRIES */
+static irCacheEntry_t irCache[IR_CACHE_ENTRIES];
+/** @brief Mutex for the cache, held while sending from a cached buffer */
+static SemaphoreHandle_t irCacheMutex = NULL;
+/** @brief Storage change counter of the cached data
+ * @see halStorageGetIRGeneration */
+static uint32_t irCacheGeneration = 0;
+/** @brief Usage counter for LRU replacement */
+static uint32_t irCacheTick = 0;
+/** @brief Cache & latency statistics */
+static fct_infrared_stats_t irStats;
+/** @brief Evicted/flushed cache buffers which might still be read by the
+ * RMT (refilled from the buffer while sending), freed as soon as the
+ * RMT channel is idle
+ * @see fct_infrared_cache_release */
+static rmt_item32_t *irCacheStale[2*IR_CACHE_ENTRIES];
+
+/** @brief Mutex for the hold-to-repeat state */
+static SemaphoreHandle_t irHoldMutex = NULL;
+/** @brief Periodic timer for sending repeat frames */
+static esp_timer_handle_t irHoldTimer = NULL;
+/** @brief Repeat frame & stale frame of the held command
+ * @see ir_hold_t */
+static ir_hold_t irHold;
+
+/** @brief Free stale cache buffers, if the RMT channel is idle
+ * @note Mutex must be held
+ * @param wait Ticks to wait for the end of the transmission */
+static void fct_infrared_cache_free_stale(TickType_t wait)
+{
+  uint8_t i;
+  for(i = 0; i<sizeof(irCacheStale)/sizeof(irCacheStale[0]); i++)
+  {
+    if(irCacheStale[i] != NULL) break;
+  }
+  if(i == sizeof(irCacheStale)/sizeof(irCacheStale[0])) return;
+  if(rmt_wait_tx_done(0,wait) != ESP_OK) return;
+  for(i = 0; i<sizeof(irCacheStale)/sizeof(irCacheStale[0]); i++)
+  {
+    free(irCacheStale[i]);
+    irCacheStale[i] = NULL;
+  }
+}
+
+/** @brief Release a buffer which is removed from the cache
+ * 
+ * The RMT might still send from this buffer (SENDIRKEEP waits only
+ * 50 ticks), it is freed directly only if the channel is idle.
+ * Otherwise it is kept until fct_infrared_cache_free_stale succeeds.
+ * @note Mutex must be held
+ * @param buffer Buffer to be freed, might be NULL */
+static void fct_infrared_cache_release(rmt_item32_t *buffer)
+{
+  if(buffer == NULL) return;
+  if(rmt_wait_tx_done(0,0) == ESP_OK)
+  {
+    free(buffer);
+    return;
+  }
+  for(uint8_t i = 0; i<sizeof(irCacheStale)/sizeof(irCacheStale[0]); i++)
+  {
+    if(irCacheStale[i] == NULL)
+    {
+      irCacheStale[i] = buffer;
+      return;
+    }
+  }
+  //no free slot: wait for the end of the transmission
+  ESP_LOGW(LOG_TAG,"Waiting for RMT to free IR cache buffers");
+  fct_infrared_cache_free_stale(portMAX_DELAY);
+  free(buffer);
+}
+
+/** @brief Free all cache entries, mutex must be held */
+static void fct_infrared_cache_flush(void)
+{
+  for(uint8_t i = 0; i<IR_CACHE_ENTRIES; i++)
+  {
+    fct_infrared_cache_release(irCache[i].buffer);
+    memset(&irCache[i],0,sizeof(irCacheEntry_t));
+  }
+}
+
+/** @brief Get a cache entry for an IR command, load it on a miss
+ * 
+ * @note Mutex must be held
+ * @param cmdName Name of the IR command
+ * @return Cache entry, NULL if the command cannot be loaded */
+static irCacheEntry_t *fct_infrared_cache_get(char *cmdName)
+{
+  irCacheEntry_t *victim = &irCache[0];
+  halIOIR_t cfg;
+  uint32_t tid;
+  
+  fct_infrared_cache_free_stale(0);
+  
+  //IR commands were stored or deleted -> drop everything
+  if(irCacheGeneration != halStorageGetIRGeneration())
+  {
+    fct_infrared_cache_flush();
+    irCacheGeneration = halStorageGetIRGeneration();
+  }
+  
+  for(uint8_t i = 0; i<IR_CACHE_ENTRIES; i++)
+  {
+    if(irCache[i].buffer != NULL && strcmp(irCache[i].name,cmdName) == 0)
+    {
+      irStats.hits++;
+      irCache[i].lastused = ++irCacheTick;
+      return &irCache[i];
+    }
+    //prefer an empty entry, otherwise the least recently used one
+    if(victim->buffer != NULL && (irCache[i].buffer == NULL || \
+      irCache[i].lastused < victim->lastused)) victim = &irCache[i];
+  }
+  irStats.misses++;
+  
+  //not cached, load from storage
+  memset(&cfg,0,sizeof(halIOIR_t));
+  if(halStorageStartTransaction(&tid,20,LOG_TAG) != ESP_OK)
+  {
+    ESP_LOGE(LOG_TAG,"Error starting transaction for IR cmd");
+    return NULL;
+  }
+  if(halStorageLoadIR(cmdName,&cfg,tid) != ESP_OK)
+  {
+    ESP_LOGE(LOG_TAG,"Error loading IR cmd");
+    halStorageFinishTransaction(tid);
+    return NULL;
+  }
+  halStorageFinishTransaction(tid);
+  
+  //replace victim, its buffer might still be sent
+  fct_infrared_cache_release(victim->buffer);
+  strncpy(victim->name,cmdName,SLOTNAME_LENGTH);
+  victim->name[SLOTNAME_LENGTH] = '\0';
+  victim->buffer = cfg.buffer;
+  victim->count = cfg.count;
+  victim->code = cfg.code;
+  victim->lastused = ++irCacheTick;
+  return victim;
+}
+
 /**@brief FUNCTION - Infrared command sending
  * 
  * This task is used to trigger an IR command on a VB action.
  * The IR command which should be sent is identified by a name.
+ * Loaded waveforms are kept in a LRU cache (IR_CACHE_ENTRIES),
+ * a cache hit does not access the storage at all.
  * 
  * @see taskInfraredConfig_t
  * @param param Task config
@@ -45,33 +205,189 @@
  * */
 void fct_infrared_send(char* cmdName)
 {
-  //local IR struct
-  halIOIR_t *cfg = malloc(sizeof(halIOIR_t));
-  //transaction ID for IR data
-  uint32_t tid;
-  if(halStorageStartTransaction(&tid,20,LOG_TAG) == ESP_OK)
+  //timestamps for press-to-transmit latency
+  int64_t tstart = esp_timer_get_time();
+  
+  if(irCacheMutex == NULL)
   {
-    if(halStorageLoadIR(cmdName,cfg,tid) == ESP_OK)
-    {
-      //send pointer to IR send queue
-      if(cfg != NULL)
-      {
-        ESP_LOGI(LOG_TAG,"Triggering IR cmd, length %d",cfg->count);
-        SENDIRSTRUCT(cfg);
-        //free config afterwards (whole config is saved to queue)
-        free(cfg);
-      } else {
-        ESP_LOGE(LOG_TAG,"IR cfg is NULL!");
-      }
-      //create tone
-      TONE(TONE_IR_SEND_FREQ,TONE_IR_SEND_DURATION);
-    } else {
-      ESP_LOGE(LOG_TAG,"Error loading IR cmd");
-    }
-    halStorageFinishTransaction(tid);
-  } else {
-    ESP_LOGE(LOG_TAG,"Error starting transaction for IR cmd");
+    ESP_LOGE(LOG_TAG,"IR not initialized");
+    return;
+  }
+  if(xSemaphoreTake(irCacheMutex,IR_CACHE_WAIT) != pdTRUE)
+  {
+    ESP_LOGE(LOG_TAG,"IR cache is busy");
+    return;
+  }
+  
+  irCacheEntry_t *entry = fct_infrared_cache_get(cmdName);
+  if(entry != NULL)
+  {
+    //buffer stays in cache
+    SENDIRKEEP(entry->buffer,entry->count);
+    irStats.lastlatency = esp_timer_get_time() - tstart;
+    if(irStats.lastlatency > irStats.maxlatency) irStats.maxlatency = irStats.lastlatency;
+    ESP_LOGI(LOG_TAG,"Sent IR cmd %s, length %d, latency %uus (hits: %u, misses: %u)", \
+      cmdName,entry->count,irStats.lastlatency,irStats.hits,irStats.misses);
   }
+  xSemaphoreGive(irCacheMutex);
+  
+  //create tone
+  if(entry != NULL) TONE(TONE_IR_SEND_FREQ,TONE_IR_SEND_DURATION);
+}
+
+/** @brief Timer callback, sends one repeat frame
+ * 
+ * Runs in the esp_timer task, so nothing is blocking here: if the
+ * state is changed, another command is sent (irCacheMutex is held by
+ * each sender) or a transmission is ongoing, this frame is skipped.
+ * In this case, rmt_write_items will not wait for the channel.
+ * @see ir_hold_tick
+ * @param arg Unused */
+static void fct_infrared_hold_timer(void *arg)
+{
+  if(xSemaphoreTake(irHoldMutex,0) != pdTRUE) return;
+  if(xSemaphoreTake(irCacheMutex,0) != pdTRUE)
+  {
+    xSemaphoreGive(irHoldMutex);
+    return;
+  }
+  ir_hold_tick(&irHold);
+  xSemaphoreGive(irCacheMutex);
+  xSemaphoreGive(irHoldMutex);
+}
+
+/** @brief FUNCTION - Send an IR command & repeat it while the VB is held
+ * 
+ * The command is sent once (like fct_infrared_send), afterwards a
+ * periodic timer sends the protocol's repeat frame (e.g. NEC repeat code)
+ * or the full frame for raw commands, until fct_infrared_hold_stop is
+ * called for this VB.
+ * The interval is the protocol's frame period, or generalConfig_t.irrepeat
+ * if set (IR_HOLD_DEFAULT_INTERVAL for raw commands).
+ * 
+ * @param cmdName Name of the IR command
+ * @param vb Virtual button which holds this command
+ * @return ESP_OK if repeating is started, ESP_FAIL otherwise
+ * @see fct_infrared_hold_stop
+ * */
+esp_err_t fct_infrared_hold_start(char* cmdName, uint8_t vb)
+{
+  generalConfig_t *cfg = configGetCurrent();
+  rmt_item32_t *frame = NULL;
+  uint16_t count = 0;
+  uint32_t period;
+  
+  if(irCacheMutex == NULL || irHoldMutex == NULL || irHoldTimer == NULL)
+  {
+    ESP_LOGE(LOG_TAG,"IR not initialized");
+    return ESP_FAIL;
+  }
+  //only one command can be held
+  fct_infrared_hold_stop(IR_HOLD_ALL);
+  
+  if(xSemaphoreTake(irCacheMutex,IR_CACHE_WAIT) != pdTRUE)
+  {
+    ESP_LOGE(LOG_TAG,"IR cache is busy");
+    return ESP_FAIL;
+  }
+  irCacheEntry_t *entry = fct_infrared_cache_get(cmdName);
+  if(entry == NULL)
+  {
+    xSemaphoreGive(irCacheMutex);
+    return ESP_FAIL;
+  }
+  
+  //create repeat frame: protocol repeat frame or the full waveform
+  frame = ir_hold_create_frame(&entry->code,entry->buffer,entry->count,&count);
+  period = ir_hold_interval(entry->code.protocol,cfg != NULL ? cfg->irrepeat : 0);
+  
+  if(frame == NULL)
+  {
+    ESP_LOGE(LOG_TAG,"Cannot create IR repeat frame");
+    xSemaphoreGive(irCacheMutex);
+    return ESP_FAIL;
+  }
+  
+  //activate repeating, timer is started before the first frame to keep the period
+  xSemaphoreTake(irHoldMutex,portMAX_DELAY);
+  ir_hold_start(&irHold,frame,count,vb);
+  esp_timer_start_periodic(irHoldTimer,period);
+  xSemaphoreGive(irHoldMutex);
+  
+  //send first (full) frame
+  SENDIRKEEP(entry->buffer,entry->count);
+  xSemaphoreGive(irCacheMutex);
+  ESP_LOGI(LOG_TAG,"Holding IR cmd %s (%s), repeat every %uus", \
+    cmdName,ir_protocol_name(entry->code.protocol),period);
+  
+  //create tone
+  TONE(TONE_IR_SEND_FREQ,TONE_IR_SEND_DURATION);
+  return ESP_OK;
+}
+
+/** @brief FUNCTION - Stop repeating a held IR command
+ * 
+ * @param vb Virtual button which was released. Only if it started
+ * the repeating, it is stopped. Use IR_HOLD_ALL to stop in any case.
+ * @see fct_infrared_hold_start
+ * */
+void fct_infrared_hold_stop(uint8_t vb)
+{
+  if(irHoldMutex == NULL) return;
+  xSemaphoreTake(irHoldMutex,portMAX_DELAY);
+  //the timer callback cannot send while the mutex is held
+  if(ir_hold_stop(&irHold,vb,50))
+  {
+    esp_timer_stop(irHoldTimer);
+    if(irHold.stale != NULL) ESP_LOGW(LOG_TAG,"IR repeat frame still sending, freed later");
+  }
+  xSemaphoreGive(irHoldMutex);
+}
+
+/** @brief FUNCTION - Get IR cache & latency statistics
+ * 
+ * @param stats Pointer where the statistics are copied to
+ * @see fct_infrared_stats_t
+ * */
+void fct_infrared_get_stats(fct_infrared_stats_t *stats)
+{
+  if(stats != NULL) memcpy(stats,&irStats,sizeof(fct_infrared_stats_t));
+}
+
+/** @brief FUNCTION - Initialize the infrared functions
+ * 
+ * Creates the mutexes for the IR waveform cache and the timer for
+ * repeating held commands.
+ * 
+ * @return ESP_OK on success, ESP_FAIL otherwise
+ * */
+esp_err_t fct_infrared_init(void)
+{
+  if(irCacheMutex != NULL) return ESP_OK;
+  memset(irCache,0,sizeof(irCache));
+  memset(irCacheStale,0,sizeof(irCacheStale));
+  memset(&irStats,0,sizeof(irStats));
+  ir_hold_init(&irHold,0);
+  irCacheMutex = RTOS_MUTEX_CREATE();
+  irHoldMutex = RTOS_MUTEX_CREATE();
+  if(irCacheMutex == NULL || irHoldMutex == NULL)
+  {
+    ESP_LOGE(LOG_TAG,"Cannot create IR mutex");
+    return ESP_FAIL;
+  }
+  
+  //timer for repeating held commands
+  esp_timer_create_args_t args = {
+    .callback = fct_infrared_hold_timer,
+    .arg = NULL,
+    .name = "irhold"
+  };
+  if(esp_timer_create(&args,&irHoldTimer) != ESP_OK)
+  {
+    ESP_LOGE(LOG_TAG,"Cannot create IR hold timer");
+    return ESP_FAIL;
+  }
+  return ESP_OK;
 }
 
 /** @brief FUNCTION - Trigger an IR command recording.
@@ -100,18 +416,18 @@ esp_err_t fct_infrared_record(char* cmdName, uint8_t outputtoserial)
   
   //create the IR struct
   halIOIR_t *cfg = malloc(sizeof(halIOIR_t));
-  rmt_item32_t *buf = malloc(sizeof(rmt_item32_t)*TASK_HAL_IR_RECV_MAXIMUM_EDGES);
-  cfg->buffer = buf;
-  cfg->status = IR_RECEIVING;
   
   //check if memory was allocated
-  if(buf == NULL || cfg == NULL)
+  if(cfg == NULL)
   {
     ESP_LOGE(LOG_TAG,"Error allocating IR memory");
-    if(buf != NULL) free(buf);
-    if(cfg != NULL) free(cfg);
     return ESP_FAIL;
   }
+  //edge buffer is allocated by the receiving task, growing as needed
+  cfg->buffer = NULL;
+  cfg->count = 0;
+  cfg->status = IR_RECEIVING;
+  cfg->code.protocol = IR_PROTO_RAW;
   
   
   //put it to queue
@@ -128,7 +444,6 @@ esp_err_t fct_infrared_record(char* cmdName, uint8_t outputtoserial)
       ESP_LOGW(LOG_TAG,"IR timeout waiting for status change");
       //free buffers
       free(cfg);
-      free(buf);
       return ESP_FAIL;
     }
   }
@@ -138,17 +453,22 @@ esp_err_t fct_infrared_record(char* cmdName, uint8_t outputtoserial)
     case IR_TOOSHORT:
       ESP_LOGW(LOG_TAG,"IR cmd too short");
       //free buffers
+      free(cfg->buffer);
       free(cfg);
-      free(buf);
       return ESP_FAIL;
     case IR_FINISHED:
+      //try to decode a known protocol, stored compact if successful
+      if(ir_protocol_decode(cfg->buffer,cfg->count,&cfg->code) != ESP_OK)
+      {
+        ESP_LOGI(LOG_TAG,"Unknown IR protocol, storing raw edges");
+      }
       //finished, storing
       if(halStorageStartTransaction(&tid, 20,LOG_TAG) != ESP_OK)
       {
         ESP_LOGE(LOG_TAG,"Cannot start transaction");
         //free buffers
+        free(cfg->buffer);
         free(cfg);
-        free(buf);
         return ESP_FAIL;
       }
       if(halStorageStoreIR(tid, cfg, cmdName) != ESP_OK)
@@ -161,12 +481,17 @@ esp_err_t fct_infrared_record(char* cmdName, uint8_t outputtoserial)
       //send out a hex stream, if enabled
       if(outputtoserial != 0)
       {
-        char output[8*cfg->count + 4];
-        for(uint16_t i = 0; i<cfg->count; i++)
+        //might be long, don't put it on the stack
+        char *output = malloc(10*cfg->count + 1);
+        if(output != NULL)
         {
-          sprintf(&output[i*8],"%08X\r\n",cfg->buffer[i].val);
+          for(uint16_t i = 0; i<cfg->count; i++)
+          {
+            sprintf(&output[i*10],"%08X\r\n",cfg->buffer[i].val);
+          }
+          halSerialSendUSBSerial(output,10*cfg->count,10);
+          free(output);
         }
-        halSerialSendUSBSerial(output,strnlen(output,8*cfg->count + 4),10);
       } else {
 		halSerialSendUSBSerial("OK",2,10); 
 	  }
@@ -174,21 +499,21 @@ esp_err_t fct_infrared_record(char* cmdName, uint8_t outputtoserial)
     case IR_OVERFLOW:
       ESP_LOGW(LOG_TAG,"IR cmd too long");
       //free buffers
+      free(cfg->buffer);
       free(cfg);
-      free(buf);
       return ESP_FAIL;
     default:
       ESP_LOGE(LOG_TAG,"Unknown IR recv status");
       //free buffers
+      free(cfg->buffer);
       free(cfg);
-      free(buf);
       return ESP_FAIL;
   }
 
   //everything fine...
   //free buffers
+  free(cfg->buffer);
   free(cfg);
-  free(buf);
   return ESP_OK;
 }
 
@@ -35,12 +35,38 @@
 #include <freertos/FreeRTOS.h>
 #include <freertos/event_groups.h>
 #include <freertos/queue.h>
+#include <freertos/semphr.h>
 #include <esp_log.h>
 //used for rmt_item32_t type
 #include "driver/rmt.h"
+//used for measuring load/send latency
+#include "esp_timer.h"
 //common definitions & data for all of these functional tasks
 #include "common.h"
 #include "../config_switcher.h"
+//decoding/encoding of IR protocols
+#include "infrared_protocols.h"
+//repeat scheduling of held commands (IR_HOLD_ALL, IR_HOLD_DEFAULT_INTERVAL)
+#include "ir_hold.h"
+
+/** @brief Count of IR waveforms kept in RAM for repeated sending
+ * @see fct_infrared_send */
+#define IR_CACHE_ENTRIES 4
+
+/** @brief Maximum ticks to wait for the IR cache (another command is sent) */
+#define IR_CACHE_WAIT 20
+
+/** @brief Statistics of the IR waveform cache & sending latency */
+typedef struct fct_infrared_stats {
+  /** @brief Count of sent commands, which were cached */
+  uint32_t hits;
+  /** @brief Count of sent commands, which were loaded from storage */
+  uint32_t misses;
+  /** @brief Latency from calling fct_infrared_send until transmitted [us] */
+  uint32_t lastlatency;
+  /** @brief Maximum latency [us] */
+  uint32_t maxlatency;
+} fct_infrared_stats_t;
 
 /**@brief FUNCTION - Set the time between two IR edges which will trigger the timeout
  * (end of received command)
@@ -84,5 +110,45 @@ esp_err_t fct_infrared_record(char* cmdName, uint8_t outputtoserial);
  * */
 void fct_infrared_send(char* cmdName);
 
+/** @brief FUNCTION - Send an IR command & repeat it while the VB is held
+ * 
+ * The command is sent once (like fct_infrared_send), afterwards a
+ * periodic timer sends the protocol's repeat frame (e.g. NEC repeat code)
+ * or the full frame for raw commands, until fct_infrared_hold_stop is
+ * called for this VB.
+ * The interval is the protocol's frame period, or generalConfig_t.irrepeat
+ * if set (IR_HOLD_DEFAULT_INTERVAL for raw commands).
+ * 
+ * @param cmdName Name of the IR command
+ * @param vb Virtual button which holds this command
+ * @return ESP_OK if repeating is started, ESP_FAIL otherwise
+ * @see fct_infrared_hold_stop
+ * */
+esp_err_t fct_infrared_hold_start(char* cmdName, uint8_t vb);
+
+/** @brief FUNCTION - Stop repeating a held IR command
+ * 
+ * @param vb Virtual button which was released. Only if it started
+ * the repeating, it is stopped. Use IR_HOLD_ALL to stop in any case.
+ * @see fct_infrared_hold_start
+ * */
+void fct_infrared_hold_stop(uint8_t vb);
+
+/** @brief FUNCTION - Get IR cache & latency statistics
+ * 
+ * @param stats Pointer where the statistics are copied to
+ * @see fct_infrared_stats_t
+ * */
+void fct_infrared_get_stats(fct_infrared_stats_t *stats);
+
+/** @brief FUNCTION - Initialize the infrared functions
+ * 
+ * Creates the mutexes for the IR waveform cache and the timer for
+ * repeating held commands.
+ * 
+ * @return ESP_OK on success, ESP_FAIL otherwise
+ * */
+esp_err_t fct_infrared_init(void);
+
 
 #endif
@@ -34,6 +34,8 @@
 
 /** @brief Logging tag for this module */
 #define LOG_TAG "macro"
+/** @brief Log level of this module, DLOGx calls with a higher level are removed */
+#define LOG_LEVEL_MACROS ESP_LOG_INFO
 
 
 /**@brief FUNCTION - Macro execution
@@ -82,7 +84,7 @@ esp_err_t fct_macro(char *param)
         if(time < 30000)
         {
           vTaskDelay(time / portTICK_PERIOD_MS);
-          ESP_LOGD(LOG_TAG,"Waiting: %d ms",time);
+          DLOGD(LOG_LEVEL_MACROS,LOG_TAG,"Waiting: %d ms",time);
         } else {
           ESP_LOGE(LOG_TAG,"Hit AT WA with a delay time too high: %d",time);
         }
@@ -100,7 +102,10 @@ esp_err_t fct_macro(char *param)
           //save to queue struct
           command.buf = buffer;
           command.len = length;
+          //buffer is freed by the parser, cannot be deferred
+          #if LOG_LEVEL_MACROS >= ESP_LOG_DEBUG
           ESP_LOGD(LOG_TAG,"Sent AT cmd: %s",buffer);
+          #endif
           //send to queue, wait maximum 10 ticks (100ms) for a free space.
           if(xQueueSend(halSerialATCmds,(void*)&command,10) != pdTRUE)
           {
@@ -132,10 +132,8 @@ static void handler_hid(void *event_handler_arg, esp_event_base_t event_base, in
     }
     current = current->next;
   }
-  #if LOG_LEVEL_VB >= ESP_LOG_DEBUG
-  if(count == 0) ESP_LOGD(LOG_TAG,"Sent %d cmds for VB %d", count, vb & 0x7F);
-  #endif
-  if(count != 0) ESP_LOGI(LOG_TAG,"Sent %d cmds for VB %d: 0x%02X:0x%02X:0x%02X", \
+  if(count == 0) DLOGD(LOG_LEVEL_HID,LOG_TAG,"Sent %d cmds for VB %d", count, vb & 0x7F);
+  if(count != 0) DLOGI(LOG_LEVEL_HID,LOG_TAG,"Sent %d cmds for VB %d: 0x%02X:0x%02X:0x%02X", \
     count, vb & 0x7F,firsttriggered->cmd[0],firsttriggered->cmd[1],firsttriggered->cmd[2]);
   xSemaphoreGive(hidCmdSem);
 }
@@ -146,9 +144,8 @@ static void handler_hid(void *event_handler_arg, esp_event_base_t event_base, in
  * @return ESP_OK on success, ESP_FAIL on an error.*/
 esp_err_t handler_hid_init(void)
 {
-  //init HID mutex
-  if(hidCmdSem != NULL) vSemaphoreDelete(hidCmdSem);
-  hidCmdSem = xSemaphoreCreateMutex();
+  //init HID mutex (only once, it might be taken while re-initializing)
+  if(hidCmdSem == NULL) hidCmdSem = RTOS_MUTEX_CREATE();
   if(hidCmdSem == NULL)
   {
     ESP_LOGE(LOG_TAG,"Cannot create mutex, exiting!");
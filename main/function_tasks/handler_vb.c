@@ -108,6 +108,9 @@ static void handler_vb(void *event_handler_arg, esp_event_base_t event_base, int
   
   vb |= (*((uint32_t*) event_data)) & 0x7F;
   
+  //stop any IR command repeated while this VB was held
+  if((vb & 0x80) == 0) fct_infrared_hold_stop(vb);
+  
   //begin with head of chain
   vb_cmd_t *current = cmd_chain;
   //iterate through all available vb cmds
@@ -154,12 +157,20 @@ static void handler_vb(void *event_handler_arg, esp_event_base_t event_base, int
             fct_infrared_send(current->cmdparam);
           }
           break;
+        case T_SENDIR_HOLD:
+          if(current->cmdparam == NULL)
+          {
+            ESP_LOGE(LOG_TAG,"Param is null, cannot send IR");
+          } else {
+            fct_infrared_hold_start(current->cmdparam, vb & 0x7F);
+          }
+          break;
         case T_MQTT:
           if(current->cmdparam == NULL)
           {
             ESP_LOGE(LOG_TAG,"Param is null, cannot send MQTT publish");
           } else {
-            taskMQTTPublish(current->cmdparam);
+            taskMQTTPublishAction((mqtt_action_t*)current->cmdparam);
           }
           break;
         case T_REST:
@@ -190,9 +201,8 @@ static void handler_vb(void *event_handler_arg, esp_event_base_t event_base, int
  * @return ESP_OK on success, ESP_FAIL on an error.*/
 esp_err_t handler_vb_init(void)
 {
-  //init VB mutex
-  if(vbCmdSem != NULL) vSemaphoreDelete(vbCmdSem);
-  vbCmdSem = xSemaphoreCreateMutex();
+  //init VB mutex (only once, it might be taken while re-initializing)
+  if(vbCmdSem == NULL) vbCmdSem = RTOS_MUTEX_CREATE();
   if(vbCmdSem == NULL)
   {
     ESP_LOGE(LOG_TAG,"Cannot create mutex, exiting!");
@@ -410,6 +420,9 @@ esp_err_t handler_vb_setCmdChain(vb_cmd_t *chain)
  * */
 esp_err_t handler_vb_clearCmds(void)
 {
+  //the releasing VB might not be assigned anymore, stop repeating IR
+  fct_infrared_hold_stop(IR_HOLD_ALL);
+  
   if(cmd_chain == NULL)
   {
     ESP_LOGW(LOG_TAG,"VB cmds already empty");
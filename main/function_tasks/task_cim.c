@@ -1 +1,333 @@
- 
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ * Copyright 2019 Benjamin Aigner <aignerb@technikum-wien.at,
+ * beni@asterics-foundation.org>
+ */
+/**
+ * @file
+ * @brief CONTINOUS TASK - AsTeRICS CIM protocol on the serial port
+ *
+ * One task receives CIM packets from halSerialATCmds (same queue as
+ * the AT parser) and sends the periodic sensor frames in between.
+ * The queue receive timeout is the time until the next frame is due.
+ *
+ * @see task_cim.h
+ */
+
+#include "task_cim.h"
+#include "task_commands.h"
+#include "hal_io.h"
+#include "esp_system.h"
+#include <xtensa/hal.h>
+
+/** @brief Tag for ESP_LOG logging */
+#define LOG_TAG "task_cim"
+
+/** @brief Set a module-wide log level for the CIM task */
+#define LOG_LEVEL_CIM ESP_LOG_INFO
+
+/** @brief Handle of the CIM task, NULL if not running */
+static TaskHandle_t cimTask = NULL;
+
+/** @brief First packet, passed to the CIM task on start */
+static atcmd_t cimFirstPacket;
+
+/** @brief Current report period [ms], 0 if disabled */
+static uint16_t cimPeriod = CIM_PERIOD_DEFAULT;
+
+/** @brief 1 if periodic reports are started */
+static uint8_t cimStreaming = 0;
+
+/** @brief Serial number of the next event */
+static uint8_t cimEventSerial = 0;
+
+/** @brief Routing bits (DATATO_USB/DATATO_BLE) before entering CIM mode */
+static EventBits_t cimRouting = 0;
+
+/** @brief Transmit buffer, used by the CIM task only */
+static uint8_t cimTxBuffer[CIM_MAX_PACKET_LENGTH];
+
+/** @brief Feature addresses, sent in the feature list */
+static const uint16_t cimFeatures[] = {CIM_FEATURE_UNIQUENUMBER, \
+  CIM_FEATURE_SENSORS, CIM_FEATURE_PERIOD, CIM_FEATURE_LEDS, CIM_FEATURE_BUZZER};
+
+/** @brief Read a little endian 16bit value from packet data */
+static uint16_t taskCIMGet16(const uint8_t *p)
+{
+  return p[0] | (p[1] << 8);
+}
+
+/** @brief Build & send one CIM packet
+ * @param serial Serial number (request's serial number for replies)
+ * @param feature CIM feature address
+ * @param code Reply code
+ * @param data Data, may be NULL if length is 0
+ * @param length Length of data */
+static void taskCIMReply(uint8_t serial, uint16_t feature, uint16_t code, const void *data, uint16_t length)
+{
+  uint32_t len = cim_packet_build(cimTxBuffer, sizeof(cimTxBuffer), serial, feature, code, data, length);
+  if(len == 0 || halSerialSendUSBSerialRaw(cimTxBuffer, len, \
+    CIM_TX_TIMEOUT_MS / portTICK_PERIOD_MS) != (int)len)
+  {
+    ESP_LOGW(LOG_TAG,"Cannot send packet, feature 0x%04X",feature);
+  }
+}
+
+/** @brief Send the last sensor sample
+ * @param serial Serial number
+ * @param code Reply code (CIM_CMD_READ or CIM_REPLY_EVENT) */
+static void taskCIMSendFrame(uint8_t serial, uint16_t code)
+{
+  uint32_t start = xthal_get_ccount();
+  adcTelemetry_t sample;
+
+  halAdcGetLastSample(&sample);
+  taskCIMReply(serial, CIM_FEATURE_SENSORS, code, &sample, sizeof(sample));
+  metricsMax(METRIC_CIM_FRAME_CYCLES, xthal_get_ccount() - start);
+}
+
+/** @brief Process a read request
+ * @param p Received packet */
+static void taskCIMRead(cim_packet_t *p)
+{
+  uint8_t mac[6];
+
+  switch(p->feature)
+  {
+    case CIM_FEATURE_UNIQUENUMBER:
+      esp_efuse_mac_get_default(mac);
+      taskCIMReply(p->serial, p->feature, p->code, &mac[2], 4);
+      break;
+    case CIM_FEATURE_SENSORS:
+      taskCIMSendFrame(p->serial, p->code);
+      break;
+    case CIM_FEATURE_PERIOD:
+      taskCIMReply(p->serial, p->feature, p->code, &cimPeriod, sizeof(cimPeriod));
+      break;
+    case CIM_FEATURE_LEDS:
+    case CIM_FEATURE_BUZZER:
+      taskCIMReply(p->serial, p->feature, p->code | CIM_REPLY_ERR_CMD, NULL, 0);
+      break;
+    default:
+      taskCIMReply(p->serial, p->feature, p->code | CIM_REPLY_ERR_FEATURE, NULL, 0);
+      break;
+  }
+}
+
+/** @brief Process a write request
+ * @param p Received packet */
+static void taskCIMWrite(cim_packet_t *p)
+{
+  uint16_t code = p->code;
+
+  switch(p->feature)
+  {
+    case CIM_FEATURE_PERIOD:
+    {
+      if(p->length != 2) { code |= CIM_REPLY_ERR_DATA; break; }
+      uint16_t period = taskCIMGet16(p->data);
+      if(period != 0 && (period < CIM_PERIOD_MIN || period > CIM_PERIOD_MAX))
+      {
+        code |= CIM_REPLY_ERR_DATA;
+        break;
+      }
+      cimPeriod = period;
+      ESP_LOGI(LOG_TAG,"Report period: %dms",cimPeriod);
+      break;
+    }
+    case CIM_FEATURE_LEDS:
+      if(p->length != 3) { code |= CIM_REPLY_ERR_DATA; break; }
+      LED(p->data[0],p->data[1],p->data[2],LED_ANIM_STEADY);
+      break;
+    case CIM_FEATURE_BUZZER:
+      if(p->length != 4) { code |= CIM_REPLY_ERR_DATA; break; }
+      TONE(taskCIMGet16(&p->data[0]),taskCIMGet16(&p->data[2]));
+      break;
+    case CIM_FEATURE_UNIQUENUMBER:
+    case CIM_FEATURE_SENSORS:
+      code |= CIM_REPLY_ERR_CMD;
+      break;
+    default:
+      code |= CIM_REPLY_ERR_FEATURE;
+      break;
+  }
+  taskCIMReply(p->serial, p->feature, code, NULL, 0);
+}
+
+/** @brief Process one received CIM packet
+ * @param buf Received packet
+ * @param len Length of the packet */
+static void taskCIMProcess(uint8_t *buf, uint16_t len)
+{
+  cim_packet_t p;
+  uint8_t list[2 + sizeof(cimFeatures)];
+
+  if(cim_packet_parse(buf, len, &p) != 0)
+  {
+    metricsInc(METRIC_CIM_ERRORS);
+    ESP_LOGW(LOG_TAG,"Invalid packet, len %d",len);
+    return;
+  }
+
+  if(p.areid < CIM_ARE_ID)
+  {
+    taskCIMReply(p.serial, p.feature, p.code | CIM_REPLY_ERR_ARE_VERSION, NULL, 0);
+    return;
+  }
+
+  switch(p.code)
+  {
+    case CIM_CMD_FEATURELIST:
+      //CIM ID, followed by all feature addresses
+      list[0] = CIM_ID_FLIPMOUSE & 0xFF;
+      list[1] = CIM_ID_FLIPMOUSE >> 8;
+      memcpy(&list[2], cimFeatures, sizeof(cimFeatures));
+      taskCIMReply(p.serial, p.feature, p.code, list, sizeof(list));
+      break;
+    case CIM_CMD_WRITE:
+      taskCIMWrite(&p);
+      break;
+    case CIM_CMD_READ:
+      taskCIMRead(&p);
+      break;
+    case CIM_CMD_RESET:
+      cimStreaming = 0;
+      cimPeriod = CIM_PERIOD_DEFAULT;
+      taskCIMReply(p.serial, p.feature, p.code, NULL, 0);
+      break;
+    case CIM_CMD_START:
+      cimStreaming = 1;
+      taskCIMReply(p.serial, p.feature, p.code, NULL, 0);
+      break;
+    case CIM_CMD_STOP:
+      cimStreaming = 0;
+      taskCIMReply(p.serial, p.feature, p.code, NULL, 0);
+      break;
+    default:
+      taskCIMReply(p.serial, p.feature, p.code | CIM_REPLY_ERR_CMD, NULL, 0);
+      break;
+  }
+}
+
+/** @brief Leave the CIM mode & restart the AT command parser
+ * @param cmd Received AT command, processed by the AT parser */
+static void taskCIMExit(atcmd_t *cmd)
+{
+  cimStreaming = 0;
+  //restore the HID routing
+  xEventGroupClearBits(connectionRoutingStatus,DATATO_CIM);
+  xEventGroupSetBits(connectionRoutingStatus,cimRouting);
+
+  //hand over the AT command, it must be processed before any later one
+  if(xQueueSendToFront(halSerialATCmds,cmd,0) != pdTRUE) free(cmd->buf);
+
+  cimTask = NULL;
+  if(taskCommandsRestart() != ESP_OK) ESP_LOGE(LOG_TAG,"Cannot restart AT parser");
+  else ESP_LOGI(LOG_TAG,"AT command received, leaving CIM mode");
+  vTaskDelete(NULL);
+}
+
+/** @brief CIM task
+ *
+ * Processes the CIM packets & sends the periodic sensor frames.
+ * @param param Pointer to the first packet (atcmd_t)
+ * */
+static void task_cim(void *param)
+{
+  atcmd_t recv = *(atcmd_t*)param;
+  TickType_t nextframe = xTaskGetTickCount();
+  uint8_t wasstreaming = 0;
+
+  //disable HID output while in CIM mode
+  cimRouting = xEventGroupGetBits(connectionRoutingStatus) & (DATATO_USB | DATATO_BLE);
+  xEventGroupClearBits(connectionRoutingStatus,DATATO_USB | DATATO_BLE);
+  xEventGroupSetBits(connectionRoutingStatus,DATATO_CIM);
+  ESP_LOGI(LOG_TAG,"CIM mode started");
+
+  taskCIMProcess(recv.buf, recv.len);
+  free(recv.buf);
+
+  while(1)
+  {
+    TickType_t period = cimPeriod / portTICK_PERIOD_MS;
+    TickType_t wait = portMAX_DELAY;
+    uint8_t streaming = cimStreaming && period != 0;
+
+    //first frame is sent right after the start
+    if(streaming && !wasstreaming) nextframe = xTaskGetTickCount();
+    wasstreaming = streaming;
+
+    if(streaming)
+    {
+      TickType_t now = xTaskGetTickCount();
+      wait = ((int32_t)(nextframe - now) > 0) ? (nextframe - now) : 0;
+    }
+
+    if(xQueueReceive(halSerialATCmds,&recv,wait) == pdTRUE)
+    {
+      METRICS_QUEUE_HWM(METRIC_HWM_ATCMDS,halSerialATCmds);
+      if(recv.buf == NULL) continue;
+      //anything else than a CIM packet is an AT command
+      if(recv.len < 2 || recv.buf[0] != CIM_HEADER_0 || recv.buf[1] != CIM_HEADER_1)
+      {
+        //does not return
+        taskCIMExit(&recv);
+      }
+      taskCIMProcess(recv.buf, recv.len);
+      free(recv.buf);
+      //a frame might be due already, checked below
+      streaming = cimStreaming && period != 0;
+    }
+
+    if(streaming && (int32_t)(xTaskGetTickCount() - nextframe) >= 0)
+    {
+      taskCIMSendFrame(cimEventSerial++, CIM_REPLY_EVENT);
+      metricsInc(METRIC_CIM_FRAMES);
+      nextframe += period;
+      //don't send a burst of frames if we are late (e.g., UART was busy)
+      if((int32_t)(xTaskGetTickCount() - nextframe) >= 0) nextframe = xTaskGetTickCount() + period;
+    }
+  }
+}
+
+/** @brief Start the CIM task
+ *
+ * Called by task_commands, if a CIM packet is received. The packet is
+ * passed to the CIM task & processed there first.
+ * @param packet First CIM packet (allocated by halSerialRXTask). Freed
+ * by the CIM task on success, by the caller otherwise
+ * @param len Length of the packet
+ * @return ESP_OK on success, ESP_FAIL otherwise (task already running,
+ * cannot start task)
+ * */
+esp_err_t taskCIMStart(uint8_t *packet, uint16_t len)
+{
+  if(cimTask != NULL) return ESP_FAIL;
+  esp_log_level_set(LOG_TAG,LOG_LEVEL_CIM);
+
+  cimFirstPacket.buf = packet;
+  cimFirstPacket.len = len;
+  //heap allocated (not RTOS_TASK_CREATE), this task is deleted & restarted
+  if(xTaskCreatePinnedToCore(task_cim, "cim", TASK_CIM_STACKSIZE, &cimFirstPacket, \
+    TASK_CIM_PRIORITY, &cimTask, TASK_CORE_SYSTEM) != pdPASS)
+  {
+    ESP_LOGE(LOG_TAG,"Error creating CIM task");
+    cimTask = NULL;
+    return ESP_FAIL;
+  }
+  return ESP_OK;
+}
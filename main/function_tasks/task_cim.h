@@ -1 +1,114 @@
- 
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ * Copyright 2019 Benjamin Aigner <aignerb@technikum-wien.at,
+ * beni@asterics-foundation.org>
+ */
+/**
+ * @file
+ * @brief CONTINOUS TASK - AsTeRICS CIM protocol on the serial port
+ *
+ * The CIM mode is an alternative to the AT command parser: the FLipMouse
+ * is used as sensor input for the AsTeRICS Runtime Environment (ARE).
+ *
+ * Switching between both protocols:
+ * * task_commands receives a CIM packet ("@T", see halSerialRXTask), starts
+ *   this task (taskCIMStart) with this packet & deletes itself.
+ * * task_cim receives an AT command, puts it back to the front of the
+ *   queue, restarts the AT parser (taskCommandsRestart) & deletes itself.
+ *
+ * While in CIM mode, DATATO_USB/DATATO_BLE are cleared (no HID output)
+ * and DATATO_CIM is set. The previous routing is restored on exit.
+ *
+ * The CIM ID & feature addresses follow the Lipmouse CIM of the AsTeRICS
+ * project (ARE plugin "Lipmouse", LipmouseInstance.java), the FLipMouse is
+ * its successor. Data layouts are FLipMouse specific (little endian):
+ * | Address | Access | Data                                        | Lipmouse         |
+ * |---------|--------|---------------------------------------------|------------------|
+ * | 0x0000  | R      | Unique number (4 bytes, from the MAC)       | UNIQUENUMBER     |
+ * | 0x0001  | R/W    | Report period [ms] (uint16), 0 to disable   | SET_ADCPERIOD    |
+ * | 0x0002  | R      | Sensor frame (adcTelemetry_t, 18 bytes)     | ADCREPORT        |
+ * | 0x0003  | W      | LED color (r, g, b)                         | SET_LEDS         |
+ * | 0x0004  | -      | reserved, not implemented                   | BUTTONREPORT     |
+ * | 0x0010  | W      | Buzzer tone (frequency [Hz], duration [ms]) | FLipMouse only   |
+ *
+ * After CIM_CMD_START, sensor frames are sent periodically as events
+ * (feature 0x0002, reply code CIM_REPLY_EVENT) until CIM_CMD_STOP,
+ * CIM_CMD_RESET or an AT command.
+ * The sensor frame is the last sample of the ADC task (halAdcGetLastSample),
+ * frames are not synchronized to the ADC sampling.
+ *
+ * @see cim_packet.h
+ * @see METRIC_CIM_FRAMES
+ * @see METRIC_CIM_FRAME_CYCLES
+ */
+
+#ifndef _TASK_CIM_H
+#define _TASK_CIM_H
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/event_groups.h>
+#include <freertos/queue.h>
+#include <esp_log.h>
+//common definitions & data for all of these functional tasks
+#include "common.h"
+#include "hal_serial.h"
+#include "hal_adc.h"
+#include "metrics.h"
+#include "cim_packet.h"
+
+/** @brief Stack size for the CIM task */
+#define TASK_CIM_STACKSIZE 3072
+
+/** @brief CIM ID of the FLipMouse, sent in the feature list
+ * @note Same as the Lipmouse CIM (LipmouseInstance.java: LIPMOUSE_CIM_ID) */
+#define CIM_ID_FLIPMOUSE 0xA401
+
+/** @brief Feature: unique number (read), Lipmouse: UNIQUENUMBER */
+#define CIM_FEATURE_UNIQUENUMBER 0x0000
+/** @brief Feature: report period (read/write), Lipmouse: SET_ADCPERIOD */
+#define CIM_FEATURE_PERIOD 0x0001
+/** @brief Feature: sensor frame (read, periodic events), Lipmouse: ADCREPORT */
+#define CIM_FEATURE_SENSORS 0x0002
+/** @brief Feature: LED color (write), Lipmouse: SET_LEDS */
+#define CIM_FEATURE_LEDS 0x0003
+/** @brief Feature: buzzer tone (write)
+ * @note FLipMouse extension, outside of the Lipmouse address range */
+#define CIM_FEATURE_BUZZER 0x0010
+
+/** @brief Default report period [ms] */
+#define CIM_PERIOD_DEFAULT 20
+/** @brief Minimum report period [ms], same as the ADC sampling period */
+#define CIM_PERIOD_MIN 10
+/** @brief Maximum report period [ms] */
+#define CIM_PERIOD_MAX 1000
+
+/** @brief Maximum time to wait for the UART when sending [ms] */
+#define CIM_TX_TIMEOUT_MS 10
+
+/** @brief Start the CIM task
+ *
+ * Called by task_commands, if a CIM packet is received. The packet is
+ * passed to the CIM task & processed there first.
+ * @param packet First CIM packet (allocated by halSerialRXTask). Freed
+ * by the CIM task on success, by the caller otherwise
+ * @param len Length of the packet
+ * @return ESP_OK on success, ESP_FAIL otherwise (task already running,
+ * cannot start task)
+ * */
+esp_err_t taskCIMStart(uint8_t *packet, uint16_t len);
+
+#endif /* _TASK_CIM_H */
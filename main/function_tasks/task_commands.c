@@ -313,6 +313,52 @@ esp_err_t cmdFr(char* orig, void* p1, void* p2) {
     return ESP_OK;
   } else return ESP_FAIL;
 }
+esp_err_t cmdPc(char* orig, void* p1, void* p2) {
+  char str[48];
+  //registry metrics
+  for(uint8_t i = 0; i<METRIC_COUNT; i++)
+  {
+    sprintf(str,"PERF:%s=%"PRIu32,metricsName(i),metricsGet(i));
+    halSerialSendUSBSerial(str,strnlen(str,sizeof(str)),20);
+  }
+  //boot phases
+  const char *phase;
+  uint32_t timestamp;
+  for(uint8_t i = 0; i<METRICS_BOOT_PHASES; i++)
+  {
+    if(metricsGetBootPhase(i,&phase,&timestamp) == 0) break;
+    snprintf(str,sizeof(str),"PERF:boot_%s_us=%"PRIu32,phase,timestamp);
+    halSerialSendUSBSerial(str,strnlen(str,sizeof(str)),20);
+  }
+  //statistics of other modules
+  fct_infrared_stats_t ir;
+  fct_infrared_get_stats(&ir);
+  sprintf(str,"PERF:ir_cache_hits=%"PRIu32,ir.hits);
+  halSerialSendUSBSerial(str,strnlen(str,sizeof(str)),20);
+  sprintf(str,"PERF:ir_cache_misses=%"PRIu32,ir.misses);
+  halSerialSendUSBSerial(str,strnlen(str,sizeof(str)),20);
+  sprintf(str,"PERF:ir_max_latency_us=%"PRIu32,ir.maxlatency);
+  halSerialSendUSBSerial(str,strnlen(str,sizeof(str)),20);
+  mqtt_stats_t mqtt;
+  taskMQTTGetStats(&mqtt);
+  sprintf(str,"PERF:mqtt_published=%"PRIu32,mqtt.published);
+  halSerialSendUSBSerial(str,strnlen(str,sizeof(str)),20);
+  sprintf(str,"PERF:mqtt_dropped=%"PRIu32,mqtt.dropped);
+  halSerialSendUSBSerial(str,strnlen(str,sizeof(str)),20);
+  sprintf(str,"PERF:mqtt_max_latency_us=%"PRIu32,mqtt.maxlatency);
+  halSerialSendUSBSerial(str,strnlen(str,sizeof(str)),20);
+  //RAM usage & fragmentation
+  sprintf(str,"PERF:free_heap=%d",xPortGetFreeHeapSize());
+  halSerialSendUSBSerial(str,strnlen(str,sizeof(str)),20);
+  sprintf(str,"PERF:min_free_heap=%d",xPortGetMinimumEverFreeHeapSize());
+  halSerialSendUSBSerial(str,strnlen(str,sizeof(str)),20);
+  sprintf(str,"PERF:largest_free_block=%d",heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
+  halSerialSendUSBSerial(str,strnlen(str,sizeof(str)),20);
+  sprintf(str,"PERF:rtos_static_bytes=%"PRIu32,rtosStaticBytes);
+  halSerialSendUSBSerial(str,strnlen(str,sizeof(str)),20);
+  halSerialSendUSBSerial("END",strnlen("END",4),20);
+  return ESP_OK;
+}
 esp_err_t cmdPw(char* orig, void* p1, void* p2)
 {
   return halStorageNVSStoreString(NVS_WIFIPW,(char*)p1);
@@ -848,6 +894,19 @@ esp_err_t cmdIp(char* orig, void* p1, void* p2) {
   }
   return ESP_OK;
 }
+esp_err_t cmdIs(char* orig, void* p1, void* p2) {
+  if(requestVBUpdate == VB_SINGLESHOT)
+  {
+    //nothing to hold, send once
+    fct_infrared_send((char*)p1);
+  } else {
+    //set action type
+    vbaction.cmd = T_SENDIR_HOLD;
+    vbaction.cmdparam = malloc(strnlen((char*)p1,ATCMD_LENGTH)+1);
+    strncpy(vbaction.cmdparam,(char*)p1,strnlen((char*)p1,ATCMD_LENGTH)+1);
+  }
+  return ESP_OK;
+}
 esp_err_t cmdIh(char* orig, void* p1, void* p2) {
   return ESP_OK;
 }
@@ -946,9 +1005,11 @@ esp_err_t cmdMq(char* orig, void* p1, void* p2) {
     return taskMQTTPublish((char*)p1);
   } else {
     //set action type
+    //parse once on assignment, cmdparam holds a mqtt_action_t
+    mqtt_action_t *action = taskMQTTParse((char*)p1);
+    if(action == NULL) return ESP_FAIL;
     vbaction.cmd = T_MQTT;
-    vbaction.cmdparam = malloc(strnlen((char*)p1,ATCMD_LENGTH)+1);
-    strncpy(vbaction.cmdparam,(char*)p1,strnlen((char*)p1,ATCMD_LENGTH)+1);
+    vbaction.cmdparam = (char*)action;
   }
   return ESP_OK;
 }
@@ -957,10 +1018,13 @@ esp_err_t cmdRe(char* orig, void* p1, void* p2) {
   {
     return taskREST((char*)p1);
   } else {
-    //set action type
+    //set action type, store a terminated copy of the URL
+    size_t len = strnlen((char*)p1,ATCMD_LENGTH);
+    vbaction.cmdparam = malloc(len+1);
+    if(vbaction.cmdparam == NULL) return ESP_FAIL;
+    memcpy(vbaction.cmdparam,p1,len);
+    vbaction.cmdparam[len] = '\0';
     vbaction.cmd = T_REST;
-    vbaction.cmdparam = malloc(strnlen((char*)p1,ATCMD_LENGTH)+1);
-    strncpy(vbaction.cmdparam,(char*)p1,strnlen((char*)p1,ATCMD_LENGTH)+1);
   }
   return ESP_OK;
 }
@@ -970,6 +1034,20 @@ esp_err_t cmdMh(char* orig, void* p1, void* p2) {
 esp_err_t cmdMl(char* orig, void* p1, void* p2) {
   return halStorageNVSStoreString(NVS_MQTT_DELIM,(char*)p1);
 }
+esp_err_t cmdMc(char* orig, void* p1, void* p2) {
+  return halStorageNVSStoreString(NVS_MQTT_CONTROL,(char*)p1);
+}
+esp_err_t cmdMp(char* orig, void* p1, void* p2) {
+  char perm[8];
+  sprintf(perm,"%d",(int32_t)p1);
+  return halStorageNVSStoreString(NVS_MQTT_CTRLPERM,perm);
+}
+esp_err_t cmdSi(char* orig, void* p1, void* p2) {
+  char timeout[8];
+  sprintf(timeout,"%d",(int32_t)p1);
+  halAdcSetIdleTimeout((int32_t)p1 * 1000);
+  return halStorageNVSStoreString(NVS_ADC_IDLETIMEOUT,timeout);
+}
 esp_err_t cmdWp(char* orig, void* p1, void* p2) {
   return halStorageNVSStoreString(NVS_STATIONPW,(char*)p1);
 }
@@ -995,6 +1073,7 @@ const onecmd_t commands[] = {
   {"AR", {PARAM_NUMBER,PARAM_NONE},{1,0},{500,0},cmdAr,0,NOCAST},
   {"AI", {PARAM_NUMBER,PARAM_NONE},{1,0},{500,0},cmdAi,0,NOCAST},
   {"FR", {PARAM_NONE,PARAM_NONE},{0,0},{0,0},cmdFr,0,NOCAST},
+  {"PC", {PARAM_NONE,PARAM_NONE},{0,0},{0,0},cmdPc,0,NOCAST},
   {"FB", {PARAM_NUMBER,PARAM_NONE},{0,0},{3,0},NULL,offsetof(CMD_TARGET_TYPE,feedback),UINT8},
   {"PW", {PARAM_STRING,PARAM_NONE},{8,0},{32,0},cmdPw,0,NOCAST},
   {"FW", {PARAM_NUMBER,PARAM_NONE},{2,0},{3,0},cmdFw,0,NOCAST},
@@ -1053,6 +1132,7 @@ const onecmd_t commands[] = {
   {"SS", {PARAM_NUMBER,PARAM_NONE},{0,0},{512,0},NULL,offsetof(CMD_TARGET_TYPE,adc.threshold_strongsip),UINT16},
   {"TP", {PARAM_NUMBER,PARAM_NONE},{512,0},{1023,0},NULL,offsetof(CMD_TARGET_TYPE,adc.threshold_puff),UINT16},
   {"SP", {PARAM_NUMBER,PARAM_NONE},{512,0},{1023,0},NULL,offsetof(CMD_TARGET_TYPE,adc.threshold_strongpuff),UINT16},
+  {"SI", {PARAM_NUMBER,PARAM_NONE},{0,0},{HAL_ADC_IDLE_TIMEOUT_MAX_S,0},cmdSi,0,NOCAST},
   
   // joystick commands
   {"JX", {PARAM_NUMBER,PARAM_NUMBER},{0,0},{1023,1},cmdJx,0,NOCAST},
@@ -1069,6 +1149,8 @@ const onecmd_t commands[] = {
   // IR commands
   {"IR", {PARAM_STRING,PARAM_NONE},{2,0},{32,0},cmdIr,0,NOCAST},
   {"IP", {PARAM_STRING,PARAM_NONE},{2,0},{32,0},cmdIp,0,NOCAST},
+  {"IS", {PARAM_STRING,PARAM_NONE},{2,0},{32,0},cmdIs,0,NOCAST},
+  {"IN", {PARAM_NUMBER,PARAM_NONE},{0,0},{1000,0},NULL,offsetof(CMD_TARGET_TYPE,irrepeat),UINT16},
   {"IH", {PARAM_STRING,PARAM_NONE},{2,0},{ATCMD_LENGTH-strlen(CMD_PREFIX)-CMD_LENGTH,0},cmdIh,0,NOCAST},
   {"IC", {PARAM_STRING,PARAM_NONE},{2,0},{32,0},cmdIc,0,NOCAST},
   {"IW", {PARAM_NONE,PARAM_NONE},{0,0},{0,0},cmdIw,0,NOCAST},
@@ -1080,6 +1162,8 @@ const onecmd_t commands[] = {
   {"RE", {PARAM_STRING,PARAM_NONE},{5,0},{514},cmdRe,0,NOCAST},
   {"MH", {PARAM_STRING,PARAM_NONE},{6,0},{100,0},cmdMh,0,NOCAST},
   {"ML", {PARAM_STRING,PARAM_NONE},{1,0},{1,0},cmdMl,0,NOCAST},
+  {"MC", {PARAM_STRING,PARAM_NONE},{0,0},{MQTT_CTRL_TOPIC_LENGTH-1,0},cmdMc,0,NOCAST},
+  {"MP", {PARAM_NUMBER,PARAM_NONE},{0,0},{MQTT_CTRL_VB|MQTT_CTRL_SLOT|MQTT_CTRL_AT,0},cmdMp,0,NOCAST},
   {"WP", {PARAM_STRING,PARAM_NONE},{0,0},{63,0},cmdWp,0,NOCAST},
   {"WH", {PARAM_STRING,PARAM_NONE},{4,0},{31,0},cmdWh,0,NOCAST},
 };
@@ -1442,6 +1526,23 @@ void task_commands(void *params)
       //if no command received, try again...
       if(received == -1 || commandBuffer == NULL) continue;
       
+      #ifdef DEVICE_FLIPMOUSE
+      //a CIM packet switches to the CIM protocol (AsTeRICS), this task
+      //is restarted by the CIM task on the next AT command.
+      if(received >= 2 && commandBuffer[0] == CIM_HEADER_0 && commandBuffer[1] == CIM_HEADER_1)
+      {
+        if(taskCIMStart(commandBuffer,received) == ESP_OK)
+        {
+          xEventGroupSetBits(systemStatus,SYSTEM_EMPTY_CMD_QUEUE);
+          currentCommandTask = NULL;
+          vTaskDelete(NULL);
+        }
+        ESP_LOGE(LOG_TAG,"Cannot start CIM mode");
+        free(commandBuffer);
+        continue;
+      }
+      #endif
+      
       //before we start parsing anything, we need to be sure
       //all global commands are cleared.
       memset(&mouse,0,sizeof(hid_cmd_t));
@@ -1715,6 +1816,8 @@ void storeSlot(char* slotname)
   halStorageStore(tid,outputstring,250);
   sprintf(outputstring,"AT FB %d\n",currentcfg->feedback);
   halStorageStore(tid,outputstring,250);
+  sprintf(outputstring,"AT IN %d\n",currentcfg->irrepeat);
+  halStorageStore(tid,outputstring,250);
   
   
   //return: 0 if nothing is active, 1 for USB only, 2 for BLE only, 3 for both
@@ -1766,7 +1869,7 @@ esp_err_t taskCommandsInit(void)
   //set log level to given log level
   esp_log_level_set(LOG_TAG,LOG_LEVEL_CMDPARSER);
   //create receive task
-  xTaskCreate(task_commands, "cmdtask", TASK_COMMANDS_STACKSIZE, NULL, TASK_COMMANDS_PRIORITY, &currentCommandTask);
+  xTaskCreatePinnedToCore(task_commands, "cmdtask", TASK_COMMANDS_STACKSIZE, NULL, TASK_COMMANDS_PRIORITY, &currentCommandTask, TASK_CORE_SYSTEM);
   if(currentCommandTask == NULL)
   {
     ESP_LOGE(LOG_TAG,"Error initializing command parser task");
@@ -1784,7 +1887,7 @@ esp_err_t taskCommandsInit(void)
 esp_err_t taskCommandsRestart(void)
 {
   if(currentCommandTask != NULL) return ESP_FAIL;
-  xTaskCreate(task_commands, "uart_rx_task", TASK_COMMANDS_STACKSIZE, NULL, TASK_COMMANDS_PRIORITY, &currentCommandTask);
+  xTaskCreatePinnedToCore(task_commands, "uart_rx_task", TASK_COMMANDS_STACKSIZE, NULL, TASK_COMMANDS_PRIORITY, &currentCommandTask, TASK_CORE_SYSTEM);
   if(currentCommandTask != NULL) return ESP_OK;
   else return ESP_FAIL;
 }
@@ -53,15 +53,18 @@
 #include "esp_ota_ops.h"
 #include "esp_flash_partitions.h"
 #include "esp_partition.h"
+#include "esp_heap_caps.h"
 //common definitions & data for all of these functional tasks
 #include "common.h"
 #include <inttypes.h>
 
 #include "hal_serial.h"
+#include "metrics.h"
 #include "fct_infrared.h"
 #include "fct_macros.h"
 #include "handler_hid.h"
 #include "handler_vb.h"
+#include "task_cim.h"
 #include "keyboard.h"
 #include "../config_switcher.h"
 
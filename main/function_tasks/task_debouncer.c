@@ -261,8 +261,8 @@ void debouncerCallback(void *arg) {
       switch(virtualButton & 0x7F)
       {
         //tones for sip/puff
-        case VB_SIP: TONE(TONE_SIP_FREQ,TONE_SIP_DURATION); break;
-        case VB_PUFF: TONE(TONE_PUFF_FREQ,TONE_PUFF_DURATION); break;
+        case VB_SIP: TONEPRIO(TONE_SIP_FREQ,TONE_SIP_DURATION,HAL_IO_TONE_PRIO_LOW); break;
+        case VB_PUFF: TONEPRIO(TONE_PUFF_FREQ,TONE_PUFF_DURATION,HAL_IO_TONE_PRIO_LOW); break;
         //tones for StrongPuff + XXX 
         case VB_STRONGPUFF_UP:
         case VB_STRONGPUFF_DOWN:
@@ -417,6 +417,8 @@ void task_debouncer(void *param)
     
     if(xQueueReceive(debouncer_in,&evt,portMAX_DELAY) == pdTRUE)
     {
+      METRICS_QUEUE_HWM(METRIC_HWM_DEBOUNCER,debouncer_in);
+      metricsInc(METRIC_DEBOUNCE_EVENTS);
       if(evt.vb >= VB_MAX)
       {
         ESP_LOGE(LOG_TAG,"VB out of range!");
@@ -62,6 +62,7 @@
 #include <esp_timer.h>
 //common definitions & data for all of these functional tasks
 #include "common.h"
+#include "metrics.h"
 #include "../config_switcher.h"
 
 /** @brief Default time before debounce kicks in and a raw_action input
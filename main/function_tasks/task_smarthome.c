@@ -58,6 +58,38 @@
 /** @brief MQTT client handle, used for publishing */
 esp_mqtt_client_handle_t mqtt_client;
 
+/** @brief One message in the MQTT outbox */
+typedef struct mqtt_outbox_entry {
+  /** @brief Copy of the publish action */
+  mqtt_action_t *action;
+  /** @brief Time of the trigger [us], used for latency measurement */
+  int64_t queued;
+} mqtt_outbox_entry_t;
+
+/** @brief Outbox for messages which could not be published (yet)
+ * 
+ * Ring buffer, the oldest message is at mqttOutboxTail.
+ * @note Access only with mqttOutboxSem. */
+static mqtt_outbox_entry_t mqttOutbox[MQTT_OUTBOX_LENGTH];
+/** @brief Index of the oldest message in the outbox */
+static uint8_t mqttOutboxTail = 0;
+/** @brief Count of messages in the outbox */
+static uint8_t mqttOutboxCount = 0;
+/** @brief Mutex for the outbox and the publish statistics */
+static SemaphoreHandle_t mqttOutboxSem = NULL;
+/** @brief Publish statistics
+ * @see taskMQTTGetStats */
+static mqtt_stats_t mqttStats;
+
+/** @brief Base topic for inbound control, empty if disabled
+ * @see taskMQTTControlInit */
+static char mqttCtrlBase[MQTT_CTRL_TOPIC_LENGTH];
+/** @brief Permissions for inbound control
+ * @see MQTT_CTRL_DEFAULT */
+static uint8_t mqttCtrlPerm = MQTT_CTRL_DEFAULT;
+/** @brief Rate limiting: theoretical arrival time of the next message [us] */
+static int64_t mqttCtrlNext = 0;
+
 /** @brief Wifi config
  * @note if this is NOT global -> wifi is not working*/
 wifi_config_t wifi_config;
@@ -67,6 +99,7 @@ wifi_config_t wifi_config;
  * @see SH_WIFI_ACTIVE
  * @see SH_MQTT_INITIALIZED
  * @see SH_WIFI_INITIALIZED
+ * @see SH_REST_INITIALIZED
  * */
 EventGroupHandle_t smarthomestatus;
 
@@ -74,12 +107,13 @@ EventGroupHandle_t smarthomestatus;
 #define SH_MQTT_INITIALIZED (1<<1)
 #define SH_WIFI_ACTIVE (1<<2)
 #define SH_WIFI_INITIALIZED (1<<3)
+#define SH_REST_INITIALIZED (1<<4)
 
 /** @brief Check for eventgroup before accessing it. Will be initialized if not available
  * @return ESP_OK if create was sucessful or event group was already initialized. ESP_FAIL of creating failed.*/
 esp_err_t checkeventgroup(void)
 {
-  if(smarthomestatus == NULL) smarthomestatus = xEventGroupCreate();
+  if(smarthomestatus == NULL) smarthomestatus = RTOS_EVENTGROUP_CREATE();
   if(smarthomestatus == NULL) return ESP_FAIL;
   return ESP_OK;
 }
@@ -116,6 +150,232 @@ static esp_err_t wifi_sh_event_handler(void *ctx, system_event_t *event)
 }
 
 
+/** @brief Publish one message, update statistics
+ * 
+ * @note Call only with mqttOutboxSem taken.
+ * @param action Message to publish
+ * @param queued Time of the trigger [us]
+ * @return ESP_OK if published, ESP_FAIL if not connected or sending failed
+ * */
+static esp_err_t mqtt_send(const mqtt_action_t *action, int64_t queued)
+{
+  if(!(xEventGroupGetBits(smarthomestatus) & SH_MQTT_ACTIVE)) return ESP_FAIL;
+  
+  if(esp_mqtt_client_publish(mqtt_client, action->topic, action->payload, \
+    action->payloadlen, action->qos, 0) < 0)
+  {
+    return ESP_FAIL;
+  }
+  
+  uint32_t latency = (uint32_t)(esp_timer_get_time() - queued);
+  mqttStats.published++;
+  mqttStats.lastlatency = latency;
+  if(latency > mqttStats.maxlatency) mqttStats.maxlatency = latency;
+  ESP_LOGD(LOG_TAG_MQTT,"Published %s @ %s, latency %" PRIu32 "us", \
+    action->payload,action->topic,latency);
+  return ESP_OK;
+}
+
+/** @brief Publish all messages of the outbox, in order
+ * 
+ * Stops at the first message which cannot be sent, it will be
+ * retried on the next call (next publish or reconnect).
+ * @note Call only with mqttOutboxSem taken.
+ * */
+static void mqtt_outbox_flush(void)
+{
+  while(mqttOutboxCount != 0)
+  {
+    mqtt_outbox_entry_t *entry = &mqttOutbox[mqttOutboxTail];
+    if(mqtt_send(entry->action,entry->queued) != ESP_OK) return;
+    free(entry->action);
+    entry->action = NULL;
+    mqttOutboxTail = (mqttOutboxTail + 1) % MQTT_OUTBOX_LENGTH;
+    mqttOutboxCount--;
+  }
+}
+
+/** @brief Copy a publish action to the outbox
+ * 
+ * If the outbox is full, the oldest message is dropped.
+ * @note Call only with mqttOutboxSem taken.
+ * @param action Message to store
+ * @param queued Time of the trigger [us]
+ * @return ESP_OK if stored, ESP_FAIL otherwise (out of memory)
+ * */
+static esp_err_t mqtt_outbox_add(const mqtt_action_t *action, int64_t queued)
+{
+  size_t topiclen = strlen(action->topic);
+  mqtt_action_t *copy = malloc(sizeof(mqtt_action_t) + topiclen + action->payloadlen + 2);
+  if(copy == NULL)
+  {
+    ESP_LOGE(LOG_TAG_MQTT,"Error allocating outbox message");
+    return ESP_FAIL;
+  }
+  copy->topic = (char*)(copy + 1);
+  copy->payload = copy->topic + topiclen + 1;
+  copy->payloadlen = action->payloadlen;
+  copy->qos = action->qos;
+  memcpy(copy->topic,action->topic,topiclen + 1);
+  memcpy(copy->payload,action->payload,action->payloadlen + 1);
+  
+  //full: drop the oldest message
+  if(mqttOutboxCount == MQTT_OUTBOX_LENGTH)
+  {
+    ESP_LOGW(LOG_TAG_MQTT,"Outbox full, dropping %s @ %s", \
+      mqttOutbox[mqttOutboxTail].action->payload,mqttOutbox[mqttOutboxTail].action->topic);
+    free(mqttOutbox[mqttOutboxTail].action);
+    mqttOutboxTail = (mqttOutboxTail + 1) % MQTT_OUTBOX_LENGTH;
+    mqttOutboxCount--;
+    mqttStats.dropped++;
+  }
+  
+  uint8_t head = (mqttOutboxTail + mqttOutboxCount) % MQTT_OUTBOX_LENGTH;
+  mqttOutbox[head].action = copy;
+  mqttOutbox[head].queued = queued;
+  mqttOutboxCount++;
+  mqttStats.queued++;
+  return ESP_OK;
+}
+
+/** @brief Load inbound control base topic & permissions from NVS */
+static void mqtt_control_load(void)
+{
+  char perm[8];
+  
+  //a key which is not found returns ESP_OK without writing the buffer
+  perm[0] = '\0';
+  mqttCtrlBase[0] = '\0';
+  if(halStorageNVSLoadString(NVS_MQTT_CONTROL,mqttCtrlBase) != ESP_OK)
+  {
+    mqttCtrlBase[0] = '\0';
+  }
+  mqttCtrlPerm = MQTT_CTRL_DEFAULT;
+  if(halStorageNVSLoadString(NVS_MQTT_CTRLPERM,perm) == ESP_OK && perm[0] != '\0')
+  {
+    mqttCtrlPerm = atoi(perm) & (MQTT_CTRL_VB | MQTT_CTRL_SLOT | MQTT_CTRL_AT);
+  }
+}
+
+/** @brief Rate limiting for inbound control
+ * 
+ * Allows MQTT_CTRL_RATE messages per second, with bursts of
+ * MQTT_CTRL_BURST messages.
+ * @param now Current time [us]
+ * @return ESP_OK if the message is allowed, ESP_FAIL otherwise
+ * */
+static esp_err_t mqtt_control_ratelimit(int64_t now)
+{
+  const int64_t interval = 1000000 / MQTT_CTRL_RATE;
+  int64_t next = (mqttCtrlNext > now) ? mqttCtrlNext : now;
+  if(next - now > (MQTT_CTRL_BURST - 1) * interval) return ESP_FAIL;
+  mqttCtrlNext = next + interval;
+  return ESP_OK;
+}
+
+/** @brief Handle one inbound control message
+ * 
+ * The topic is mapped to a VB event, slot switch or AT command,
+ * which is injected in the corresponding queue.
+ * 
+ * @see taskMQTTControlInit
+ * @param event MQTT data event
+ * @return ESP_OK if the action was injected, ESP_FAIL otherwise
+ * */
+static esp_err_t mqtt_control_handle(esp_mqtt_event_handle_t event)
+{
+  int64_t now = esp_timer_get_time();
+  size_t baselen = strlen(mqttCtrlBase);
+  char param[SLOTNAME_LENGTH];
+  const char *sub;
+  int sublen;
+  
+  //only topics below our base topic
+  if(baselen == 0 || event->topic_len <= (int)baselen + 1 || \
+    strncmp(event->topic,mqttCtrlBase,baselen) != 0 || event->topic[baselen] != '/')
+  {
+    return ESP_FAIL;
+  }
+  sub = event->topic + baselen + 1;
+  sublen = event->topic_len - baselen - 1;
+  
+  //fragmented messages are not supported, control messages are short
+  if(event->current_data_offset != 0 || event->data_len != event->total_data_len)
+  {
+    ESP_LOGW(LOG_TAG_MQTT,"Control: fragmented message on %.*s",sublen,sub);
+    return ESP_FAIL;
+  }
+  
+  if(mqtt_control_ratelimit(now) != ESP_OK)
+  {
+    ESP_LOGW(LOG_TAG_MQTT,"Control: rate limit, dropping %.*s",sublen,sub);
+    return ESP_FAIL;
+  }
+  
+  //VB press/release, directly to the debouncer
+  if(sublen > 3 && sublen <= 6 && strncmp(sub,"vb/",3) == 0)
+  {
+    raw_action_t evt;
+    evt.vb = 0;
+    evt.payload = NULL;
+    for(int i = 3; i<sublen; i++)
+    {
+      if(sub[i] < '0' || sub[i] > '9') return ESP_FAIL;
+      evt.vb = evt.vb * 10 + (sub[i] - '0');
+    }
+    if(!(mqttCtrlPerm & MQTT_CTRL_VB) || evt.vb >= VB_MAX)
+    {
+      ESP_LOGW(LOG_TAG_MQTT,"Control: VB %" PRIu32 " not allowed",evt.vb);
+      return ESP_FAIL;
+    }
+    if(event->data_len == 5 && strncmp(event->data,"press",5) == 0) evt.type = VB_PRESS_EVENT;
+    else if(event->data_len == 7 && strncmp(event->data,"release",7) == 0) evt.type = VB_RELEASE_EVENT;
+    else return ESP_FAIL;
+    
+    if(xQueueSendToBack(debouncer_in,&evt,0) != pdTRUE) return ESP_FAIL;
+    
+  //slot switch, directly to the config switcher
+  } else if(sublen == 4 && strncmp(sub,"slot",4) == 0) {
+    if(!(mqttCtrlPerm & MQTT_CTRL_SLOT))
+    {
+      ESP_LOGW(LOG_TAG_MQTT,"Control: slot switch not allowed");
+      return ESP_FAIL;
+    }
+    if(event->data_len == 0 || event->data_len >= SLOTNAME_LENGTH) return ESP_FAIL;
+    memset(param,0,SLOTNAME_LENGTH);
+    memcpy(param,event->data,event->data_len);
+    
+    if(config_switcher == NULL || xQueueSend(config_switcher,param,0) != pdTRUE) return ESP_FAIL;
+    
+  //AT command, to the command parser
+  } else if(sublen == 2 && strncmp(sub,"at",2) == 0) {
+    if(!(mqttCtrlPerm & MQTT_CTRL_AT))
+    {
+      ESP_LOGW(LOG_TAG_MQTT,"Control: AT commands not allowed");
+      return ESP_FAIL;
+    }
+    if(event->data_len == 0 || event->data_len >= ATCMD_LENGTH) return ESP_FAIL;
+    //payload will be freed in receiving task
+    atcmd_t cmd;
+    cmd.buf = malloc(event->data_len + 1);
+    if(cmd.buf == NULL) return ESP_FAIL;
+    memcpy(cmd.buf,event->data,event->data_len);
+    cmd.buf[event->data_len] = '\0';
+    cmd.len = event->data_len + 1;
+    if(xQueueSend(halSerialATCmds,&cmd,0) != pdTRUE)
+    {
+      free(cmd.buf);
+      return ESP_FAIL;
+    }
+  } else {
+    return ESP_FAIL;
+  }
+  
+  ESP_LOGD(LOG_TAG_MQTT,"Control: %.*s = %.*s, injected in %lldus",sublen,sub, \
+    event->data_len,event->data,(long long)(esp_timer_get_time() - now));
+  return ESP_OK;
+}
+
 /** @brief Default event_handler for mqtt
  * 
  * This is basically the protocols/mqtt/tcp example's handler code.
@@ -128,8 +388,26 @@ static esp_err_t mqtt_event_handler(esp_mqtt_event_handle_t event)
         case MQTT_EVENT_CONNECTED:
             ESP_LOGI(LOG_TAG_MQTT, "MQTT_EVENT_CONNECTED");
             xEventGroupSetBits(smarthomestatus, SH_MQTT_ACTIVE);
-            //if we got connected -> start
-            esp_mqtt_client_start(mqtt_client);
+            //(re-)connected -> send everything which was triggered while offline
+            if(xSemaphoreTake(mqttOutboxSem,MQTT_OUTBOX_WAIT) == pdTRUE)
+            {
+              if(mqttOutboxCount != 0)
+              {
+                ESP_LOGI(LOG_TAG_MQTT,"Sending %d messages from outbox",mqttOutboxCount);
+              }
+              mqtt_outbox_flush();
+              xSemaphoreGive(mqttOutboxSem);
+            }
+            //(re-)subscribe the inbound control topics
+            if(mqttCtrlBase[0] != '\0')
+            {
+              char topic[MQTT_CTRL_TOPIC_LENGTH + 2];
+              snprintf(topic,sizeof(topic),"%s/#",mqttCtrlBase);
+              if(esp_mqtt_client_subscribe(mqtt_client,topic,0) < 0)
+              {
+                ESP_LOGE(LOG_TAG_MQTT,"Error subscribing %s",topic);
+              }
+            }
             break;
         case MQTT_EVENT_DISCONNECTED:
             ESP_LOGI(LOG_TAG_MQTT, "MQTT_EVENT_DISCONNECTED");
@@ -146,9 +424,14 @@ static esp_err_t mqtt_event_handler(esp_mqtt_event_handle_t event)
             ESP_LOGI(LOG_TAG_MQTT, "MQTT_EVENT_PUBLISHED, msg_id=%d", event->msg_id);
             break;
         case MQTT_EVENT_DATA:
-            ESP_LOGI(LOG_TAG_MQTT, "MQTT_EVENT_DATA");
-            printf("TOPIC=%.*s\r\n", event->topic_len, event->topic);
-            printf("DATA=%.*s\r\n", event->data_len, event->data);
+            if(mqtt_control_handle(event) == ESP_OK)
+            {
+              mqttStats.ctrlreceived++;
+            } else {
+              mqttStats.ctrlrejected++;
+              ESP_LOGI(LOG_TAG_MQTT, "Ignored: %.*s = %.*s", event->topic_len, \
+                event->topic, event->data_len, event->data);
+            }
             break;
         case MQTT_EVENT_ERROR:
             ESP_LOGI(LOG_TAG_MQTT, "MQTT_EVENT_ERROR");
@@ -176,7 +459,8 @@ esp_err_t taskMQTTInit(void)
   if(checkeventgroup() != ESP_OK) return ESP_FAIL;
   
   //check if already initialized, if yes we are finished here, if no:
-  //set bit immediately and continue
+  //set bit immediately (no second init in parallel) and continue.
+  //On any error, the bit is cleared again to allow a retry.
   if(xEventGroupGetBits(smarthomestatus) & SH_MQTT_INITIALIZED) return ESP_OK;
   xEventGroupSetBits(smarthomestatus, SH_MQTT_INITIALIZED);
   
@@ -188,6 +472,18 @@ esp_err_t taskMQTTInit(void)
   
   //set the log level for MQTT
   esp_log_level_set(LOG_TAG_MQTT, LOG_LEVEL_MQTT);
+  
+  //inbound control settings are loaded on each init
+  mqtt_control_load();
+  
+  //the outbox is kept on a deinit/init cycle
+  if(mqttOutboxSem == NULL) mqttOutboxSem = RTOS_MUTEX_CREATE();
+  if(mqttOutboxSem == NULL)
+  {
+    ESP_LOGE(LOG_TAG_MQTT,"Error creating outbox mutex");
+    xEventGroupClearBits(smarthomestatus, SH_MQTT_INITIALIZED);
+    return ESP_FAIL;
+  }
 
   /** @brief MQTT broker host name/ip */
   char mqttbroker[101];
@@ -198,6 +494,7 @@ esp_err_t taskMQTTInit(void)
   if(ret != ESP_OK)
   {
     ESP_LOGE(LOG_TAG_MQTT,"Error reading MQTT broker, cannot connect: %d",ret);
+    xEventGroupClearBits(smarthomestatus, SH_MQTT_INITIALIZED);
     return ESP_FAIL;
   }
   
@@ -207,10 +504,47 @@ esp_err_t taskMQTTInit(void)
     .event_handle = mqtt_event_handler,
   };
   mqtt_client = esp_mqtt_client_init(&mqtt_cfg);
+  if(mqtt_client == NULL)
+  {
+    ESP_LOGE(LOG_TAG_MQTT,"Error init MQTT client");
+    xEventGroupClearBits(smarthomestatus, SH_MQTT_INITIALIZED);
+    return ESP_FAIL;
+  }
+  //connect; reconnecting is done by the client
+  if(esp_mqtt_client_start(mqtt_client) != ESP_OK)
+  {
+    ESP_LOGE(LOG_TAG_MQTT,"Error starting MQTT client");
+    esp_mqtt_client_destroy(mqtt_client);
+    mqtt_client = NULL;
+    xEventGroupClearBits(smarthomestatus, SH_MQTT_INITIALIZED);
+    return ESP_FAIL;
+  }
   
   return ESP_OK;
 }
 
+/** @brief Init the MQTT inbound control channel
+ * 
+ * If a base topic is set ("AT MC"), MQTT (and WiFi in station mode) are
+ * started and "<base>/#" is subscribed on each connect.
+ * 
+ * @see mqtt_control_handle
+ * @see NVS_MQTT_CONTROL
+ * @see NVS_MQTT_CTRLPERM
+ * @return ESP_OK on success or if no base topic is set, ESP_FAIL otherwise
+ * */
+esp_err_t taskMQTTControlInit(void)
+{
+  mqtt_control_load();
+  if(mqttCtrlBase[0] == '\0')
+  {
+    ESP_LOGD(LOG_TAG_MQTT,"No control topic set, inbound control disabled");
+    return ESP_OK;
+  }
+  ESP_LOGI(LOG_TAG_MQTT,"Control topic: %s/#, permissions 0x%02X",mqttCtrlBase,mqttCtrlPerm);
+  return taskMQTTInit();
+}
+
 /** @brief Init Wifi
  * 
  * This init function initializes the wifi in station mode.
@@ -355,9 +689,8 @@ esp_err_t taskWifiDeInit(void)
   return ESP_OK;
 }
 
-/** @brief Publish data via MQTT
+/** @brief Parse a MQTT publish action
  * 
- * This function publishes the given data.
  * The parameter topic_payload will be split into the topic name
  * and the corresponding payload to publish.
  * The splitting is done by the currently set MQTT delimiter character,
@@ -365,125 +698,403 @@ esp_err_t taskWifiDeInit(void)
  * if no other character is set.
  * 
  * @see MQTT_DELIMITER
- * @return ESP_OK on success, ESP_FAIL otherwise
+ * @param topic_payload Topic name and payload to be published. E.g.,
+ * "/topic1:ON". Delimiter can be changed via NVS key NVS_MQTT_DELIM.
+ * @return Pointer to the parsed action (free with free()), NULL on errors
  * */
-esp_err_t taskMQTTPublish(char* topic_payload)
+mqtt_action_t *taskMQTTParse(char* topic_payload)
 {
-  //we can call it multiple times, if the flag is set, init does nothing
-  if(taskMQTTInit() != ESP_OK)
-  {
-    ESP_LOGE(LOG_TAG_MQTT,"Error init MQTT");
-    return ESP_FAIL;
-  }
-  
   char delim[3] = ":";
   esp_err_t ret = halStorageNVSLoadString(NVS_MQTT_DELIM,delim);
   if(ret != ESP_OK)
   {
     ESP_LOGI(LOG_TAG_MQTT,"Using default delimiter");
-    delim[0] = ':';
+    delim[0] = MQTT_DELIMITER;
     delim[1] = '\0';
   }
   
-  
   //split into topic & payload
   char* sep = strpbrk(topic_payload,&delim[0]);
   if(sep == NULL)
   {
     ESP_LOGE(LOG_TAG_MQTT,"Wrong delimiter, cannot send MQTT message");
+    return NULL;
+  }
+  size_t topiclen = sep - topic_payload;
+  size_t payloadlen = strnlen(sep+1,ATCMD_LENGTH);
+  
+  //one allocation for the record, topic & payload
+  mqtt_action_t *action = malloc(sizeof(mqtt_action_t) + topiclen + payloadlen + 2);
+  if(action == NULL)
+  {
+    ESP_LOGE(LOG_TAG_MQTT,"Error allocating MQTT action");
+    return NULL;
+  }
+  action->topic = (char*)(action + 1);
+  action->payload = action->topic + topiclen + 1;
+  action->payloadlen = payloadlen;
+  action->qos = MQTT_ACTION_QOS;
+  memcpy(action->topic,topic_payload,topiclen);
+  action->topic[topiclen] = '\0';
+  memcpy(action->payload,sep+1,payloadlen);
+  action->payload[payloadlen] = '\0';
+  
+  return action;
+}
+
+/** @brief Publish a pre-parsed MQTT action
+ * 
+ * If the broker is connected and no older messages are waiting, the
+ * message is published immediately. Otherwise it is copied to the
+ * outbox, which is sent in order as soon as the client (re-)connects.
+ * 
+ * @param action Action to publish, created by taskMQTTParse
+ * @return ESP_OK if published or queued, ESP_FAIL otherwise
+ * @see MQTT_OUTBOX_LENGTH
+ */
+esp_err_t taskMQTTPublishAction(const mqtt_action_t *action)
+{
+  int64_t queued = esp_timer_get_time();
+  esp_err_t ret;
+  
+  if(action == NULL) return ESP_FAIL;
+  
+  //we can call it multiple times, if the flag is set, init does nothing
+  if(taskMQTTInit() != ESP_OK || mqttOutboxSem == NULL)
+  {
+    ESP_LOGE(LOG_TAG_MQTT,"Error init MQTT");
     return ESP_FAIL;
   }
-  //save topic data
-  char* topic = malloc(sep-topic_payload+1);
-  strncpy(topic,topic_payload,sep-topic_payload+1);
-  topic[sep-topic_payload] = '\0';
   
-  char* payload = malloc(strnlen(sep+1,200)+1);
-  strncpy(payload,sep+1,strnlen(sep+1,200)+1);
-  payload[strnlen(sep+1,200)] = '\0';
+  if(xSemaphoreTake(mqttOutboxSem,MQTT_OUTBOX_WAIT) != pdTRUE)
+  {
+    ESP_LOGE(LOG_TAG_MQTT,"Outbox busy, cannot publish %s",action->topic);
+    return ESP_FAIL;
+  }
   
-  ESP_LOGI(LOG_TAG_MQTT,"Publish: %s @ %s",payload,topic);
+  //older messages first, keep the order
+  mqtt_outbox_flush();
+  if(mqttOutboxCount == 0 && mqtt_send(action,queued) == ESP_OK)
+  {
+    ret = ESP_OK;
+  } else {
+    ESP_LOGI(LOG_TAG_MQTT,"Broker not reachable, queued %s @ %s",action->payload,action->topic);
+    ret = mqtt_outbox_add(action,queued);
+  }
   
-  //publish message
-  esp_mqtt_client_publish(mqtt_client, topic, payload, 0, 0, 0);
+  xSemaphoreGive(mqttOutboxSem);
+  return ret;
+}
+
+/** @brief Publish data via MQTT
+ * 
+ * Parses the given string (see taskMQTTParse) and publishes it
+ * (see taskMQTTPublishAction). Used for single shot "AT MQ" commands,
+ * VB actions are parsed only once on assignment.
+ * 
+ * @param topic_payload Topic name and payload to be published. E.g.,
+ * "/topic1:ON". Delimiter can be changed via NVS key NVS_MQTT_DELIM.
+ * @return ESP_OK on success, ESP_FAIL otherwise
+ * */
+esp_err_t taskMQTTPublish(char* topic_payload)
+{
+  mqtt_action_t *action = taskMQTTParse(topic_payload);
+  if(action == NULL) return ESP_FAIL;
+  esp_err_t ret = taskMQTTPublishAction(action);
+  free(action);
+  return ret;
+}
+
+/** @brief Get MQTT publish statistics
+ * 
+ * @param stats Pointer where the statistics are copied to
+ * @see mqtt_stats_t
+ * */
+void taskMQTTGetStats(mqtt_stats_t *stats)
+{
+  if(stats == NULL) return;
+  if(mqttOutboxSem != NULL && xSemaphoreTake(mqttOutboxSem,MQTT_OUTBOX_WAIT) == pdTRUE)
+  {
+    memcpy(stats,&mqttStats,sizeof(mqtt_stats_t));
+    xSemaphoreGive(mqttOutboxSem);
+  } else {
+    memcpy(stats,&mqttStats,sizeof(mqtt_stats_t));
+  }
+}
+
+/** @brief One queued REST call */
+typedef struct rest_request {
+  /** @brief URL to call, allocated by taskREST, freed by the dispatcher */
+  char *url;
+  /** @brief Time of the trigger [us], used for latency measurement */
+  int64_t queued;
+} rest_request_t;
+
+/** @brief One kept-alive HTTP connection of the REST pool */
+typedef struct rest_conn {
+  /** @brief HTTP client, NULL if this slot is unused */
+  esp_http_client_handle_t client;
+  /** @brief Host part of the URL ("http://host:port"), used as key */
+  char host[REST_HOST_LENGTH];
+  /** @brief Time of last successful request [us], used for LRU & idle timeout */
+  int64_t lastused;
+} rest_conn_t;
+
+/** @brief Queue of pending REST calls
+ * @see rest_request_t */
+static QueueHandle_t restQueue = NULL;
+
+/** @brief Pool of kept-alive connections, one per host
+ * @note Only accessed by the REST dispatcher task */
+static rest_conn_t restPool[REST_POOL_SIZE];
+
+/** @brief Extract the host part of an URL
+ * 
+ * Everything up to the first '/' after the scheme is used,
+ * e.g. "http://192.168.1.10:8080" for "http://192.168.1.10:8080/switch?on".
+ * 
+ * @param url Full URL
+ * @param host Buffer for the host part, REST_HOST_LENGTH bytes
+ * */
+static void rest_host(const char *url, char *host)
+{
+  const char *start = strstr(url,"://");
+  start = (start != NULL) ? start + 3 : url;
+  size_t len = strcspn(start,"/?") + (start - url);
+  if(len >= REST_HOST_LENGTH) len = REST_HOST_LENGTH - 1;
+  memcpy(host,url,len);
+  host[len] = '\0';
+}
+
+/** @brief Close a pooled connection & free this slot */
+static void rest_pool_drop(rest_conn_t *conn)
+{
+  if(conn->client != NULL)
+  {
+    ESP_LOGD(LOG_TAG_REST,"Closing connection to %s",conn->host);
+    esp_http_client_cleanup(conn->client);
+  }
+  conn->client = NULL;
+  conn->host[0] = '\0';
+}
+
+/** @brief Close all connections, which were idle longer than REST_KEEPALIVE_MS */
+static void rest_pool_close_idle(void)
+{
+  int64_t now = esp_timer_get_time();
+  for(uint8_t i = 0; i<REST_POOL_SIZE; i++)
+  {
+    if(restPool[i].client != NULL && \
+      (now - restPool[i].lastused) > (int64_t)REST_KEEPALIVE_MS*1000)
+    {
+      rest_pool_drop(&restPool[i]);
+    }
+  }
+}
+
+/** @brief Get the pooled connection for a host or create a new one
+ * 
+ * If no connection to this host is available, a free slot or (if all
+ * are used) the least recently used slot is (re-)initialized.
+ * 
+ * @param host Host part of the URL, used as key
+ * @param url Full URL, used for initializing a new client
+ * @return Pointer to the pool slot, NULL if the client cannot be created
+ * */
+static rest_conn_t *rest_pool_get(const char *host, const char *url)
+{
+  rest_conn_t *slot = &restPool[0];
   
-  //free allocated strings
-  if(topic != NULL) free(topic);
-  if(payload != NULL) free(payload);
+  for(uint8_t i = 0; i<REST_POOL_SIZE; i++)
+  {
+    //connection to this host is available
+    if(restPool[i].client != NULL && strcmp(restPool[i].host,host) == 0)
+    {
+      return &restPool[i];
+    }
+    //prefer a free slot, otherwise the least recently used one
+    if(slot->client != NULL && \
+      (restPool[i].client == NULL || restPool[i].lastused < slot->lastused))
+    {
+      slot = &restPool[i];
+    }
+  }
   
-  return ESP_OK;
+  rest_pool_drop(slot);
+  //init with empty certificate, https is not supported
+  esp_http_client_config_t config = {
+      .cert_pem = "",
+      .url = url,
+      .timeout_ms = REST_TIMEOUT_MS
+  };
+  slot->client = esp_http_client_init(&config);
+  if(slot->client == NULL)
+  {
+    ESP_LOGE(LOG_TAG_REST,"Error init http client");
+    return NULL;
+  }
+  strncpy(slot->host,host,REST_HOST_LENGTH);
+  slot->lastused = esp_timer_get_time();
+  ESP_LOGD(LOG_TAG_REST,"New connection to %s",host);
+  return slot;
 }
 
-/** @brief Trigger a REST call via http/s GET
+/** @brief Send one REST call, using a pooled connection
  * 
- * This function calls the given URL via http/s GET.
- * If Wifi is not initialized, it will be started.
- * On the first call, there might be a delay until wifi is connected.
+ * On errors, the connection is closed and the call is retried with a
+ * new connection (a kept-alive connection might have been closed
+ * by the server in the meantime), up to REST_RETRIES times.
  * 
- * @note Wifi is activated here, if this was not done before. 
- * There might be a timeout or missed REST call if wifi is not active.
- * Nevertheless, we will wait 5s for the Wifi to be active.
+ * @param req Request to send
  * @return ESP_OK on success, ESP_FAIL otherwise
+ * */
+static esp_err_t rest_perform(rest_request_t *req)
+{
+  char host[REST_HOST_LENGTH];
+  rest_host(req->url,host);
+  
+  for(uint8_t attempt = 0; attempt <= REST_RETRIES; attempt++)
+  {
+    if(attempt != 0)
+    {
+      vTaskDelay(((REST_RETRY_DELAY_MS << (attempt-1)) / portTICK_PERIOD_MS) + 1);
+    }
+    
+    rest_conn_t *conn = rest_pool_get(host,req->url);
+    if(conn == NULL) continue;
+    
+    int64_t start = esp_timer_get_time();
+    esp_err_t ret = esp_http_client_set_url(conn->client,req->url);
+    if(ret == ESP_OK) ret = esp_http_client_perform(conn->client);
+    int64_t end = esp_timer_get_time();
+    
+    if(ret == ESP_OK)
+    {
+      conn->lastused = end;
+      ESP_LOGD(LOG_TAG_REST,"GET %s: status %d, trigger->request %lldus, request %lldus, attempt %d", \
+        req->url,esp_http_client_get_status_code(conn->client), \
+        (long long)(start - req->queued),(long long)(end - start),attempt+1);
+      return ESP_OK;
+    }
+    
+    ESP_LOGW(LOG_TAG_REST,"Error GET %s (attempt %d): %s",req->url,attempt+1,esp_err_to_name(ret));
+    rest_pool_drop(conn);
+  }
+  
+  ESP_LOGE(LOG_TAG_REST,"Giving up GET %s",req->url);
+  return ESP_FAIL;
+}
+
+/** @brief REST dispatcher task
+ * 
+ * Sends the queued REST calls one after another and closes
+ * idle connections.
  * 
- * @todo Implement a queue for REST commands. Currently, we will block here all handler_vb actions.
- * @todo Somewhere in storing the REST URL, we corrupt the heap by one byte (Bad head at 0x3ffe7f40. Expected 0xabba1234 got 0xabba0034)
+ * @see taskREST
  * */
-esp_err_t taskREST(char* uri)
+static void rest_task(void *param)
 {
-  //we can call it multiple times, if the flag is set, init does nothing
-  if(taskWifiInit() != ESP_OK)
+  rest_request_t req;
+  
+  while(1)
   {
-    ESP_LOGE(LOG_TAG_REST,"Error init WiFi");
-    return ESP_FAIL;
+    //wait for the next call, if nothing happens, check for idle connections
+    if(xQueueReceive(restQueue,&req,REST_KEEPALIVE_MS/portTICK_PERIOD_MS) == pdTRUE)
+    {
+      //wait for the WIFI_ACTIVE flag to be set (only blocks on the first call).
+      //if not set in time, just try anyway sending the REST call.
+      if(!(xEventGroupWaitBits(smarthomestatus,SH_WIFI_ACTIVE,pdFALSE, \
+        pdFALSE,REST_WIFI_WAIT_MS/portTICK_PERIOD_MS) & SH_WIFI_ACTIVE))
+      {
+        ESP_LOGW(LOG_TAG_REST,"WiFi not active, trying anyway");
+      }
+      rest_perform(&req);
+      free(req.url);
+    }
+    rest_pool_close_idle();
   }
-  //wait ~2s for the WIFI_ACTIVE flag to be set.
-  //if not set in time, just try anyway sending the REST call.
-  xEventGroupWaitBits(smarthomestatus,SH_WIFI_ACTIVE,pdFALSE, \
-    pdFALSE,5000/portTICK_PERIOD_MS);
+}
+
+/** @brief Init the REST dispatcher task & queue
+ * 
+ * @see SH_REST_INITIALIZED
+ * @return ESP_OK on success (or already initialized), ESP_FAIL otherwise
+ * */
+static esp_err_t taskRESTInit(void)
+{
+  if(checkeventgroup() != ESP_OK) return ESP_FAIL;
+  
+  //check if already initialized, if yes we are finished here, if no:
+  //set bit immediately and continue
+  if(xEventGroupGetBits(smarthomestatus) & SH_REST_INITIALIZED) return ESP_OK;
+  xEventGroupSetBits(smarthomestatus, SH_REST_INITIALIZED);
   
   //set log level
   esp_log_level_set(LOG_TAG_REST, LOG_LEVEL_REST);
   
-  //copy the given URL, because we cannot be sure how
-  //this string will be valid.
-  char* url = malloc(strnlen(uri,ATCMD_LENGTH)+1);
-  
-  if(url == NULL)
+  restQueue = RTOS_QUEUE_CREATE(REST_QUEUE_LENGTH,sizeof(rest_request_t));
+  if(restQueue == NULL)
   {
-    ESP_LOGE(LOG_TAG_REST,"Error malloc URI");
+    ESP_LOGE(LOG_TAG_REST,"Error creating REST queue");
+    xEventGroupClearBits(smarthomestatus, SH_REST_INITIALIZED);
     return ESP_FAIL;
   }
-  
-  strncpy(url,uri,strnlen(uri,ATCMD_LENGTH)+1);
-  
-  //init with empty config
-  esp_http_client_config_t config = {
-      .cert_pem = "",
-      .url = url
-  };
+  if(RTOS_TASK_CREATE(rest_task,"rest",TASK_REST_STACKSIZE,NULL, \
+    TASK_REST_PRIORITY,NULL,TASK_CORE_SYSTEM) != pdPASS)
+  {
+    ESP_LOGE(LOG_TAG_REST,"Error creating REST task");
+    vQueueDelete(restQueue);
+    restQueue = NULL;
+    xEventGroupClearBits(smarthomestatus, SH_REST_INITIALIZED);
+    return ESP_FAIL;
+  }
+  return ESP_OK;
+}
 
-  esp_http_client_handle_t client = esp_http_client_init(&config);
-  if(client == NULL)
+/** @brief Trigger a REST call via http GET
+ * 
+ * The given URL is copied and queued for the REST dispatcher task,
+ * this function does not block. The dispatcher waits for WiFi (on the
+ * first call), keeps the connection to each host alive for further calls
+ * and retries failed calls up to REST_RETRIES times.
+ * 
+ * @note Wifi is activated here, if this was not done before.
+ * @param uri URL to call, e.g. "http://192.168.1.10/switch?on"
+ * @return ESP_OK if the call is queued, ESP_FAIL otherwise (queue full,
+ * WiFi not available)
+ * @see REST_QUEUE_LENGTH
+ * @see REST_POOL_SIZE
+ * */
+esp_err_t taskREST(char* uri)
+{
+  //we can call it multiple times, if the flag is set, init does nothing
+  if(taskWifiInit() != ESP_OK)
   {
-    ESP_LOGE(LOG_TAG_REST,"Error init http client");
+    ESP_LOGE(LOG_TAG_REST,"Error init WiFi");
     return ESP_FAIL;
   }
-  //set the given URL
-  if(esp_http_client_set_url(client,uri) != ESP_OK)
+  if(taskRESTInit() != ESP_OK) return ESP_FAIL;
+  
+  //copy the given URL, because we cannot be sure how
+  //long this string will be valid.
+  rest_request_t req;
+  size_t len = strnlen(uri,ATCMD_LENGTH);
+  req.url = malloc(len+1);
+  if(req.url == NULL)
   {
-    ESP_LOGE(LOG_TAG_REST,"Error setting URI");
-    esp_http_client_cleanup(client);
+    ESP_LOGE(LOG_TAG_REST,"Error malloc URI");
     return ESP_FAIL;
   }
-  //preform call
-  if(esp_http_client_perform(client) != ESP_OK)
+  memcpy(req.url,uri,len);
+  req.url[len] = '\0';
+  req.queued = esp_timer_get_time();
+  
+  //never block the caller (VB handler / command parser)
+  if(xQueueSend(restQueue,&req,0) != pdTRUE)
   {
-    ESP_LOGE(LOG_TAG_REST,"Error http_client_perform");
-    esp_http_client_cleanup(client);
+    ESP_LOGW(LOG_TAG_REST,"REST queue full, dropping %s",req.url);
+    free(req.url);
     return ESP_FAIL;
   }
-  //cleanup & return
-  esp_http_client_cleanup(client);
   return ESP_OK;
 }
-
@@ -40,11 +40,13 @@
 #include <freertos/event_groups.h>
 #include <freertos/queue.h>
 #include <freertos/task.h>
+#include <freertos/semphr.h>
 #include <esp_log.h>
 //common definitions & data for all of these functional tasks
 #include "common.h"
 #include <inttypes.h>
 #include "hal_storage.h"
+#include "hal_serial.h"
 #include "lwip/sockets.h"
 #include "lwip/dns.h"
 #include "lwip/netdb.h"
@@ -56,6 +58,7 @@
 #include "esp_event_loop.h"
 #include "esp_event_legacy.h"
 #include "esp_http_client.h"
+#include "esp_timer.h"
 #include "nvs.h"
 #include "nvs_flash.h"
 #include "esp_log.h"
@@ -69,6 +72,105 @@
  * It is used to split the "AT MQ" string into topic and payload. */
 #define MQTT_DELIMITER ':'
 
+/** @brief QoS level used for MQTT publish actions
+ * @note QoS 1: the broker acknowledges each message. */
+#define MQTT_ACTION_QOS 1
+
+/** @brief Count of MQTT publishes, which are kept while the broker is not reachable
+ * @note If the outbox is full, the oldest message is dropped. */
+#define MQTT_OUTBOX_LENGTH 16
+
+/** @brief Maximum ticks to wait for the MQTT outbox (another publish is sent) */
+#define MQTT_OUTBOX_WAIT 20
+
+/** @brief One pre-parsed MQTT publish action
+ * 
+ * Created once by taskMQTTParse (e.g., when "AT MQ" is assigned to a VB)
+ * and published by taskMQTTPublishAction on each trigger.
+ * @note The record, topic and payload are ONE allocation, a single free()
+ * releases all of it (as done for vb_cmd_t.cmdparam).
+ * @see taskMQTTParse
+ * @see taskMQTTPublishAction */
+typedef struct mqtt_action {
+  /** @brief Topic name, points into this allocation */
+  char *topic;
+  /** @brief Payload, points into this allocation */
+  char *payload;
+  /** @brief Length of the payload */
+  uint16_t payloadlen;
+  /** @brief QoS level for publishing
+   * @see MQTT_ACTION_QOS */
+  uint8_t qos;
+} mqtt_action_t;
+
+/** @brief Statistics of MQTT publishing
+ * @see taskMQTTGetStats */
+typedef struct mqtt_stats {
+  /** @brief Count of published messages */
+  uint32_t published;
+  /** @brief Count of messages, which were put into the outbox (broker not reachable) */
+  uint32_t queued;
+  /** @brief Count of messages, which were dropped (outbox full) */
+  uint32_t dropped;
+  /** @brief Latency from trigger until published of last message [us] */
+  uint32_t lastlatency;
+  /** @brief Maximum latency [us] */
+  uint32_t maxlatency;
+  /** @brief Count of executed inbound control messages */
+  uint32_t ctrlreceived;
+  /** @brief Count of rejected inbound control messages (permission, rate limit, invalid) */
+  uint32_t ctrlrejected;
+} mqtt_stats_t;
+
+/** @brief Inbound control permission: press/release VBs ("<base>/vb/<nr>") */
+#define MQTT_CTRL_VB   (1<<0)
+/** @brief Inbound control permission: load slots ("<base>/slot") */
+#define MQTT_CTRL_SLOT (1<<1)
+/** @brief Inbound control permission: execute AT commands ("<base>/at") */
+#define MQTT_CTRL_AT   (1<<2)
+/** @brief Inbound control permissions, if not set via "AT MP"
+ * @note AT commands are not allowed by default, they can change
+ * any setting (e.g. WiFi credentials) */
+#define MQTT_CTRL_DEFAULT (MQTT_CTRL_VB | MQTT_CTRL_SLOT)
+
+/** @brief Maximum length of the inbound control base topic ("AT MC") */
+#define MQTT_CTRL_TOPIC_LENGTH 64
+
+/** @brief Sustained rate of accepted inbound control messages [1/s] */
+#define MQTT_CTRL_RATE 10
+
+/** @brief Count of inbound control messages, which are accepted in a burst */
+#define MQTT_CTRL_BURST 5
+
+/** @brief Stack size for the REST dispatcher task */
+#define TASK_REST_STACKSIZE 4096
+
+/** @brief Count of REST calls which can be queued (not yet sent)
+ * @note If the queue is full, further calls are dropped. */
+#define REST_QUEUE_LENGTH 8
+
+/** @brief Count of hosts with a kept-alive HTTP connection
+ * @note If more hosts are used, the least recently used connection is closed. */
+#define REST_POOL_SIZE 3
+
+/** @brief Maximum length of the host part ("http://host:port") of a REST URL */
+#define REST_HOST_LENGTH 64
+
+/** @brief Idle time after which a kept-alive connection is closed [ms] */
+#define REST_KEEPALIVE_MS 30000
+
+/** @brief Timeout for one HTTP request [ms] */
+#define REST_TIMEOUT_MS 3000
+
+/** @brief Count of retries for a failed REST call */
+#define REST_RETRIES 2
+
+/** @brief Delay before the first retry [ms], doubled on each further retry */
+#define REST_RETRY_DELAY_MS 200
+
+/** @brief Maximum time the dispatcher waits for WiFi before sending anyway [ms] */
+#define REST_WIFI_WAIT_MS 5000
+
 /** @brief Deinit the MQTT task and the wifi
  * 
  * This function deactives MQTT/WiFi in station mode. It is necessary
@@ -78,23 +180,24 @@
  * */
 esp_err_t taskMQTTDeInit(void);
 
-/** @brief Publish data via MQTT
+/** @brief Trigger a REST call via http GET
  * 
- * This function publishes the given data.
- * The parameter topic_payload will be split into the topic name
- * and the corresponding payload to publish.
- * The splitting is done by the currently set MQTT delimiter character,
- * which can be modified with "AT MS". MQTT_DELIMITER will be used
- * if no other character is set.
+ * The given URL is copied and queued for the REST dispatcher task,
+ * this function does not block. The dispatcher waits for WiFi (on the
+ * first call), keeps the connection to each host alive for further calls
+ * and retries failed calls up to REST_RETRIES times.
  * 
- * @see MQTT_DELIMITER
- * @return ESP_OK on success, ESP_FAIL otherwise
+ * @note Wifi is activated here, if this was not done before.
+ * @param URL URL to call, e.g. "http://192.168.1.10/switch?on"
+ * @return ESP_OK if the call is queued, ESP_FAIL otherwise (queue full,
+ * WiFi not available)
+ * @see REST_QUEUE_LENGTH
+ * @see REST_POOL_SIZE
  * */
 esp_err_t taskREST(char* URL);
 
-/** @brief Publish data via MQTT
+/** @brief Parse a MQTT publish action
  * 
- * This function publishes the given data.
  * The parameter topic_payload will be split into the topic name
  * and the corresponding payload to publish.
  * The splitting is done by the currently set MQTT delimiter character,
@@ -104,15 +207,69 @@ esp_err_t taskREST(char* URL);
  * @see MQTT_DELIMITER
  * @param topic_payload Topic name and payload to be published. E.g.,
  * "/topic1:ON". Delimiter can be changed via NVS key NVS_MQTT_DELIM.
- * @return ESP_OK on success, ESP_FAIL otherwise
+ * @return Pointer to the parsed action (free with free()), NULL on errors
+ * */
+mqtt_action_t *taskMQTTParse(char* topic_payload);
+
+/** @brief Publish a pre-parsed MQTT action
+ * 
+ * If the broker is connected and no older messages are waiting, the
+ * message is published immediately. Otherwise it is copied to the
+ * outbox, which is sent in order as soon as the client (re-)connects.
+ * 
+ * @param action Action to publish, created by taskMQTTParse
+ * @return ESP_OK if published or queued, ESP_FAIL otherwise
  * @note Wifi will be enabled here, if MQTT is not active.
  * @note Wifi credentials and broker information must be in NVS BEFORE calling this function.
  * @see NVS_STATIONNAME
  * @see NVS_STATIONPW
  * @see NVS_MQTT_BROKER
+ * @see MQTT_OUTBOX_LENGTH
+ */
+esp_err_t taskMQTTPublishAction(const mqtt_action_t *action);
+
+/** @brief Publish data via MQTT
+ * 
+ * Parses the given string (see taskMQTTParse) and publishes it
+ * (see taskMQTTPublishAction). Used for single shot "AT MQ" commands,
+ * VB actions are parsed only once on assignment.
+ * 
+ * @param topic_payload Topic name and payload to be published. E.g.,
+ * "/topic1:ON". Delimiter can be changed via NVS key NVS_MQTT_DELIM.
+ * @return ESP_OK on success, ESP_FAIL otherwise
+ * @see taskMQTTParse
+ * @see taskMQTTPublishAction
  */
 esp_err_t taskMQTTPublish(char* topic_payload);
 
+/** @brief Get MQTT publish statistics
+ * 
+ * @param stats Pointer where the statistics are copied to
+ * @see mqtt_stats_t
+ * */
+void taskMQTTGetStats(mqtt_stats_t *stats);
+
+/** @brief Init the MQTT inbound control channel
+ * 
+ * If a base topic is set ("AT MC"), MQTT (and WiFi in station mode) are
+ * started and "<base>/#" is subscribed. Received messages are mapped to:
+ * * "<base>/vb/<nr>" with payload "press" or "release": VB event, sent
+ *   directly to debouncer_in
+ * * "<base>/slot" with the slot name (or "__NEXT",...) as payload: sent
+ *   directly to the config_switcher queue
+ * * "<base>/at" with an AT command as payload: sent to halSerialATCmds
+ * 
+ * Each type must be allowed by the permission mask ("AT MP", see
+ * MQTT_CTRL_DEFAULT), messages exceeding MQTT_CTRL_RATE/MQTT_CTRL_BURST
+ * are dropped.
+ * 
+ * @note Changes of the base topic or permissions are used on the next init.
+ * @see NVS_MQTT_CONTROL
+ * @see NVS_MQTT_CTRLPERM
+ * @return ESP_OK on success or if no base topic is set, ESP_FAIL otherwise
+ * */
+esp_err_t taskMQTTControlInit(void);
+
 /** @brief Init Wifi
  * 
  * This init function initializes the wifi in station mode.
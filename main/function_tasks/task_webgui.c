@@ -67,8 +67,10 @@ static char wifipw[64];
 
 /** @brief Static HTTP HTML header */
 const static char http_html_hdr[] = "HTTP/1.1 200 OK\r\n";
+/** @brief Static HTTP response if the FS is busy, the connection is closed */
+const static char http_busy_hdr[] = "HTTP/1.1 503 Service Unavailable\r\nRetry-After: 1\r\nConnection: close\r\nContent-Length: 0\r\n\r\n";
 /** @brief Static HTTP redirect header */
-const static char http_redir_hdr[] = "HTTP/1.1 302 Found\r\nLocation: http://192.168.4.1/index.htm\r\n\Expires: Mon, 26 Jul 1997 05:00:00 GMT\r\nCache-Control: no-cache, no-store, must-revalidate\r\nPragma: no-cache\r\nCache-Control: post-check=0, pre-check=0\r\nContent-Length: 0\r\n";
+const static char http_redir_hdr[] = "HTTP/1.1 302 Found\r\nLocation: http://192.168.4.1/index.htm\r\n\Expires: Mon, 26 Jul 1997 05:00:00 GMT\r\nCache-Control: no-cache, no-store, must-revalidate\r\nPragma: no-cache\r\nCache-Control: post-check=0, pre-check=0\r\nContent-Length: 0\r\n\r\n";
 
 /** @brief Mutex to lock FS access (only one file after another will be sent) */
 SemaphoreHandle_t  fsSem;
@@ -77,9 +79,12 @@ SemaphoreHandle_t  fsSem;
  * @note This is global to close the socket after the http task is deleted */
 int http_sockfd;
 
-/** @brief Webserver socket - new connection
- * @note This is global to close the socket after the http task is deleted */
-int http_new_sockfd;
+/** @brief Webserver sockets - connections currently served by each worker, -1 if idle
+ * @note This is global to close the sockets after the http tasks are deleted */
+int http_worker_fd[TASK_WEBGUI_HTTP_WORKERS];
+
+/** @brief Queue of accepted connections (socket fds), which are served by the workers */
+QueueHandle_t httpConnQueue = NULL;
 
 /** @brief Websocket conn reference
  * @note Global reference to close after task is deleted */
@@ -123,6 +128,8 @@ TimerHandle_t wifiTimer;
 TaskHandle_t wifiWSServerHandle_t = NULL;
 /** @brief Task handle for http server task */
 TaskHandle_t wifiHTTPServerHandle_t = NULL;
+/** @brief Task handles for http worker tasks */
+TaskHandle_t wifiHTTPWorkerHandle_t[TASK_WEBGUI_HTTP_WORKERS];
 
 /** @brief Get the number of currently connected Wifi stations
  * @return Number of connected clients */
@@ -186,6 +193,8 @@ void wifiStartStopOffTimer(int onoff)
  * as on the serial interface, therefore simply put into the command
  * queue.
  * Outgoing data is equally to serial output data.
+ * Up to WS_MAX_CLIENTS clients can be connected, each one is served
+ * by its own task.
  * 
  * @see halSerialATCmds
  * @see halSerialSendUSBSerial
@@ -221,9 +230,16 @@ void ws_server(void *pvParameters) {
 			continue;
 		}
 		ESP_LOGI(LOG_TAG,"Incoming WS connection");
+		//each client is served by its own task (see websocket.c)
+		if(WS_client_add(ws_newconn) != ESP_OK)
+		{
+			ESP_LOGW(LOG_TAG,"Cannot serve WS connection, closing");
+			netconn_close(ws_newconn);
+			netconn_delete(ws_newconn);
+			continue;
+		}
 		//add the websocket sending functions to hal_serial for getting output data
 		halSerialAddOutputStream(WS_write_data);
-		ws_server_netconn_serve(ws_newconn);
 	}
 }
 
@@ -248,18 +264,50 @@ void wifi_timer_cb(TimerHandle_t xTimer)
   } else {
     uint8_t slotnr = halStorageGetCurrentSlotNumber();
 	if(slotnr == 0) slotnr++;
-	LED((slotnr%2)*0xFF,((slotnr/2)%2)*0xFF,((slotnr/4)%2)*0xFF,0);
+	LEDANIM(LED_ANIM_FADE,(slotnr%2)*0xFF,((slotnr/2)%2)*0xFF,((slotnr/4)%2)*0xFF,500,0,0);
 	ESP_LOGI(LOG_TAG,"Disabling wifi - no clients connected");
   }
 }
 
+/** @brief Send a complete buffer
+ * 
+ * Blocks (and therefore yields) only if the socket's send buffer is full,
+ * partial sends are continued.
+ * @param fd Socket
+ * @param data Data to be sent
+ * @param len Length of data
+ * @return ESP_OK if everything is sent, ESP_FAIL on an error/timeout */
+static esp_err_t http_send_all(int fd, const char *data, size_t len)
+{
+  while(len > 0)
+  {
+    int sent = send(fd, data, len, 0);
+    if(sent <= 0)
+    {
+      ESP_LOGW(LOG_TAG,"Send failed: %d",errno);
+      return ESP_FAIL;
+    }
+    data += sent;
+    len -= sent;
+  }
+  return ESP_OK;
+}
+
 /** @brief Serve static content from FAT
  * 
- * This method is used to send data from the FAT partition to a client
+ * This method is used to send data from the FAT partition to a client.
+ * The complete header is put into the transmit buffer, followed by
+ * the first part of the file, so small files are sent with one write.
+ * Larger files are streamed in chunks of TASK_WEBGUI_HTTP_TXBUFSIZE.
+ * The FS mutex is only held while reading, not while sending.
+ * 
  * @param resource Name of the resource to be sent
- * @param conn Currently active connection
+ * @param fd Socket of the currently active connection
+ * @param txbuf Transmit buffer (TASK_WEBGUI_HTTP_TXBUFSIZE), reused for each request
+ * @return ESP_OK if the connection can be kept open, ESP_FAIL if it
+ * must be closed (FS busy, send error)
  */
-void fat_serve(char* resource, int fd) {
+static esp_err_t fat_serve(char* resource, int fd, char *txbuf) {
   //if we serve a html file for a different URL, Content Type
   //is not set correctly (no file ending given).
   //Set this value to != 0 to force ContentType = text/html
@@ -269,11 +317,11 @@ void fat_serve(char* resource, int fd) {
   //redirects or other captive portal logic
   //URL source: https://stackoverflow.com/questions/46289283/esp8266-captive-portal-with-pop-up
   
-  if(strcmp(resource,"/fwlink") == 0) { redirect(resource, fd); return; }
-  if(strcmp(resource,"/connecttest.txt") == 0) { redirect(resource, fd); return; }
-  if(strcmp(resource,"/hotspot-detect.html") == 0) { redirect(resource, fd); return; }
-  if(strcmp(resource,"/library/test/success.html") == 0) { redirect(resource, fd); return; }
-  if(strcmp(resource,"/kindle-wifi/wifistub.html") == 0) { redirect(resource, fd); return; }
+  if(strcmp(resource,"/fwlink") == 0) { redirect(resource, fd); return ESP_OK; }
+  if(strcmp(resource,"/connecttest.txt") == 0) { redirect(resource, fd); return ESP_OK; }
+  if(strcmp(resource,"/hotspot-detect.html") == 0) { redirect(resource, fd); return ESP_OK; }
+  if(strcmp(resource,"/library/test/success.html") == 0) { redirect(resource, fd); return ESP_OK; }
+  if(strcmp(resource,"/kindle-wifi/wifistub.html") == 0) { redirect(resource, fd); return ESP_OK; }
   
   //do NOT redirect for Android, instead serve root file.
   //if(strcmp(resource,"/generate_204") == 0) { redirect(resource, fd); return; }
@@ -281,166 +329,344 @@ void fat_serve(char* resource, int fd) {
   
   //if we have a very long filename, rewrite for index.htm...
   //we had a DoubleExceptionVector for long names (not supported by FAT)
-  if(strlen(resource) > 32) sprintf(resource,"/index.htm");
+  if(strlen(resource) > 32) resource = (char*)"/index.htm";
+  
+  //basepath + 8.3 file + folder + margin
+  char file[sizeof(base_path)+32];
   
-  if(xSemaphoreTake(fsSem,200) == pdTRUE)
+  //Captive portal:
+  //for all devices which do NOT want a redirect, serve index file
+  if(strcmp(resource,"/generate_204") == 0) {
+    sprintf(file,"%s%s%s",base_path,"/index.htm",".gz");
+    force_html = 1; //force content type
+  } else if(strcmp(resource,"/gen_204") == 0) {
+    sprintf(file,"%s%s%s",base_path,"/index.htm",".gz");
+    force_html = 1; //force content type
+  } else {
+    sprintf(file,"%s%s%s",base_path,resource,".gz");
+  }
+  ESP_LOGI(LOG_TAG,"serving from FAT: %s",file);
+  
+  if(xSemaphoreTake(fsSem,200) != pdTRUE)
   {
-    //basepath + 8.3 file + folder + margin
-    char file[sizeof(base_path)+32];
-    
-    //Captive portal:
-    //for all devices which do NOT want a redirect, serve index file
-    if(strcmp(resource,"/generate_204") == 0) {
-      sprintf(file,"%s%s%s",base_path,"/index.htm",".gz");
-      force_html = 1; //force content type
-    } else if(strcmp(resource,"/gen_204") == 0) {
-      sprintf(file,"%s%s%s",base_path,"/index.htm",".gz");
-      force_html = 1; //force content type
-    } else {
-      sprintf(file,"%s%s%s",base_path,resource,".gz");
+    ESP_LOGE(LOG_TAG,"Timeout waiting for fat mutex!");
+    send(fd, http_busy_hdr, sizeof(http_busy_hdr) - 1, 0);
+    return ESP_FAIL;
+  }
+  // open the file for reading
+  FILE* f = fopen(file, "r");
+  if(f == NULL) {
+    ESP_LOGW(LOG_TAG,"Resource not found: %s, opening index.htm", file);
+    sprintf(file,"%s%s%s",base_path,"/index.htm",".gz");
+    f = fopen(file, "r");
+    force_html = 1; //force content type
+    if(f == NULL)
+    {
+      xSemaphoreGive(fsSem);
+      ESP_LOGE(LOG_TAG,"Index not found? Sending redirect...");
+      send(fd, http_redir_hdr, sizeof(http_redir_hdr) - 1, 0);
+      return ESP_OK;
     }
-    ESP_LOGI(LOG_TAG,"serving from FAT: %s",file);
-		
-		// open the file for reading
-		FILE* f = fopen(file, "r");
-		if(f == NULL) {
-      ESP_LOGW(LOG_TAG,"Resource not found: %s, opening index.htm", file);
-      sprintf(file,"%s%s%s",base_path,"/index.htm",".gz");
-      f = fopen(file, "r");
-      force_html = 1; //force content type
-      if(f == NULL)
-      {
-        ESP_LOGE(LOG_TAG,"Index not found? Sending redirect...");
-        send(fd, http_redir_hdr, sizeof(http_redir_hdr) - 1, 0);
-        xSemaphoreGive(fsSem);
-        return;
-      }
-		}
-    
-    //get the size of this file (for html header)
-    fseek(f, 0L, SEEK_END);
-    int sz = ftell(f);
-    rewind(f);
-    
-    //send http header (200)
-    send(fd, http_html_hdr, sizeof(http_html_hdr) - 1,MSG_MORE);
-    
-    //send http header (content type)
-    int reslen = strlen(resource);
-    char hdr[36];
-    if(strcmp(&resource[reslen-4],".css") == 0)
+  }
+  
+  //get the size of this file (for html header)
+  fseek(f, 0L, SEEK_END);
+  int sz = ftell(f);
+  rewind(f);
+  xSemaphoreGive(fsSem);
+  
+  //determine content type
+  const char *type;
+  int reslen = strlen(resource);
+  if(reslen >= 4 && strcmp(&resource[reslen-4],".css") == 0) {
+    type = "text/css";
+  } else if(force_html != 0 || (reslen >= 4 && strcmp(&resource[reslen-4],".htm") == 0)) {
+    type = "text/html";
+  } else if(reslen >= 3 && strcmp(&resource[reslen-3],".js") == 0) {
+    type = "text/javascript";
+  } else {
+    type = "text/plain";
+  }
+  
+  //complete http header (200, content type, gzip encoding, length) in one buffer
+  int hdrlen = snprintf(txbuf,TASK_WEBGUI_HTTP_TXBUFSIZE,"%sContent-Type: %s\r\n" \
+    "Content-Encoding: gzip\r\nContent-Length: %d\r\n\r\n",http_html_hdr,type,sz);
+  #if (LOG_LEVEL_WEB >= ESP_LOG_DEBUG)
+  ESP_LOGD(LOG_TAG,"Hdr: %s",txbuf);
+  #endif
+  
+  //stream file, the first chunk is appended to the header
+  int64_t tstart = esp_timer_get_time();
+  int i = 0, len = 0, fill = hdrlen;
+  esp_err_t ret = ESP_OK;
+  do {
+    xSemaphoreTake(fsSem,portMAX_DELAY);
+    len = fread(&txbuf[fill], 1, TASK_WEBGUI_HTTP_TXBUFSIZE - fill, f);
+    xSemaphoreGive(fsSem);
+    i += len;
+    fill += len;
+    if(http_send_all(fd, txbuf, fill) != ESP_OK) { ret = ESP_FAIL; break; }
+    fill = 0;
+  } while(len > 0 && i < sz);
+  
+  xSemaphoreTake(fsSem,portMAX_DELAY);
+  fclose(f);
+  xSemaphoreGive(fsSem);
+  
+  int64_t duration = esp_timer_get_time() - tstart;
+  ESP_LOGI(LOG_TAG,"Sent %d bytes in %lldus (%lld kB/s)",i,duration, \
+    duration > 0 ? ((int64_t)i * 1000000 / 1024) / duration : 0);
+  return ret;
+}
+
+/** @brief Find a header in the request
+ * 
+ * @param headers Header lines (after the request line), 0-terminated
+ * @param name Header name including colon, e.g. "Connection:" (case insensitive)
+ * @return Pointer to the value (terminated by CRLF), NULL if not found */
+static char *http_header(char *headers, const char *name)
+{
+  char *line = headers;
+  size_t len = strlen(name);
+  
+  while(line != NULL && *line != '\0')
+  {
+    if(strncasecmp(line,name,len) == 0)
     {
-      snprintf(hdr,36,"Content-Type: text/css\r\n");
-    } else if(strcmp(&resource[reslen-4],".htm") == 0 || force_html != 0) {
-      snprintf(hdr,36,"Content-Type: text/html\r\n");
-    } else if(strcmp(&resource[reslen-3],".js") == 0) {
-      snprintf(hdr,36,"Content-Type: text/javascript\r\n");
-    } else {
-      snprintf(hdr,36,"Content-Type: text/plain\r\n");
+      char *value = line + len;
+      while(*value == ' ') value++;
+      return value;
     }
-    send(fd, hdr, strlen(hdr),MSG_MORE);
-    #if (LOG_LEVEL_WEB >= ESP_LOG_DEBUG)
-    ESP_LOGD(LOG_TAG,"Hdr: %s",hdr);
-    #endif
-    
-    //enable gzip compression by sending corresponding header
-    snprintf(hdr,36,"Content-Encoding: gzip\r\n");
-    send(fd, hdr, strlen(hdr),MSG_MORE);
-    #if (LOG_LEVEL_WEB >= ESP_LOG_DEBUG)
-    ESP_LOGD(LOG_TAG,"Hdr: %s",hdr);
-    #endif
-    
-    //send http header (content length)
-    snprintf(hdr,36,"Content-Length: %d\r\n\r\n",sz);
-    send(fd, hdr, strlen(hdr),MSG_MORE);
-    #if (LOG_LEVEL_WEB >= ESP_LOG_DEBUG)
-    ESP_LOGD(LOG_TAG,"Hdr: %s",hdr);
-    #endif
-    
-    
-    
-		//allocate a buffer in size of one FAT block
-		char* buffer = malloc(512);
-		int i=0, len=0;
-    do {
-			len=fread(buffer, 1, 512, f);
-			i+=len;
-      send(fd, buffer, len, 0);
-      vTaskDelay(1);
-		} while (len==512);
-		
+    line = strstr(line,"\r\n");
+    if(line != NULL) line += 2;
+  }
+  return NULL;
+}
+
+/** @brief Check if the connection should be kept open after this request
+ * 
+ * HTTP/1.1 uses keep-alive by default, HTTP/1.0 closes by default.
+ * The "Connection" header overrides the default.
+ * @param version HTTP version from the request line
+ * @param headers Header lines (after the request line), 0-terminated
+ * @return 1 if the connection is kept open, 0 otherwise */
+static uint8_t http_keepalive(char *version, char *headers)
+{
+  uint8_t keepalive = (version != NULL && strncmp(version,"HTTP/1.1",8) == 0);
+  char *value = http_header(headers,"Connection:");
+  
+  if(value != NULL)
+  {
+    if(strncasecmp(value,"close",5) == 0) keepalive = 0;
+    if(strncasecmp(value,"keep-alive",10) == 0) keepalive = 1;
+  }
+  return keepalive;
+}
+
+/** @brief Serve an embedded web GUI asset
+ * 
+ * The gzip data is sent directly from flash (see webgui_assets.h).
+ * If the client sends a matching ETag (If-None-Match), only a
+ * 304 Not Modified header is sent.
+ * Captive portal URLs which want a 200 answer get the index page.
+ * 
+ * @param resource Name of the requested resource
+ * @param fd Socket of the currently active connection
+ * @param txbuf Transmit buffer (TASK_WEBGUI_HTTP_TXBUFSIZE)
+ * @param headers Request header lines, used for If-None-Match
+ * @return ESP_OK if the asset was found (and sent), ESP_FAIL if it is not embedded
+ * @see fat_serve
+ */
+static esp_err_t asset_serve(char* resource, int fd, char *txbuf, char *headers)
+{
+  if(strcmp(resource,"/generate_204") == 0 || strcmp(resource,"/gen_204") == 0)
+  {
+    resource = (char*)"/index.htm";
+  }
+  const webgui_asset_t *asset = webgui_asset_find(resource);
+  if(asset == NULL) return ESP_FAIL;
+  
+  //client has the current version
+  if(webgui_asset_not_modified(asset,http_header(headers,"If-None-Match:")))
+  {
+    int hdrlen = snprintf(txbuf,TASK_WEBGUI_HTTP_TXBUFSIZE,"HTTP/1.1 304 Not Modified\r\n" \
+      "ETag: %s\r\nCache-Control: %s\r\n\r\n",asset->etag,TASK_WEBGUI_HTTP_CACHECONTROL);
+    http_send_all(fd, txbuf, hdrlen);
     #if (LOG_LEVEL_WEB >= ESP_LOG_DEBUG)
-    ESP_LOGD(LOG_TAG,"Sent %u bytes",i);
+    ESP_LOGD(LOG_TAG,"Not modified: %s",resource);
     #endif
-		fclose(f);
-    free(buffer);
-    xSemaphoreGive(fsSem);
-  } else {
-    ESP_LOGE(LOG_TAG,"Timeout waiting for fat mutex!");
+    return ESP_OK;
   }
+  
+  int64_t tstart = esp_timer_get_time();
+  int hdrlen = snprintf(txbuf,TASK_WEBGUI_HTTP_TXBUFSIZE,"%sContent-Type: %s\r\n" \
+    "Content-Encoding: gzip\r\nContent-Length: %" PRIu32 "\r\nETag: %s\r\nCache-Control: %s\r\n\r\n", \
+    http_html_hdr,asset->type,asset->len,asset->etag,TASK_WEBGUI_HTTP_CACHECONTROL);
+  //first part of the data is sent together with the header,
+  //the remaining data is sent directly from flash
+  uint32_t first = TASK_WEBGUI_HTTP_TXBUFSIZE - hdrlen;
+  if(first > asset->len) first = asset->len;
+  memcpy(&txbuf[hdrlen],asset->data,first);
+  if(http_send_all(fd, txbuf, hdrlen + first) == ESP_OK && first < asset->len)
+  {
+    http_send_all(fd, (const char*)&asset->data[first], asset->len - first);
+  }
+  
+  int64_t duration = esp_timer_get_time() - tstart;
+  ESP_LOGI(LOG_TAG,"Sent embedded %s, %" PRIu32 " bytes in %lldus",resource,asset->len,duration);
+  return ESP_OK;
 }
 
 /** @brief Handle an incoming HTTP connection
  * 
  * This handler is used to server the webpage to a connected client.
- * Data is read from the FAT/VFS partition of the flash.
+ * Data is sent from the embedded asset table (see webgui_assets.h), if
+ * the file is not embedded it is read from the FAT/VFS partition of the flash.
  * The partition is created and uploaded by *make makefatfs flashfatfs*
- * @param conn Current active net connection
+ * 
+ * Requests are read until the end of the header, which might be received
+ * in multiple parts. The connection is kept open (HTTP/1.1 keep-alive) for
+ * further requests until the client closes it, TASK_WEBGUI_HTTP_KEEPALIVE
+ * seconds are idle or TASK_WEBGUI_HTTP_MAXREQUESTS requests are served.
+ * @note Request bodies are not supported (GET only)
+ * @param fd Socket of the current connection
+ * @param txbuf Transmit buffer for responses, see fat_serve
  * */
-static void http_server_netconn_serve(int fd) {
-  if(fd < 0) return;
-  #define MAX_BUFF_SIZE 512
+static void http_server_netconn_serve(int fd, char *txbuf) {
+  if(fd < 0 || txbuf == NULL) return;
+  int fill = 0;
+  uint8_t requests = 0;
   
-  char *buf = malloc(MAX_BUFF_SIZE);
+  char *buf = malloc(TASK_WEBGUI_HTTP_HDRSIZE);
   if(buf == NULL)
   {
     ESP_LOGE(LOG_TAG,"Cannot allocate buf for recv");
     return;
   }
+  
+  //close idle keep-alive connections
+  struct timeval tv = { .tv_sec = TASK_WEBGUI_HTTP_KEEPALIVE, .tv_usec = 0 };
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  //don't block forever on a stalled client
+  setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
 
-  //read incoming
-  int size = recv(fd,buf,MAX_BUFF_SIZE-1,0);
-  #if (LOG_LEVEL_WEB >= ESP_LOG_DEBUG)
-  ESP_LOGD(LOG_TAG,"recv size: %d",size);
-  #endif
-  if(size > 0)
+  while(requests < TASK_WEBGUI_HTTP_MAXREQUESTS)
   {
-    buf[size] = '\0';
-    char *request_line = strtok(buf, "\n");
-		
-		if(request_line) {
-			// default page -> redirect to index.html
-			if(strstr(request_line, "GET / ")) {
-				fat_serve((char*)"/index.htm", fd);
-			} else {
-				// get the requested resource
-        char* method = strtok(request_line, " ");
-        //get rid of "unused" variable.
-        //strtok although needs this call.
-        (void)(method);
-				char* resource = strtok(NULL, " ");
-				fat_serve(resource, fd);
-			}
-		}
+    //read incoming until the header is complete
+    char *end = NULL;
+    while(1)
+    {
+      buf[fill] = '\0';
+      end = strstr(buf,"\r\n\r\n");
+      if(end != NULL) break;
+      if(fill >= TASK_WEBGUI_HTTP_HDRSIZE - 1)
+      {
+        ESP_LOGW(LOG_TAG,"Request header too long");
+        free(buf);
+        return;
+      }
+      int size = recv(fd,&buf[fill],TASK_WEBGUI_HTTP_HDRSIZE-1-fill,0);
+      #if (LOG_LEVEL_WEB >= ESP_LOG_DEBUG)
+      ESP_LOGD(LOG_TAG,"recv size: %d",size);
+      #endif
+      //closed by client, error or keep-alive timeout
+      if(size <= 0)
+      {
+        free(buf);
+        return;
+      }
+      fill += size;
+    }
+    int hdrlen = (end - buf) + 4;
+    //terminate header lines (after the last CRLF)
+    end[2] = '\0';
+    
+    //split request line & remaining headers
+    char *headers = strstr(buf,"\r\n");
+    *headers = '\0';
+    headers += 2;
+    char *method = strtok(buf, " ");
+    char *resource = strtok(NULL, " ");
+    char *version = strtok(NULL, " ");
+    uint8_t keepalive = http_keepalive(version, headers);
+    
+    if(method == NULL || resource == NULL)
+    {
+      ESP_LOGW(LOG_TAG,"Invalid request line");
+      break;
+    }
+    //query strings are not used for static files
+    char *query = strchr(resource,'?');
+    if(query != NULL) *query = '\0';
+    // default page -> redirect to index.html
+    if(strcmp(resource,"/") == 0) resource = (char*)"/index.htm";
+    //embedded assets first, other files/redirects are handled by fat_serve
+    if(asset_serve(resource, fd, txbuf, headers) != ESP_OK)
+    {
+      //FS busy (503 sent) or send error: close this connection
+      if(fat_serve(resource, fd, txbuf) != ESP_OK) keepalive = 0;
+    }
+    requests++;
+    
+    //keep any pipelined request for the next loop
+    fill -= hdrlen;
+    memmove(buf,&buf[hdrlen],fill);
+    if(keepalive == 0) break;
   }
+  #if (LOG_LEVEL_WEB >= ESP_LOG_DEBUG)
+  ESP_LOGD(LOG_TAG,"Closing connection after %d requests",requests);
+  #endif
   free(buf);
 }
 
-
+/** @brief HTTP worker task
+ * 
+ * Each worker takes accepted connections from httpConnQueue and
+ * serves them until they are closed.
+ * @note The worker's tx buffer is not freed if the task is deleted by
+ * wifiEnDisable; wifi can be enabled only once each powercycle.
+ * @see http_server_netconn_serve
+ * @param pvParameters Number of this worker (index for http_worker_fd)
+ * */
+static void http_worker(void *pvParameters) {
+  uint32_t id = (uint32_t)pvParameters;
+  int fd;
+  //transmit buffer, reused for all responses of this worker
+  char *txbuf = malloc(TASK_WEBGUI_HTTP_TXBUFSIZE);
+  if(txbuf == NULL)
+  {
+    ESP_LOGE(LOG_TAG,"Cannot allocate http tx buffer");
+    wifiHTTPWorkerHandle_t[id] = NULL;
+    vTaskDelete(NULL);
+  }
+  
+  while(1)
+  {
+    if(xQueueReceive(httpConnQueue,&fd,portMAX_DELAY) == pdTRUE)
+    {
+      http_worker_fd[id] = fd;
+      http_server_netconn_serve(fd, txbuf);
+      http_worker_fd[id] = -1;
+      close(fd);
+    }
+  }
+}
 
 /** @brief Main webserver task
  * 
- * This task is used to handle incoming connections via netconn_accept.
- * Each time a connection is opened, it will be served by
- * http_server_netconn_serve.
+ * This task is used to handle incoming connections via accept.
+ * Each accepted connection is put into httpConnQueue and
+ * served by one of the TASK_WEBGUI_HTTP_WORKERS worker tasks.
  * 
+ * @see http_worker
  * @see http_server_netconn_serve
  * @param pvParameters Unused.
  * */
 static void http_server(void *pvParameters) {
   socklen_t addr_len;
   struct sockaddr_in sock_addr;
-	int ret;
+  int ret;
+  int fd;
   //we will wait until the flag for WIFI enable request is set.
   while(((xEventGroupWaitBits(connectionRoutingStatus,WIFI_TO_ACTIVATE,pdTRUE, \
 	pdTRUE, portMAX_DELAY)) & WIFI_TO_ACTIVATE) == 0);
@@ -464,30 +690,50 @@ static void http_server(void *pvParameters) {
     http_sockfd = -1;
     vTaskDelete(NULL);
   }
-  ret = listen(http_sockfd, 1);
+  ret = listen(http_sockfd, TASK_WEBGUI_HTTP_BACKLOG);
     if(ret) {
     ESP_LOGE(LOG_TAG,"Failed to listen: %d",ret);
     close(http_sockfd);
     http_sockfd = -1;
     vTaskDelete(NULL);
   }
-	ESP_LOGI(LOG_TAG,"http_server task started");
+  
+  //create the queue of accepted connections (once) & the workers
+  if(httpConnQueue == NULL) httpConnQueue = xQueueCreate(TASK_WEBGUI_HTTP_BACKLOG,sizeof(int));
+  if(httpConnQueue == NULL)
+  {
+    ESP_LOGE(LOG_TAG,"Cannot create http connection queue");
+    close(http_sockfd);
+    http_sockfd = -1;
+    vTaskDelete(NULL);
+  }
+  for(uint32_t i = 0; i<TASK_WEBGUI_HTTP_WORKERS; i++)
+  {
+    char name[16];
+    sprintf(name,"http_worker%d",i);
+    http_worker_fd[i] = -1;
+    xTaskCreatePinnedToCore(&http_worker, name, TASK_WEBGUI_HTTP_WORKER_STACKSIZE, \
+      (void*)i, TASK_WEBGUI_PRIORITY, &wifiHTTPWorkerHandle_t[i], TASK_CORE_SYSTEM);
+  }
+	ESP_LOGI(LOG_TAG,"http_server task started, %d workers",TASK_WEBGUI_HTTP_WORKERS);
   
 	do {
-    //accept connection & save netconn handle
-		http_new_sockfd = accept(http_sockfd, (struct sockaddr *)&sock_addr, &addr_len);
-	    if (http_new_sockfd < 0) {
-	        ESP_LOGE(LOG_TAG, "Failed to accept: %d",http_new_sockfd);
-	    } else {
-	      //serve
-	      http_server_netconn_serve(http_new_sockfd);
-	      //close
-	      close(http_new_sockfd);
-	    }
-		vTaskDelay(1); //allows task to be pre-empted
+    //accept connection & pass it to a worker
+    addr_len = sizeof(sock_addr);
+		fd = accept(http_sockfd, (struct sockaddr *)&sock_addr, &addr_len);
+    if (fd < 0) {
+      ESP_LOGE(LOG_TAG, "Failed to accept: %d",fd);
+      vTaskDelay(10);
+    } else {
+      //all workers busy & queue full: drop this connection
+      if(xQueueSend(httpConnQueue,&fd,100/portTICK_PERIOD_MS) != pdTRUE)
+      {
+        ESP_LOGW(LOG_TAG,"All http workers busy, closing connection");
+        close(fd);
+      }
+    }
 	} while(1);
   //if we run into an error or this task is going to be removed
-	close(http_new_sockfd);
 	close(http_sockfd);
   //delete task
   vTaskDelete(NULL);
@@ -646,9 +892,22 @@ esp_err_t wifiEnDisable(int onoff)
     captdnsDeinit();
     if(wifiHTTPServerHandle_t != NULL) vTaskDelete(wifiHTTPServerHandle_t);
     if(wifiWSServerHandle_t != NULL) vTaskDelete(wifiWSServerHandle_t);
-    //close remaining sockets
-    close(http_new_sockfd);
+    for(uint8_t i = 0; i<TASK_WEBGUI_HTTP_WORKERS; i++)
+    {
+      if(wifiHTTPWorkerHandle_t[i] != NULL) vTaskDelete(wifiHTTPWorkerHandle_t[i]);
+      wifiHTTPWorkerHandle_t[i] = NULL;
+      //close remaining sockets
+      if(http_worker_fd[i] >= 0) close(http_worker_fd[i]);
+      http_worker_fd[i] = -1;
+    }
+    //close accepted connections which were not served yet
+    if(httpConnQueue != NULL)
+    {
+      int fd;
+      while(xQueueReceive(httpConnQueue,&fd,0) == pdTRUE) close(fd);
+    }
     close(http_sockfd);
+    WS_close_all();
     netconn_close(ws_conn);
     
     //signal an already used wifi
@@ -725,7 +984,7 @@ esp_err_t wifiEnDisable(int onoff)
 	captdnsInit();
     
     /*++++ start Websocket task ++++*/
-	xTaskCreate(&ws_server, "ws_server", TASK_WEBGUI_WEBSOCKET_STACKSIZE, NULL, 5, &wifiWSServerHandle_t);
+	xTaskCreatePinnedToCore(&ws_server, "ws_server", TASK_WEBGUI_WEBSOCKET_STACKSIZE, NULL, TASK_WEBGUI_PRIORITY, &wifiWSServerHandle_t, TASK_CORE_SYSTEM);
     
     return ESP_OK;
   }
@@ -790,7 +1049,7 @@ esp_err_t taskWebGUIInit(void)
   }
   
   /*++++ start HTTP task ++++*/
-  xTaskCreate(&http_server, "http_server", TASK_WEBGUI_SERVER_STACKSIZE, NULL, 5, &wifiHTTPServerHandle_t);
+  xTaskCreatePinnedToCore(&http_server, "http_server", TASK_WEBGUI_SERVER_STACKSIZE, NULL, TASK_WEBGUI_PRIORITY, &wifiHTTPServerHandle_t, TASK_CORE_SYSTEM);
   
   return ESP_OK;
 }
@@ -44,6 +44,9 @@
 //common definitions & data for all of these functional tasks
 #include "common.h"
 #include <inttypes.h>
+//strncasecmp for HTTP header parsing
+#include <strings.h>
+#include <errno.h>
 
 #include "esp_wifi.h"
 #include "esp_event_loop.h"
@@ -54,6 +57,7 @@
 #include "esp_err.h"
 #include "esp_vfs.h"
 #include "esp_vfs_fat.h"
+#include "esp_timer.h"
 
 
 #include "lwip/api.h"
@@ -62,6 +66,7 @@
 
 #include "captdns.h"
 #include "websocket.h"
+#include "webgui_assets.h"
 
 /** @brief Stack size for websocket server task */
 #define TASK_WEBGUI_WEBSOCKET_STACKSIZE 4096
@@ -72,6 +77,25 @@
 /** @brief Websocket port */
 #define TASK_WEBGUI_WSPORT 1804
 
+/** @brief Count of HTTP worker tasks (concurrently served connections) */
+#define TASK_WEBGUI_HTTP_WORKERS 3
+/** @brief Stack size for each HTTP worker task */
+#define TASK_WEBGUI_HTTP_WORKER_STACKSIZE 4096
+/** @brief Backlog for listen & queue size for accepted, not yet served connections */
+#define TASK_WEBGUI_HTTP_BACKLOG 6
+/** @brief Idle time [s] until a keep-alive connection is closed */
+#define TASK_WEBGUI_HTTP_KEEPALIVE 5
+/** @brief Maximum count of requests on one keep-alive connection */
+#define TASK_WEBGUI_HTTP_MAXREQUESTS 64
+/** @brief Buffer size for request headers (maximum header size) */
+#define TASK_WEBGUI_HTTP_HDRSIZE 1024
+/** @brief Transmit buffer size for each HTTP worker (header + file chunks) */
+#define TASK_WEBGUI_HTTP_TXBUFSIZE 4096
+/** @brief Cache-Control for embedded assets.
+ * Browsers revalidate each time via ETag, which is answered with
+ * 304 Not Modified if the firmware (and therefore the asset) is unchanged. */
+#define TASK_WEBGUI_HTTP_CACHECONTROL "no-cache"
+
 /** @brief Init the web / DNS server and the web gui
  * 
  * This init function initializes the wifi, web server, dns server (captive portal)
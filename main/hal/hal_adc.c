@@ -79,6 +79,21 @@ typedef struct adcData {
  * @see halAdcTaskThreshold */
 TaskHandle_t adcHandle = NULL;
 
+#ifdef RTOS_STATIC_ALLOCATION
+/** @brief Static stacks of the ADC task
+ * 
+ * Two sets of buffers are used alternately: a deleted task might be
+ * cleaned up by the idle task after the new one is created, so the
+ * buffers of the previous task are never reused directly.
+ * @see halAdcStartTask */
+static StackType_t adcTaskStack[2][RTOS_STACK_ADC];
+/** @brief Static TCBs of the ADC task
+ * @see adcTaskStack */
+static StaticTask_t adcTaskTCB[2];
+/** @brief Index of the buffers for the next ADC task */
+static uint8_t adcTaskBuffer = 0;
+#endif
+
 /** current activated ADC config.
  * @see adc_config_t
  * */
@@ -99,6 +114,20 @@ TickType_t adcCalibLast = 0;
  * */
 SemaphoreHandle_t adcSem = NULL;
 
+/** @brief Callback for sensor telemetry, NULL if not used
+ * @see halAdcSetTelemetryStream */
+static adctelemetry_h telemetrycb = NULL;
+
+/** @brief Idle timeout for adaptive sampling [ms], 0 to disable
+ * @see halAdcSetIdleTimeout */
+static volatile uint32_t adcIdleTimeout = HAL_ADC_IDLE_TIMEOUT_MS;
+
+/** @brief Last sensor sample, read via halAdcGetLastSample */
+static adcTelemetry_t lastSample;
+
+/** @brief Spinlock for lastSample (written & read on different cores) */
+static portMUX_TYPE lastSampleMux = portMUX_INITIALIZER_UNLOCKED;
+
 /** calibration characteristics, loaded by esp-idf provided methods*/
 esp_adc_cal_characteristics_t characteristics;
 
@@ -258,7 +287,11 @@ void halAdcProcessStrongMode(adcData_t *D)
  * 
  * All values are sent in predefined string: <br>
  * VALUES:\<pressure\>,\<up\>,\<down\>,\<left\>,\<right\>,\<x\>,\<y\> \\r \\n
+ * In addition, each sample is passed to the telemetry stream, if set,
+ * and stored for halAdcGetLastSample.
  * 
+ * @see halAdcSetTelemetryStream
+ * @see halAdcGetLastSample
  * @param up Up value
  * @param down Down value
  * @param left Left value
@@ -272,6 +305,22 @@ void halAdcReportRaw(uint32_t up, uint32_t down, uint32_t left, uint32_t right,
     #define REPORT_RAW_COUNT 8
     static int prescaler = 0;
     
+    adcTelemetry_t sample = {
+        .timestamp = (uint32_t)esp_timer_get_time(),
+        .pressure = pressure, .up = up, .down = down, .left = left, .right = right,
+        .x = (x > INT16_MAX) ? INT16_MAX : ((x < INT16_MIN) ? INT16_MIN : x),
+        .y = (y > INT16_MAX) ? INT16_MAX : ((y < INT16_MIN) ? INT16_MIN : y),
+    };
+    
+    //store for polling consumers (CIM), 18 bytes under a spinlock
+    portENTER_CRITICAL(&lastSampleMux);
+    lastSample = sample;
+    portEXIT_CRITICAL(&lastSampleMux);
+    
+    //each sample is passed to the telemetry stream (not decimated, no UART)
+    adctelemetry_h cb = telemetrycb;
+    if(cb != NULL) cb(&sample);
+    
     if(adc_conf.reportraw != 0)
     {
         if(prescaler % REPORT_RAW_COUNT == 0)
@@ -314,6 +363,7 @@ void halAdcReadData(adcData_t *values)
     } else { 
         //save value
         values->pressure= pressure;       
+        metricsInc(METRIC_ADC_SAMPLES);
     }
 }
 
@@ -378,6 +428,7 @@ int halAdcReadData(adcData_t *values)
 	if(toohigh != 0)
 	{
 		ESP_LOGW(LOG_TAG,"sensor deviation over rate,discarding");
+		metricsInc(METRIC_ADC_DISCARDED);
 		return -1;
 	}
 
@@ -477,6 +528,7 @@ int halAdcReadData(adcData_t *values)
     {
         ESP_LOGD(LOG_TAG,"raw x/y %d/%d; ",values->x,values->y);
     }
+    metricsInc(METRIC_ADC_SAMPLES);
     return 0;
 }
 #endif /* DEVICE_FLIPMOUSE */
@@ -661,6 +713,61 @@ void halAdcProcessPressure(adcData_t *D)
     }
 }
 
+/** @brief Record the sampling jitter of an ADC task
+ * 
+ * Called after each vTaskDelayUntil, the deviation of the time since
+ * the previous call from the period is saved as METRIC_ADC_JITTER_US
+ * (maximum).
+ * @param last Timestamp of the previous call, 0 on the first call
+ * @param period Sampling period of the task [ms]
+ * */
+static void halAdcRecordJitter(int64_t *last, uint32_t period)
+{
+  int64_t now = esp_timer_get_time();
+  if(*last != 0)
+  {
+    int64_t deviation = now - *last - (int64_t)period * 1000;
+    if(deviation < 0) deviation = -deviation;
+    metricsMax(METRIC_ADC_JITTER_US, (uint32_t)deviation);
+  }
+  *last = now;
+}
+
+/** @brief Get the period until the next sample (adaptive sampling)
+ * 
+ * Full rate is kept while an action might be in progress (strong mode,
+ * pressure out of the sip/puff thresholds, calibration) or raw values are
+ * streamed. Otherwise the rate is lowered after the idle timeout
+ * (halAdcSetIdleTimeout) without activity.
+ * @param activity State of the activity detection
+ * @param D Current sample
+ * @param active Activity detected by the task (movement, held action)
+ * @return Period until the next sample [ms]
+ * @see adc_activity_update
+ * */
+static uint16_t halAdcNextPeriod(adc_activity_t *activity, adcData_t *D, uint8_t active)
+{
+  int32_t raw[ADC_ACTIVITY_CHANNELS] = {D->up, D->down, D->left, D->right, D->pressure};
+  uint8_t wasidle = activity->idle;
+  
+  //idle timeout might be changed at runtime
+  activity->timeout = adcIdleTimeout;
+  if(activity->timeout == 0) activity->idle = 0;
+  
+  if(D->strongmode != STRONG_NORMAL || D->calibrate_request != 0 || \
+    telemetrycb != NULL || adc_conf.reportraw != 0 || \
+    D->pressure < adc_conf.threshold_sip || D->pressure > adc_conf.threshold_puff)
+  {
+    active = 1;
+  }
+  
+  uint16_t period = adc_activity_update(activity, raw, active);
+  if(wasidle && !activity->idle) metricsInc(METRIC_ADC_WAKEUPS);
+  //count the samples which are not taken until the next one
+  if(activity->idle) metricsAdd(METRIC_ADC_SKIPPED, period / activity->period - 1);
+  return period;
+}
+
 #ifdef DEVICE_FLIPMOUSE
 /** @brief HAL TASK - Mouse task for ADC
  * 
@@ -688,9 +795,15 @@ void halAdcTaskMouse(void * pvParameters)
     float accelFactor= 20 / 100000000.0f;
     hid_cmd_t command,command2;
     TickType_t xLastWakeTime = xTaskGetTickCount();
+    int64_t lastWake = 0;
     //set adc data reference for timer
     vTimerSetTimerID(adcStrongTimeoutTimerHandle,&D);
     uint32_t debug_out_cnt = 0;
+    //adaptive sampling rate
+    adc_activity_t activity;
+    uint16_t period = HAL_ADC_PERIOD_MS;
+    adc_activity_init(&activity, HAL_ADC_PERIOD_MS, HAL_ADC_IDLE_PERIOD_MS, \
+      HAL_ADC_IDLE_TIMEOUT_MS, HAL_ADC_IDLE_NOISE);
     
     while(1)
     {
@@ -814,6 +927,9 @@ void halAdcTaskMouse(void * pvParameters)
             halAdcProcessStrongMode(&D);
         }
         
+        //lower the sampling rate if idle
+        period = halAdcNextPeriod(&activity, &D, (D.x != 0 || D.y != 0));
+        
         //give mutex
         xSemaphoreGive(adcSem);
         
@@ -821,7 +937,8 @@ void halAdcTaskMouse(void * pvParameters)
         if(D.calibrate_request != 0) halAdcCalibrate();
         
         //delay the task.
-        vTaskDelayUntil( &xLastWakeTime, 10/portTICK_PERIOD_MS);
+        vTaskDelayUntil( &xLastWakeTime, period/portTICK_PERIOD_MS);
+        halAdcRecordJitter(&lastWake, period);
     }
 }
 
@@ -849,7 +966,8 @@ void halAdcTaskJoystick(void * pvParameters)
     D.strongmode = STRONG_NORMAL;
     //int32_t x,y;
     //joystick_command_t command;
-    TickType_t xLastWakeTime;
+    TickType_t xLastWakeTime = xTaskGetTickCount();
+    int64_t lastWake = 0;
     //set adc data reference for timer
     vTimerSetTimerID(adcStrongTimeoutTimerHandle,&D);
     
@@ -907,10 +1025,53 @@ void halAdcTaskJoystick(void * pvParameters)
         
         //delay the task.
         vTaskDelayUntil(&xLastWakeTime, 20/portTICK_PERIOD_MS); 
+        halAdcRecordJitter(&lastWake, 20);
     }
 }
 
 #endif
+
+/** @brief Set a callback which receives each sensor sample
+ * 
+ * Independent of the raw value reporting via serial interface (AT SR),
+ * each ADC reading is passed to this callback (e.g. the webgui's binary
+ * websocket telemetry).
+ * @param cb Function callback, NULL to remove
+ * */
+void halAdcSetTelemetryStream(adctelemetry_h cb)
+{
+    telemetrycb = cb;
+}
+
+/** @brief Get the last sensor sample
+ * 
+ * Used by consumers which poll the sensors with their own rate (e.g.
+ * the CIM task), instead of receiving each sample via the telemetry stream.
+ * @note In idle mode (HAL_ADC_IDLE_PERIOD_MS) the sample is updated less
+ * often, the values are within HAL_ADC_IDLE_NOISE anyway.
+ * @param sample The last sample is copied to this pointer (all zero
+ * before the first sample)
+ * */
+void halAdcGetLastSample(adcTelemetry_t *sample)
+{
+    portENTER_CRITICAL(&lastSampleMux);
+    *sample = lastSample;
+    portEXIT_CRITICAL(&lastSampleMux);
+}
+
+/** @brief Set the time without activity until the sampling rate is lowered
+ * 
+ * Used by the mouse & threshold task on their next sample, can be called
+ * before halAdcInit (e.g. with the value stored in NVS).
+ * @param timeout Idle timeout [ms], 0 to always sample at full rate
+ * @see HAL_ADC_IDLE_TIMEOUT_MS
+ * @see NVS_ADC_IDLETIMEOUT
+ * */
+void halAdcSetIdleTimeout(uint32_t timeout)
+{
+    adcIdleTimeout = timeout;
+}
+
 /** @brief Calibration function
  * 
  * This method is called to calibrate the offset value for x and y
@@ -932,7 +1093,7 @@ void halAdcCalibrate(void)
     {
 		uint8_t retry = 0;
 		do {
-			TONE(TONE_CALIB_FREQ,TONE_CALIB_DURATION);
+			TONEPRIO(TONE_CALIB_FREQ,TONE_CALIB_DURATION,HAL_IO_TONE_PRIO_HIGH);
 			vTaskDelay(100/portTICK_PERIOD_MS);
 			
 	        if((xTaskGetTickCount() - adcCalibLast) < (HAL_ADC_CALIB_LOCKTIME / portTICK_PERIOD_MS))
@@ -989,7 +1150,7 @@ void halAdcCalibrate(void)
 			ESP_LOGE(LOG_TAG,"Cannot calibrate, sensor defect!");
 			while(1)
 			{
-				TONE(TONE_CALIB_FREQ,TONE_CALIB_DURATION);
+				TONEPRIO(TONE_CALIB_FREQ,TONE_CALIB_DURATION,HAL_IO_TONE_PRIO_HIGH);
 				vTaskDelay(1000/portTICK_PERIOD_MS);
 			}
         }
@@ -1017,8 +1178,10 @@ void halAdcTaskThreshold(void * pvParameters)
     //analog values
     adcData_t D;
     raw_action_t evt;
+    memset(&D,0,sizeof(adcData_t));
     D.strongmode = STRONG_NORMAL;
     TickType_t xLastWakeTime = xTaskGetTickCount();
+    int64_t lastWake = 0;
     //set adc data reference for timer
     vTimerSetTimerID(adcStrongTimeoutTimerHandle,&D);
     
@@ -1026,6 +1189,11 @@ void halAdcTaskThreshold(void * pvParameters)
     //1<<0: up, 1<<1: down, 1<<2: left, 1<<3: right; set if press event was sent.
     uint8_t activevbs = 0;
     #endif
+    //adaptive sampling rate
+    adc_activity_t activity;
+    uint16_t period = HAL_ADC_PERIOD_MS;
+    adc_activity_init(&activity, HAL_ADC_PERIOD_MS, HAL_ADC_IDLE_PERIOD_MS, \
+      HAL_ADC_IDLE_TIMEOUT_MS, HAL_ADC_IDLE_NOISE);
     
     while(1)
     {
@@ -1187,17 +1355,40 @@ void halAdcTaskThreshold(void * pvParameters)
         //pressure sensor is handled in another function
         halAdcProcessPressure(&D);
         
+        //lower the sampling rate if idle (no direction held)
+        #ifdef DEVICE_FLIPMOUSE
+        period = halAdcNextPeriod(&activity, &D, (activevbs != 0));
+        #else
+        period = halAdcNextPeriod(&activity, &D, 0);
+        #endif
+        
         //give mutex
         xSemaphoreGive(adcSem);
         
         //delay the task.
-        vTaskDelayUntil( &xLastWakeTime, 10/portTICK_PERIOD_MS);
+        vTaskDelayUntil( &xLastWakeTime, period/portTICK_PERIOD_MS);
+        halAdcRecordJitter(&lastWake, period);
         //vTaskDelay(20/portTICK_PERIOD_MS);
     }
     
 }
 
 
+/** @brief Start the ADC task (saved to adcHandle)
+ * @param fct Task function, e.g. halAdcTaskMouse
+ * @see adcTaskStack
+ * */
+static void halAdcStartTask(TaskFunction_t fct)
+{
+    #ifdef RTOS_STATIC_ALLOCATION
+    adcHandle = xTaskCreateStaticPinnedToCore(fct,"ADC_TASK",RTOS_STACK_ADC,NULL,HAL_ADC_TASK_PRIORITY, \
+        adcTaskStack[adcTaskBuffer],&adcTaskTCB[adcTaskBuffer],TASK_CORE_INPUT);
+    adcTaskBuffer = (adcTaskBuffer + 1) % 2;
+    #else
+    xTaskCreatePinnedToCore(fct,"ADC_TASK",RTOS_STACK_ADC,NULL,HAL_ADC_TASK_PRIORITY,&adcHandle,TASK_CORE_INPUT);
+    #endif
+}
+
 /** @brief Reload ADC config
  * 
  * This method reloads the ADC config.
@@ -1262,15 +1453,15 @@ esp_err_t halAdcUpdateConfig(adc_config_t* params)
         switch(adc_conf.mode)
         {
             case MOUSE:
-                xTaskCreate(halAdcTaskMouse,"ADC_TASK",4096,NULL,HAL_ADC_TASK_PRIORITY,&adcHandle);
+                halAdcStartTask(halAdcTaskMouse);
                 ESP_LOGI(LOG_TAG,"created ADC task for mouse, handle %d",(uint32_t)adcHandle);
                 break;
             case JOYSTICK:
-                xTaskCreate(halAdcTaskJoystick,"ADC_TASK",4096,NULL,HAL_ADC_TASK_PRIORITY,&adcHandle);
+                halAdcStartTask(halAdcTaskJoystick);
                 ESP_LOGI(LOG_TAG,"created ADC task for joystick, handle %d",(uint32_t)adcHandle);
                 break;
             case THRESHOLD:
-                xTaskCreate(halAdcTaskThreshold,"ADC_TASK",4096,NULL,HAL_ADC_TASK_PRIORITY,&adcHandle);
+                halAdcStartTask(halAdcTaskThreshold);
                 ESP_LOGI(LOG_TAG,"created ADC task for threshold, handle %d",(uint32_t)adcHandle);
                 break;
             case NONE:
@@ -1290,7 +1481,7 @@ esp_err_t halAdcUpdateConfig(adc_config_t* params)
     if(adcHandle == NULL)
     {
         //just use a threshold task, other channels are masked out in this task.
-        xTaskCreate(halAdcTaskThreshold,"ADC_TASK",4096,NULL,HAL_ADC_TASK_PRIORITY,&adcHandle);
+        halAdcStartTask(halAdcTaskThreshold);
         ESP_LOGI(LOG_TAG,"created ADC task for threshold, handle %d",(uint32_t)adcHandle); 
     }
     #endif
@@ -1355,18 +1546,21 @@ esp_err_t halAdcInit(adc_config_t* params)
     }
     
     //initialize ADC semphore as mutex
-    adcSem = xSemaphoreCreateMutex();
+    adcSem = RTOS_MUTEX_CREATE();
+    #ifdef RTOS_STATIC_ALLOCATION
+    rtosStaticBytes += sizeof(adcTaskStack) + sizeof(adcTaskTCB);
+    #endif
     
     //start first calibration
     //halAdcCalibrate();
     
     //initialize SW timer for STRONG mode timeout
     #ifdef DEVICE_FLIPMOUSE
-    adcStrongTimeoutTimerHandle = xTimerCreate("strongmode", HAL_ADC_TIMEOUT_STRONGMODE / portTICK_PERIOD_MS, \
+    adcStrongTimeoutTimerHandle = RTOS_TIMER_CREATE("strongmode", HAL_ADC_TIMEOUT_STRONGMODE / portTICK_PERIOD_MS, \
         pdFALSE,( void * ) 0,halAdcStrongTimeout);
-    adcStrongTimerHandle = xTimerCreate("strongmodedelay", HAL_ADC_DELAY_STRONGMODE / portTICK_PERIOD_MS, \
+    adcStrongTimerHandle = RTOS_TIMER_CREATE("strongmodedelay", HAL_ADC_DELAY_STRONGMODE / portTICK_PERIOD_MS, \
         pdFALSE,( void * ) 0,halAdcStrongDelay);
-    adcStrongSem = xSemaphoreCreateBinary();
+    adcStrongSem = RTOS_BINARY_CREATE();
     #endif
     
     //not initializing full config, only ADC
@@ -49,12 +49,15 @@
 #include <esp_log.h>
 #include <driver/adc.h>
 #include "esp_adc_cal.h"
+#include "esp_timer.h"
 //common definitions & data for all of these functional tasks
 #include "common.h"
 #include "hal_serial.h"
 #include "handler_hid.h"
 #include "handler_vb.h"
 #include "math.h"
+#include "metrics.h"
+#include "adc_activity.h"
 
 
 #ifdef DEVICE_FLIPMOUSE
@@ -177,6 +180,78 @@
 /** @brief Parameter for mouse acceleration calculation */
 #define ACCELTIME_MAX 20000
 
+/** @brief Sampling period of mouse & threshold task at full rate [ms] */
+#define HAL_ADC_PERIOD_MS 10
+
+/** @brief Sampling period of mouse & threshold task if idle [ms]
+ * @note This is the maximum additional latency for the first action
+ * after an idle phase. */
+#define HAL_ADC_IDLE_PERIOD_MS 50
+
+/** @brief Default time without activity until the sampling rate is lowered [ms]
+ * @note Can be changed at runtime via halAdcSetIdleTimeout ("AT SI") */
+#define HAL_ADC_IDLE_TIMEOUT_MS 10000
+
+/** @brief Maximum idle timeout, settable via "AT SI" [s] */
+#define HAL_ADC_IDLE_TIMEOUT_MAX_S 3600
+
+/** @brief Noise floor for activity detection
+ * 
+ * A change of any raw channel (including pressure) by more than this value
+ * (compared to the last active sample) switches back to full rate.
+ * @see adc_activity.h */
+#define HAL_ADC_IDLE_NOISE 10
+
+/** @brief One packed sensor sample for telemetry streams (18 bytes, little endian)
+ * @see halAdcSetTelemetryStream */
+typedef struct __attribute__((packed)) adcTelemetry {
+  /** @brief Time of this sample [us], lower 32bit of esp_timer_get_time */
+  uint32_t timestamp;
+  uint16_t pressure;
+  uint16_t up;
+  uint16_t down;
+  uint16_t left;
+  uint16_t right;
+  /** @brief Processed x value (offset & deadzone applied), saturated to 16bit */
+  int16_t x;
+  /** @brief Processed y value (offset & deadzone applied), saturated to 16bit */
+  int16_t y;
+} adcTelemetry_t;
+
+/** @brief Function pointer type for a telemetry stream
+ * @note Called in the ADC task's context, must not block! */
+typedef void (*adctelemetry_h)(const adcTelemetry_t *sample);
+
+/** @brief Set a callback which receives each sensor sample
+ * 
+ * Independent of the raw value reporting via serial interface (AT SR),
+ * each ADC reading is passed to this callback (e.g. the webgui's binary
+ * websocket telemetry).
+ * @param cb Function callback, NULL to remove
+ * */
+void halAdcSetTelemetryStream(adctelemetry_h cb);
+
+/** @brief Get the last sensor sample
+ * 
+ * Used by consumers which poll the sensors with their own rate (e.g.
+ * the CIM task), instead of receiving each sample via the telemetry stream.
+ * @note In idle mode (HAL_ADC_IDLE_PERIOD_MS) the sample is updated less
+ * often, the values are within HAL_ADC_IDLE_NOISE anyway.
+ * @param sample The last sample is copied to this pointer (all zero
+ * before the first sample)
+ * */
+void halAdcGetLastSample(adcTelemetry_t *sample);
+
+/** @brief Set the time without activity until the sampling rate is lowered
+ * 
+ * Used by the mouse & threshold task on their next sample, can be called
+ * before halAdcInit (e.g. with the value stored in NVS).
+ * @param timeout Idle timeout [ms], 0 to always sample at full rate
+ * @see HAL_ADC_IDLE_TIMEOUT_MS
+ * @see NVS_ADC_IDLETIMEOUT
+ * */
+void halAdcSetIdleTimeout(uint32_t timeout);
+
 
 /** @brief Calibration function
  * 
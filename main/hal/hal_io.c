@@ -38,7 +38,7 @@
  * The LED output is configurable either to 3 PWM outputs for RGB LEDs
  * or a Neopixel string with variable length (RGB LEDs use ledc facilities,
  * Neopixels use RMT engine). To enable easy color settings, macros are provided
- * (LED(r,g,b,m)).
+ * (LED(r,g,b,m)), animations are started via LEDANIM (see led_animation.h).
  * 
  * IR receiving / sending is done via the RMT engine and is supported by macros
  * as well.
@@ -53,29 +53,19 @@
 
 /** @brief LED update queue
  * 
- * This queue is used to update the LED color & brightness
- * Please use one uint32_t value with following content:
- * * \<bits 0-7\> RED
- * * \<bits 8-15\> GREEN
- * * \<bits 16-23\> BLUE
+ * This queue is used to update the LED color & animation.
+ * Please send one led_anim_t descriptor (or use the LED/LEDANIM macros),
+ * the LED task computes all frames of the animation:
  * 
- * Depending on the LED config (either one RGB LED or Neopixels are used),
- * bits 24-31 are used differently:
- * 
- * <b>RGB LED (LED_USE_NEOPIXEL is NOT defined)</b>:
- * 
- * * \<bits 24-31\> Fading time ([10¹ms] -> value of 200 is 2s)
- * 
- * <b>Neopixels (LED_USE_NEOPIXEL is defined)</b>:
- * 
- * * \<bits 24-31\> Animation mode:
- * * <b>0</b> Steady color on all Neopixels
- * * <b>1</b> 3 Neopixels have the given color and are circled around
- * * <b>2-0xFF</b> Currently undefined, further modes might be added.
+ * * <b>LED_ANIM_STEADY</b> Steady color on all Neopixels
+ * * <b>LED_ANIM_CIRCLE</b> 3 Neopixels have the given color and are circled around
+ * * <b>LED_ANIM_FADE</b> Fade from the current to the given color
+ * * <b>LED_ANIM_PULSE</b> Pulse the given color (e.g., WiFi active)
+ * * <b>LED_ANIM_BLINK</b> Blink the given color, e.g. slot number
  * 
  * @note Call halIOInit to initialize this queue.
  * @see halIOInit
- * @see LED_USE_NEOPIXEL
+ * @see led_anim_t
  * @see LED_NEOPIXEL_COUNT
  **/
 QueueHandle_t halIOLEDQueue = NULL;
@@ -109,6 +99,26 @@ TimerHandle_t longactiontimer = NULL;
 /** @brief Buzzer timer config (via LED-PWM unit) */
 ledc_timer_config_t buzzer_timer;
 
+/** @brief State of the currently played melody
+ * @note Accessed by the buzzer task only. */
+static struct {
+  /** Currently played melody */
+  halIOMelody_t melody;
+  /** Index of the current note */
+  uint8_t note;
+  /** Count of finished repetitions */
+  uint8_t repeat;
+  /** Set if a melody is playing */
+  uint8_t playing;
+  /** End of the current note [us] */
+  int64_t noteend;
+  /** Melody with the same priority, started after the current one */
+  halIOMelody_t pending;
+  /** Set if pending is valid */
+  uint8_t haspending;
+} buzzer;
+
+
 
 /** @brief GPIO ISR handler for buttons (internal/external)
  * 
@@ -202,6 +212,11 @@ void halIOIRFree(rmt_channel_t channel, void *arg)
  * on any status change.
  * Poll this value to see if the receiver is finished.
  * 
+ * The edge buffer is allocated here and grows in chunks of
+ * TASK_HAL_IR_RECV_CHUNK_EDGES up to TASK_HAL_IR_RECV_MAXIMUM_EDGES.
+ * On IR_FINISHED, the caller owns recv->buffer and has to free it;
+ * on any other status, the buffer is NULL.
+ * 
  * @see halIOIR_t
  * @see halIOIRRecvQueue
  * @param param Unused.
@@ -226,17 +241,21 @@ void halIOIRRecvTask(void * param)
     {
       ESP_LOGI(LOG_TAG,"IR recv triggered.");
       
-      //acquire buffer for ALL possible receiving elements
-      uint16_t offset = 0;
+      //buffer is allocated & grown while receiving
+      ir_recv_buffer_t rxbuf;
       size_t rx_size = 0;
       uint16_t local_timeout = 0;
       
-      //check buffer
-      if(recv->buffer == NULL)
+      //check buffer, a given buffer is replaced
+      if(recv->buffer != NULL)
       {
-        ESP_LOGE(LOG_TAG,"Please provide a buffer for receiving IR!");
-        continue;
+        ESP_LOGW(LOG_TAG,"IR receive buffer is allocated here, freeing given one");
+        free(recv->buffer);
+        recv->buffer = NULL;
       }
+      recv->count = 0;
+      ir_recv_buffer_init(&rxbuf, TASK_HAL_IR_RECV_CHUNK_EDGES, \
+        TASK_HAL_IR_RECV_MAXIMUM_EDGES, HAL_IO_IR_LEVEL_MASK);
       
       //start receiving on channel 4, flush all buffer elements
       rmt_rx_start(4, 1);
@@ -248,32 +267,25 @@ void halIOIRRecvTask(void * param)
         rmt_item32_t* item = (rmt_item32_t*) xRingbufferReceive(rb, &rx_size, TASK_HAL_IR_RECV_EDGE_TIMEOUT/portTICK_PERIOD_MS);
         //got one item
         if(item != NULL) {
-          //put data into buffer
-          memcpy(&recv->buffer[offset], item, sizeof(rmt_item32_t)*rx_size);
-
-          //invert active mode by inverting bits level0 and level1 in each item
-          for(size_t i = 0; i<rx_size;i++) 
-          {
-            recv->buffer[offset+i].level0 = !recv->buffer[offset+i].level0;
-            recv->buffer[offset+i].level1 = !recv->buffer[offset+i].level1;
-          }
-          //increase offset for next received item
-          offset+= rx_size;
-          
+          //ringbuffer size is in bytes; copy, invert & grow in chunks
+          esp_err_t ret = ir_recv_buffer_append(&rxbuf, item, rx_size / sizeof(rmt_item32_t));
           //give item back to ringbuffer
           vRingbufferReturnItem(rb, (void*) item);
-          //too much
-          if(offset >= TASK_HAL_IR_RECV_MAXIMUM_EDGES)
+          
+          //too much or no memory, buffer is already freed
+          if(ret != ESP_OK)
           {
-            ESP_LOGE(LOG_TAG,"Too much IR edges, finished");
-            recv->status = IR_OVERFLOW;
+            rmt_rx_stop(4);
+            if(ret == ESP_ERR_NO_MEM) ESP_LOGE(LOG_TAG,"No memory for IR edges");
+            else ESP_LOGE(LOG_TAG,"Too much IR edges, finished");
             recv->count = 0;
+            recv->status = IR_OVERFLOW;
             break;
           }
         } else {
           local_timeout += TASK_HAL_IR_RECV_EDGE_TIMEOUT;
           //check if timeout is the long one and no edges received...
-          if(local_timeout >= TASK_HAL_IR_RECV_TIMEOUT && offset == 0)
+          if(local_timeout >= TASK_HAL_IR_RECV_TIMEOUT && rxbuf.count == 0)
           {
             //timeout, cancel
             rmt_rx_stop(4);
@@ -284,19 +296,21 @@ void halIOIRRecvTask(void * param)
           }
           //if we received already something and timeout triggers ->
           //command finished
-          if(offset != 0) 
+          if(rxbuf.count != 0) 
           {
             //update status accordingly
-            if(offset > TASK_HAL_IR_RECV_MINIMUM_EDGES)
+            if(rxbuf.count > TASK_HAL_IR_RECV_MINIMUM_EDGES)
             {
               //save everything necessary to pointer from queue
-              recv->count = offset;
+              recv->buffer = rxbuf.buffer;
+              recv->count = rxbuf.count;
               recv->status = IR_FINISHED;
-              ESP_LOGI(LOG_TAG,"Recorded @%d %d edges",(uint32_t)recv->buffer,offset);
+              ESP_LOGI(LOG_TAG,"Recorded @%d %d edges",(uint32_t)recv->buffer,recv->count);
             } else {
               //timeout, cancel
-              recv->status = IR_TOOSHORT;
+              ir_recv_buffer_free(&rxbuf);
               recv->count = 0;
+              recv->status = IR_TOOSHORT;
               ESP_LOGE(LOG_TAG,"IR cmd too short");
             }
             rmt_rx_stop(4);
@@ -308,19 +322,91 @@ void halIOIRRecvTask(void * param)
   }
 }
 
+/** @brief Play the current note of the melody
+ * 
+ * Sets frequency & duty of the LEDC channel and the end time of the
+ * note. If all notes (and repetitions) are played, the buzzer is muted.
+ * @note Call only from the buzzer task.
+ */
+static void halIOBuzzerPlayNote(void)
+{
+  //end of notes reached, start next repetition
+  if(buzzer.note >= buzzer.melody.count)
+  {
+    buzzer.note = 0;
+    buzzer.repeat++;
+  }
+  
+  //finished?
+  if(buzzer.repeat >= (buzzer.melody.repeat ? buzzer.melody.repeat : 1))
+  {
+    //start the pending melody directly, no gap
+    if(buzzer.haspending)
+    {
+      memcpy(&buzzer.melody,&buzzer.pending,sizeof(halIOMelody_t));
+      buzzer.haspending = 0;
+      buzzer.note = 0;
+      buzzer.repeat = 0;
+    } else {
+      buzzer.playing = 0;
+      ledc_set_duty(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_3, 0);
+      ledc_update_duty(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_3);
+      return;
+    }
+  }
+  
+  halIOBuzzer_t *n = &buzzer.melody.notes[buzzer.note];
+  ESP_LOGD(LOG_TAG,"Buzz: freq %d, duration %d",n->frequency,n->duration);
+  
+  //do a tone only if frequency is != 0, otherwise it is just a pause
+  if(n->frequency != 0)
+  {
+    //reconfigure the timer only on frequency changes
+    if(buzzer_timer.freq_hz != n->frequency)
+    {
+      buzzer_timer.freq_hz = n->frequency;
+      ledc_timer_config(&buzzer_timer);
+    }
+    ledc_set_duty(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_3, 512);
+  } else {
+    ledc_set_duty(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_3, 0);
+  }
+  ledc_update_duty(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_3);
+  
+  //the buzzer task waits (on its queue) until the end of this note
+  buzzer.noteend = esp_timer_get_time() + (n->duration ? n->duration : 1) * 1000LL;
+}
+
+/** @brief Get the time until the current note ends
+ * @return Ticks to wait (rounded up), portMAX_DELAY if nothing is playing
+ */
+static TickType_t halIOBuzzerWait(void)
+{
+  if(!buzzer.playing) return portMAX_DELAY;
+  int64_t remaining = buzzer.noteend - esp_timer_get_time();
+  if(remaining <= 0) return 0;
+  return (remaining + portTICK_PERIOD_MS * 1000 - 1) / (portTICK_PERIOD_MS * 1000);
+}
+
 /** @brief HAL TASK - Buzzer update task
  * 
- * This task takes an instance of the buzzer update struct and creates
- * a tone on the buzzer accordingly.
- * Done via the LEDC driver & vTaskDelays
+ * This task takes a melody from the buzzer queue and starts it.
+ * The notes are played via the LEDC driver. While a melody is playing,
+ * the task waits on the queue until the end of the current note (no
+ * timer callback & no lock, the melody state is owned by this task),
+ * so new melodies are received at any time.
+ * A melody with a higher priority preempts the current one. A melody
+ * with the same priority is kept in one pending slot (a newer one
+ * replaces it) and started when the current one ends, so consecutive
+ * feedback is played in sequence. Lower priorities are dropped.
  * 
- * @see halIOBuzzer_t
+ * @see halIOMelody_t
  * @see halIOBuzzerQueue
  * @param param Unused.
  */
 void halIOBuzzerTask(void * param)
 {
-  halIOBuzzer_t recv;
+  halIOMelody_t recv;
   generalConfig_t *cfg = configGetCurrent();
   
   if(halIOBuzzerQueue == NULL)
@@ -338,51 +424,67 @@ void halIOBuzzerTask(void * param)
   
   while(1)
   {
-    //wait for updates
-    if(xQueueReceive(halIOBuzzerQueue,(void*)&recv,portMAX_DELAY) == pdTRUE)
+    //wait for updates or the end of the current note
+    if(xQueueReceive(halIOBuzzerQueue,(void*)&recv,halIOBuzzerWait()) != pdTRUE)
     {
-      
+      if(buzzer.playing && esp_timer_get_time() >= buzzer.noteend)
+      {
+        buzzer.note++;
+        halIOBuzzerPlayNote();
+      }
+    } else {
       //check if feedback mode is set to buzzer output. If not: do nothing
       if((cfg->feedback & 0x02) == 0) continue;
       
-      ESP_LOGD(LOG_TAG,"Buzz: freq %d, duration %d",recv.frequency,recv.duration);
-      
-      //set duty, set frequency
-      //do a tone only if frequency is != 0, otherwise it is just a pause
-      if(recv.frequency != 0)
+      if(recv.count == 0 || recv.count > HAL_IO_MELODY_NOTES)
       {
-        //multiply by 4, otherwise it would be half the frequency...
-        //ledc_set_freq(LEDC_LOW_SPEED_MODE, LEDC_TIMER_1, recv.frequency*4);
-        buzzer_timer.freq_hz = recv.frequency;
-        ledc_timer_config(&buzzer_timer);
-        
-        ledc_set_duty(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_3, 512);
-        ledc_update_duty(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_3);
+        ESP_LOGE(LOG_TAG,"Invalid melody, %d notes",recv.count);
+        continue;
       }
       
-      //delay for duration
-      vTaskDelay(recv.duration / portTICK_PERIOD_MS);
-      
-      //set duty to 0
-      ledc_set_duty(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_3, 0);
-      ledc_update_duty(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_3);
+      if(buzzer.playing && recv.priority < buzzer.melody.priority)
+      {
+        ESP_LOGD(LOG_TAG,"Melody dropped, prio %d < %d",recv.priority,buzzer.melody.priority);
+      } else if(buzzer.playing && recv.priority == buzzer.melody.priority) {
+        //play after the current one
+        memcpy(&buzzer.pending,&recv,sizeof(halIOMelody_t));
+        buzzer.haspending = 1;
+      } else {
+        //preempt the current melody (and the pending one) & start the new one
+        buzzer.haspending = 0;
+        memcpy(&buzzer.melody,&recv,sizeof(halIOMelody_t));
+        buzzer.note = 0;
+        buzzer.repeat = 0;
+        buzzer.playing = 1;
+        halIOBuzzerPlayNote();
+      }
     }
   }
 }
 
 /** @brief HAL TASK - LED update task
  * 
- * This task simply takes an uint32_t value from the LED queue
- * and calls the ledc_fading_... methods of the esp-idf.
+ * This task takes an animation descriptor from the LED queue and
+ * computes the frames (every LED_ANIM_FRAME_MS) as long as the
+ * animation is running. Static colors are sent once, afterwards
+ * the task sleeps until a new descriptor is received.
  * 
  * @see halIOLEDQueue
+ * @see led_anim_frame
  * @param param Unused
  */
 void halIOLEDTask(void * param)
 {
-  uint32_t recv = 0;
+  led_anim_t recv;
+  led_anim_state_t state;
+  uint8_t rgb[LED_NEOPIXEL_COUNT*3];
+  uint8_t running = 0;
+  int64_t start = 0;
+  uint32_t maxframe = 0;
   generalConfig_t *cfg = configGetCurrent();
   
+  memset(&state,0,sizeof(state));
+  
   if(halIOLEDQueue == NULL)
   {
     ESP_LOGW(LOG_TAG, "halIOLEDQueue not initialised");
@@ -399,44 +501,46 @@ void halIOLEDTask(void * param)
   
   while(1)
   {
-    //wait for updates
-    if(xQueueReceive(halIOLEDQueue,&recv,portMAX_DELAY))
+    //wait for updates, if an animation is running only until the next frame
+    if(xQueueReceive(halIOLEDQueue,&recv,running ? \
+      (LED_ANIM_FRAME_MS/portTICK_PERIOD_MS) : portMAX_DELAY) == pdTRUE)
     {
       //check if feedback mode is set to LED output. 
       //If not: clear LED
       if((cfg->feedback & 0x01) == 0)
       {
-        for(uint8_t i = 0; i<LED_NEOPIXEL_COUNT; i++)
-        {
-          //set the same color for each LED
-          led_strip_set_pixel_rgb(&led_strip, i,0,0,0);
-        }
-        //show new color
-        led_strip_show(&led_strip);
+        memset(&recv,0,sizeof(recv));
+        recv.mode = LED_ANIM_STEADY;
+      }
+      if(recv.mode > LED_ANIM_BLINK)
+      {
+        ESP_LOGE(LOG_TAG,"Unknown Neopixel animation mode");
         continue;
       }
-      //determine mode
-      switch(((recv & 0xFF000000) >> 24))
+      led_anim_start(&state,&recv);
+      start = esp_timer_get_time();
+      ESP_LOGD(LOG_TAG,"LED: 0x%02X/0x%02X/0x%02X, mode %d",recv.r,recv.g,recv.b,recv.mode);
+    } else if(!running) {
+      continue;
+    }
+    
+    //compute & show the current frame
+    int64_t now = esp_timer_get_time();
+    running = led_anim_frame(&state,(uint32_t)((now - start)/1000),rgb,LED_NEOPIXEL_COUNT);
+    for(uint8_t i = 0; i<LED_NEOPIXEL_COUNT; i++)
+    {
+      led_strip_set_pixel_rgb(&led_strip, i, rgb[i*3]/2, rgb[i*3+1]/2, rgb[i*3+2]/2);
+    }
+    led_strip_show(&led_strip);
+    
+    //check the CPU budget per frame
+    uint32_t frametime = (uint32_t)(esp_timer_get_time() - now);
+    if(frametime > maxframe)
+    {
+      maxframe = frametime;
+      if(frametime > LED_ANIM_FRAME_BUDGET_US)
       {
-        //currently not supported, mapping to steady color
-        case 1:
-        
-        //steady color
-        case 0:
-          for(uint8_t i = 0; i<LED_NEOPIXEL_COUNT; i++)
-          {
-            //set the same color for each LED
-            led_strip_set_pixel_rgb(&led_strip, i,(recv & 0x000000FF)/2, \
-              ((recv & 0x0000FF00) >> 8)/2, ((recv & 0x00FF0000) >> 16)/2);
-          }
-          //show new color
-          led_strip_show(&led_strip);
-          ESP_LOGD(LOG_TAG,"LED: 0x%02X/0x%02X/0x%02X",(recv & 0x000000FF), \
-              ((recv & 0x0000FF00) >> 8), ((recv & 0x00FF0000) >> 16));
-          break;
-        default:
-          ESP_LOGE(LOG_TAG,"Unknown Neopixel animation mode");
-          break;
+        ESP_LOGW(LOG_TAG,"LED frame took %"PRIu32"us (%d pixels)",frametime,LED_NEOPIXEL_COUNT);
       }
     }
   }
@@ -541,7 +645,7 @@ esp_err_t halIOInit(void)
   
   /*++++ init long press action timer. ++++*/
   //create a single shot timer with given period (HAL_IO_LONGACTION_TIMEOUT)
-  longactiontimer = xTimerCreate("IO_longaction", HAL_IO_LONGACTION_TIMEOUT/portTICK_PERIOD_MS, \
+  longactiontimer = RTOS_TIMER_CREATE("IO_longaction", HAL_IO_LONGACTION_TIMEOUT/portTICK_PERIOD_MS, \
     pdFALSE, (void *) 0, halIOTimerCallback);
   if(longactiontimer == NULL)
   {
@@ -549,7 +653,7 @@ esp_err_t halIOInit(void)
   }
   
   /*++++ init infrared drivers (via RMT engine) ++++*/
-  halIOIRRecvQueue = xQueueCreate(8,sizeof(halIOIR_t*));
+  halIOIRRecvQueue = RTOS_QUEUE_CREATE(RTOS_QLEN_IR_RECV,sizeof(halIOIR_t*));
   
   //transmitter
   rmt_config_t rmtcfg;
@@ -611,8 +715,8 @@ esp_err_t halIOInit(void)
   {
     ESP_LOGE(LOG_TAG,"Error installing rmt driver for IR RX");
   }
-  if(xTaskCreate(halIOIRRecvTask,"irrecv",TASK_HAL_IR_RECV_STACKSIZE, 
-    (void*)NULL,TASK_HAL_IR_RECV_PRIORITY, NULL) == pdPASS)
+  if(RTOS_TASK_CREATE(halIOIRRecvTask,"irrecv",TASK_HAL_IR_RECV_STACKSIZE, 
+    (void*)NULL,TASK_HAL_IR_RECV_PRIORITY, NULL, TASK_CORE_SYSTEM) == pdPASS)
   {
     ESP_LOGD(LOG_TAG,"created IR receive task");
   } else {
@@ -630,7 +734,7 @@ esp_err_t halIOInit(void)
   }
   
   //init remaining stuff of led strip driver struct
-  led_strip.access_semaphore = xSemaphoreCreateBinary();
+  led_strip.access_semaphore = RTOS_BINARY_CREATE();
   led_strip.led_strip_buf_1 = neop_buf1;
   led_strip.led_strip_buf_2 = neop_buf2;
   //initialize module
@@ -640,9 +744,9 @@ esp_err_t halIOInit(void)
     return ESP_FAIL;
   }
   //start LED update task
-  halIOLEDQueue = xQueueCreate(8,sizeof(uint32_t));
-  if(xTaskCreate(halIOLEDTask,"ledtask",TASK_HAL_LED_STACKSIZE, 
-    (void*)NULL,TASK_HAL_LED_PRIORITY, NULL) == pdPASS)
+  halIOLEDQueue = RTOS_QUEUE_CREATE(RTOS_QLEN_LED,sizeof(led_anim_t));
+  if(RTOS_TASK_CREATE(halIOLEDTask,"ledtask",TASK_HAL_LED_STACKSIZE, 
+    (void*)NULL,TASK_HAL_LED_PRIORITY, NULL, TASK_CORE_SYSTEM) == pdPASS)
   {
     ESP_LOGD(LOG_TAG,"created LED task");
   } else {
@@ -653,7 +757,7 @@ esp_err_t halIOInit(void)
   /*++++ INIT buzzer ++++*/
   //we will use the LEDC unit for the buzzer
   //because RMT has no lower frequency than 611Hz (according to example)
-  halIOBuzzerQueue = xQueueCreate(32,sizeof(halIOBuzzer_t));
+  halIOBuzzerQueue = RTOS_QUEUE_CREATE(RTOS_QLEN_BUZZER,sizeof(halIOMelody_t));
   buzzer_timer.duty_resolution = LEDC_TIMER_10_BIT; // resolution of PWM duty
   buzzer_timer.freq_hz = 100;                     // frequency of PWM signal
   buzzer_timer.speed_mode = LEDC_LOW_SPEED_MODE;           // timer mode
@@ -670,8 +774,8 @@ esp_err_t halIOInit(void)
   ledc_channel_config(&buzzer_channel);
   
   //start buzzer update task
-  if(xTaskCreate(halIOBuzzerTask,"buzztask",TASK_HAL_BUZZER_STACKSIZE, 
-    (void*)NULL,TASK_HAL_BUZZER_PRIORITY, NULL) == pdPASS)
+  if(RTOS_TASK_CREATE(halIOBuzzerTask,"buzztask",TASK_HAL_BUZZER_STACKSIZE, 
+    (void*)NULL,TASK_HAL_BUZZER_PRIORITY, NULL, TASK_CORE_SYSTEM) == pdPASS)
   {
     ESP_LOGD(LOG_TAG,"created buzzer task");
   } else {
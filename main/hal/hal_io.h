@@ -39,41 +39,65 @@
  * 
  * The LED output is provided via (at least) one Neopixel LED.
  * To enable easy color settings, a macro is provided
- * (LED(r,g,b,m)).
+ * (LED(r,g,b,m)), animations are started via LEDANIM (see led_animation.h).
  * 
  * IR receiving / sending is done via the RMT engine and is supported by macros
  * as well.
  * */
  
+#include <inttypes.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/event_groups.h>
 #include <freertos/portmacro.h>
 #include "freertos/task.h"
 #include "freertos/queue.h"
+#include "freertos/semphr.h"
 #include <esp_log.h>
 #include "esp_err.h"
 #include "driver/ledc.h"
 #include "driver/gpio.h"
 #include "driver/rmt.h"
+#include "esp_timer.h"
 #include "led_strip/led_strip.h"
+//fixed point LED animations
+#include "led_animation.h"
+//growing IR receive buffer
+#include "ir_recv_buffer.h"
 //common definitions & data for all of these functional tasks
 #include "common.h"
 #include "../config_switcher.h"
 
-/** @brief Macro to easily create a tone
+/** @brief Macro to easily create a tone (normal priority)
  * @param freq Frequency of the tone [Hz]
- * @param length Tone length [ms] */
-#define TONE(freq,length) { \
-  halIOBuzzer_t tone = {    \
-    .frequency = freq,      \
-    .duration = length };   \
+ * @param length Tone length [ms]
+ * @see TONEPRIO */
+#define TONE(freq,length) TONEPRIO(freq,length,HAL_IO_TONE_PRIO_NORMAL)
+
+/** @brief Macro to easily create a tone with a given priority
+ * @param freq Frequency of the tone [Hz]
+ * @param length Tone length [ms]
+ * @param prio Priority, e.g. HAL_IO_TONE_PRIO_LOW
+ * @see halIOMelody_t */
+#define TONEPRIO(freq,length,prio) { \
+  halIOMelody_t tone = {    \
+    .priority = prio,       \
+    .count = 1,             \
+    .repeat = 1,            \
+    .notes = {{ .frequency = freq, .duration = length }} }; \
+  MELODY(&tone); }
+
+/** @brief Macro to play a melody (the melody is copied)
+ * @param m Pointer to a halIOMelody_t
+ * @see halIOBuzzerQueue */
+#define MELODY(m) { \
     if(halIOBuzzerQueue != NULL) { \
-  xQueueSend(halIOBuzzerQueue, (void*)&tone , (TickType_t) 0 ); }}
+  xQueueSend(halIOBuzzerQueue, (void*)(m) , (TickType_t) 0 ); }}
 
-/** @brief Macro to easily send an IR buffer 
+/** @brief Macro to easily send an IR buffer, the buffer is kept
  * @param buf rmt_item32_t pointer to the buffer
- * @param len Count of buffer items */
-#define SENDIR(buf,len) { \
+ * @param len Count of buffer items
+ * @see SENDIR */
+#define SENDIRKEEP(buf,len) { \
   /* check if there is an ongoing transmission. If yes, block for 50 ticks */ \
   rmt_wait_tx_done(0, 50); \
    /*rmt_register_tx_end_callback(halIOIRFree,buf);*/ /*disabled for idf v3.0 */ \
@@ -85,6 +109,13 @@
   if(ret != ESP_OK) ESP_LOGE(LOG_TAG,"Error writing RMT items: %d",ret); \
   /* added for esp-idf v3.0 */ \
   rmt_wait_tx_done(0, 50); \
+}
+
+/** @brief Macro to easily send an IR buffer, the buffer is freed afterwards
+ * @param buf rmt_item32_t pointer to the buffer
+ * @param len Count of buffer items */
+#define SENDIR(buf,len) { \
+  SENDIRKEEP(buf,len); \
   free(buf); \
 }
 
@@ -93,16 +124,29 @@
  * @see halIOIR_t */
 #define SENDIRSTRUCT(cfg) SENDIR(cfg->buffer, cfg->count)
 
-/** @brief Macro to easily update the LEDs (RGB or Neopixel, depending on configuration)
+/** @brief Macro to easily update the LEDs (Neopixel)
  * @param r 8bit value for red
  * @param g 8bit value for green
  * @param b 8bit value for blue
- * @param m Fade time [10¹ms] or animation mode
+ * @param m Animation mode (e.g., LED_ANIM_STEADY), with the default period
+ * @see halIOLEDQueue */
+#define LED(r,g,b,m) LEDANIM(m,r,g,b,LED_ANIM_DEFAULT_PERIOD,0,0)
+
+/** @brief Macro to start a LED animation (Neopixel)
+ * @param m Animation mode, e.g. LED_ANIM_BLINK
+ * @param red 8bit value for red
+ * @param green 8bit value for green
+ * @param blue 8bit value for blue
+ * @param p Period of one fade/pulse/blink/round [ms]
+ * @param c Count of pulses/blinks, 0 for endless
+ * @param d Blink on time (x/256 of the period), 0 for 50%
+ * @see led_anim_t
  * @see halIOLEDQueue */
-#define LED(r,g,b,m) { \
+#define LEDANIM(m,red,green,blue,p,c,d) { \
   if(halIOLEDQueue != NULL) { \
-  uint32_t colorupdate = ((m & 0xFF)<<24) | ((b & 0xFF)<<16) | ((g & 0xFF)<<8) | (r & 0xFF); \
-  xQueueSend(halIOLEDQueue, (void*)&colorupdate , (TickType_t) 0 ); \
+  led_anim_t animupdate = { .mode = (m), .r = (red) & 0xFF, .g = (green) & 0xFF, .b = (blue) & 0xFF, \
+    .period = (p), .count = (c), .duty = (d) }; \
+  xQueueSend(halIOLEDQueue, (void*)&animupdate , (TickType_t) 0 ); \
 } }
 
 #ifdef DEVICE_FLIPMOUSE
@@ -198,29 +242,19 @@
 
 /** @brief LED update queue
  * 
- * This queue is used to update the LED color & brightness
- * Please use one uint32_t value with following content:
- * * \<bits 0-7\> RED
- * * \<bits 8-15\> GREEN
- * * \<bits 16-23\> BLUE
- * 
- * Depending on the LED config (either one RGB LED or Neopixels are used),
- * bits 24-31 are used differently:
- * 
- * <b>RGB LED (LED_USE_NEOPIXEL is NOT defined)</b>:
- * 
- * * \<bits 24-31\> Fading time ([10¹ms] -> value of 200 is 2s)
+ * This queue is used to update the LED color & animation.
+ * Please send one led_anim_t descriptor (or use the LED/LEDANIM macros),
+ * the LED task computes all frames of the animation:
  * 
- * <b>Neopixels (LED_USE_NEOPIXEL is defined)</b>:
- * 
- * * \<bits 24-31\> Animation mode:
- * * <b>0</b> Steady color on all Neopixels
- * * <b>1</b> 3 Neopixels have the given color and are circled around
- * * <b>2-0xFF</b> Currently undefined, further modes might be added.
+ * * <b>LED_ANIM_STEADY</b> Steady color on all Neopixels
+ * * <b>LED_ANIM_CIRCLE</b> 3 Neopixels have the given color and are circled around
+ * * <b>LED_ANIM_FADE</b> Fade from the current to the given color
+ * * <b>LED_ANIM_PULSE</b> Pulse the given color (e.g., WiFi active)
+ * * <b>LED_ANIM_BLINK</b> Blink the given color, e.g. slot number
  * 
  * @note Call halIOInit to initialize this queue.
  * @see halIOInit
- * @see LED_USE_NEOPIXEL
+ * @see led_anim_t
  * @see LED_NEOPIXEL_COUNT
  **/
 extern QueueHandle_t halIOLEDQueue;
@@ -235,36 +269,32 @@ extern QueueHandle_t halIOLEDQueue;
 /**@brief How many edges are necessary to declare a command valid? */
 #define TASK_HAL_IR_RECV_MINIMUM_EDGES 5
 
-/**@brief How many edges can be stored maximum? */
-#define TASK_HAL_IR_RECV_MAXIMUM_EDGES 256
+/**@brief How many edges can be stored maximum?
+ * @note The receive buffer grows in chunks of TASK_HAL_IR_RECV_CHUNK_EDGES
+ * up to this cap. Must be below 0xFFFE (used as markers in hal_storage). */
+#ifndef TASK_HAL_IR_RECV_MAXIMUM_EDGES
+#define TASK_HAL_IR_RECV_MAXIMUM_EDGES 1024
+#endif
+
+/**@brief Growing step of the IR receive buffer [edges] */
+#define TASK_HAL_IR_RECV_CHUNK_EDGES 64
+
+/**@brief Level bits (level0 & level1) of a rmt_item32_t, used to invert
+ * the TSOP's active low signal while copying. */
+#define HAL_IO_IR_LEVEL_MASK ((1UL<<15) | (1UL<<31))
 
 /** @brief Task stacksize for LED update task */
 #define TASK_HAL_LED_STACKSIZE 2048
 
-/** @brief Task priority for LED update task */
-#define TASK_HAL_LED_PRIORITY (tskIDLE_PRIORITY + 2)
-
 /** @brief Task stacksize for buzzer update task */
 #define TASK_HAL_BUZZER_STACKSIZE 2048
 
 /** @brief Task stacksize for IR send task */
 #define TASK_HAL_IR_SEND_STACKSIZE 2048
 
-/** @brief Task priority for IR send task */
-#define TASK_HAL_IR_SEND_PRIORITY (tskIDLE_PRIORITY + 2)
-
 /** @brief Task stacksize for IR receive task */
 #define TASK_HAL_IR_RECV_STACKSIZE 2048
 
-/** @brief Task priority for IR receive task */
-#define TASK_HAL_IR_RECV_PRIORITY (tskIDLE_PRIORITY + 2)
-
-/** @brief Task priority for buzzer update task */
-#define TASK_HAL_BUZZER_PRIORITY (tskIDLE_PRIORITY + 2)
-
-/** @brief Task priority for buzzer update task */
-#define TASK_HAL_BUZZER_PRIORITY (tskIDLE_PRIORITY + 2)
-
 /** @brief Initializing IO HAL
  * 
  * This method initializes the IO HAL stuff:<br>
@@ -313,10 +343,29 @@ QueueHandle_t halIOIRRecvQueue;
 /** @brief Queue to trigger any sending of infrared remote commands 
  * @see halIOIR_t */
 QueueHandle_t halIOIRSendQueue;
-/** @brief Queue to trigger a buzzer tone 
- * @see halIOBuzzer_t */
+/** @brief Queue to trigger a buzzer tone or melody
+ * 
+ * One halIOMelody_t is sent for a complete melody, it is played
+ * by the buzzer task via LEDC, without blocking the sender.
+ * A running melody is replaced by a melody with a higher priority.
+ * A melody with the same priority is played afterwards (one pending
+ * slot, a newer one replaces it), melodies with a lower priority are
+ * dropped while a melody is playing.
+ * @see halIOMelody_t
+ * @see TONE
+ * @see MELODY */
 QueueHandle_t halIOBuzzerQueue;
 
+/** @brief Maximum count of notes in one melody */
+#define HAL_IO_MELODY_NOTES 8
+
+/** @brief Tone priority: input feedback (e.g., sip/puff) */
+#define HAL_IO_TONE_PRIO_LOW    0
+/** @brief Tone priority: action feedback (default for TONE) */
+#define HAL_IO_TONE_PRIO_NORMAL 1
+/** @brief Tone priority: system feedback (e.g., slot switch, calibration) */
+#define HAL_IO_TONE_PRIO_HIGH   2
+
 /** @brief Output buzzer noise */
 typedef struct halIOBuzzer {
   /** Frequency of tone [Hz]
@@ -326,4 +375,17 @@ typedef struct halIOBuzzer {
   uint16_t duration;
 } halIOBuzzer_t;
 
+/** @brief Melody descriptor for the buzzer
+ * @see halIOBuzzerQueue */
+typedef struct halIOMelody {
+  /** Priority, e.g. HAL_IO_TONE_PRIO_LOW */
+  uint8_t priority;
+  /** Count of used notes (1-HAL_IO_MELODY_NOTES) */
+  uint8_t count;
+  /** Count of repetitions of all notes (0 is treated as 1) */
+  uint8_t repeat;
+  /** Notes (tones & pauses) */
+  halIOBuzzer_t notes[HAL_IO_MELODY_NOTES];
+} halIOMelody_t;
+
 #endif
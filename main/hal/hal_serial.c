@@ -70,6 +70,12 @@
  */
 #define HAL_SERIAL_UART_TIMEOUT_MS 10000
 
+/** @brief Timeout for the remaining bytes of a binary CIM packet
+ * 
+ * A full packet (CIM_MAX_PACKET_LENGTH) takes ~7ms at 115k2 baud.
+ * @see halSerialReceiveCIM */
+#define HAL_SERIAL_CIM_TIMEOUT_MS 50
+
 /** @brief Timout for receiving ADC data via I2C
  * @see halSerialReceiveI2CADC */
 #define HAL_SERIAL_I2C_TIMEOUT_MS 100
@@ -114,6 +120,32 @@ void halSerialFlushRX(void)
   uart_flush(HAL_SERIAL_UART);
 }
 
+/** @brief Receive the remainder of a binary CIM packet
+ * 
+ * Called by halSerialRXTask after the first header byte ('@') was
+ * received at the beginning of a line. The remaining header is read,
+ * followed by the data (length given in the header).
+ * 
+ * @param buf Buffer, containing the first byte. At least CIM_MAX_PACKET_LENGTH
+ * @return Length of the full packet, -1 on an invalid header or a timeout
+ * @see cim_packet.h
+ * */
+static int halSerialReceiveCIM(uint8_t *buf)
+{
+  TickType_t timeout = HAL_SERIAL_CIM_TIMEOUT_MS / portTICK_PERIOD_MS;
+  
+  int len = uart_read_bytes(HAL_SERIAL_UART, &buf[1], CIM_HEADER_LENGTH - 1, timeout);
+  if(len != CIM_HEADER_LENGTH - 1) return -1;
+  
+  int32_t datalength = cim_packet_datalength(buf);
+  if(datalength < 0) return -1;
+  if(datalength == 0) return CIM_HEADER_LENGTH;
+  
+  len = uart_read_bytes(HAL_SERIAL_UART, &buf[CIM_HEADER_LENGTH], datalength, timeout);
+  if(len != datalength) return -1;
+  return CIM_HEADER_LENGTH + datalength;
+}
+
 /** @brief UART RX task for AT command pattern detection and parsing
  * 
  * This task is used to pend on any incoming UART bytes.
@@ -121,7 +153,11 @@ void halSerialFlushRX(void)
  * On a fully received AT command (terminated either by '\\r' or '\\n'),
  * the buffer will be sent to the halSerialATCmds queue.
  * 
+ * A '@' at the beginning of a line starts a binary CIM packet, which is
+ * received by its length (not by line endings) & sent to the same queue.
+ * 
  * @see halSerialATCmds
+ * @see halSerialReceiveCIM
  * */
 void halSerialRXTask(void *pvParameters)
 {
@@ -152,6 +188,37 @@ void halSerialRXTask(void *pvParameters)
         continue;
       }
       
+      //binary CIM packet, an AT command never starts with '@'
+      if(data == CIM_HEADER_0 && cmdoffset == 0)
+      {
+        bufstatic[0] = data;
+        int cimlen = halSerialReceiveCIM(bufstatic);
+        if(cimlen < 0)
+        {
+          //drop remaining bytes of this packet (resync on the next
+          //request), the ARE repeats unanswered requests
+          halSerialFlushRX();
+          metricsInc(METRIC_CIM_ERRORS);
+          ESP_LOGW(LOG_TAG,"Invalid CIM packet, discarding");
+          continue;
+        }
+        buf = malloc(cimlen);
+        if(buf == NULL)
+        {
+          ESP_LOGE(LOG_TAG,"Cannot allocate %d B buffer for CIM packet",cimlen);
+          continue;
+        }
+        memcpy(buf,bufstatic,cimlen);
+        currentcmd.buf = buf;
+        currentcmd.len = cimlen;
+        if(halSerialATCmds == NULL || xQueueSend(halSerialATCmds,(void*)&currentcmd,10) != pdTRUE)
+        {
+          ESP_LOGE(LOG_TAG,"AT cmd queue is full/NULL, cannot send CIM packet");
+          free(buf);
+        }
+        continue;
+      }
+      
       //now read data until we reach \r or \n
       if(data == '\r' || data == '\n')
       {
@@ -287,6 +354,13 @@ void halSerialHIDTask(void *param)
       //pend on MQ, if timeout triggers, just wait again.
       if(xQueueReceive(hid_usb,&rx,portMAX_DELAY))
       {
+        METRICS_QUEUE_HWM(METRIC_HWM_HID_USB,hid_usb);
+        if(metricsGet(METRIC_FIRST_HID_US) == 0) 
+        {
+          metricsSet(METRIC_FIRST_HID_US,(uint32_t)esp_timer_get_time());
+          metricsBootPhase("first_hid_usb");
+        }
+        metricsInc(METRIC_HID_USB);
         //output if debug
         #if LOG_LEVEL_SERIAL >= ESP_LOG_DEBUG
           ESP_LOGD(LOG_TAG,"HID: %02X:%02X:%02X",rx.cmd[0],rx.cmd[1],rx.cmd[2]);
@@ -345,6 +419,7 @@ int halSerialReceiveI2CADC(uint8_t **data)
   if(ret == ESP_OK) return size;
   else 
   {
+    metricsInc(METRIC_I2C_ERRORS);
     //try to re-initialize for next call.
     halSerialInitI2C(true);
     return -1;
@@ -370,6 +445,7 @@ int halSerialReceiveUSBSerial(uint8_t **data)
   atcmd_t recv;
   if(xQueueReceive(halSerialATCmds,&recv,HAL_SERIAL_UART_TIMEOUT_MS / portTICK_PERIOD_MS))
   {
+    METRICS_QUEUE_HWM(METRIC_HWM_ATCMDS,halSerialATCmds);
     //test for valid buffer
     if(recv.buf == NULL)
     {
@@ -441,6 +517,30 @@ int halSerialSendUSBSerial(char *data, uint32_t length, TickType_t ticks_to_wait
   } else return -1;
 }
 
+/** @brief Send binary data to USB-Serial (USB-CDC)
+ * 
+ * In contrast to halSerialSendUSBSerial, no line ending is appended and
+ * the data is not sent to the additional output stream.
+ * Used for binary protocols (CIM).
+ * 
+ * @return -1 on error, number of sent bytes otherwise
+ * @param data Data to be sent
+ * @param length Number of bytes to send
+ * @param ticks_to_wait Maximum time to wait for a free UART
+ * */
+int halSerialSendUSBSerialRaw(const uint8_t *data, uint32_t length, TickType_t ticks_to_wait)
+{
+  if(serialsendingsem == NULL) return -1;
+  
+  //acquire mutex to have TX permission on UART
+  if(xSemaphoreTake(serialsendingsem, ticks_to_wait) == pdTRUE)
+  {
+    int txBytes = uart_write_bytes(HAL_SERIAL_UART, (const char*)data, length);
+    xSemaphoreGive(serialsendingsem);
+    return txBytes;
+  } else return -1;
+}
+
 /** @brief Reset the serial HID report data
  * 
  * Used for slot/config switchers.
@@ -566,7 +666,7 @@ esp_err_t halSerialInit(void)
   
   //create mutex for all tasks sending to serial TX queue.
   //avoids splitting of different packets due to preemption
-  serialsendingsem = xSemaphoreCreateMutex();
+  serialsendingsem = RTOS_MUTEX_CREATE();
   if(serialsendingsem == NULL) 
   {
     ESP_LOGE(LOG_TAG,"Cannot create semaphore for TX"); 
@@ -574,7 +674,7 @@ esp_err_t halSerialInit(void)
   }
   
   //create the AT command queue
-  halSerialATCmds = xQueueCreate(CMDQUEUE_SIZE,sizeof(atcmd_t));
+  halSerialATCmds = RTOS_QUEUE_CREATE(CMDQUEUE_SIZE,sizeof(atcmd_t));
 
   /*++++ I2C config (sending HID commands; receiving ADC data) ++++*/
   halSerialInitI2C(false);
@@ -582,10 +682,12 @@ esp_err_t halSerialInit(void)
 
   /*++++ task setup ++++*/
   //task for sending HID commands via I2C
-  xTaskCreate(halSerialHIDTask, "serialHID", HAL_SERIAL_TASK_STACKSIZE+256, NULL, configMAX_PRIORITIES-3, NULL);
+  RTOS_TASK_CREATE(halSerialHIDTask, "serialHID", RTOS_STACK_SERIAL_HID, NULL, \
+    HAL_SERIAL_HID_TASK_PRIORITY, NULL, TASK_CORE_INPUT);
   
   //Create a task to handler UART event from ISR
-  xTaskCreate(halSerialRXTask, "serialRX", HAL_SERIAL_TASK_STACKSIZE, NULL, configMAX_PRIORITIES-3, NULL);
+  RTOS_TASK_CREATE(halSerialRXTask, "serialRX", RTOS_STACK_SERIAL_RX, NULL, \
+    HAL_SERIAL_RX_TASK_PRIORITY, NULL, TASK_CORE_SYSTEM);
 
   //everything went fine
   ESP_LOGI(LOG_TAG,"Driver installation complete");
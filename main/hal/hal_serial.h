@@ -57,6 +57,9 @@
 #include "common.h"
 //used for add/remove keycodes from a HID report
 #include "keyboard.h"
+#include "metrics.h"
+//framing of binary CIM packets (AsTeRICS)
+#include "cim_packet.h"
 //used to get current locale information
 #include "../config_switcher.h"
 
@@ -121,7 +124,8 @@ void halSerialRemoveOutputStream(void);
 /** @brief AT command type for halSerialATCmds queue
  * 
  * This type of data is used to pass one AT command (in format
- * of "AT MX 100") to any pending task.
+ * of "AT MX 100") or one binary CIM packet (starting with "@T") to any
+ * pending task.
  * @see halSerialATCmds
  * */
 typedef struct atcmd {
@@ -169,6 +173,19 @@ void halSerialReset(uint8_t exceptDevice);
  * */
 int halSerialSendUSBSerial(char *data, uint32_t length, TickType_t ticks_to_wait);
 
+/** @brief Send binary data to USB-Serial (USB-CDC)
+ * 
+ * In contrast to halSerialSendUSBSerial, no line ending is appended and
+ * the data is not sent to the additional output stream.
+ * Used for binary protocols (CIM).
+ * 
+ * @return -1 on error, number of sent bytes otherwise
+ * @param data Data to be sent
+ * @param length Number of bytes to send
+ * @param ticks_to_wait Maximum time to wait for a free UART
+ * */
+int halSerialSendUSBSerialRaw(const uint8_t *data, uint32_t length, TickType_t ticks_to_wait);
+
 /** @brief Flush Serial RX input buffer */
 void halSerialFlushRX(void);
 
@@ -77,6 +77,9 @@ static uint8_t storageCurrentSlotNumber = 0;
  * on halStorageFinishTransaction
  * */
 static FILE *storeHandle = NULL;
+/** @brief Change counter for IR commands, incremented on each store/delete
+ * @see halStorageGetIRGeneration */
+static volatile uint32_t storageIRGeneration = 0;
 
 /** @brief Partition name (used to define different memory types) */
 const static char *base_path = "/spiffs";
@@ -221,6 +224,27 @@ esp_err_t halStorageInit(void)
   return ret;
 }
 
+/** @brief Create the storage mutex
+ * 
+ * Call this function once on boot, before any task starts a storage
+ * transaction. The filesystem itself is mounted on the first
+ * transaction.
+ * 
+ * @see halStorageStartTransaction
+ * @return ESP_OK on success (or if already created), ESP_FAIL otherwise
+ * */
+esp_err_t halStorageMutexInit(void)
+{
+  if(halStorageMutex != NULL) return ESP_OK;
+  halStorageMutex = RTOS_MUTEX_CREATE();
+  if(halStorageMutex == NULL)
+  {
+    ESP_LOGE(LOG_TAG,"Not sufficient memory to create mutex, cannot access!");
+    return ESP_FAIL;
+  }
+  return ESP_OK;
+}
+
 /** @brief Internal helper to check for a valid WL handle and the correct tid 
  * @see storageCurrentTID
  * @param tid Currently used TID
@@ -492,6 +516,9 @@ esp_err_t halStorageDeleteIRCmd(int16_t slotnr, uint32_t tid)
   //check for valid storage handle
   if(halStorageChecks(tid) != ESP_OK) return ESP_FAIL;
   
+  //IR commands are changed, invalidate any cached ones
+  storageIRGeneration++;
+  
   //delete one or all slots
   struct stat st;
   for(uint8_t i = from; i<=to; i++)
@@ -1072,7 +1099,8 @@ esp_err_t halStorageLoadNumber(uint8_t slotnumber, uint32_t tid, uint8_t outputS
       {
         ESP_LOGE(LOG_TAG,"Buffer overflow on serial");
       } else {
-        ESP_LOGI(LOG_TAG,"Sent serial config with len %d to queue: %s",strnlen(at,ATCMD_LENGTH),at);
+        //the line itself is already on the serial port, at is freed afterwards
+        DLOGD(LOG_LEVEL_STORAGE,LOG_TAG,"Sent serial config line, len %d",strnlen(at,ATCMD_LENGTH));
       }
       cmdcount++;
       free(at);
@@ -1097,6 +1125,21 @@ esp_err_t halStorageLoadNumber(uint8_t slotnumber, uint32_t tid, uint8_t outputS
       //print out MQTT delimiter ("AT ML")
       sprintf(outputstring,"AT ML ");
       ret = halStorageNVSLoadString(NVS_MQTT_DELIM,&outputstring[6]);
+      if(ret == ESP_OK) halSerialSendUSBSerial(outputstring, \
+        strnlen(outputstring,ATCMD_LENGTH),100/portTICK_PERIOD_MS);
+      //print out MQTT control base topic ("AT MC")
+      sprintf(outputstring,"AT MC ");
+      ret = halStorageNVSLoadString(NVS_MQTT_CONTROL,&outputstring[6]);
+      if(ret == ESP_OK) halSerialSendUSBSerial(outputstring, \
+        strnlen(outputstring,ATCMD_LENGTH),100/portTICK_PERIOD_MS);
+      //print out MQTT control permissions ("AT MP")
+      sprintf(outputstring,"AT MP ");
+      ret = halStorageNVSLoadString(NVS_MQTT_CTRLPERM,&outputstring[6]);
+      if(ret == ESP_OK) halSerialSendUSBSerial(outputstring, \
+        strnlen(outputstring,ATCMD_LENGTH),100/portTICK_PERIOD_MS);
+      //print out ADC idle timeout ("AT SI")
+      sprintf(outputstring,"AT SI ");
+      ret = halStorageNVSLoadString(NVS_ADC_IDLETIMEOUT,&outputstring[6]);
       if(ret == ESP_OK) halSerialSendUSBSerial(outputstring, \
         strnlen(outputstring,ATCMD_LENGTH),100/portTICK_PERIOD_MS);
       //print out Wifi station name ("AT WH")
@@ -1308,6 +1351,11 @@ esp_err_t halStorageStore(uint32_t tid, char *cfgstring, uint8_t slotnumber)
  * command name. 
  * If there is already a cmd with this given name, it is overwritten!
  * 
+ * If the command was decoded (cfg->code.protocol != IR_PROTO_RAW),
+ * only the compact irCode_t is stored instead of the edges.
+ * In this case, the edge count is replaced by HAL_STORAGE_IR_COMPACT.
+ * Raw edges are packed (HAL_STORAGE_IR_PACKED) if possible.
+ * 
  * @param tid Transaction id
  * @param cfg Pointer to a IR config, can be freed after this call
  * @param cmdName Name of this IR command
@@ -1358,6 +1406,8 @@ esp_err_t halStorageStoreIR(uint32_t tid, halIOIR_t *cfg, char *cmdName)
     ESP_LOGE(LOG_TAG,"cannot open file for writing: %s",file);
     return ESP_FAIL;
   }
+  //IR commands are changed, invalidate any cached ones
+  storageIRGeneration++;
   
   fseek(f,0,SEEK_SET);
   
@@ -1367,6 +1417,53 @@ esp_err_t halStorageStoreIR(uint32_t tid, halIOIR_t *cfg, char *cmdName)
   fwrite(cmdName,sizeof(char),namelen, f);
   fwrite(&nullterm,sizeof(char),1, f);
   
+  //decoded command: store marker & compact code only
+  if(cfg->code.protocol != IR_PROTO_RAW)
+  {
+    uint16_t marker = HAL_STORAGE_IR_COMPACT;
+    //limit repeats, otherwise the synthesized edges might not fit on loading
+    irCode_t code = cfg->code;
+    if(code.repeats > IR_PROTOCOL_MAX_REPEATS) code.repeats = IR_PROTOCOL_MAX_REPEATS;
+    fwrite(&marker,sizeof(uint16_t),1, f);
+    if(fwrite(&code,sizeof(irCode_t),1,f) != 1)
+    {
+      ESP_LOGE(LOG_TAG,"Error writing IR cmd");
+      fclose(f);
+      return ESP_FAIL;
+    }
+    ESP_LOGI(LOG_TAG,"Stored IR cmd %u (%s) as %s with %u bytes payload (raw: %u bytes)", \
+      cmdnumber, cmdName, ir_protocol_name(cfg->code.protocol), sizeof(irCode_t), \
+      sizeof(rmt_item32_t)*cfg->count);
+    fclose(f);
+    return ESP_OK;
+  }
+  
+  //raw command: try to pack the edges, store packed data if smaller
+  uint8_t *packed = malloc(sizeof(rmt_item32_t)*cfg->count);
+  if(packed != NULL)
+  {
+    uint16_t packedlen = ir_raw_pack(cfg->buffer,cfg->count,packed,sizeof(rmt_item32_t)*cfg->count);
+    if(packedlen != 0)
+    {
+      uint16_t marker = HAL_STORAGE_IR_PACKED;
+      fwrite(&marker,sizeof(uint16_t),1, f);
+      fwrite(&packedlen,sizeof(uint16_t),1, f);
+      if(fwrite(packed,sizeof(uint8_t),packedlen,f) != packedlen)
+      {
+        ESP_LOGE(LOG_TAG,"Error writing IR cmd");
+        free(packed);
+        fclose(f);
+        return ESP_FAIL;
+      }
+      ESP_LOGI(LOG_TAG,"Stored IR cmd %u (%s) packed with %u bytes payload (raw: %u bytes)", \
+        cmdnumber, cmdName, packedlen, sizeof(rmt_item32_t)*cfg->count);
+      free(packed);
+      fclose(f);
+      return ESP_OK;
+    }
+    free(packed);
+  }
+  
   //write length of IR commands.
   fwrite(&cfg->count,sizeof(uint16_t),1, f);
   
@@ -1390,6 +1487,21 @@ esp_err_t halStorageStoreIR(uint32_t tid, halIOIR_t *cfg, char *cmdName)
   return ESP_OK;
 }
 
+/** @brief Get the change counter of IR commands
+ * 
+ * This counter is incremented each time an IR command is stored
+ * or deleted. It can be used to invalidate cached IR commands,
+ * no transaction is necessary.
+ * 
+ * @return Current change counter
+ * @see halStorageStoreIR
+ * @see halStorageDeleteIRCmd
+ * */
+uint32_t halStorageGetIRGeneration(void)
+{
+  return storageIRGeneration;
+}
+
 /** @brief Load an IR command by name
  * 
  * This method loads an IR command from storage.
@@ -1400,6 +1512,9 @@ esp_err_t halStorageStoreIR(uint32_t tid, halIOIR_t *cfg, char *cmdName)
  * Finally, if the command is loaded, call halStorageFinishTransaction to
  * free the storage access to the other tasks or the next call.
  * 
+ * Compact (decoded) commands are synthesized to RMT edges here, so
+ * cfg->buffer always contains a sendable waveform.
+ * 
  * @see halStorageStartTransaction
  * @see halStorageFinishTransaction
  * @param cmdName Name of the slot to be loaded
@@ -1464,7 +1579,103 @@ esp_err_t halStorageLoadIR(char *cmdName, halIOIR_t *cfg, uint32_t tid)
       ESP_LOGI(LOG_TAG,"Found IR slot \"%s\" @%u",cmdName,currentSlot);
       //read length of recorded items
       uint16_t irlength = 0;
-      fread(&irlength,sizeof(uint16_t),1,f);
+      if(fread(&irlength,sizeof(uint16_t),1,f) != 1)
+      {
+        ESP_LOGE(LOG_TAG,"Cannot read data from file");
+        fclose(f);
+        return ESP_FAIL;
+      }
+      
+      //compact command: read code & synthesize the edges
+      if(irlength == HAL_STORAGE_IR_COMPACT)
+      {
+        if(fread(&cfg->code,sizeof(irCode_t),1,f) != 1)
+        {
+          ESP_LOGE(LOG_TAG,"Cannot read data from file");
+          fclose(f);
+          return ESP_FAIL;
+        }
+        fclose(f);
+        //get length first, then fill the buffer
+        irlength = ir_protocol_encode(&cfg->code,NULL,0);
+        if(irlength == 0 || irlength > TASK_HAL_IR_RECV_MAXIMUM_EDGES)
+        {
+          ESP_LOGE(LOG_TAG,"Cannot encode IR cmd (length %u)",irlength);
+          return ESP_FAIL;
+        }
+        cfg->buffer = malloc(sizeof(rmt_item32_t)*irlength);
+        if(cfg->buffer == NULL)
+        {
+          ESP_LOGE(LOG_TAG,"No memory for IR command");
+          return ESP_FAIL;
+        }
+        cfg->count = ir_protocol_encode(&cfg->code,cfg->buffer,irlength);
+        ESP_LOGI(LOG_TAG,"Synthesized %s cmd, length %d", \
+          ir_protocol_name(cfg->code.protocol),cfg->count);
+        return ESP_OK;
+      }
+      //raw command
+      cfg->code.protocol = IR_PROTO_RAW;
+      
+      //packed raw command: read packed data & unpack the edges
+      if(irlength == HAL_STORAGE_IR_PACKED)
+      {
+        uint16_t packedlen = 0;
+        //packed data is only stored if smaller than the raw edges
+        if(fread(&packedlen,sizeof(uint16_t),1,f) != 1 || packedlen == 0 || \
+          packedlen > HAL_STORAGE_IR_PACKED_MAXLEN)
+        {
+          ESP_LOGE(LOG_TAG,"Invalid packed IR cmd length %u",packedlen);
+          fclose(f);
+          return ESP_FAIL;
+        }
+        uint8_t *packed = malloc(packedlen);
+        if(packed == NULL)
+        {
+          ESP_LOGE(LOG_TAG,"No memory for IR command");
+          fclose(f);
+          return ESP_FAIL;
+        }
+        if(fread(packed,sizeof(uint8_t),packedlen,f) != packedlen)
+        {
+          ESP_LOGE(LOG_TAG,"Cannot read data from file");
+          free(packed);
+          fclose(f);
+          return ESP_FAIL;
+        }
+        fclose(f);
+        irlength = ir_raw_unpack(packed,packedlen,NULL,0);
+        if(irlength == 0 || irlength > TASK_HAL_IR_RECV_MAXIMUM_EDGES)
+        {
+          ESP_LOGE(LOG_TAG,"Corrupt packed IR cmd");
+          free(packed);
+          return ESP_FAIL;
+        }
+        cfg->buffer = malloc(sizeof(rmt_item32_t)*irlength);
+        if(cfg->buffer == NULL)
+        {
+          ESP_LOGE(LOG_TAG,"No memory for IR command");
+          free(packed);
+          return ESP_FAIL;
+        }
+        cfg->count = ir_raw_unpack(packed,packedlen,cfg->buffer,irlength);
+        free(packed);
+        if(cfg->count == 0)
+        {
+          ESP_LOGE(LOG_TAG,"Corrupt packed IR cmd");
+          free(cfg->buffer);
+          return ESP_FAIL;
+        }
+        return ESP_OK;
+      }
+      
+      //no recording has more edges
+      if(irlength == 0 || irlength > TASK_HAL_IR_RECV_MAXIMUM_EDGES)
+      {
+        ESP_LOGE(LOG_TAG,"Invalid IR cmd length %u",irlength);
+        fclose(f);
+        return ESP_FAIL;
+      }
       
       //allocate amount of IR edges.
       cfg->buffer = malloc(sizeof(rmt_item32_t)*irlength);
@@ -1525,16 +1736,12 @@ esp_err_t halStorageLoadIR(char *cmdName, halIOIR_t *cfg, uint32_t tid)
  * */
 esp_err_t halStorageStartTransaction(uint32_t *tid, TickType_t tickstowait, const char* caller)
 {
-  //check if mutex is initialized
+  //check if mutex is initialized (created once on boot)
   if(halStorageMutex == NULL)
   {
-    //if not, try to initialize
-    halStorageMutex = xSemaphoreCreateMutex();
-    if(halStorageMutex == NULL)
-    {
-      ESP_LOGE(LOG_TAG,"Not sufficient memory to create mutex, cannot access!");
-      return ESP_FAIL;
-    }
+    ESP_LOGE(LOG_TAG,"Mutex is NULL, call halStorageMutexInit on boot");
+    *tid = 0;
+    return ESP_FAIL;
   }
   
   //try to take the mutex
@@ -1554,6 +1761,11 @@ esp_err_t halStorageStartTransaction(uint32_t *tid, TickType_t tickstowait, cons
       if(halStorageInit() != ESP_OK)
       {
         ESP_LOGE(LOG_TAG,"error halStorageInit");
+        //release the storage again, otherwise no retry is possible
+        storageCurrentTID = 0;
+        strncpy(storageCurrentTIDHolder,"",2);
+        *tid = 0;
+        xSemaphoreGive(halStorageMutex);
         return ESP_FAIL;
       }
     }
@@ -91,12 +91,33 @@
 
 //for IR stuff
 #include "hal_io.h"
+//IR protocol decoding/encoding for compact IR commands
+#include "infrared_protocols.h"
 
 /** @brief Namespace for storing NVS key/value pairs.
  * @warning If changed, all previously data cannot be used!
  * */
 #define HAL_STORAGE_NVS_NAMESPACE "devcfg"
 
+/** @brief Marker for IR files, which contain an irCode_t instead of edges.
+ * 
+ * Stored in place of the edge count (no recording can have that many edges).
+ * @see halStorageStoreIR
+ * @see irCode_t */
+#define HAL_STORAGE_IR_COMPACT 0xFFFF
+
+/** @brief Marker for IR files, which contain packed raw edges.
+ * 
+ * Followed by the uint16_t length of the packed data.
+ * @see ir_raw_pack */
+#define HAL_STORAGE_IR_PACKED 0xFFFE
+
+/** @brief Maximum length of packed IR data [bytes]
+ * 
+ * Packed data is only stored if it is smaller than the raw edges.
+ * @see HAL_STORAGE_IR_PACKED */
+#define HAL_STORAGE_IR_PACKED_MAXLEN (sizeof(rmt_item32_t)*TASK_HAL_IR_RECV_MAXIMUM_EDGES)
+
 typedef enum {
   NEXT, /** load next slot (no name needed) **/
   PREV, /** load previous slot (no name needed) **/
@@ -125,6 +146,17 @@ typedef struct storageHeader {
   uint8_t vb;
 } storageHeader_t;
 
+/** @brief Create the storage mutex
+ * 
+ * Call this function once on boot, before any task starts a storage
+ * transaction. The filesystem itself is mounted on the first
+ * transaction.
+ * 
+ * @see halStorageStartTransaction
+ * @return ESP_OK on success (or if already created), ESP_FAIL otherwise
+ * */
+esp_err_t halStorageMutexInit(void);
+
 /** @brief Load a string from NVS (global, no slot assignment)
  * 
  * This method is used to load a string from a non-volatile storage.
@@ -290,6 +322,18 @@ esp_err_t halStorageLoadNumber(uint8_t slotnumber, uint32_t tid, uint8_t outputS
  * */
 esp_err_t halStorageLoadName(char *slotname, uint32_t tid);
 
+/** @brief Get the change counter of IR commands
+ * 
+ * This counter is incremented each time an IR command is stored
+ * or deleted. It can be used to invalidate cached IR commands,
+ * no transaction is necessary.
+ * 
+ * @return Current change counter
+ * @see halStorageStoreIR
+ * @see halStorageDeleteIRCmd
+ * */
+uint32_t halStorageGetIRGeneration(void);
+
 /** @brief Load an IR command by name
  * 
  * This method loads an IR command from storage.
@@ -300,6 +344,9 @@ esp_err_t halStorageLoadName(char *slotname, uint32_t tid);
  * Finally, if the command is loaded, call halStorageFinishTransaction to
  * free the storage access to the other tasks or the next call.
  * 
+ * Compact (decoded) commands are synthesized to RMT edges here, so
+ * cfg->buffer always contains a sendable waveform.
+ * 
  * @see halStorageStartTransaction
  * @see halStorageFinishTransaction
  * @param cmdName Name of the slot to be loaded
@@ -343,6 +390,11 @@ esp_err_t halStorageGetNameForNumberIR(uint32_t tid, uint8_t slotnumber, char *c
  * command name. 
  * If there is already a cmd with this given name, it is overwritten!
  * 
+ * If the command was decoded (cfg->code.protocol != IR_PROTO_RAW),
+ * only the compact irCode_t is stored instead of the edges.
+ * In this case, the edge count is replaced by HAL_STORAGE_IR_COMPACT.
+ * Raw edges are packed (HAL_STORAGE_IR_PACKED) if possible.
+ * 
  * @param tid Transaction id
  * @param cfg Pointer to a IR config, can be freed after this call
  * @param cmdName Name of this IR command
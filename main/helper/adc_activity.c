@@ -0,0 +1,76 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ * Copyright 2019 Benjamin Aigner <aignerb@technikum-wien.at,
+ * beni@asterics-foundation.org>
+ */
+/** @file
+ * @brief Activity detection for adaptive ADC sampling
+ *
+ * Raw values are compared to the last active sample (not to the
+ * previous one), so slow drifts are detected as well.
+ *
+ * @see adc_activity.h
+ **/
+
+#include "adc_activity.h"
+
+/** @brief Initialize the activity detection (full rate)
+ * @param a State
+ * @param period Sampling period at full rate [ms]
+ * @param idleperiod Sampling period in idle mode [ms]
+ * @param timeout Time without activity until idle mode [ms], 0 to disable
+ * @param noise Deviation of a raw channel which is detected as activity
+ * */
+void adc_activity_init(adc_activity_t *a, uint16_t period, uint16_t idleperiod,
+  uint32_t timeout, int32_t noise)
+{
+  memset(a,0,sizeof(adc_activity_t));
+  a->period = period;
+  a->idleperiod = idleperiod < period ? period : idleperiod;
+  a->timeout = timeout;
+  a->noise = noise;
+}
+
+/** @brief Process one sample & get the period until the next one
+ *
+ * @param a State
+ * @param raw Raw values (up, down, left, right, pressure)
+ * @param active Activity detected by the caller (movement out of the
+ * deadzone, held action, strong mode, telemetry,...)
+ * @return Period until the next sample [ms]
+ * */
+uint16_t adc_activity_update(adc_activity_t *a, const int32_t *raw, uint8_t active)
+{
+  //any channel above the noise floor?
+  for(uint8_t i = 0; i<ADC_ACTIVITY_CHANNELS && !active && a->valid; i++)
+  {
+    if(abs(raw[i] - a->ref[i]) > a->noise) active = 1;
+  }
+
+  if(active || !a->valid)
+  {
+    memcpy(a->ref,raw,sizeof(a->ref));
+    a->valid = 1;
+    a->idletime = 0;
+    a->idle = 0;
+  } else if(a->idle == 0) {
+    a->idletime += a->period;
+    if(a->timeout != 0 && a->idletime >= a->timeout) a->idle = 1;
+  }
+
+  return a->idle ? a->idleperiod : a->period;
+}
@@ -0,0 +1,91 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ * Copyright 2019 Benjamin Aigner <aignerb@technikum-wien.at,
+ * beni@asterics-foundation.org>
+ */
+/** @file
+ * @brief Activity detection for adaptive ADC sampling
+ *
+ * The ADC tasks (mouse & threshold mode) sample the sensors with a
+ * fixed period. If the user is idle for a while (no movement out of
+ * the deadzone, no pressure change, no held action), the sampling
+ * period is increased to save CPU time and I2C transfers.
+ * The first sample which differs from the last active sample by more
+ * than the noise floor (any channel, including pressure) switches back
+ * to the full rate.
+ *
+ * The wake-up penalty is bounded by the idle period: a change is
+ * detected at most one idle period later than at the full rate.
+ *
+ * @note This module has no dependencies to FreeRTOS or the hardware,
+ * the decision can be replayed on a host with recorded samples.
+ * @see halAdcTaskMouse
+ * @see halAdcTaskThreshold
+ **/
+
+#ifndef _ADC_ACTIVITY_H_
+#define _ADC_ACTIVITY_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** @brief Count of raw channels (up, down, left, right, pressure) */
+#define ADC_ACTIVITY_CHANNELS 5
+
+/** @brief State of the activity detection
+ * @see adc_activity_init */
+typedef struct adc_activity {
+  /** @brief Sampling period at full rate [ms] */
+  uint16_t period;
+  /** @brief Sampling period in idle mode [ms] */
+  uint16_t idleperiod;
+  /** @brief Time without activity until idle mode [ms], 0 to disable */
+  uint32_t timeout;
+  /** @brief Deviation of a raw channel which is detected as activity */
+  int32_t noise;
+  /** @brief Raw values of the last active sample */
+  int32_t ref[ADC_ACTIVITY_CHANNELS];
+  /** @brief Time since the last active sample [ms] */
+  uint32_t idletime;
+  /** @brief 1 if the reference values are valid */
+  uint8_t valid;
+  /** @brief 1 if sampling with idleperiod */
+  uint8_t idle;
+} adc_activity_t;
+
+/** @brief Initialize the activity detection (full rate)
+ * @param a State
+ * @param period Sampling period at full rate [ms]
+ * @param idleperiod Sampling period in idle mode [ms]
+ * @param timeout Time without activity until idle mode [ms], 0 to disable
+ * @param noise Deviation of a raw channel which is detected as activity
+ * */
+void adc_activity_init(adc_activity_t *a, uint16_t period, uint16_t idleperiod,
+  uint32_t timeout, int32_t noise);
+
+/** @brief Process one sample & get the period until the next one
+ *
+ * @param a State
+ * @param raw Raw values (up, down, left, right, pressure)
+ * @param active Activity detected by the caller (movement out of the
+ * deadzone, held action, strong mode, telemetry,...)
+ * @return Period until the next sample [ms]
+ * */
+uint16_t adc_activity_update(adc_activity_t *a, const int32_t *raw, uint8_t active);
+
+#endif /* _ADC_ACTIVITY_H_ */
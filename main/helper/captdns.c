@@ -27,6 +27,7 @@ the internal webserver.
 #include "esp_log.h"
 #include "tcpip_adapter.h"
 #include "string.h"
+#include "common.h"
 
 static int sockFd;
 TaskHandle_t dnsTaskHandle;
@@ -317,7 +318,7 @@ static void captdnsTask(void *pvParameters) {
 
 void captdnsInit(void) 
 {
-  xTaskCreate(captdnsTask, (const char *)"captdns", DNS_TASK_STACKSIZE, NULL, 3, &dnsTaskHandle);
+  xTaskCreatePinnedToCore(captdnsTask, (const char *)"captdns", DNS_TASK_STACKSIZE, NULL, TASK_DNS_PRIORITY, &dnsTaskHandle, TASK_CORE_SYSTEM);
   #if (LOG_LEVEL_DNS>=ESP_LOG_INFO)
   ESP_LOGI(LOG_TAG,"DNS task started");
   #endif
@@ -0,0 +1,96 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ * Copyright 2019 Benjamin Aigner <aignerb@technikum-wien.at,
+ * beni@asterics-foundation.org>
+ */
+/** @file
+ * @brief Packet framing of the AsTeRICS CIM protocol
+ *
+ * @see cim_packet.h
+ **/
+
+#include "cim_packet.h"
+
+/** @brief Read a little endian 16bit value */
+static uint16_t cim_get16(const uint8_t *p)
+{
+  return p[0] | (p[1] << 8);
+}
+
+/** @brief Write a little endian 16bit value */
+static void cim_set16(uint8_t *p, uint16_t val)
+{
+  p[0] = val & 0xFF;
+  p[1] = val >> 8;
+}
+
+/** @brief Get the data length from a received header
+ * @param header At least CIM_HEADER_LENGTH bytes
+ * @return Data length, -1 if the header is invalid or the length exceeds
+ * CIM_MAX_DATA_LENGTH */
+int32_t cim_packet_datalength(const uint8_t *header)
+{
+  if(header[0] != CIM_HEADER_0 || header[1] != CIM_HEADER_1) return -1;
+  uint16_t length = cim_get16(&header[CIM_OFFSET_LENGTH]);
+  if(length > CIM_MAX_DATA_LENGTH) return -1;
+  return length;
+}
+
+/** @brief Parse a full CIM packet
+ * @param buf Received bytes
+ * @param len Count of received bytes
+ * @param p Parsed packet
+ * @return 0 on success, -1 on an invalid header or a length mismatch */
+int32_t cim_packet_parse(const uint8_t *buf, uint32_t len, cim_packet_t *p)
+{
+  if(len < CIM_HEADER_LENGTH) return -1;
+  int32_t length = cim_packet_datalength(buf);
+  if(length < 0 || len != CIM_HEADER_LENGTH + (uint32_t)length) return -1;
+
+  p->areid = cim_get16(&buf[CIM_OFFSET_AREID]);
+  p->length = length;
+  p->serial = buf[CIM_OFFSET_SERIAL];
+  p->feature = cim_get16(&buf[CIM_OFFSET_FEATURE]);
+  p->code = cim_get16(&buf[CIM_OFFSET_CODE]);
+  p->data = length ? &buf[CIM_HEADER_LENGTH] : NULL;
+  return 0;
+}
+
+/** @brief Build a CIM packet
+ * @param buf Output buffer
+ * @param size Size of the output buffer
+ * @param serial Serial number
+ * @param feature CIM feature address
+ * @param code Request/reply code
+ * @param data Data, may be NULL if length is 0
+ * @param length Length of data
+ * @return Length of the packet, 0 if buf is too small */
+uint32_t cim_packet_build(uint8_t *buf, uint32_t size, uint8_t serial,
+  uint16_t feature, uint16_t code, const void *data, uint16_t length)
+{
+  if(size < CIM_HEADER_LENGTH + (uint32_t)length) return 0;
+
+  buf[0] = CIM_HEADER_0;
+  buf[1] = CIM_HEADER_1;
+  cim_set16(&buf[CIM_OFFSET_AREID], CIM_ARE_ID);
+  cim_set16(&buf[CIM_OFFSET_LENGTH], length);
+  buf[CIM_OFFSET_SERIAL] = serial;
+  cim_set16(&buf[CIM_OFFSET_FEATURE], feature);
+  cim_set16(&buf[CIM_OFFSET_CODE], code);
+  if(length != 0) memcpy(&buf[CIM_HEADER_LENGTH], data, length);
+  return CIM_HEADER_LENGTH + length;
+}
@@ -0,0 +1,152 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ * Copyright 2019 Benjamin Aigner <aignerb@technikum-wien.at,
+ * beni@asterics-foundation.org>
+ */
+/** @file
+ * @brief Packet framing of the AsTeRICS CIM protocol
+ *
+ * A CIM (Communication Interface Module) talks to the AsTeRICS Runtime
+ * Environment (ARE) via binary packets over the serial port.
+ * All multi-byte fields are little endian:
+ *
+ * | Offset | Size | Field                                  |
+ * |--------|------|----------------------------------------|
+ * | 0      | 2    | Header "@T"                            |
+ * | 2      | 2    | ARE ID (protocol version)              |
+ * | 4      | 2    | Data length                            |
+ * | 6      | 1    | Serial number (echoed in replies)      |
+ * | 7      | 2    | CIM feature address                    |
+ * | 9      | 2    | Request/reply code                     |
+ * | 11     | n    | Data                                   |
+ *
+ * An AT command can never start with '@', so the serial RX task can
+ * distinguish both protocols by the first byte.
+ *
+ * @note This module has no dependencies to FreeRTOS or the hardware,
+ * packets can be tested on a host.
+ * @see task_cim.h
+ **/
+
+#ifndef _CIM_PACKET_H_
+#define _CIM_PACKET_H_
+
+#include <stdint.h>
+#include <string.h>
+
+/** @brief First byte of each CIM packet */
+#define CIM_HEADER_0 '@'
+/** @brief Second byte of each CIM packet */
+#define CIM_HEADER_1 'T'
+
+/** @brief Length of the packet header (without data) */
+#define CIM_HEADER_LENGTH 11
+/** @brief Maximum data length of a packet, longer packets are discarded */
+#define CIM_MAX_DATA_LENGTH 64
+/** @brief Maximum length of a full packet */
+#define CIM_MAX_PACKET_LENGTH (CIM_HEADER_LENGTH + CIM_MAX_DATA_LENGTH)
+
+/** @brief ARE ID (protocol version) sent in each packet, minimum accepted
+ * version of requests (Arduino CIM: ARE_MINIMAL_VERSION) */
+#define CIM_ARE_ID 0x0001
+
+/** @brief Offset of the ARE ID */
+#define CIM_OFFSET_AREID 2
+/** @brief Offset of the data length */
+#define CIM_OFFSET_LENGTH 4
+/** @brief Offset of the serial number */
+#define CIM_OFFSET_SERIAL 6
+/** @brief Offset of the feature address */
+#define CIM_OFFSET_FEATURE 7
+/** @brief Offset of the request/reply code */
+#define CIM_OFFSET_CODE 9
+
+/* Request/reply codes & flags.
+ * Source: ARE CIM service, CIMProtocolPacket.java (COMMAND_* constants)
+ * and the Arduino CIM firmware of the AsTeRICS project (CMD_* defines).
+ * The lower byte is the command, replies echo the request's command.
+ * The upper byte carries error flags in replies. */
+/** @brief Request code: get the CIM ID & all feature addresses (COMMAND_REQUEST_FEATURE_LIST) */
+#define CIM_CMD_FEATURELIST 0x0000
+/** @brief Request code: write a feature (COMMAND_REQUEST_WRITE_FEATURE) */
+#define CIM_CMD_WRITE 0x0010
+/** @brief Request code: read a feature (COMMAND_REQUEST_READ_FEATURE) */
+#define CIM_CMD_READ 0x0011
+/** @brief Reply code: unrequested event, e.g. periodic report (COMMAND_EVENT_REPLY) */
+#define CIM_REPLY_EVENT 0x0020
+/** @brief Request code: reset the CIM, stop reports & default values (COMMAND_REQUEST_RESET_CIM) */
+#define CIM_CMD_RESET 0x0080
+/** @brief Request code: start the periodic reports (COMMAND_REQUEST_START_CIM) */
+#define CIM_CMD_START 0x0081
+/** @brief Request code: stop the periodic reports (COMMAND_REQUEST_STOP_CIM) */
+#define CIM_CMD_STOP 0x0082
+
+/** @brief Reply flag: unknown feature address (CIM spec: invalid feature) */
+#define CIM_REPLY_ERR_FEATURE (1<<8)
+/** @brief Reply flag: ARE ID (protocol version) not supported
+ * (CIM spec: invalid ARE version) */
+#define CIM_REPLY_ERR_ARE_VERSION (1<<9)
+/** @brief Reply flag: invalid data length or value
+ * @note FLipMouse specific, not defined by the ARE */
+#define CIM_REPLY_ERR_DATA (1<<10)
+/** @brief Reply flag: unknown request code or not supported for this feature
+ * @note FLipMouse specific, not defined by the ARE */
+#define CIM_REPLY_ERR_CMD (1<<11)
+
+/** @brief One parsed CIM packet
+ * @note data points into the parsed buffer. */
+typedef struct cim_packet {
+  /** @brief ARE ID (protocol version) */
+  uint16_t areid;
+  /** @brief Length of data */
+  uint16_t length;
+  /** @brief Serial number */
+  uint8_t serial;
+  /** @brief CIM feature address */
+  uint16_t feature;
+  /** @brief Request/reply code */
+  uint16_t code;
+  /** @brief Data, NULL if length is 0 */
+  const uint8_t *data;
+} cim_packet_t;
+
+/** @brief Get the data length from a received header
+ * @param header At least CIM_HEADER_LENGTH bytes
+ * @return Data length, -1 if the header is invalid or the length exceeds
+ * CIM_MAX_DATA_LENGTH */
+int32_t cim_packet_datalength(const uint8_t *header);
+
+/** @brief Parse a full CIM packet
+ * @param buf Received bytes
+ * @param len Count of received bytes
+ * @param p Parsed packet
+ * @return 0 on success, -1 on an invalid header or a length mismatch */
+int32_t cim_packet_parse(const uint8_t *buf, uint32_t len, cim_packet_t *p);
+
+/** @brief Build a CIM packet
+ * @param buf Output buffer
+ * @param size Size of the output buffer
+ * @param serial Serial number
+ * @param feature CIM feature address
+ * @param code Request/reply code
+ * @param data Data, may be NULL if length is 0
+ * @param length Length of data
+ * @return Length of the packet, 0 if buf is too small */
+uint32_t cim_packet_build(uint8_t *buf, uint32_t size, uint8_t serial,
+  uint16_t feature, uint16_t code, const void *data, uint16_t length);
+
+#endif /* _CIM_PACKET_H_ */
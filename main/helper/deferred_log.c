@@ -0,0 +1,210 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ * Copyright 2019 Benjamin Aigner <aignerb@technikum-wien.at,
+ * beni@asterics-foundation.org>
+ */
+/** @file
+ * @brief Deferred logging for hot paths
+ *
+ * Ring buffers (one per core) & drain task for the DLOGx macros.
+ *
+ * An entry is reserved by incrementing the ring's head (compare-and-set,
+ * like metricsAdd), filled and published by writing its sequence
+ * number. The drain task prints entries in order, up to the first one
+ * which is reserved but not yet published.
+ *
+ * @see deferred_log.h
+ **/
+
+#include "deferred_log.h"
+#include <stdio.h>
+#include <string.h>
+#include <xtensa/hal.h>
+#include "common.h"
+#include "metrics.h"
+
+/** @brief Logging tag for this module */
+#define LOG_TAG "dlog"
+
+/** @brief Count of calls for measuring the cost of one call */
+#define DLOG_BENCH_COUNT 16
+
+/** @brief One log entry (40 bytes) */
+typedef struct dlog_entry {
+  /** @brief Index+1 of this entry, written last (published) */
+  volatile uint32_t seq;
+  /** @brief Timestamp [ms], same as ESP_LOGx */
+  uint32_t timestamp;
+  /** @brief Log tag */
+  const char *tag;
+  /** @brief Format string */
+  const char *fmt;
+  /** @brief Log level */
+  uint8_t level;
+  /** @brief Count of valid arguments */
+  uint8_t argc;
+  /** @brief Raw arguments */
+  uint32_t args[DLOG_MAX_ARGS];
+} dlog_entry_t;
+
+/** @brief Ring buffer of one core */
+typedef struct dlog_ring {
+  /** @brief Next index to be reserved (producers) */
+  volatile uint32_t head;
+  /** @brief Next index to be printed (drain task only) */
+  volatile uint32_t tail;
+  /** @brief Entries, accessed with index & (DLOG_RING_SIZE-1) */
+  dlog_entry_t entries[DLOG_RING_SIZE];
+} dlog_ring_t;
+
+/** @brief One ring per core */
+static dlog_ring_t dlogRings[portNUM_PROCESSORS];
+
+/** @brief Letters for the log levels, same as ESP_LOGx */
+static const char dlogLetters[] = {'N','E','W','I','D','V'};
+
+/** @brief Colors for the log levels, same as ESP_LOGx (empty if disabled) */
+static const char *dlogColors[] = {"",LOG_COLOR_E,LOG_COLOR_W,LOG_COLOR_I,LOG_COLOR_D,LOG_COLOR_V};
+
+/** @brief Store a log entry in the ring of the current core
+ *
+ * Lock-free, can be called from any task. Use the DLOGx macros instead
+ * of calling this function directly.
+ * @param level Log level
+ * @param tag Log tag, must be constant
+ * @param fmt printf format string, must be constant
+ * @param argc Count of following arguments (32bit each)
+ * */
+void dlogWrite(esp_log_level_t level, const char *tag, const char *fmt, uint32_t argc, ...)
+{
+  dlog_ring_t *ring = &dlogRings[xPortGetCoreID()];
+  uint32_t index, set;
+  va_list ap;
+
+  //reserve an entry, drop if the ring is full
+  do {
+    index = ring->head;
+    if(index - ring->tail >= DLOG_RING_SIZE)
+    {
+      metricsInc(METRIC_DLOG_DROPPED);
+      return;
+    }
+    set = index + 1;
+    uxPortCompareSet(&ring->head, index, &set);
+  } while(set != index);
+
+  dlog_entry_t *entry = &ring->entries[index & (DLOG_RING_SIZE-1)];
+  entry->timestamp = esp_log_timestamp();
+  entry->tag = tag;
+  entry->fmt = fmt;
+  entry->level = level;
+  entry->argc = argc;
+  va_start(ap, argc);
+  for(uint8_t i = 0; i<argc && i<DLOG_MAX_ARGS; i++) entry->args[i] = va_arg(ap, uint32_t);
+  va_end(ap);
+
+  //publish, after all other fields are written
+  __sync_synchronize();
+  entry->seq = index + 1;
+}
+
+/** @brief Format & print one entry via esp_log_write */
+static void dlogPrint(const dlog_entry_t *entry)
+{
+  char line[DLOG_LINE_LENGTH];
+  const uint32_t *a = entry->args;
+  uint8_t level = entry->level < sizeof(dlogLetters) ? entry->level : ESP_LOG_VERBOSE;
+
+  int len = snprintf(line, sizeof(line), "%s%c (%"PRIu32") %s: ", dlogColors[level],
+    dlogLetters[level], entry->timestamp, entry->tag);
+  if(len < 0 || len >= sizeof(line)) len = 0;
+  //unused arguments are ignored by snprintf
+  snprintf(&line[len], sizeof(line) - len, entry->fmt, a[0], a[1], a[2], a[3], a[4]);
+  esp_log_write(level, entry->tag, "%s" LOG_RESET_COLOR "\n", line);
+}
+
+/** @brief Print all pending log entries
+ * @note Called by the drain task, can be used to flush the log
+ * before a reset.
+ * @return Count of printed entries */
+uint32_t dlogDrain(void)
+{
+  static uint32_t dropped = 0;
+  uint32_t count = 0;
+  dlog_entry_t entry;
+
+  for(uint8_t core = 0; core<portNUM_PROCESSORS; core++)
+  {
+    dlog_ring_t *ring = &dlogRings[core];
+    while(ring->tail != ring->head)
+    {
+      dlog_entry_t *current = &ring->entries[ring->tail & (DLOG_RING_SIZE-1)];
+      //reserved, but not published yet: continue on next drain
+      if(current->seq != ring->tail + 1) break;
+      memcpy(&entry, current, sizeof(dlog_entry_t));
+      //free the entry before printing (slow)
+      __sync_synchronize();
+      ring->tail++;
+      dlogPrint(&entry);
+      count++;
+    }
+  }
+
+  if(metricsGet(METRIC_DLOG_DROPPED) != dropped)
+  {
+    ESP_LOGW(LOG_TAG,"%"PRIu32" entries dropped (total)",metricsGet(METRIC_DLOG_DROPPED));
+    dropped = metricsGet(METRIC_DLOG_DROPPED);
+  }
+  return count;
+}
+
+/** @brief Drain task, prints all entries every DLOG_DRAIN_PERIOD_MS */
+static void dlogTask(void *param)
+{
+  while(1)
+  {
+    dlogDrain();
+    vTaskDelay(DLOG_DRAIN_PERIOD_MS / portTICK_PERIOD_MS);
+  }
+}
+
+/** @brief Initialize the deferred logging
+ *
+ * Measures the cost of one log call (METRIC_DLOG_CYCLES) and starts
+ * the drain task. Entries recorded before are printed afterwards.
+ * @return ESP_OK on success, ESP_FAIL otherwise
+ * */
+esp_err_t dlogInit(void)
+{
+  //measure the cost of one call, entries are not printed (level verbose)
+  esp_log_level_set(LOG_TAG, ESP_LOG_INFO);
+  uint32_t start = xthal_get_ccount();
+  for(uint8_t i = 0; i<DLOG_BENCH_COUNT; i++)
+  {
+    dlogWrite(ESP_LOG_VERBOSE, LOG_TAG, "benchmark %d/%d", 2, i, DLOG_BENCH_COUNT);
+  }
+  metricsSet(METRIC_DLOG_CYCLES, (xthal_get_ccount() - start) / DLOG_BENCH_COUNT);
+  ESP_LOGI(LOG_TAG,"deferred log call: %"PRIu32" cycles",metricsGet(METRIC_DLOG_CYCLES));
+
+  if(RTOS_TASK_CREATE(dlogTask, "dlog", DLOG_TASK_STACKSIZE, NULL, \
+    TASK_DLOG_PRIORITY, NULL, TASK_CORE_SYSTEM) != pdPASS)
+  {
+    ESP_LOGE(LOG_TAG,"error creating drain task");
+    return ESP_FAIL;
+  }
+  return ESP_OK;
+}
@@ -0,0 +1,127 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ * Copyright 2019 Benjamin Aigner <aignerb@technikum-wien.at,
+ * beni@asterics-foundation.org>
+ */
+/** @file
+ * @brief Deferred logging for hot paths
+ *
+ * ESP_LOGx formats the message with printf and writes it to the
+ * UART (shared with the AT command port) in the calling task.
+ * For hot paths (per character, per HID report, per VB event,...)
+ * the DLOGx macros are used instead: only the format string pointer,
+ * the tag, a timestamp and the raw arguments are stored in a ring
+ * buffer (one per core, lock-free via uxPortCompareSet).
+ * A low priority task (dlog) formats & prints these entries later via
+ * esp_log_write, the output looks like the one of ESP_LOGx.
+ *
+ * Each DLOGx call takes the module's compile time level (e.g.,
+ * LOG_LEVEL_HID) as first parameter. If the message's level is higher,
+ * the call is removed by the compiler.
+ *
+ * Restrictions:<br>
+ * * Up to DLOG_MAX_ARGS arguments, each must be 32bit or less
+ *   (integers, pointers). No floats, no 64bit values.
+ * * Strings (%s) must be constant, the pointer is dereferenced later.
+ *
+ * If the ring is full, entries are dropped and counted as
+ * METRIC_DLOG_DROPPED. The cost of one call is measured on init
+ * (METRIC_DLOG_CYCLES).
+ *
+ * @see metrics.h
+ **/
+
+#ifndef _DEFERRED_LOG_H_
+#define _DEFERRED_LOG_H_
+
+#include <stdint.h>
+#include <stdarg.h>
+#include <esp_log.h>
+#include <esp_err.h>
+
+/** @brief Maximum count of arguments per log entry */
+#define DLOG_MAX_ARGS 5
+
+/** @brief Count of entries per core, must be a power of 2 */
+#define DLOG_RING_SIZE 64
+
+/** @brief Stack size of the drain task */
+#define DLOG_TASK_STACKSIZE 3072
+
+/** @brief Interval of the drain task [ms] */
+#define DLOG_DRAIN_PERIOD_MS 20
+
+/** @brief Maximum length of one formatted log line */
+#define DLOG_LINE_LENGTH 160
+
+/** @brief Count arguments of a DLOG macro (0 to DLOG_MAX_ARGS+1) */
+#define DLOG_NARGS(...) DLOG_NARGS_(0, ##__VA_ARGS__, 6, 5, 4, 3, 2, 1, 0)
+/** @brief Helper for DLOG_NARGS */
+#define DLOG_NARGS_(_0, _1, _2, _3, _4, _5, _6, N, ...) N
+
+/** @brief Record a deferred log entry
+ *
+ * Removed by the compiler if modlevel or LOG_LOCAL_LEVEL is lower
+ * than level.
+ * @param modlevel Compile time level of the module, e.g. LOG_LEVEL_HID
+ * @param level Level of this message, e.g. ESP_LOG_INFO
+ * @param tag Log tag, must be constant
+ * @param fmt printf format string, must be constant */
+#define DLOG(modlevel, level, tag, fmt, ...) do { \
+  _Static_assert(DLOG_NARGS(__VA_ARGS__) <= DLOG_MAX_ARGS, "DLOG: too many arguments"); \
+  if((modlevel) >= (level) && LOG_LOCAL_LEVEL >= (level)) \
+    dlogWrite(level, tag, fmt, DLOG_NARGS(__VA_ARGS__), ##__VA_ARGS__); \
+} while(0)
+
+/** @brief Deferred log, error level @see DLOG */
+#define DLOGE(modlevel, tag, fmt, ...) DLOG(modlevel, ESP_LOG_ERROR, tag, fmt, ##__VA_ARGS__)
+/** @brief Deferred log, warning level @see DLOG */
+#define DLOGW(modlevel, tag, fmt, ...) DLOG(modlevel, ESP_LOG_WARN, tag, fmt, ##__VA_ARGS__)
+/** @brief Deferred log, info level @see DLOG */
+#define DLOGI(modlevel, tag, fmt, ...) DLOG(modlevel, ESP_LOG_INFO, tag, fmt, ##__VA_ARGS__)
+/** @brief Deferred log, debug level @see DLOG */
+#define DLOGD(modlevel, tag, fmt, ...) DLOG(modlevel, ESP_LOG_DEBUG, tag, fmt, ##__VA_ARGS__)
+/** @brief Deferred log, verbose level @see DLOG */
+#define DLOGV(modlevel, tag, fmt, ...) DLOG(modlevel, ESP_LOG_VERBOSE, tag, fmt, ##__VA_ARGS__)
+
+/** @brief Store a log entry in the ring of the current core
+ *
+ * Lock-free, can be called from any task. Use the DLOGx macros instead
+ * of calling this function directly.
+ * @param level Log level
+ * @param tag Log tag, must be constant
+ * @param fmt printf format string, must be constant
+ * @param argc Count of following arguments (32bit each)
+ * */
+void dlogWrite(esp_log_level_t level, const char *tag, const char *fmt, uint32_t argc, ...)
+  __attribute__((format(printf, 3, 5)));
+
+/** @brief Print all pending log entries
+ * @note Called by the drain task, can be used to flush the log
+ * before a reset.
+ * @return Count of printed entries */
+uint32_t dlogDrain(void);
+
+/** @brief Initialize the deferred logging
+ *
+ * Measures the cost of one log call (METRIC_DLOG_CYCLES) and starts
+ * the drain task. Entries recorded before are printed afterwards.
+ * @return ESP_OK on success, ESP_FAIL otherwise
+ * */
+esp_err_t dlogInit(void);
+
+#endif /* _DEFERRED_LOG_H_ */
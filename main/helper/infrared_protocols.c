@@ -0,0 +1,849 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ * Copyright 2019 Benjamin Aigner <aignerb@technikum-wien.at,
+ * beni@asterics-foundation.org>
+ */
+/** @file
+ * @brief Infrared protocol helper functions
+ *
+ * This module recognizes common IR remote protocols in recorded RMT
+ * edges and synthesizes the RMT waveform for a decoded command again.
+ *
+ * Decoding is done on "pulses": consecutive RMT half-items with the same
+ * level are merged, durations are converted to microseconds.
+ * Pulse distance protocols (NEC, Samsung, SIRC) are matched pulse by
+ * pulse, bi-phase protocols (RC5, RC6) are expanded into half-bit
+ * units before the bits are read.
+ *
+ * @note All durations are in RMT ticks, level 1 is a mark (carrier on).
+ * @see irCode_t
+ **/
+
+#include "infrared_protocols.h"
+
+/** @brief Logging tag for this module */
+#define LOG_TAG "IRproto"
+
+/** @brief Convert microseconds to RMT ticks */
+#define US_TO_TICKS(us)   (((us) * IR_PROTOCOL_TICK_10_US) / 10)
+/** @brief Convert RMT ticks to microseconds */
+#define TICKS_TO_US(t)    (((t) * 10) / IR_PROTOCOL_TICK_10_US)
+/** @brief Maximum duration of one RMT half item (15bit) */
+#define IR_MAX_TICKS      32767
+
+/*++++ protocol timings [us] ++++*/
+#define NEC_HDR_MARK      9000
+#define NEC_HDR_SPACE     4500
+#define NEC_RPT_SPACE     2250
+#define NEC_BIT_MARK      560
+#define NEC_ONE_SPACE     1690
+#define NEC_ZERO_SPACE    560
+#define NEC_PERIOD        108000
+
+#define SAMSUNG_HDR_MARK  4500
+#define SAMSUNG_HDR_SPACE 4500
+#define SAMSUNG_PERIOD    108000
+
+#define SIRC_HDR_MARK     2400
+#define SIRC_SPACE        600
+#define SIRC_ONE_MARK     1200
+#define SIRC_ZERO_MARK    600
+#define SIRC_PERIOD       45000
+/** @brief Minimum gap after a SIRC frame, shorter spaces belong to another protocol (e.g. RC6) */
+#define SIRC_MIN_GAP      5000
+/** @brief Sony devices need a command at least 3 times */
+#define SIRC_MIN_FRAMES   3
+
+#define RC5_T             889
+#define RC5_BITS          14
+#define RC5_PERIOD        113778
+
+#define RC6_T             444
+#define RC6_HDR_MARK      (6*RC6_T)
+#define RC6_HDR_SPACE     (2*RC6_T)
+/** @brief start bit + 3 mode bits (2 units each), trailer bit (4 units), 16 data bits */
+#define RC6_UNITS         (2 + 6 + 4 + 32)
+#define RC6_PERIOD        107000
+
+/** @brief Read position within recorded RMT items
+ * @note pos is counting half items (duration0/duration1) */
+typedef struct ir_cursor {
+  const rmt_item32_t *items;
+  uint16_t count;
+  uint16_t pos;
+} ir_cursor_t;
+
+/** @brief State for synthesizing a waveform
+ * @note If items is NULL, only the necessary count is determined. */
+typedef struct ir_builder {
+  rmt_item32_t *items;
+  uint16_t max;
+  uint16_t count;
+  uint8_t half;
+  /** pending (not yet written) pulse */
+  uint8_t level;
+  uint32_t ticks;
+  /** elapsed time since begin of the current frame [us] */
+  uint32_t elapsed;
+} ir_builder_t;
+
+/** @brief Decoder function for one protocol */
+typedef esp_err_t (*ir_decoder_t)(ir_cursor_t *c, irCode_t *code);
+
+/** @brief Get the next pulse (merged half items with the same level)
+ * @param c Cursor, will be advanced
+ * @param level Level of this pulse
+ * @return Duration in [us], 0 if the end of the recording is reached */
+static uint32_t ir_next(ir_cursor_t *c, uint8_t *level)
+{
+  uint32_t ticks = 0;
+  uint8_t first = 0xFF;
+
+  while(c->pos < c->count*2)
+  {
+    const rmt_item32_t *it = &c->items[c->pos/2];
+    uint32_t d = (c->pos & 1) ? it->duration1 : it->duration0;
+    uint8_t l = (c->pos & 1) ? it->level1 : it->level0;
+    //a duration of 0 terminates the RMT data
+    if(d == 0) { c->pos = c->count*2; break; }
+    if(first == 0xFF) first = l;
+    else if(l != first) break;
+    ticks += d;
+    c->pos++;
+  }
+  if(ticks == 0) return 0;
+  *level = first;
+  return TICKS_TO_US(ticks);
+}
+
+/** @brief Check a duration against a nominal value (25% + 100us tolerance) */
+static uint8_t ir_match(uint32_t us, uint32_t nominal)
+{
+  uint32_t tol = nominal/4 + 100;
+  return (us + tol >= nominal) && (us <= nominal + tol);
+}
+
+/** @brief Read the next pulse and check it against level & nominal duration */
+static uint8_t ir_expect(ir_cursor_t *c, uint8_t level, uint32_t nominal)
+{
+  uint8_t l = 0;
+  uint32_t us = ir_next(c,&l);
+  return (us != 0) && (l == level) && ir_match(us,nominal);
+}
+
+/** @brief Classify a pulse as 0 or 1 bit
+ * @return 0 or 1, -1 if it matches none of them */
+static int ir_bit(uint32_t us, uint32_t zero, uint32_t one)
+{
+  if(us > (zero + one) / 2) return ir_match(us,one) ? 1 : -1;
+  return ir_match(us,zero) ? 0 : -1;
+}
+
+/** @brief Read 32bits of a NEC like pulse distance frame (including header & stop bit) */
+static esp_err_t ir_decode_pulsedistance(ir_cursor_t *c, uint32_t hdrmark, uint32_t hdrspace, uint32_t *data)
+{
+  uint8_t l = 0;
+  if(!ir_expect(c,1,hdrmark)) return ESP_FAIL;
+  if(!ir_expect(c,0,hdrspace)) return ESP_FAIL;
+
+  *data = 0;
+  for(uint8_t i = 0; i<32; i++)
+  {
+    if(!ir_expect(c,1,NEC_BIT_MARK)) return ESP_FAIL;
+    uint32_t us = ir_next(c,&l);
+    if(us == 0 || l != 0) return ESP_FAIL;
+    int bit = ir_bit(us,NEC_ZERO_SPACE,NEC_ONE_SPACE);
+    if(bit < 0) return ESP_FAIL;
+    if(bit) *data |= (1UL<<i);
+  }
+  //stop bit
+  if(!ir_expect(c,1,NEC_BIT_MARK)) return ESP_FAIL;
+  return ESP_OK;
+}
+
+/** @brief Decoder for NEC frames */
+static esp_err_t ir_decode_nec(ir_cursor_t *c, irCode_t *code)
+{
+  uint32_t data;
+  if(ir_decode_pulsedistance(c,NEC_HDR_MARK,NEC_HDR_SPACE,&data) != ESP_OK) return ESP_FAIL;
+  //check command & inverted command
+  if((((data >> 16) ^ (data >> 24)) & 0xFF) != 0xFF) return ESP_FAIL;
+  code->protocol = IR_PROTO_NEC;
+  code->address = data & 0xFFFF;
+  code->command = (data >> 16) & 0xFF;
+  return ESP_OK;
+}
+
+/** @brief Decoder for a NEC repeat code (header mark, short space, stop bit) */
+static esp_err_t ir_decode_nec_repeat(ir_cursor_t *c)
+{
+  if(!ir_expect(c,1,NEC_HDR_MARK)) return ESP_FAIL;
+  if(!ir_expect(c,0,NEC_RPT_SPACE)) return ESP_FAIL;
+  if(!ir_expect(c,1,NEC_BIT_MARK)) return ESP_FAIL;
+  return ESP_OK;
+}
+
+/** @brief Decoder for Samsung frames */
+static esp_err_t ir_decode_samsung(ir_cursor_t *c, irCode_t *code)
+{
+  uint32_t data;
+  if(ir_decode_pulsedistance(c,SAMSUNG_HDR_MARK,SAMSUNG_HDR_SPACE,&data) != ESP_OK) return ESP_FAIL;
+  if((((data >> 16) ^ (data >> 24)) & 0xFF) != 0xFF) return ESP_FAIL;
+  code->protocol = IR_PROTO_SAMSUNG;
+  code->address = data & 0xFFFF;
+  code->command = (data >> 16) & 0xFF;
+  return ESP_OK;
+}
+
+/** @brief Decoder for Sony SIRC frames (12, 15 or 20 bits) */
+static esp_err_t ir_decode_sirc(ir_cursor_t *c, irCode_t *code)
+{
+  uint32_t data = 0;
+  uint8_t bits = 0;
+  uint8_t l = 0;
+
+  if(!ir_expect(c,1,SIRC_HDR_MARK)) return ESP_FAIL;
+  if(!ir_expect(c,0,SIRC_SPACE)) return ESP_FAIL;
+
+  while(bits < 20)
+  {
+    uint32_t us = ir_next(c,&l);
+    if(us == 0 || l != 1) return ESP_FAIL;
+    int bit = ir_bit(us,SIRC_ZERO_MARK,SIRC_ONE_MARK);
+    if(bit < 0) return ESP_FAIL;
+    if(bit) data |= (1UL<<bits);
+    bits++;
+    //the space of the last bit is part of the gap, don't consume it
+    ir_cursor_t save = *c;
+    us = ir_next(c,&l);
+    if(us == 0 || l != 0 || !ir_match(us,SIRC_SPACE))
+    {
+      //the frame ends with the recording or a gap
+      if(us != 0 && (l != 0 || us < SIRC_MIN_GAP)) return ESP_FAIL;
+      *c = save;
+      break;
+    }
+  }
+  if(bits != 12 && bits != 15 && bits != 20) return ESP_FAIL;
+
+  code->protocol = IR_PROTO_SIRC;
+  code->bits = bits;
+  code->command = data & 0x7F;
+  code->address = data >> 7;
+  return ESP_OK;
+}
+
+/** @brief Expand bi-phase pulses into half-bit units
+ *
+ * Each pulse must be 1 to maxunits units long. If the last half-bit
+ * is a space, it is merged into the gap after the frame and added here.
+ * The gap itself is not consumed.
+ *
+ * @param c Cursor
+ * @param t Duration of one unit [us]
+ * @param maxunits Maximum count of units for one pulse
+ * @param units Output buffer for the levels of each unit
+ * @param n Count of already filled units
+ * @param count Count of necessary units
+ * @return ESP_OK if all units are filled, ESP_FAIL otherwise */
+static esp_err_t ir_read_units(ir_cursor_t *c, uint32_t t, uint8_t maxunits, uint8_t *units, uint8_t n, uint8_t count)
+{
+  uint8_t l = 0;
+  while(n < count)
+  {
+    ir_cursor_t save = *c;
+    uint32_t us = ir_next(c,&l);
+    uint32_t u = (us + t/2) / t;
+
+    if(us == 0 || u == 0 || u > maxunits || (n + u) > count)
+    {
+      *c = save;
+      //last half-bit is a space, merged into the gap
+      if((n + 1) == count && (us == 0 || l == 0))
+      {
+        units[n++] = 0;
+        return ESP_OK;
+      }
+      return ESP_FAIL;
+    }
+    while(u--) units[n++] = l;
+  }
+  return ESP_OK;
+}
+
+/** @brief Decoder for RC5 frames */
+static esp_err_t ir_decode_rc5(ir_cursor_t *c, irCode_t *code)
+{
+  uint8_t units[RC5_BITS*2];
+  uint16_t data = 0;
+
+  //first half of the start bit is a space, which is not recorded
+  units[0] = 0;
+  if(ir_read_units(c,RC5_T,2,units,1,RC5_BITS*2) != ESP_OK) return ESP_FAIL;
+
+  //RC5: space->mark is 1, mark->space is 0; MSB first
+  for(uint8_t i = 0; i<RC5_BITS; i++)
+  {
+    if(units[2*i] == units[2*i+1]) return ESP_FAIL;
+    data = (data << 1) | units[2*i+1];
+  }
+  //start bit must be 1
+  if((data & (1<<13)) == 0) return ESP_FAIL;
+
+  code->protocol = IR_PROTO_RC5;
+  code->toggle = (data >> 11) & 0x01;
+  code->address = (data >> 6) & 0x1F;
+  //second start bit is the inverted 7th command bit (RC5x)
+  code->command = (data & 0x3F) | ((((data >> 12) & 0x01) ^ 0x01) << 6);
+  return ESP_OK;
+}
+
+/** @brief Decoder for RC6 (mode 0) frames */
+static esp_err_t ir_decode_rc6(ir_cursor_t *c, irCode_t *code)
+{
+  uint8_t units[RC6_UNITS];
+  uint16_t data = 0;
+
+  if(!ir_expect(c,1,RC6_HDR_MARK)) return ESP_FAIL;
+  if(!ir_expect(c,0,RC6_HDR_SPACE)) return ESP_FAIL;
+  //trailer bit (2 units) might be merged with a neighbour unit
+  if(ir_read_units(c,RC6_T,3,units,0,RC6_UNITS) != ESP_OK) return ESP_FAIL;
+
+  //start bit (1) + mode 0 (000); RC6: mark->space is 1
+  if(units[0] != 1 || units[1] != 0) return ESP_FAIL;
+  for(uint8_t i = 2; i<8; i+=2)
+  {
+    if(units[i] != 0 || units[i+1] != 1) return ESP_FAIL;
+  }
+  //trailer bit is the toggle bit, double length
+  if(units[8] != units[9] || units[10] != units[11] || units[9] == units[10]) return ESP_FAIL;
+  code->toggle = units[8];
+
+  for(uint8_t i = 12; i<RC6_UNITS; i+=2)
+  {
+    if(units[i] == units[i+1]) return ESP_FAIL;
+    data = (data << 1) | units[i];
+  }
+
+  code->protocol = IR_PROTO_RC6;
+  code->address = data >> 8;
+  code->command = data & 0xFF;
+  return ESP_OK;
+}
+
+/** @brief All available decoders, tried in this order
+ * @note RC6 is tried before SIRC: its header & half bits are within the
+ * SIRC tolerance, but RC6 has a stricter bi-phase structure. */
+static const ir_decoder_t ir_decoders[] = {
+  ir_decode_nec,
+  ir_decode_samsung,
+  ir_decode_rc6,
+  ir_decode_sirc,
+  ir_decode_rc5
+};
+
+/** @brief Decode recorded IR edges to a compact command
+ *
+ * All supported protocols are tried on the given edges. If one matches,
+ * the code struct is filled, including the count of repeated frames
+ * following the first one.
+ *
+ * @param items Recorded edges (level 1 is a mark)
+ * @param count Count of rmt_item32_t items
+ * @param code Pointer where the decoded command will be stored
+ * @return ESP_OK if a protocol was recognized, ESP_FAIL otherwise
+ * (code->protocol is set to IR_PROTO_RAW then)
+ * */
+esp_err_t ir_protocol_decode(const rmt_item32_t *items, uint16_t count, irCode_t *code)
+{
+  if(code == NULL) return ESP_FAIL;
+  memset(code,0,sizeof(irCode_t));
+  code->protocol = IR_PROTO_RAW;
+  if(items == NULL || count == 0) return ESP_FAIL;
+
+  //skip any leading space
+  uint16_t start = 0;
+  while(start < count*2)
+  {
+    uint8_t l = (start & 1) ? items[start/2].level1 : items[start/2].level0;
+    if(l != 0) break;
+    start++;
+  }
+
+  for(uint8_t i = 0; i < sizeof(ir_decoders)/sizeof(ir_decoder_t); i++)
+  {
+    ir_cursor_t c = {.items = items, .count = count, .pos = start};
+    irCode_t first;
+    memset(&first,0,sizeof(irCode_t));
+    if(ir_decoders[i](&c,&first) != ESP_OK) continue;
+
+    //count following frames (NEC: repeat codes or full frames)
+    while(first.repeats < IR_PROTOCOL_MAX_REPEATS)
+    {
+      uint8_t l = 0;
+      //skip the gap between two frames
+      if(ir_next(&c,&l) == 0 || l != 0) break;
+      ir_cursor_t save = c;
+      if(first.protocol == IR_PROTO_NEC && ir_decode_nec_repeat(&c) == ESP_OK)
+      {
+        first.repeats++;
+        continue;
+      }
+      c = save;
+      irCode_t next;
+      memset(&next,0,sizeof(irCode_t));
+      if(ir_decoders[i](&c,&next) != ESP_OK) break;
+      if(next.address != first.address || next.command != first.command || \
+        next.bits != first.bits) break;
+      first.repeats++;
+    }
+
+    memcpy(code,&first,sizeof(irCode_t));
+    ESP_LOGI(LOG_TAG,"Decoded %s: addr 0x%04X, cmd 0x%04X, repeats %d", \
+      ir_protocol_name(code->protocol),code->address,code->command,code->repeats);
+    return ESP_OK;
+  }
+  return ESP_FAIL;
+}
+
+/** @brief Write one RMT half item */
+static void ir_put_half(ir_builder_t *b, uint8_t level, uint32_t ticks)
+{
+  if(b->items != NULL && b->count < b->max)
+  {
+    rmt_item32_t *it = &b->items[b->count];
+    if(b->half == 0)
+    {
+      it->level0 = level;
+      it->duration0 = ticks;
+      it->level1 = 0;
+      it->duration1 = 0;
+    } else {
+      it->level1 = level;
+      it->duration1 = ticks;
+    }
+  }
+  if(b->half) b->count++;
+  b->half ^= 1;
+}
+
+/** @brief Write the pending pulse, split into maximum RMT durations */
+static void ir_flush(ir_builder_t *b)
+{
+  while(b->ticks > 0)
+  {
+    uint32_t t = (b->ticks > IR_MAX_TICKS) ? IR_MAX_TICKS : b->ticks;
+    ir_put_half(b,b->level,t);
+    b->ticks -= t;
+  }
+}
+
+/** @brief Add a pulse, pulses with the same level are merged */
+static void ir_pulse(ir_builder_t *b, uint8_t level, uint32_t us)
+{
+  b->elapsed += us;
+  //don't start a waveform with a space
+  if(level == 0 && b->count == 0 && b->half == 0 && b->ticks == 0) return;
+  if(b->ticks != 0 && b->level != level) ir_flush(b);
+  b->level = level;
+  b->ticks += US_TO_TICKS(us);
+}
+
+/** @brief Add a space until the given frame period is over, starts a new frame */
+static void ir_gap(ir_builder_t *b, uint32_t period)
+{
+  if(b->elapsed < period) ir_pulse(b,0,period - b->elapsed);
+  else ir_pulse(b,0,NEC_HDR_MARK);
+  b->elapsed = 0;
+}
+
+/** @brief Add one bi-phase bit, first is the level of the first half */
+static void ir_biphase(ir_builder_t *b, uint8_t first, uint32_t t)
+{
+  ir_pulse(b,first,t);
+  ir_pulse(b,first ^ 0x01,t);
+}
+
+/** @brief Add a NEC like pulse distance frame (including header & stop bit) */
+static void ir_encode_pulsedistance(ir_builder_t *b, uint32_t hdrmark, uint32_t hdrspace, uint32_t data)
+{
+  ir_pulse(b,1,hdrmark);
+  ir_pulse(b,0,hdrspace);
+  for(uint8_t i = 0; i<32; i++)
+  {
+    ir_pulse(b,1,NEC_BIT_MARK);
+    ir_pulse(b,0,(data & (1UL<<i)) ? NEC_ONE_SPACE : NEC_ZERO_SPACE);
+  }
+  ir_pulse(b,1,NEC_BIT_MARK);
+}
+
+/** @brief Synthesize a waveform
+ * @param code Decoded command
+ * @param items Buffer for the waveform, might be NULL to get the length only
+ * @param maxcount Size of the buffer in rmt_item32_t items
+ * @param repeatframe If set, only one repeat frame is created
+ * @return Count of (necessary) rmt_item32_t items, 0 on an error */
+static uint16_t ir_encode(const irCode_t *code, rmt_item32_t *items, uint16_t maxcount, uint8_t repeatframe)
+{
+  ir_builder_t b;
+  uint32_t data;
+  uint16_t frames;
+
+  if(code == NULL) return 0;
+  memset(&b,0,sizeof(ir_builder_t));
+  b.items = items;
+  b.max = maxcount;
+  frames = repeatframe ? 1 : (code->repeats + 1);
+
+  switch(code->protocol)
+  {
+    case IR_PROTO_NEC:
+      data = code->address | ((uint32_t)(code->command & 0xFF) << 16) | \
+        ((uint32_t)(~code->command & 0xFF) << 24);
+      if(!repeatframe) ir_encode_pulsedistance(&b,NEC_HDR_MARK,NEC_HDR_SPACE,data);
+      else frames = 2;
+      //NEC repeats with a short repeat code
+      for(uint16_t i = 1; i<frames; i++)
+      {
+        if(!repeatframe) ir_gap(&b,NEC_PERIOD);
+        ir_pulse(&b,1,NEC_HDR_MARK);
+        ir_pulse(&b,0,NEC_RPT_SPACE);
+        ir_pulse(&b,1,NEC_BIT_MARK);
+      }
+      break;
+    case IR_PROTO_SAMSUNG:
+      data = code->address | ((uint32_t)(code->command & 0xFF) << 16) | \
+        ((uint32_t)(~code->command & 0xFF) << 24);
+      for(uint16_t i = 0; i<frames; i++)
+      {
+        if(i != 0) ir_gap(&b,SAMSUNG_PERIOD);
+        ir_encode_pulsedistance(&b,SAMSUNG_HDR_MARK,SAMSUNG_HDR_SPACE,data);
+      }
+      break;
+    case IR_PROTO_SIRC:
+      if(code->bits != 12 && code->bits != 15 && code->bits != 20) return 0;
+      data = (code->command & 0x7F) | ((uint32_t)code->address << 7);
+      if(!repeatframe && frames < SIRC_MIN_FRAMES) frames = SIRC_MIN_FRAMES;
+      for(uint16_t i = 0; i<frames; i++)
+      {
+        if(i != 0) ir_gap(&b,SIRC_PERIOD);
+        ir_pulse(&b,1,SIRC_HDR_MARK);
+        ir_pulse(&b,0,SIRC_SPACE);
+        for(uint8_t j = 0; j<code->bits; j++)
+        {
+          ir_pulse(&b,1,(data & (1UL<<j)) ? SIRC_ONE_MARK : SIRC_ZERO_MARK);
+          ir_pulse(&b,0,SIRC_SPACE);
+        }
+      }
+      break;
+    case IR_PROTO_RC5:
+      //start bit, inverted 7th command bit, toggle, 5bit address, 6bit command
+      data = (1<<13) | ((((code->command >> 6) & 0x01) ^ 0x01) << 12) | \
+        ((code->toggle & 0x01) << 11) | ((code->address & 0x1F) << 6) | (code->command & 0x3F);
+      for(uint16_t i = 0; i<frames; i++)
+      {
+        if(i != 0) ir_gap(&b,RC5_PERIOD);
+        //RC5: 1 is space->mark
+        for(int8_t j = RC5_BITS-1; j>=0; j--) ir_biphase(&b,((data >> j) & 0x01) ^ 0x01,RC5_T);
+      }
+      break;
+    case IR_PROTO_RC6:
+      data = ((code->address & 0xFF) << 8) | (code->command & 0xFF);
+      for(uint16_t i = 0; i<frames; i++)
+      {
+        if(i != 0) ir_gap(&b,RC6_PERIOD);
+        ir_pulse(&b,1,RC6_HDR_MARK);
+        ir_pulse(&b,0,RC6_HDR_SPACE);
+        //start bit 1, mode 000; RC6: 1 is mark->space
+        ir_biphase(&b,1,RC6_T);
+        for(uint8_t j = 0; j<3; j++) ir_biphase(&b,0,RC6_T);
+        //trailer/toggle bit has double length
+        ir_biphase(&b,code->toggle & 0x01,2*RC6_T);
+        for(int8_t j = 15; j>=0; j--) ir_biphase(&b,(data >> j) & 0x01,RC6_T);
+      }
+      break;
+    default:
+      ESP_LOGE(LOG_TAG,"Cannot encode protocol %d",code->protocol);
+      return 0;
+  }
+
+  //a trailing space is not necessary, idle level is 0
+  if(b.level == 0) b.ticks = 0;
+  ir_flush(&b);
+  //terminate the last item (duration1 is 0)
+  if(b.half) b.count++;
+
+  if(items != NULL && b.count > maxcount)
+  {
+    ESP_LOGE(LOG_TAG,"IR buffer too small: %d/%d",b.count,maxcount);
+    return 0;
+  }
+  return b.count;
+}
+
+/** @brief Get a printable name of an IR protocol
+ * @param protocol Protocol number, see irprotocol_t
+ * @return Name of the protocol, "RAW" if unknown */
+const char *ir_protocol_name(uint8_t protocol)
+{
+  switch(protocol)
+  {
+    case IR_PROTO_NEC: return "NEC";
+    case IR_PROTO_RC5: return "RC5";
+    case IR_PROTO_RC6: return "RC6";
+    case IR_PROTO_SIRC: return "SIRC";
+    case IR_PROTO_SAMSUNG: return "Samsung";
+    default: return "RAW";
+  }
+}
+
+/** @brief Synthesize the RMT waveform of a compact command
+ *
+ * Call this function with items set to NULL to get the count of
+ * necessary items, allocate the buffer and call it again to fill it.
+ *
+ * @param code Decoded command
+ * @param items Buffer for the waveform, might be NULL to get the length only
+ * @param maxcount Size of the buffer in rmt_item32_t items
+ * @return Count of (necessary) rmt_item32_t items, 0 on an error
+ * */
+uint16_t ir_protocol_encode(const irCode_t *code, rmt_item32_t *items, uint16_t maxcount)
+{
+  return ir_encode(code,items,maxcount,0);
+}
+
+/** @brief Synthesize the repeat frame of a compact command
+ *
+ * This frame is sent while a button is held: NEC uses the short
+ * repeat code, all other protocols repeat one full frame (same toggle bit).
+ * Call with items set to NULL to get the length only.
+ *
+ * @param code Decoded command
+ * @param items Buffer for the waveform, might be NULL to get the length only
+ * @param maxcount Size of the buffer in rmt_item32_t items
+ * @return Count of (necessary) rmt_item32_t items, 0 on an error
+ * @see ir_protocol_period
+ * */
+uint16_t ir_protocol_encode_repeat(const irCode_t *code, rmt_item32_t *items, uint16_t maxcount)
+{
+  return ir_encode(code,items,maxcount,1);
+}
+
+/** @brief Get the frame period of an IR protocol
+ * @param protocol Protocol number, see irprotocol_t
+ * @return Period between two frames in [us], 0 for raw commands */
+uint32_t ir_protocol_period(uint8_t protocol)
+{
+  switch(protocol)
+  {
+    case IR_PROTO_NEC: return NEC_PERIOD;
+    case IR_PROTO_RC5: return RC5_PERIOD;
+    case IR_PROTO_RC6: return RC6_PERIOD;
+    case IR_PROTO_SIRC: return SIRC_PERIOD;
+    case IR_PROTO_SAMSUNG: return SAMSUNG_PERIOD;
+    default: return 0;
+  }
+}
+
+/** @brief Find the dictionary entry for a duration
+ * @return Index of the entry, -1 if no entry is within the tolerance */
+static int ir_raw_lookup(const uint16_t *dict, uint8_t dictcount, uint32_t ticks)
+{
+  int best = -1;
+  uint32_t bestdiff = 0xFFFFFFFF;
+  for(uint8_t i = 0; i<dictcount; i++)
+  {
+    uint32_t diff = (ticks > dict[i]) ? (ticks - dict[i]) : (dict[i] - ticks);
+    //0 is the end marker, must match exactly
+    if((ticks == 0 || dict[i] == 0) && diff != 0) continue;
+    if(diff <= (uint32_t)(dict[i]/8 + 2) && diff < bestdiff)
+    {
+      best = i;
+      bestdiff = diff;
+    }
+  }
+  return best;
+}
+
+/** @brief Append a run token (repeat previous item) to the packed stream */
+static uint16_t ir_raw_put_run(uint8_t *buf, uint16_t len, uint16_t maxlen, uint16_t run)
+{
+  if(run == 0) return len;
+  if(run < 16)
+  {
+    if(len < maxlen) buf[len] = IR_RAW_RUN_TOKEN | (run - 1);
+    return len + 1;
+  }
+  if(len < maxlen) buf[len] = IR_RAW_RUN_TOKEN | 0x0F;
+  len++;
+  run -= 16;
+  //varint: 7bit per byte, MSB set if more bytes follow
+  do {
+    if(len < maxlen) buf[len] = (run & 0x7F) | ((run > 0x7F) ? 0x80 : 0);
+    len++;
+    run >>= 7;
+  } while(run != 0);
+  return len;
+}
+
+/** @brief Compress raw IR edges
+ *
+ * Durations are quantized to a dictionary of up to IR_RAW_MAX_DICT
+ * values (mean of each cluster), every item is stored as one byte
+ * (two 4bit dictionary indizes). Repeated items are run-length coded.
+ *
+ * Packed format (little endian):<br>
+ * uint16_t item count, uint8_t levels (bit0: level0, bit1: level1),
+ * uint8_t dictionary count, uint16_t dictionary[], tokens
+ *
+ * @param items Raw edges
+ * @param count Count of rmt_item32_t items
+ * @param buf Output buffer
+ * @param maxlen Size of output buffer
+ * @return Length of packed data, 0 if these edges cannot be packed
+ * (too many different durations, changing levels or buffer too small)
+ * */
+uint16_t ir_raw_pack(const rmt_item32_t *items, uint16_t count, uint8_t *buf, uint16_t maxlen)
+{
+  uint16_t dict[IR_RAW_MAX_DICT];
+  uint32_t sum[IR_RAW_MAX_DICT];
+  uint16_t cnt[IR_RAW_MAX_DICT];
+  uint8_t dictcount = 0;
+  uint8_t levels;
+  uint16_t len;
+
+  if(items == NULL || buf == NULL || count == 0) return 0;
+  levels = items[0].level0 | (items[0].level1 << 1);
+
+  //1.) build dictionary, cluster durations
+  for(uint32_t i = 0; i<count*2; i++)
+  {
+    uint32_t d = (i & 1) ? items[i/2].duration1 : items[i/2].duration0;
+    uint8_t l = (i & 1) ? items[i/2].level1 : items[i/2].level0;
+    //levels must follow the pattern of the first item (except end marker)
+    if(d != 0 && l != ((levels >> (i & 1)) & 0x01)) return 0;
+    int idx = ir_raw_lookup(dict,dictcount,d);
+    if(idx < 0)
+    {
+      if(dictcount == IR_RAW_MAX_DICT) return 0;
+      idx = dictcount++;
+      sum[idx] = 0;
+      cnt[idx] = 0;
+    }
+    sum[idx] += d;
+    cnt[idx]++;
+    dict[idx] = sum[idx] / cnt[idx];
+  }
+
+  //2.) header
+  if(maxlen < 4 + 2*dictcount) return 0;
+  buf[0] = count & 0xFF;
+  buf[1] = count >> 8;
+  buf[2] = levels;
+  buf[3] = dictcount;
+  len = 4;
+  for(uint8_t i = 0; i<dictcount; i++)
+  {
+    buf[len++] = dict[i] & 0xFF;
+    buf[len++] = dict[i] >> 8;
+  }
+
+  //3.) tokens, one byte per item or a run of the previous item
+  int16_t prev = -1;
+  uint16_t run = 0;
+  for(uint16_t i = 0; i<count; i++)
+  {
+    int i0 = ir_raw_lookup(dict,dictcount,items[i].duration0);
+    int i1 = ir_raw_lookup(dict,dictcount,items[i].duration1);
+    //cluster mean moved too far away
+    if(i0 < 0 || i1 < 0) return 0;
+    uint8_t sym = (i0 << 4) | i1;
+    if(sym == prev) { run++; continue; }
+    len = ir_raw_put_run(buf,len,maxlen,run);
+    run = 0;
+    if(len < maxlen) buf[len] = sym;
+    len++;
+    prev = sym;
+  }
+  len = ir_raw_put_run(buf,len,maxlen,run);
+
+  if(len > maxlen) return 0;
+  return len;
+}
+
+/** @brief Decompress raw IR edges
+ *
+ * Call this function with items set to NULL to get the count of
+ * items, allocate the buffer and call it again to fill it.
+ *
+ * @param buf Packed data, created by ir_raw_pack
+ * @param len Length of packed data
+ * @param items Buffer for the edges, might be NULL to get the count only
+ * @param maxcount Size of the buffer in rmt_item32_t items
+ * @return Count of rmt_item32_t items, 0 on an error
+ * */
+uint16_t ir_raw_unpack(const uint8_t *buf, uint16_t len, rmt_item32_t *items, uint16_t maxcount)
+{
+  uint16_t dict[IR_RAW_MAX_DICT];
+  uint16_t count, pos, n = 0;
+  uint8_t levels, dictcount;
+  rmt_item32_t item;
+
+  if(buf == NULL || len < 4) return 0;
+  count = buf[0] | (buf[1] << 8);
+  levels = buf[2];
+  dictcount = buf[3];
+  if(items == NULL) return count;
+  if(count > maxcount || dictcount > IR_RAW_MAX_DICT || len < 4 + 2*dictcount) return 0;
+
+  pos = 4;
+  for(uint8_t i = 0; i<dictcount; i++, pos+=2) dict[i] = buf[pos] | (buf[pos+1] << 8);
+
+  item.val = 0;
+  item.level0 = levels & 0x01;
+  item.level1 = (levels >> 1) & 0x01;
+  while(pos < len && n < count)
+  {
+    uint8_t sym = buf[pos++];
+    if((sym & IR_RAW_RUN_TOKEN) == IR_RAW_RUN_TOKEN)
+    {
+      //repeat previous item
+      uint32_t run = (sym & 0x0F) + 1;
+      if(n == 0) return 0;
+      if(run == 16)
+      {
+        uint32_t extra = 0;
+        uint8_t shift = 0;
+        do {
+          if(pos >= len || shift > 14) return 0;
+          extra |= (uint32_t)(buf[pos] & 0x7F) << shift;
+          shift += 7;
+        } while(buf[pos++] & 0x80);
+        run += extra;
+      }
+      if(n + run > count) return 0;
+      while(run--) { items[n] = items[n-1]; n++; }
+    } else {
+      if((sym >> 4) >= dictcount || (sym & 0x0F) >= dictcount) return 0;
+      item.duration0 = dict[sym >> 4];
+      item.duration1 = dict[sym & 0x0F];
+      items[n++] = item;
+    }
+  }
+  if(n != count) return 0;
+  return n;
+}
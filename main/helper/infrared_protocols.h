@@ -0,0 +1,150 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ * Copyright 2019 Benjamin Aigner <aignerb@technikum-wien.at,
+ * beni@asterics-foundation.org>
+ */
+/** @file
+ * @brief Infrared protocol helper functions
+ *
+ * This module recognizes common IR remote protocols in recorded RMT
+ * edges and synthesizes the RMT waveform for a decoded command again.
+ *
+ * Supported protocols:<br>
+ * * NEC (including repeat codes)
+ * * Philips RC5
+ * * Philips RC6 (mode 0)
+ * * Sony SIRC (12, 15 and 20 bit)
+ * * Samsung
+ *
+ * A recognized command is stored as irCode_t (8 bytes) instead
+ * of up to TASK_HAL_IR_RECV_MAXIMUM_EDGES rmt_item32_t items.
+ * If a recording cannot be decoded, the raw edges are used as a fallback,
+ * packed with a duration dictionary and run-length coding (ir_raw_pack).
+ *
+ * @note All durations are in RMT ticks, level 1 is a mark (carrier on).
+ * @see irCode_t
+ * @see fct_infrared.c
+ **/
+
+#ifndef _INFRARED_PROTOCOLS_H_
+#define _INFRARED_PROTOCOLS_H_
+
+#include <stdint.h>
+#include <string.h>
+#include "driver/rmt.h"
+//irCode_t & irprotocol_t are defined here
+#include "common.h"
+
+/** @brief RMT counter value for 10 us.
+ * @warning Must match the RMT clock divider used in hal_io.c (RMT_CLK_DIV) */
+#define IR_PROTOCOL_TICK_10_US    (80000000/100/100000)
+
+/** @brief Maximum count of repeated frames in a compact command
+ *
+ * Longer recordings are truncated to this count. Limits the synthesized
+ * waveform (16 frames of a 46 item protocol) well below
+ * TASK_HAL_IR_RECV_MAXIMUM_EDGES.*/
+#define IR_PROTOCOL_MAX_REPEATS   15
+
+/** @brief Decode recorded IR edges to a compact command
+ *
+ * All supported protocols are tried on the given edges. If one matches,
+ * the code struct is filled, including the count of repeated frames
+ * following the first one.
+ *
+ * @param items Recorded edges (level 1 is a mark)
+ * @param count Count of rmt_item32_t items
+ * @param code Pointer where the decoded command will be stored
+ * @return ESP_OK if a protocol was recognized, ESP_FAIL otherwise
+ * (code->protocol is set to IR_PROTO_RAW then)
+ * */
+esp_err_t ir_protocol_decode(const rmt_item32_t *items, uint16_t count, irCode_t *code);
+
+/** @brief Synthesize the RMT waveform of a compact command
+ *
+ * Call this function with items set to NULL to get the count of
+ * necessary items, allocate the buffer and call it again to fill it.
+ *
+ * @param code Decoded command
+ * @param items Buffer for the waveform, might be NULL to get the length only
+ * @param maxcount Size of the buffer in rmt_item32_t items
+ * @return Count of (necessary) rmt_item32_t items, 0 on an error
+ * */
+uint16_t ir_protocol_encode(const irCode_t *code, rmt_item32_t *items, uint16_t maxcount);
+
+/** @brief Synthesize the repeat frame of a compact command
+ *
+ * This frame is sent while a button is held: NEC uses the short
+ * repeat code, all other protocols repeat one full frame (same toggle bit).
+ * Call with items set to NULL to get the length only.
+ *
+ * @param code Decoded command
+ * @param items Buffer for the waveform, might be NULL to get the length only
+ * @param maxcount Size of the buffer in rmt_item32_t items
+ * @return Count of (necessary) rmt_item32_t items, 0 on an error
+ * @see ir_protocol_period
+ * */
+uint16_t ir_protocol_encode_repeat(const irCode_t *code, rmt_item32_t *items, uint16_t maxcount);
+
+/** @brief Get the frame period of an IR protocol
+ * @param protocol Protocol number, see irprotocol_t
+ * @return Period between two frames in [us], 0 for raw commands */
+uint32_t ir_protocol_period(uint8_t protocol);
+
+/** @brief Maximum count of different durations for packed raw edges */
+#define IR_RAW_MAX_DICT           15
+/** @brief Token in packed raw edges, which repeats the previous item */
+#define IR_RAW_RUN_TOKEN          0xF0
+
+/** @brief Compress raw IR edges
+ *
+ * Durations are quantized to a dictionary of up to IR_RAW_MAX_DICT
+ * values (mean of each cluster), every item is stored as one byte
+ * (two 4bit dictionary indizes). Repeated items are run-length coded.
+ *
+ * Packed format (little endian):<br>
+ * uint16_t item count, uint8_t levels (bit0: level0, bit1: level1),
+ * uint8_t dictionary count, uint16_t dictionary[], tokens
+ *
+ * @param items Raw edges
+ * @param count Count of rmt_item32_t items
+ * @param buf Output buffer
+ * @param maxlen Size of output buffer
+ * @return Length of packed data, 0 if these edges cannot be packed
+ * (too many different durations, changing levels or buffer too small)
+ * */
+uint16_t ir_raw_pack(const rmt_item32_t *items, uint16_t count, uint8_t *buf, uint16_t maxlen);
+
+/** @brief Decompress raw IR edges
+ *
+ * Call this function with items set to NULL to get the count of
+ * items, allocate the buffer and call it again to fill it.
+ *
+ * @param buf Packed data, created by ir_raw_pack
+ * @param len Length of packed data
+ * @param items Buffer for the edges, might be NULL to get the count only
+ * @param maxcount Size of the buffer in rmt_item32_t items
+ * @return Count of rmt_item32_t items, 0 on an error
+ * */
+uint16_t ir_raw_unpack(const uint8_t *buf, uint16_t len, rmt_item32_t *items, uint16_t maxcount);
+
+/** @brief Get a printable name of an IR protocol
+ * @param protocol Protocol number, see irprotocol_t
+ * @return Name of the protocol, "RAW" if unknown */
+const char *ir_protocol_name(uint8_t protocol);
+
+#endif /* _INFRARED_PROTOCOLS_H_ */
@@ -0,0 +1,168 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ * Copyright 2019 Benjamin Aigner <aignerb@technikum-wien.at,
+ * beni@asterics-foundation.org>
+ */
+/** @file
+ * @brief Repeat scheduling for held IR commands
+ *
+ * The caller serializes all calls (fct_infrared.c holds a mutex), the
+ * timer tick is the only periodic caller.
+ *
+ * @see ir_hold.h
+ **/
+
+#include "ir_hold.h"
+
+/** @brief Initialize an inactive hold state
+ * @param h Hold state
+ * @param channel RMT channel used for sending
+ * */
+void ir_hold_init(ir_hold_t *h, rmt_channel_t channel)
+{
+  memset(h,0,sizeof(ir_hold_t));
+  h->vb = IR_HOLD_ALL;
+  h->channel = channel;
+}
+
+/** @brief Create the repeat frame of a command
+ *
+ * Protocol commands use their repeat frame (NEC: repeat code, others:
+ * one full frame), raw commands are repeated completely.
+ * @param code Decoded command, protocol IR_PROTO_RAW for raw commands
+ * @param full Full waveform (used for raw commands)
+ * @param fullcount Count of items in the full waveform
+ * @param count Count of items in the returned frame
+ * @return Allocated repeat frame, NULL on an error
+ * */
+rmt_item32_t *ir_hold_create_frame(const irCode_t *code, const rmt_item32_t *full,
+  uint16_t fullcount, uint16_t *count)
+{
+  rmt_item32_t *frame = NULL;
+  uint16_t n;
+  
+  *count = 0;
+  if(code->protocol != IR_PROTO_RAW)
+  {
+    n = ir_protocol_encode_repeat(code,NULL,0);
+    if(n != 0) frame = malloc(sizeof(rmt_item32_t)*n);
+    if(frame != NULL) n = ir_protocol_encode_repeat(code,frame,n);
+  } else {
+    n = fullcount;
+    if(full != NULL && n != 0) frame = malloc(sizeof(rmt_item32_t)*n);
+    if(frame != NULL) memcpy(frame,full,sizeof(rmt_item32_t)*n);
+  }
+  if(frame != NULL && n == 0)
+  {
+    free(frame);
+    frame = NULL;
+  }
+  if(frame != NULL) *count = n;
+  return frame;
+}
+
+/** @brief Get the repeat interval
+ * @param protocol Protocol number, see irprotocol_t
+ * @param irrepeat Interval set by "AT IN" [ms], 0 to use the protocol's period
+ * @return Interval [us]
+ * @see IR_HOLD_DEFAULT_INTERVAL
+ * */
+uint32_t ir_hold_interval(uint8_t protocol, uint16_t irrepeat)
+{
+  if(irrepeat != 0) return irrepeat * 1000UL;
+  uint32_t period = ir_protocol_period(protocol);
+  if(period == 0) period = IR_HOLD_DEFAULT_INTERVAL * 1000UL;
+  return period;
+}
+
+/** @brief Free a stopped repeat frame, if the RMT channel is idle
+ * @param h Hold state
+ * */
+void ir_hold_free_stale(ir_hold_t *h)
+{
+  if(h->stale != NULL && rmt_wait_tx_done(h->channel,0) == ESP_OK)
+  {
+    free(h->stale);
+    h->stale = NULL;
+  }
+}
+
+/** @brief Activate repeating with a new frame
+ *
+ * The state must be inactive (ir_hold_stop). A stale frame is freed,
+ * if the RMT is idle.
+ * @param h Hold state
+ * @param frame Repeat frame, created by ir_hold_create_frame (owned by h)
+ * @param count Count of items in the frame
+ * @param vb Virtual button which holds this command
+ * */
+void ir_hold_start(ir_hold_t *h, rmt_item32_t *frame, uint16_t count, uint8_t vb)
+{
+  ir_hold_free_stale(h);
+  h->frame = frame;
+  h->count = count;
+  h->vb = vb;
+}
+
+/** @brief Timer tick: send one repeat frame, if the RMT is idle
+ *
+ * Does not block: if a transmission is ongoing, this frame is skipped.
+ * @param h Hold state
+ * @return 1 if a frame was sent, 0 otherwise
+ * */
+uint8_t ir_hold_tick(ir_hold_t *h)
+{
+  if(h->frame == NULL) return 0;
+  if(rmt_wait_tx_done(h->channel,0) != ESP_OK)
+  {
+    h->skipped++;
+    return 0;
+  }
+  if(rmt_write_items(h->channel,h->frame,h->count,false) != ESP_OK) return 0;
+  h->sent++;
+  return 1;
+}
+
+/** @brief Stop repeating
+ *
+ * If the frame is still transmitted after waiting, it is kept as stale
+ * frame and freed later (ir_hold_free_stale).
+ * @param h Hold state
+ * @param vb Virtual button which was released. Only if it started
+ * the repeating, it is stopped. Use IR_HOLD_ALL to stop in any case.
+ * @param wait Ticks to wait for the end of the transmission
+ * @return 1 if repeating was stopped, 0 otherwise
+ * */
+uint8_t ir_hold_stop(ir_hold_t *h, uint8_t vb, uint32_t wait)
+{
+  ir_hold_free_stale(h);
+  if(h->frame == NULL || (vb != IR_HOLD_ALL && vb != h->vb)) return 0;
+  
+  //last frame might still be sent from this buffer
+  if(rmt_wait_tx_done(h->channel,wait) == ESP_OK)
+  {
+    free(h->frame);
+  } else {
+    //an older stale frame is not sent anymore (the newer one is)
+    if(h->stale != NULL) free(h->stale);
+    h->stale = h->frame;
+  }
+  h->frame = NULL;
+  h->count = 0;
+  h->vb = IR_HOLD_ALL;
+  return 1;
+}
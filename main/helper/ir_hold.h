@@ -0,0 +1,136 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ * Copyright 2019 Benjamin Aigner <aignerb@technikum-wien.at,
+ * beni@asterics-foundation.org>
+ */
+/** @file
+ * @brief Repeat scheduling for held IR commands
+ *
+ * While a virtual button is held, the IR command is repeated with its
+ * protocol's frame period. This module creates the repeat frame (NEC
+ * repeat code or one full frame), chooses the interval and decides on
+ * each timer tick if a frame is sent: a tick is skipped if the RMT is
+ * still transmitting (another command or the previous frame).
+ * A stopped frame might still be read by the RMT, it is kept as stale
+ * frame until the channel is idle.
+ *
+ * @note This module has no dependencies to FreeRTOS, the timer & the
+ * RMT calls are replaced by stubs on the host.
+ * @see fct_infrared_hold_start
+ * @see fct_infrared_hold_stop
+ **/
+
+#ifndef _IR_HOLD_H_
+#define _IR_HOLD_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_err.h"
+#include "driver/rmt.h"
+#include "infrared_protocols.h"
+
+/** @brief Repeat interval for held raw IR commands [ms], if not set by generalConfig_t.irrepeat */
+#define IR_HOLD_DEFAULT_INTERVAL 110
+
+/** @brief Parameter for ir_hold_stop to stop any held command */
+#define IR_HOLD_ALL 0xFF
+
+/** @brief State of the hold-to-repeat scheduling
+ * @see ir_hold_init */
+typedef struct ir_hold {
+  /** @brief Repeat frame which is sent while the VB is held, NULL if inactive */
+  rmt_item32_t *frame;
+  /** @brief Count of rmt_item32_t items in the repeat frame */
+  uint16_t count;
+  /** @brief Repeat frame which might still be transmitted after stopping,
+   * freed as soon as the RMT channel is idle */
+  rmt_item32_t *stale;
+  /** @brief VB which started the repeating, IR_HOLD_ALL if inactive */
+  uint8_t vb;
+  /** @brief RMT channel used for sending */
+  rmt_channel_t channel;
+  /** @brief Count of sent repeat frames */
+  uint32_t sent;
+  /** @brief Count of skipped ticks (RMT was busy) */
+  uint32_t skipped;
+} ir_hold_t;
+
+/** @brief Initialize an inactive hold state
+ * @param h Hold state
+ * @param channel RMT channel used for sending
+ * */
+void ir_hold_init(ir_hold_t *h, rmt_channel_t channel);
+
+/** @brief Create the repeat frame of a command
+ *
+ * Protocol commands use their repeat frame (NEC: repeat code, others:
+ * one full frame), raw commands are repeated completely.
+ * @param code Decoded command, protocol IR_PROTO_RAW for raw commands
+ * @param full Full waveform (used for raw commands)
+ * @param fullcount Count of items in the full waveform
+ * @param count Count of items in the returned frame
+ * @return Allocated repeat frame, NULL on an error
+ * */
+rmt_item32_t *ir_hold_create_frame(const irCode_t *code, const rmt_item32_t *full,
+  uint16_t fullcount, uint16_t *count);
+
+/** @brief Get the repeat interval
+ * @param protocol Protocol number, see irprotocol_t
+ * @param irrepeat Interval set by "AT IN" [ms], 0 to use the protocol's period
+ * @return Interval [us]
+ * @see IR_HOLD_DEFAULT_INTERVAL
+ * */
+uint32_t ir_hold_interval(uint8_t protocol, uint16_t irrepeat);
+
+/** @brief Activate repeating with a new frame
+ *
+ * The state must be inactive (ir_hold_stop). A stale frame is freed,
+ * if the RMT is idle.
+ * @param h Hold state
+ * @param frame Repeat frame, created by ir_hold_create_frame (owned by h)
+ * @param count Count of items in the frame
+ * @param vb Virtual button which holds this command
+ * */
+void ir_hold_start(ir_hold_t *h, rmt_item32_t *frame, uint16_t count, uint8_t vb);
+
+/** @brief Timer tick: send one repeat frame, if the RMT is idle
+ *
+ * Does not block: if a transmission is ongoing, this frame is skipped.
+ * @param h Hold state
+ * @return 1 if a frame was sent, 0 otherwise
+ * */
+uint8_t ir_hold_tick(ir_hold_t *h);
+
+/** @brief Stop repeating
+ *
+ * If the frame is still transmitted after waiting, it is kept as stale
+ * frame and freed later (ir_hold_free_stale).
+ * @param h Hold state
+ * @param vb Virtual button which was released. Only if it started
+ * the repeating, it is stopped. Use IR_HOLD_ALL to stop in any case.
+ * @param wait Ticks to wait for the end of the transmission
+ * @return 1 if repeating was stopped, 0 otherwise
+ * */
+uint8_t ir_hold_stop(ir_hold_t *h, uint8_t vb, uint32_t wait);
+
+/** @brief Free a stopped repeat frame, if the RMT channel is idle
+ * @param h Hold state
+ * */
+void ir_hold_free_stale(ir_hold_t *h);
+
+#endif /* _IR_HOLD_H_ */
@@ -0,0 +1,99 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ * Copyright 2019 Benjamin Aigner <aignerb@technikum-wien.at,
+ * beni@asterics-foundation.org>
+ */
+/** @file
+ * @brief Growing receive buffer for recorded IR edges
+ *
+ * The buffer grows by whole chunks, so a recording of N edges needs
+ * about N/chunk reallocations instead of one per ringbuffer item.
+ *
+ * @see ir_recv_buffer.h
+ **/
+
+#include "ir_recv_buffer.h"
+
+/** @brief Initialize an empty receive buffer (nothing is allocated)
+ * @param b Receive buffer
+ * @param chunk Growing step [edges]
+ * @param maximum Maximum count of edges
+ * @param mask XOR mask applied to each copied item (e.g. level bits)
+ * */
+void ir_recv_buffer_init(ir_recv_buffer_t *b, uint16_t chunk, uint16_t maximum, uint32_t mask)
+{
+  memset(b,0,sizeof(ir_recv_buffer_t));
+  b->chunk = chunk == 0 ? 1 : chunk;
+  b->maximum = maximum;
+  b->mask = mask;
+}
+
+/** @brief Append edges to the buffer, grow it if necessary
+ *
+ * On an error, the buffer is freed & reset.
+ * @param b Receive buffer
+ * @param items Received edges
+ * @param count Count of received edges
+ * @return ESP_OK if appended, ESP_ERR_INVALID_SIZE if more than the
+ * maximum edges are received, ESP_ERR_NO_MEM if the buffer cannot grow
+ * */
+esp_err_t ir_recv_buffer_append(ir_recv_buffer_t *b, const rmt_item32_t *items, uint16_t count)
+{
+  uint32_t needed = (uint32_t)b->count + count;
+  
+  //too much
+  if(needed > b->maximum)
+  {
+    ir_recv_buffer_free(b);
+    return ESP_ERR_INVALID_SIZE;
+  }
+  
+  //grow buffer in chunks, if necessary
+  if(needed > b->allocated)
+  {
+    uint32_t newsize = b->allocated;
+    while(newsize < needed) newsize += b->chunk;
+    if(newsize > b->maximum) newsize = b->maximum;
+    rmt_item32_t *grown = realloc(b->buffer,sizeof(rmt_item32_t)*newsize);
+    if(grown == NULL)
+    {
+      ir_recv_buffer_free(b);
+      return ESP_ERR_NO_MEM;
+    }
+    b->buffer = grown;
+    b->allocated = newsize;
+  }
+  
+  //copy & invert in one pass
+  for(uint16_t i = 0; i<count; i++)
+  {
+    b->buffer[b->count+i].val = items[i].val ^ b->mask;
+  }
+  b->count = needed;
+  return ESP_OK;
+}
+
+/** @brief Free the edges & reset the buffer
+ * @param b Receive buffer
+ * */
+void ir_recv_buffer_free(ir_recv_buffer_t *b)
+{
+  free(b->buffer);
+  b->buffer = NULL;
+  b->count = 0;
+  b->allocated = 0;
+}
@@ -0,0 +1,83 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ * Copyright 2019 Benjamin Aigner <aignerb@technikum-wien.at,
+ * beni@asterics-foundation.org>
+ */
+/** @file
+ * @brief Growing receive buffer for recorded IR edges
+ *
+ * The IR receive task gets the edges from the RMT ringbuffer in
+ * blocks of unknown size. They are appended to a buffer, which grows
+ * in chunks up to a maximum count of edges. The level bits are inverted
+ * while copying (the TSOP receiver is active low).
+ *
+ * @note This module has no dependencies to FreeRTOS or the hardware,
+ * long recordings can be replayed on a host.
+ * @see halIOIRRecvTask
+ **/
+
+#ifndef _IR_RECV_BUFFER_H_
+#define _IR_RECV_BUFFER_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_err.h"
+#include "driver/rmt.h"
+
+/** @brief State of a receive buffer
+ * @see ir_recv_buffer_init */
+typedef struct ir_recv_buffer {
+  /** @brief Edges, NULL if nothing is received */
+  rmt_item32_t *buffer;
+  /** @brief Count of received edges */
+  uint16_t count;
+  /** @brief Count of allocated edges */
+  uint16_t allocated;
+  /** @brief Growing step [edges] */
+  uint16_t chunk;
+  /** @brief Maximum count of edges */
+  uint16_t maximum;
+  /** @brief XOR mask applied to each copied item */
+  uint32_t mask;
+} ir_recv_buffer_t;
+
+/** @brief Initialize an empty receive buffer (nothing is allocated)
+ * @param b Receive buffer
+ * @param chunk Growing step [edges]
+ * @param maximum Maximum count of edges
+ * @param mask XOR mask applied to each copied item (e.g. level bits)
+ * */
+void ir_recv_buffer_init(ir_recv_buffer_t *b, uint16_t chunk, uint16_t maximum, uint32_t mask);
+
+/** @brief Append edges to the buffer, grow it if necessary
+ *
+ * On an error, the buffer is freed & reset.
+ * @param b Receive buffer
+ * @param items Received edges
+ * @param count Count of received edges
+ * @return ESP_OK if appended, ESP_ERR_INVALID_SIZE if more than the
+ * maximum edges are received, ESP_ERR_NO_MEM if the buffer cannot grow
+ * */
+esp_err_t ir_recv_buffer_append(ir_recv_buffer_t *b, const rmt_item32_t *items, uint16_t count);
+
+/** @brief Free the edges & reset the buffer
+ * @param b Receive buffer
+ * */
+void ir_recv_buffer_free(ir_recv_buffer_t *b);
+
+#endif /* _IR_RECV_BUFFER_H_ */
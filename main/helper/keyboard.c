@@ -61,7 +61,10 @@
 #include <string.h>
 #include "keyboard.h"
 #include "esp_log.h"
+#include "deferred_log.h"
 #define LOG_TAG "KB"
+/** @brief Log level of this module, DLOGx calls with a higher level are removed */
+#define LOG_LEVEL_KEYBOARD ESP_LOG_INFO
 
 /** Helper macro to compare key identifiers, y must be of fixed size! */
 #define COMP(x,y) ((memcmp(x,y,sizeof(y)-1) == 0) && (x[sizeof(y)-1] == '\0' || \
@@ -1930,20 +1933,19 @@ uint16_t unicode_to_keycode(uint16_t cpoint, uint8_t locale)
 	if (cpoint < 32) {
 		if (cpoint == 10) 
     {
-      ESP_LOGI(LOG_TAG,"cpoint %d, locale %d, mask %d, key %d",cpoint,locale,keycodes_masks[locale][3],KEY_ENTER);
+      DLOGD(LOG_LEVEL_KEYBOARD,LOG_TAG,"cpoint %d, locale %d, mask %d, key %d",cpoint,locale,keycodes_masks[locale][3],KEY_ENTER);
       return KEY_ENTER & keycodes_masks[locale][3];
     }
 		if (cpoint == 11) 
     {
-      ESP_LOGI(LOG_TAG,"cpoint %d, locale %d, mask %d, key %d",cpoint,locale,keycodes_masks[locale][3],KEY_TAB);
+      DLOGD(LOG_LEVEL_KEYBOARD,LOG_TAG,"cpoint %d, locale %d, mask %d, key %d",cpoint,locale,keycodes_masks[locale][3],KEY_TAB);
       return KEY_TAB & keycodes_masks[locale][3];
     }
 		return 0;
 	}
 	if (cpoint < 128) 
   {
-    ESP_LOGI(LOG_TAG,"ASCII lookup");
-    ESP_LOGI(LOG_TAG,"cpoint %d, locale %d, mask --, key %d",cpoint,locale,keycodes_ascii[locale][cpoint - 0x20]);
+    DLOGD(LOG_LEVEL_KEYBOARD,LOG_TAG,"ASCII lookup: cpoint %d, locale %d, mask --, key %d",cpoint,locale,keycodes_ascii[locale][cpoint - 0x20]);
     return keycodes_ascii[locale][cpoint - 0x20];
   }
 	if (cpoint <= 0xA0) 
@@ -1958,7 +1960,7 @@ uint16_t unicode_to_keycode(uint16_t cpoint, uint8_t locale)
       ESP_LOGE(LOG_TAG,"locale is LAYOUT_US_ENGLISH, no unicode available");
       return 0;
     } else {
-      ESP_LOGI(LOG_TAG,"cpoint %d, locale %d, mask --, key %d",cpoint,locale,keycodes_iso_8859_1[locale-1][cpoint-0xA0]);
+      DLOGD(LOG_LEVEL_KEYBOARD,LOG_TAG,"cpoint %d, locale %d, mask --, key %d",cpoint,locale,keycodes_iso_8859_1[locale-1][cpoint-0xA0]);
       return keycodes_iso_8859_1[locale-1][cpoint-0xA0];
     }
   }
@@ -1985,16 +1987,16 @@ uint16_t deadkey_to_keycode(uint16_t keycode, uint8_t locale)
 {
 	keycode &= keycodes_masks[locale][2];
 	if (keycode == 0) return 0;
-  ESP_LOGI(LOG_TAG,"deadkeys: applying mask 0x%X, result: %d", keycodes_masks[locale][2], keycode);
+  DLOGD(LOG_LEVEL_KEYBOARD,LOG_TAG,"deadkeys: applying mask 0x%X, result: %d", keycodes_masks[locale][2], keycode);
   for(uint8_t i = 0; i<sizeof(keycodes_deadkey_bits[locale]); i++)
   {
     if(keycode == keycodes_deadkey_bits[locale][i])
     {
-      ESP_LOGI(LOG_TAG,"deadkey found, index: %d, deadkey: %d",i,keycodes_deadkey[locale][i]);
+      DLOGD(LOG_LEVEL_KEYBOARD,LOG_TAG,"deadkey found, index: %d, deadkey: %d",i,keycodes_deadkey[locale][i]);
       return keycodes_deadkey[locale][i];
     }
   }
-  ESP_LOGI(LOG_TAG,"no deadkey");
+  DLOGD(LOG_LEVEL_KEYBOARD,LOG_TAG,"no deadkey");
 	return 0;
 }
 
@@ -2030,7 +2032,7 @@ uint8_t keycode_to_modifier(uint16_t keycode, uint8_t locale)
 	if (keycode & keycodes_masks[locale][0]) modifier |= MODIFIERKEY_SHIFT;
 	if (keycode & keycodes_masks[locale][1]) modifier |= MODIFIERKEY_RIGHT_ALT;
 	if (keycode & keycodes_masks[locale][4]) modifier |= MODIFIERKEY_RIGHT_CTRL;
-  if(modifier) ESP_LOGI(LOG_TAG,"found modifiers: %X",modifier);
+  if(modifier) DLOGD(LOG_LEVEL_KEYBOARD,LOG_TAG,"found modifiers: %X",modifier);
 	return modifier;
 }
 
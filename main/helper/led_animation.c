@@ -0,0 +1,158 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ * Copyright 2019 Benjamin Aigner <aignerb@technikum-wien.at,
+ * beni@asterics-foundation.org>
+ */
+/** @file
+ * @brief LED animation helper functions
+ *
+ * This module computes the Neopixel colors of one animation frame from
+ * a compact animation descriptor (led_anim_t).
+ * Levels are fixed point values with 8bit fraction (0-256, 256 is full
+ * brightness), only two divisions are done per frame.
+ *
+ * @see led_animation.h
+ **/
+
+#include "led_animation.h"
+
+/** @brief Full brightness level (1.0 in fixed point) */
+#define LEVEL_FULL 256
+
+/** @brief Set all pixels to the same color */
+static void led_anim_fill(uint8_t *rgb, uint16_t count, const uint8_t *color)
+{
+  for(uint16_t i = 0; i<count; i++)
+  {
+    rgb[i*3] = color[0];
+    rgb[i*3+1] = color[1];
+    rgb[i*3+2] = color[2];
+  }
+}
+
+/** @brief Scale a color by a level (0-LEVEL_FULL) */
+static void led_anim_scale(const uint8_t *color, uint16_t level, uint8_t *out)
+{
+  for(uint8_t i = 0; i<3; i++) out[i] = (color[i] * level) >> 8;
+}
+
+/** @brief Start a new animation
+ *
+ * The color of the previous animation's last frame is kept as start
+ * color for fading.
+ *
+ * @param state Animation state
+ * @param anim New animation descriptor
+ * */
+void led_anim_start(led_anim_state_t *state, const led_anim_t *anim)
+{
+  memcpy(state->from,state->last,3);
+  memcpy(&state->anim,anim,sizeof(led_anim_t));
+  if(state->anim.period == 0) state->anim.period = LED_ANIM_DEFAULT_PERIOD;
+}
+
+/** @brief Compute one frame of the running animation
+ *
+ * @param state Animation state, started by led_anim_start
+ * @param elapsed Time since start of the animation [ms]
+ * @param rgb Output buffer, 3 bytes (r,g,b) per pixel
+ * @param count Count of pixels
+ * @return 1 if further frames are necessary (animation is running),
+ * 0 if this frame is final
+ * */
+uint8_t led_anim_frame(led_anim_state_t *state, uint32_t elapsed, uint8_t *rgb, uint16_t count)
+{
+  const led_anim_t *anim = &state->anim;
+  const uint8_t color[3] = {anim->r, anim->g, anim->b};
+  uint8_t out[3];
+  uint8_t running = 1;
+  uint16_t level;
+
+  if(count == 0) return 0;
+
+  //number of the current cycle & position within it (0-255)
+  uint32_t cycle = elapsed / anim->period;
+  uint16_t phase = ((elapsed - cycle * anim->period) << 8) / anim->period;
+
+  switch(anim->mode)
+  {
+    case LED_ANIM_FADE:
+      if(cycle != 0)
+      {
+        memcpy(out,color,3);
+        running = 0;
+      } else {
+        for(uint8_t i = 0; i<3; i++)
+        {
+          out[i] = state->from[i] + (((int16_t)color[i] - state->from[i]) * (int16_t)phase) / LEVEL_FULL;
+        }
+      }
+      led_anim_fill(rgb,count,out);
+      break;
+
+    case LED_ANIM_PULSE:
+      if(anim->count != 0 && cycle >= anim->count)
+      {
+        memcpy(out,color,3);
+        running = 0;
+      } else {
+        //triangle 0 -> 256 -> 0, squared for a perceived linear brightness
+        level = (phase < 128) ? (phase << 1) : ((LEVEL_FULL - phase) << 1);
+        level = (level * level) >> 8;
+        led_anim_scale(color,level,out);
+      }
+      led_anim_fill(rgb,count,out);
+      break;
+
+    case LED_ANIM_BLINK:
+      if(anim->count != 0 && cycle >= anim->count)
+      {
+        memcpy(out,color,3);
+        running = 0;
+      } else {
+        level = (phase < (anim->duty ? anim->duty : 128)) ? LEVEL_FULL : 0;
+        led_anim_scale(color,level,out);
+      }
+      led_anim_fill(rgb,count,out);
+      break;
+
+    case LED_ANIM_CIRCLE:
+      //not possible with up to 3 pixels, steady color instead
+      if(count <= 3)
+      {
+        led_anim_fill(rgb,count,color);
+        running = 0;
+        break;
+      }
+      memset(rgb,0,count*3);
+      uint16_t pos = (phase * count) >> 8;
+      for(uint8_t i = 0; i<3; i++)
+      {
+        memcpy(&rgb[((pos + i) % count) * 3],color,3);
+      }
+      break;
+
+    case LED_ANIM_STEADY:
+    default:
+      led_anim_fill(rgb,count,color);
+      running = 0;
+      break;
+  }
+
+  memcpy(state->last,rgb,3);
+  return running;
+}
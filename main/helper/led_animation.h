@@ -0,0 +1,128 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ * Copyright 2019 Benjamin Aigner <aignerb@technikum-wien.at,
+ * beni@asterics-foundation.org>
+ */
+/** @file
+ * @brief LED animation helper functions
+ *
+ * This module computes the Neopixel colors of one animation frame from
+ * a compact animation descriptor (led_anim_t, 8 bytes). It is used by
+ * the LED task in hal_io.c, callers post one descriptor via the LED
+ * queue instead of many color updates.
+ *
+ * Supported animations:<br>
+ * * Steady color
+ * * Circling group of 3 pixels
+ * * Fade from the current to a new color
+ * * Pulsing (breathing) color
+ * * Blink pattern (e.g., slot number), afterwards steady color
+ *
+ * All calculations are done in fixed point (8bit fractions), without
+ * floats or divisions per pixel. The cost of one frame is linear in the
+ * count of pixels and stays below LED_ANIM_FRAME_BUDGET_US for up to
+ * 64 pixels.
+ *
+ * @note This module has no dependencies to FreeRTOS or the hardware.
+ * @see halIOLEDQueue
+ * @see halIOLEDTask
+ **/
+
+#ifndef _LED_ANIMATION_H_
+#define _LED_ANIMATION_H_
+
+#include <stdint.h>
+#include <string.h>
+
+/** @brief Animation mode: steady color on all pixels */
+#define LED_ANIM_STEADY   0
+/** @brief Animation mode: 3 pixels with the given color are circled around,
+ * one round takes led_anim_t.period */
+#define LED_ANIM_CIRCLE   1
+/** @brief Animation mode: fade from the current color to the given color
+ * within led_anim_t.period */
+#define LED_ANIM_FADE     2
+/** @brief Animation mode: pulse between off and the given color, one pulse
+ * takes led_anim_t.period, led_anim_t.count pulses (0: endless) */
+#define LED_ANIM_PULSE    3
+/** @brief Animation mode: blink led_anim_t.count times (0: endless) with the
+ * given color, afterwards steady color. On time is led_anim_t.duty */
+#define LED_ANIM_BLINK    4
+
+/** @brief Default period for animations [ms], if not given (LED macro) */
+#define LED_ANIM_DEFAULT_PERIOD 1000
+
+/** @brief Time between two frames of a running animation [ms] */
+#define LED_ANIM_FRAME_MS 20
+
+/** @brief CPU time budget for computing one frame [us]
+ * @note If exceeded, the LED task logs a warning. */
+#define LED_ANIM_FRAME_BUDGET_US 200
+
+/** @brief Compact animation descriptor, sent to the LED task
+ * @see halIOLEDQueue */
+typedef struct led_anim {
+  /** @brief Animation mode, e.g. LED_ANIM_STEADY */
+  uint8_t mode;
+  /** @brief Color - red */
+  uint8_t r;
+  /** @brief Color - green */
+  uint8_t g;
+  /** @brief Color - blue */
+  uint8_t b;
+  /** @brief Period of one fade/pulse/blink/round [ms] */
+  uint16_t period;
+  /** @brief Count of pulses/blinks, 0 for endless */
+  uint8_t count;
+  /** @brief Blink on time, fraction of the period (x/256), 0 for 50% */
+  uint8_t duty;
+} led_anim_t;
+
+/** @brief State of a running animation
+ * @see led_anim_start
+ * @see led_anim_frame */
+typedef struct led_anim_state {
+  /** @brief Currently running animation */
+  led_anim_t anim;
+  /** @brief Start color for fading (color of the last frame) */
+  uint8_t from[3];
+  /** @brief Color of the last frame (first pixel) */
+  uint8_t last[3];
+} led_anim_state_t;
+
+/** @brief Start a new animation
+ *
+ * The color of the previous animation's last frame is kept as start
+ * color for fading.
+ *
+ * @param state Animation state
+ * @param anim New animation descriptor
+ * */
+void led_anim_start(led_anim_state_t *state, const led_anim_t *anim);
+
+/** @brief Compute one frame of the running animation
+ *
+ * @param state Animation state, started by led_anim_start
+ * @param elapsed Time since start of the animation [ms]
+ * @param rgb Output buffer, 3 bytes (r,g,b) per pixel
+ * @param count Count of pixels
+ * @return 1 if further frames are necessary (animation is running),
+ * 0 if this frame is final
+ * */
+uint8_t led_anim_frame(led_anim_state_t *state, uint32_t elapsed, uint8_t *rgb, uint16_t count);
+
+#endif /* _LED_ANIMATION_H_ */
@@ -0,0 +1,153 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ * Copyright 2019 Benjamin Aigner <aignerb@technikum-wien.at,
+ * beni@asterics-foundation.org>
+ */
+/** @file
+ * @brief Runtime performance counters
+ *
+ * Storage & names of all metrics, the update functions are inlined
+ * (see metrics.h).
+ *
+ * @see metrics.h
+ **/
+
+#include "metrics.h"
+
+/** @brief Logging tag for this module */
+#define LOG_TAG "metrics"
+
+/** @brief Count of updates for measuring the update cost */
+#define METRICS_BENCH_COUNT 1000
+
+/** @brief Storage of all metrics */
+volatile uint32_t metrics[METRIC_COUNT];
+
+/** @brief Names of recorded boot phases */
+static const char *bootPhaseNames[METRICS_BOOT_PHASES];
+/** @brief Timestamps of recorded boot phases [us] */
+static uint32_t bootPhaseTimes[METRICS_BOOT_PHASES];
+/** @brief Count of reserved boot phase entries */
+static volatile uint32_t bootPhaseCount = 0;
+
+/** @brief Names of all metrics, printed by "AT PC" */
+static const char *metricNames[METRIC_COUNT] = {
+  [METRIC_ADC_SAMPLES] = "adc_samples",
+  [METRIC_ADC_DISCARDED] = "adc_discarded",
+  [METRIC_ADC_SKIPPED] = "adc_skipped",
+  [METRIC_ADC_WAKEUPS] = "adc_wakeups",
+  [METRIC_I2C_ERRORS] = "i2c_errors",
+  [METRIC_DEBOUNCE_EVENTS] = "debounce_events",
+  [METRIC_HID_USB] = "hid_usb_cmds",
+  [METRIC_HID_BLE] = "hid_ble_cmds",
+  [METRIC_HWM_HID_USB] = "hid_usb_hwm",
+  [METRIC_HWM_HID_BLE] = "hid_ble_hwm",
+  [METRIC_HWM_DEBOUNCER] = "debouncer_in_hwm",
+  [METRIC_HWM_ATCMDS] = "atcmds_hwm",
+  [METRIC_ADC_JITTER_US] = "adc_jitter_us",
+  [METRIC_SLOTSWITCH_US] = "slotswitch_us",
+  [METRIC_SLOTSWITCH_MAX_US] = "slotswitch_max_us",
+  [METRIC_BOOT_US] = "boot_us",
+  [METRIC_FIRST_HID_US] = "first_hid_us",
+  [METRIC_DLOG_DROPPED] = "dlog_dropped",
+  [METRIC_DLOG_CYCLES] = "dlog_cycles",
+  [METRIC_CIM_FRAMES] = "cim_frames",
+  [METRIC_CIM_ERRORS] = "cim_errors",
+  [METRIC_CIM_FRAME_CYCLES] = "cim_frame_cycles",
+  [METRIC_UPDATE_NS] = "update_ns",
+};
+
+/** @brief Record the end of a boot phase (timestamp since reset)
+ * @note Can be called from any task, phases after
+ * METRICS_BOOT_PHASES are ignored.
+ * @param name Name of the phase, must be a constant string */
+void metricsBootPhase(const char *name)
+{
+  uint32_t timestamp = (uint32_t)esp_timer_get_time();
+  uint32_t index, set;
+  //reserve an entry (lock-free, like metricsAdd)
+  do {
+    index = bootPhaseCount;
+    if(index >= METRICS_BOOT_PHASES) return;
+    set = index + 1;
+    uxPortCompareSet(&bootPhaseCount, index, &set);
+  } while(set != index);
+  bootPhaseTimes[index] = timestamp;
+  bootPhaseNames[index] = name;
+}
+
+/** @brief Get a recorded boot phase
+ * @param index Number of the phase (in order of recording)
+ * @param name Name of the phase is returned here
+ * @param timestamp Time since reset [us] is returned here
+ * @return 1 if available, 0 otherwise */
+uint8_t metricsGetBootPhase(uint8_t index, const char **name, uint32_t *timestamp)
+{
+  //name is set after the timestamp, NULL if still in progress
+  if(index >= bootPhaseCount || bootPhaseNames[index] == NULL) return 0;
+  *name = bootPhaseNames[index];
+  *timestamp = bootPhaseTimes[index];
+  return 1;
+}
+
+/** @brief Print all recorded boot phases (log, info level) */
+void metricsBootPrint(void)
+{
+  const char *name;
+  uint32_t timestamp;
+  for(uint8_t i = 0; i<METRICS_BOOT_PHASES; i++)
+  {
+    if(metricsGetBootPhase(i,&name,&timestamp) == 0) break;
+    ESP_LOGI(LOG_TAG,"boot: %-16s %6"PRIu32"us",name,timestamp);
+  }
+}
+
+/** @brief Get the current value of a metric
+ * @param id Metric
+ * @return Current value */
+uint32_t metricsGet(metric_t id)
+{
+  if(id >= METRIC_COUNT) return 0;
+  return metrics[id];
+}
+
+/** @brief Get the name of a metric
+ * @param id Metric
+ * @return Name (e.g., "adc_samples"), "?" for an invalid id */
+const char *metricsName(metric_t id)
+{
+  if(id >= METRIC_COUNT || metricNames[id] == NULL) return "?";
+  return metricNames[id];
+}
+
+/** @brief Initialize the metrics
+ *
+ * Resets all metrics and measures the cost of one metric update
+ * (METRIC_UPDATE_NS).
+ * */
+void metricsInit(void)
+{
+  for(uint8_t i = 0; i<METRIC_COUNT; i++) metrics[i] = 0;
+
+  //measure the update cost, using the result field itself
+  int64_t start = esp_timer_get_time();
+  for(uint16_t i = 0; i<METRICS_BENCH_COUNT; i++) metricsInc(METRIC_UPDATE_NS);
+  int64_t duration = esp_timer_get_time() - start;
+  metricsSet(METRIC_UPDATE_NS, (uint32_t)((duration * 1000) / METRICS_BENCH_COUNT));
+
+  ESP_LOGI(LOG_TAG,"metric update: %"PRIu32"ns",metrics[METRIC_UPDATE_NS]);
+}
@@ -0,0 +1,194 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ * Copyright 2019 Benjamin Aigner <aignerb@technikum-wien.at,
+ * beni@asterics-foundation.org>
+ */
+/** @file
+ * @brief Runtime performance counters
+ *
+ * This module provides a small registry of named counters and gauges
+ * (metric_t), which are updated from the hot paths (ADC sampling,
+ * debouncer, HID transports, queues, ...).
+ * All values are uint32_t and updated lock-free via the compare-and-set
+ * instruction of the ESP32 (uxPortCompareSet), no mutex or critical
+ * section is used. The cost of one update is measured on metricsInit
+ * and available as METRIC_UPDATE_NS.
+ *
+ * The registry is printed via "AT PC" (one "name=value" line per metric).
+ *
+ * In addition, timestamps of boot phases are recorded (metricsBootPhase),
+ * printed after initialization and via "AT PC".
+ *
+ * @note Counters wrap around at 2^32.
+ * @see metricsInc
+ * @see metricsMax
+ **/
+
+#ifndef _METRICS_H_
+#define _METRICS_H_
+
+#include <stdint.h>
+#include <inttypes.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <esp_log.h>
+#include "esp_timer.h"
+
+/** @brief Available metrics
+ * @note Add the name to metricNames in metrics.c for each new entry. */
+typedef enum metric {
+  /** @brief Counter: sensor samples processed (halAdcReadData) */
+  METRIC_ADC_SAMPLES = 0,
+  /** @brief Counter: sensor samples discarded (deviation too high) */
+  METRIC_ADC_DISCARDED,
+  /** @brief Counter: sensor samples not taken, because of the idle sampling rate */
+  METRIC_ADC_SKIPPED,
+  /** @brief Counter: switches from idle to full sampling rate */
+  METRIC_ADC_WAKEUPS,
+  /** @brief Counter: I2C read errors (sensor board) */
+  METRIC_I2C_ERRORS,
+  /** @brief Counter: VB events received by the debouncer */
+  METRIC_DEBOUNCE_EVENTS,
+  /** @brief Counter: HID commands sent via USB */
+  METRIC_HID_USB,
+  /** @brief Counter: HID commands sent via BLE */
+  METRIC_HID_BLE,
+  /** @brief Gauge: high-water mark of hid_usb queue */
+  METRIC_HWM_HID_USB,
+  /** @brief Gauge: high-water mark of hid_ble queue */
+  METRIC_HWM_HID_BLE,
+  /** @brief Gauge: high-water mark of debouncer_in queue */
+  METRIC_HWM_DEBOUNCER,
+  /** @brief Gauge: high-water mark of halSerialATCmds queue */
+  METRIC_HWM_ATCMDS,
+  /** @brief Gauge: maximum deviation of the ADC task period [us] */
+  METRIC_ADC_JITTER_US,
+  /** @brief Gauge: duration of the last slot switch [us] */
+  METRIC_SLOTSWITCH_US,
+  /** @brief Gauge: maximum duration of a slot switch [us] */
+  METRIC_SLOTSWITCH_MAX_US,
+  /** @brief Gauge: time from reset until app_main finished init [us] */
+  METRIC_BOOT_US,
+  /** @brief Gauge: time from reset until the first HID report was sent [us] */
+  METRIC_FIRST_HID_US,
+  /** @brief Counter: deferred log entries dropped (ring full) */
+  METRIC_DLOG_DROPPED,
+  /** @brief Gauge: cost of one deferred log call [CPU cycles], measured on init */
+  METRIC_DLOG_CYCLES,
+  /** @brief Counter: CIM sensor frames sent (periodic reports) */
+  METRIC_CIM_FRAMES,
+  /** @brief Counter: CIM packets discarded (invalid header/length, timeout) */
+  METRIC_CIM_ERRORS,
+  /** @brief Gauge: maximum cost of building & sending one CIM frame [CPU cycles] */
+  METRIC_CIM_FRAME_CYCLES,
+  /** @brief Gauge: cost of one metric update [ns], measured on init */
+  METRIC_UPDATE_NS,
+  /** @brief Count of metrics, keep as last entry */
+  METRIC_COUNT
+} metric_t;
+
+/** @brief Storage of all metrics, use the access functions below */
+extern volatile uint32_t metrics[METRIC_COUNT];
+
+/** @brief Add a value to a counter (lock-free)
+ * @param id Metric to update
+ * @param val Value to add */
+static inline void metricsAdd(metric_t id, uint32_t val)
+{
+  uint32_t old, set;
+  do {
+    old = metrics[id];
+    set = old + val;
+    //stores set if metrics[id] is still old, set is the previous value afterwards
+    uxPortCompareSet(&metrics[id], old, &set);
+  } while(set != old);
+}
+
+/** @brief Increment a counter by one (lock-free)
+ * @param id Metric to update */
+static inline void metricsInc(metric_t id)
+{
+  metricsAdd(id, 1);
+}
+
+/** @brief Set a gauge
+ * @param id Metric to update
+ * @param val New value */
+static inline void metricsSet(metric_t id, uint32_t val)
+{
+  metrics[id] = val;
+}
+
+/** @brief Raise a gauge to val, if val is higher (lock-free)
+ * @param id Metric to update
+ * @param val New value */
+static inline void metricsMax(metric_t id, uint32_t val)
+{
+  uint32_t old, set;
+  do {
+    old = metrics[id];
+    if(val <= old) return;
+    set = val;
+    uxPortCompareSet(&metrics[id], old, &set);
+  } while(set != old);
+}
+
+/** @brief Update a queue high-water mark, call after xQueueReceive
+ *
+ * The fill level of a queue decreases only on receiving, so the level
+ * right before a receive is the maximum since the previous receive.
+ * @param id Metric to update
+ * @param q Queue handle */
+#define METRICS_QUEUE_HWM(id,q) metricsMax(id, uxQueueMessagesWaiting(q) + 1)
+
+/** @brief Maximum count of recorded boot phases */
+#define METRICS_BOOT_PHASES 16
+
+/** @brief Record the end of a boot phase (timestamp since reset)
+ * @note Can be called from any task, phases after
+ * METRICS_BOOT_PHASES are ignored.
+ * @param name Name of the phase, must be a constant string */
+void metricsBootPhase(const char *name);
+
+/** @brief Get a recorded boot phase
+ * @param index Number of the phase (in order of recording)
+ * @param name Name of the phase is returned here
+ * @param timestamp Time since reset [us] is returned here
+ * @return 1 if available, 0 otherwise */
+uint8_t metricsGetBootPhase(uint8_t index, const char **name, uint32_t *timestamp);
+
+/** @brief Print all recorded boot phases (log, info level) */
+void metricsBootPrint(void);
+
+/** @brief Get the current value of a metric
+ * @param id Metric
+ * @return Current value */
+uint32_t metricsGet(metric_t id);
+
+/** @brief Get the name of a metric
+ * @param id Metric
+ * @return Name (e.g., "adc_samples"), "?" for an invalid id */
+const char *metricsName(metric_t id);
+
+/** @brief Initialize the metrics
+ *
+ * Resets all metrics and measures the cost of one metric update
+ * (METRIC_UPDATE_NS).
+ * */
+void metricsInit(void);
+
+#endif /* _METRICS_H_ */
@@ -0,0 +1,168 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ * Copyright 2019 Benjamin Aigner <aignerb@technikum-wien.at,
+ * beni@asterics-foundation.org>
+ */
+/** @file
+ * @brief Allocation of long-lived RTOS objects
+ *
+ * All queues, tasks, timers, semaphores and event groups, which are
+ * created once and live until reset, are created via the macros
+ * in this file (e.g., RTOS_QUEUE_CREATE instead of xQueueCreate).
+ *
+ * If RTOS_STATIC_ALLOCATION is defined (see common.h), these objects
+ * are allocated statically (xQueueCreateStatic, xTaskCreateStatic,...),
+ * the buffers are placed in .bss by the linker. Each macro call site
+ * has its own buffers, so a call site must not create more than one
+ * living object. Otherwise the objects are allocated on the heap.
+ *
+ * The RAM used for static objects is added up in rtosStaticBytes
+ * (printed by "AT PC").
+ *
+ * Tasks are always pinned to the core given in the task table
+ * (TASK_CORE_INPUT/TASK_CORE_SYSTEM, see common.h).
+ *
+ * Objects with a limited lifetime (WiFi/webserver tasks, websocket
+ * clients, ...) are still created dynamically.
+ *
+ * @note Static allocation needs CONFIG_SUPPORT_STATIC_ALLOCATION
+ * in menuconfig (Component config -> FreeRTOS).
+ **/
+
+#ifndef _RTOS_ALLOC_H_
+#define _RTOS_ALLOC_H_
+
+#include <stdint.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <freertos/timers.h>
+#include <freertos/event_groups.h>
+
+/*++++ central table of long-lived queue lengths & task stacks ++++*/
+
+/** @brief Queue length: config_switcher (slot names) */
+#define RTOS_QLEN_CONFIG_SWITCHER   5
+/** @brief Queue length: hid_ble */
+#define RTOS_QLEN_HID_BLE           32
+/** @brief Queue length: hid_usb */
+#define RTOS_QLEN_HID_USB           32
+/** @brief Queue length: debouncer_in */
+#define RTOS_QLEN_DEBOUNCER_IN      32
+/** @brief Queue length: halIOIRRecvQueue */
+#define RTOS_QLEN_IR_RECV           8
+/** @brief Queue length: halIOLEDQueue */
+#define RTOS_QLEN_LED               8
+/** @brief Queue length: halIOBuzzerQueue */
+#define RTOS_QLEN_BUZZER            8
+
+/** @brief Stack size: ADC task (mouse/joystick/threshold) */
+#define RTOS_STACK_ADC              4096
+/** @brief Stack size: serial HID task (USB bridge) */
+#define RTOS_STACK_SERIAL_HID       (HAL_SERIAL_TASK_STACKSIZE+256)
+/** @brief Stack size: serial RX task (USB commands) */
+#define RTOS_STACK_SERIAL_RX        HAL_SERIAL_TASK_STACKSIZE
+
+/** @brief Count of bytes allocated statically for RTOS objects
+ * @note Always 0 without RTOS_STATIC_ALLOCATION */
+extern uint32_t rtosStaticBytes;
+
+#ifdef RTOS_STATIC_ALLOCATION
+
+#if !CONFIG_SUPPORT_STATIC_ALLOCATION
+#error "RTOS_STATIC_ALLOCATION needs CONFIG_SUPPORT_STATIC_ALLOCATION"
+#endif
+
+/** @brief Create a queue (static buffers)
+ * @param len Count of items
+ * @param size Size of one item
+ * @return Queue handle */
+#define RTOS_QUEUE_CREATE(len,size) ({ \
+  static StaticQueue_t _qbuf; static uint8_t _qstorage[(len)*(size)]; \
+  rtosStaticBytes += sizeof(_qbuf) + sizeof(_qstorage); \
+  xQueueCreateStatic(len,size,_qstorage,&_qbuf); })
+
+/** @brief Create a mutex (static buffer)
+ * @return Semaphore handle */
+#define RTOS_MUTEX_CREATE() ({ \
+  static StaticSemaphore_t _sbuf; rtosStaticBytes += sizeof(_sbuf); \
+  xSemaphoreCreateMutexStatic(&_sbuf); })
+
+/** @brief Create a binary semaphore (static buffer)
+ * @return Semaphore handle */
+#define RTOS_BINARY_CREATE() ({ \
+  static StaticSemaphore_t _sbuf; rtosStaticBytes += sizeof(_sbuf); \
+  xSemaphoreCreateBinaryStatic(&_sbuf); })
+
+/** @brief Create an event group (static buffer)
+ * @return Event group handle */
+#define RTOS_EVENTGROUP_CREATE() ({ \
+  static StaticEventGroup_t _ebuf; rtosStaticBytes += sizeof(_ebuf); \
+  xEventGroupCreateStatic(&_ebuf); })
+
+/** @brief Create a software timer (static buffer), parameters as xTimerCreate
+ * @return Timer handle */
+#define RTOS_TIMER_CREATE(name,period,reload,id,cb) ({ \
+  static StaticTimer_t _tbuf; rtosStaticBytes += sizeof(_tbuf); \
+  xTimerCreateStatic(name,period,reload,id,cb,&_tbuf); })
+
+/** @brief Create a task pinned to a core (static stack & TCB),
+ * parameters as xTaskCreatePinnedToCore
+ * @note The stack size is given in bytes (ESP-IDF)
+ * @return pdPASS on success */
+#define RTOS_TASK_CREATE(fct,name,stack,param,prio,handle,core) ({ \
+  static StackType_t _stack[stack]; static StaticTask_t _tcb; \
+  TaskHandle_t *_hp = (handle); \
+  TaskHandle_t _h = xTaskCreateStaticPinnedToCore(fct,name,stack,param,prio,_stack,&_tcb,core); \
+  rtosStaticBytes += sizeof(_stack) + sizeof(_tcb); \
+  if(_hp != NULL) *_hp = _h; \
+  (_h != NULL) ? pdPASS : pdFAIL; })
+
+#else
+
+/** @brief Create a queue (heap)
+ * @param len Count of items
+ * @param size Size of one item
+ * @return Queue handle */
+#define RTOS_QUEUE_CREATE(len,size) xQueueCreate(len,size)
+
+/** @brief Create a mutex (heap)
+ * @return Semaphore handle */
+#define RTOS_MUTEX_CREATE() xSemaphoreCreateMutex()
+
+/** @brief Create a binary semaphore (heap)
+ * @return Semaphore handle */
+#define RTOS_BINARY_CREATE() xSemaphoreCreateBinary()
+
+/** @brief Create an event group (heap)
+ * @return Event group handle */
+#define RTOS_EVENTGROUP_CREATE() xEventGroupCreate()
+
+/** @brief Create a software timer (heap), parameters as xTimerCreate
+ * @return Timer handle */
+#define RTOS_TIMER_CREATE(name,period,reload,id,cb) xTimerCreate(name,period,reload,id,cb)
+
+/** @brief Create a task pinned to a core (heap), parameters as
+ * xTaskCreatePinnedToCore
+ * @return pdPASS on success */
+#define RTOS_TASK_CREATE(fct,name,stack,param,prio,handle,core) \
+  xTaskCreatePinnedToCore(fct,name,stack,param,prio,handle,core)
+
+#endif /* RTOS_STATIC_ALLOCATION */
+
+#endif /* _RTOS_ALLOC_H_ */
@@ -0,0 +1,77 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ * Copyright 2019 Benjamin Aigner <aignerb@technikum-wien.at,
+ * beni@asterics-foundation.org>
+ */
+/** @file
+ * @brief Embedded web GUI assets
+ *
+ * Lookup of the asset table, which is generated by webgui/makeassets.py
+ * into webgui_assets_data.h (component build directory).
+ *
+ * @see webgui_assets.h
+ **/
+
+#include "webgui_assets.h"
+//generated asset table (webgui_assets, WEBGUI_ASSETS_COUNT)
+#include "webgui_assets_data.h"
+
+#ifndef WEBGUI_ASSETS_COUNT
+  #warning "No embedded web GUI assets for this device, serving from FAT only"
+  #define WEBGUI_ASSETS_COUNT 0
+  static const webgui_asset_t webgui_assets[1];
+#endif
+
+/** @brief Find an embedded asset by its URL
+ *
+ * @param url Requested URL (without query string)
+ * @return Pointer to the asset or NULL if not found
+ **/
+const webgui_asset_t *webgui_asset_find(const char *url)
+{
+  if(url == NULL) return NULL;
+  for(int i = 0; i < WEBGUI_ASSETS_COUNT; i++)
+  {
+    if(strcmp(url,webgui_assets[i].url) == 0) return &webgui_assets[i];
+  }
+  return NULL;
+}
+
+/** @brief Check if the client's cached version matches an asset
+ *
+ * If-None-Match might contain a list of ETags or "*".
+ * The value might be followed by further header lines, only the
+ * first line is used.
+ *
+ * @param asset Asset which will be sent
+ * @param ifnonematch Value of the If-None-Match header, might be NULL
+ * @return 1 if the ETag matches (send 304), 0 otherwise
+ **/
+uint8_t webgui_asset_not_modified(const webgui_asset_t *asset, const char *ifnonematch)
+{
+  if(asset == NULL || ifnonematch == NULL) return 0;
+  if(strncmp(ifnonematch,"*",1) == 0) return 1;
+  //search only until the end of this header line
+  size_t valuelen = strcspn(ifnonematch,"\r\n");
+  size_t etaglen = strlen(asset->etag);
+  //etag is quoted, so substrings cannot match partially
+  for(size_t i = 0; i + etaglen <= valuelen; i++)
+  {
+    if(strncmp(&ifnonematch[i],asset->etag,etaglen) == 0) return 1;
+  }
+  return 0;
+}
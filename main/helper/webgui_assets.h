@@ -0,0 +1,72 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ * Copyright 2019 Benjamin Aigner <aignerb@technikum-wien.at,
+ * beni@asterics-foundation.org>
+ */
+/** @file
+ * @brief Embedded web GUI assets
+ *
+ * The precompressed web GUI files (webgui/minified_gz) are compiled into
+ * the firmware as a read-only table. The table is generated at build time
+ * by webgui/makeassets.py (see main/component.mk) and placed in flash
+ * (.rodata), so files are sent directly from the memory mapped flash,
+ * without any file system access.
+ *
+ * Each asset has an ETag (hash of the gzip data), which is used for
+ * conditional requests (If-None-Match -> 304 Not Modified).
+ *
+ * @see task_webgui.c
+ **/
+
+#ifndef _WEBGUI_ASSETS_H_
+#define _WEBGUI_ASSETS_H_
+
+#include <stdint.h>
+#include <string.h>
+//DEVICE_FLIPMOUSE/DEVICE_FABI selects the asset table
+#include "common.h"
+
+/** @brief One embedded, gzip compressed file */
+typedef struct webgui_asset {
+  /** @brief URL of this file, e.g. "/index.htm" */
+  const char *url;
+  /** @brief Content type for the HTTP header */
+  const char *type;
+  /** @brief Gzip compressed content */
+  const uint8_t *data;
+  /** @brief Length of data */
+  uint32_t len;
+  /** @brief ETag, including quotes */
+  const char *etag;
+} webgui_asset_t;
+
+/** @brief Find an embedded asset by its URL
+ *
+ * @param url Requested URL (without query string)
+ * @return Pointer to the asset or NULL if not found
+ **/
+const webgui_asset_t *webgui_asset_find(const char *url);
+
+/** @brief Check if the client's cached version matches an asset
+ *
+ * @param asset Asset which will be sent
+ * @param ifnonematch Value of the If-None-Match header, might be NULL
+ * @return 1 if the ETag matches (send 304), 0 otherwise
+ **/
+uint8_t webgui_asset_not_modified(const webgui_asset_t *asset, const char *ifnonematch);
+
+#endif /* _WEBGUI_ASSETS_H_ */
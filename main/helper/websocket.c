@@ -31,91 +31,358 @@
  * Small adaptions done by Benjamin Aigner (2018) <aignerb@technikum-wien.at>:
  * * Replaced strlen by strnlen avoiding security flaws
  * * Changed data sink to be used with the FLipMouse/FABI firmware
+ * * Multiple clients (hub), incremental frame parser, binary telemetry
  */
 
 #include "websocket.h"
 
 #define WS_CLIENT_KEY_L		24		/**< \brief Length of the Client Key*/
 #define SHA1_RES_L			20		/**< \brief SHA1 result*/
-#define WS_STD_LEN			125		/**< \brief Maximum Length of standard length frames*/
 #define WS_SPRINTF_ARG_L	4		/**< \brief Length of sprintf argument for string (%.*s)*/
+#define WS_HDR_MAX_L		4		/**< \brief Maximum header length of sent frames (16bit length, no mask)*/
+#define WS_TELEMETRY_HDR_L	8		/**< \brief Length of the telemetry message header (type, count, time, dropped)*/
 
-/** \brief Opcode according to RFC 6455*/
-typedef enum {
-	WS_OP_CON = 0x0, 				/*!< Continuation Frame*/
-	WS_OP_TXT = 0x1, 				/*!< Text Frame*/
-	WS_OP_BIN = 0x2, 				/*!< Binary Frame*/
-	WS_OP_CLS = 0x8, 				/*!< Connection Close Frame*/
-	WS_OP_PIN = 0x9, 				/*!< Ping Frame*/
-	WS_OP_PON = 0xa 				/*!< Pong Frame*/
-} WS_OPCODES;
-
-//Reference to open websocket connection
-static struct netconn* WS_conn = NULL;
+/** \brief One connected websocket client
+ * 
+ * Each client is served by its own task. Outbound messages are queued
+ * per client, therefore a slow client only fills its own queue (and
+ * drops messages) without stalling other clients or the UART path.*/
+typedef struct {
+	struct netconn *conn;		/**< \brief Connection of this client*/
+	TaskHandle_t task;			/**< \brief Task serving this client*/
+	uint8_t slot;				/**< \brief Index in WS_clients*/
+	volatile uint8_t closing;	/**< \brief Set to close this connection (WS_close_all)*/
+	volatile uint8_t subscriptions;	/**< \brief Subscribed streams, see WS_SUB_OUTPUT*/
+	RingbufHandle_t txq;		/**< \brief Outbound text messages (serial output)*/
+	uint32_t txdropped;			/**< \brief Messages dropped, because txq was full*/
+	char batch[WS_HDR_MAX_L + WS_BATCH_SIZE];	/**< \brief Coalesced messages (header space reserved)*/
+	size_t batch_len;			/**< \brief Length of pending messages in batch*/
+	QueueHandle_t telemetry_q;	/**< \brief Telemetry samples, filled by the ADC task*/
+	volatile uint32_t telemetry_interval;	/**< \brief Telemetry interval [us], 0 if not subscribed*/
+	uint32_t telemetry_next;	/**< \brief Time of the next sample to be queued [us]*/
+	volatile uint32_t telemetry_dropped;	/**< \brief Count of dropped samples (queue full)*/
+	uint32_t stat_msgs;			/**< \brief Sent messages (statistics)*/
+	uint32_t stat_frames;		/**< \brief Sent frames (statistics)*/
+	WS_rx_t rx;					/**< \brief Receive state, see ws_rx.h*/
+} WS_client_t;
+
+//Connected clients, NULL if slot is free
+static WS_client_t *WS_clients[WS_MAX_CLIENTS];
+//Mutex for adding/removing clients & iterating over them
+static SemaphoreHandle_t WS_hubMutex = NULL;
 
 const char WS_sec_WS_keys[] = "Sec-WebSocket-Key:";
 const char WS_sec_conKey[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
 const char WS_srv_hs[] ="HTTP/1.1 101 Switching Protocols \r\nUpgrade: websocket\r\nConnection: Upgrade\r\nSec-WebSocket-Accept: %.*s\r\n\r\n";
 
 
-esp_err_t WS_write_data(char* p_data, size_t length) {
+/** \brief Build a frame header (FIN set, no mask)
+ * \param hdr Buffer for the header, at least WS_HDR_MAX_L bytes
+ * \param opcode Frame opcode
+ * \param length Payload length, max. 0xFFFF
+ * \return Length of the header */
+static size_t WS_frame_header(uint8_t *hdr, WS_OPCODES opcode, size_t length) {
+	hdr[0] = 0x80 | opcode;
+	if(length <= WS_STD_LEN) {
+		hdr[1] = length;
+		return 2;
+	}
+	//16bit length field
+	hdr[1] = 126;
+	hdr[2] = (length & 0xFF00) >> 8;
+	hdr[3] = length & 0x00FF;
+	return 4;
+}
 
-	//check if we have an open connection
-	if (WS_conn == NULL)
-		return ERR_CONN;
+/** \brief Write one frame with a single netconn_write
+ * \param c Client
+ * \param buf Buffer, WS_HDR_MAX_L bytes are reserved for the header, followed by the payload
+ * \param opcode Frame opcode
+ * \param length Payload length
+ * \note Only called by the client's task */
+static err_t WS_write_frame(WS_client_t *c, char *buf, WS_OPCODES opcode, size_t length) {
+	uint8_t hdr[WS_HDR_MAX_L];
+	size_t hdrlen = WS_frame_header(hdr, opcode, length);
+	//put header directly in front of the payload
+	char *frame = &buf[WS_HDR_MAX_L - hdrlen];
+	memcpy(frame, hdr, hdrlen);
+	c->stat_frames++;
+	return netconn_write(c->conn, frame, hdrlen + length, NETCONN_COPY);
+}
+
+/** \brief Send the pending batch of a client */
+static err_t WS_flush(WS_client_t *c) {
+	if(c->batch_len == 0) return ERR_OK;
+	err_t result = WS_write_frame(c, c->batch, WS_OP_TXT, c->batch_len);
+	c->batch_len = 0;
+	return result;
+}
+
+/** \brief Send a message as its own text frame */
+static err_t WS_write_single(WS_client_t *c, const char *data, size_t length) {
+	char small[WS_HDR_MAX_L + WS_STD_LEN];
+	char *buf = (length <= WS_STD_LEN) ? small : malloc(WS_HDR_MAX_L + length);
+	if (buf == NULL) {
+		ESP_LOGE("WS","no memory for frame");
+		return ERR_MEM;
+	}
+	memcpy(&buf[WS_HDR_MAX_L], data, length);
+	err_t result = WS_write_frame(c, buf, WS_OP_TXT, length);
+	if (buf != small) free(buf);
+	return result;
+}
+
+/** \brief Send all queued messages of a client
+ * 
+ * Messages which were queued since the last call are coalesced
+ * into as few frames as possible, separated by '\n'.
+ * Live values (VALUES:...) are parsed per message by the GUI,
+ * they are sent in their own frame. */
+static err_t WS_send_pending(WS_client_t *c) {
+	size_t length;
+	char *item;
+	err_t result = ERR_OK;
+
+	while ((result == ERR_OK) && ((item = xRingbufferReceive(c->txq, &length, 0)) != NULL)) {
+		uint8_t single = (length >= 7 && strncmp(item, "VALUES:", 7) == 0);
+		//send pending messages first, if this one doesn't fit
+		if (c->batch_len > 0 && (single || (c->batch_len + 1 + length > WS_BATCH_SIZE)))
+			result = WS_flush(c);
+		if (result == ERR_OK) {
+			if (single || length > WS_BATCH_SIZE) {
+				result = WS_write_single(c, item, length);
+			} else {
+				//append to batch, lines are separated by '\n'
+				if (c->batch_len > 0) c->batch[WS_HDR_MAX_L + c->batch_len++] = '\n';
+				memcpy(&c->batch[WS_HDR_MAX_L + c->batch_len], item, length);
+				c->batch_len += length;
+			}
+		}
+		vRingbufferReturnItem(c->txq, item);
+		c->stat_msgs++;
+	}
+	if (result == ERR_OK)
+		result = WS_flush(c);
+	return result;
+}
+
+esp_err_t WS_write_data(char* p_data, size_t length) {
 
 	//currently only 16bit length field is supported
 	if (length > 0xFFFF)
 		return ERR_VAL;
 
-	//netconn_write result buffer
-	err_t result;
-
-	//prepare header
-	WS_frame_header_t hdr;
-	hdr.FIN = 0x1;
-	
-	hdr.mask = 0;
-	hdr.reserved = 0;
-	hdr.opcode = WS_OP_TXT;
-                
-        //determine length field type
-        if(length <= WS_STD_LEN)
-        {
-                hdr.payload_length = length;
-        } else if(length <= 0xFFFF) {
-                hdr.payload_length = 126;
-        } else {
-                hdr.payload_length = 127;
-        }
-
-	//send header
-	result = netconn_write(WS_conn, &hdr, sizeof(WS_frame_header_t), NETCONN_COPY);
-
-	//check if header was send
-	if (result != ERR_OK) {
-                ESP_LOGE("WS","header");
-		return result;
-        }
-        
-        //send additional length field, if necessary
-        if(hdr.payload_length == 126)
-        {
-                char len = (length & 0xFF00) >> 8;
-                netconn_write(WS_conn, &len, 1, NETCONN_COPY);
-                len = length & 0x00FF;
-                netconn_write(WS_conn, &len, 1, NETCONN_COPY);
-        }
-
-	//send payload
-	return netconn_write(WS_conn, p_data, length, NETCONN_COPY);
+	if (WS_hubMutex == NULL)
+		return ERR_CONN;
+
+	//never wait long, the UART output must not be stalled by the websocket
+	if (xSemaphoreTake(WS_hubMutex, WS_TX_WAIT) != pdTRUE)
+		return ERR_TIMEOUT;
+
+	uint8_t connected = 0;
+	for (uint8_t i = 0; i < WS_MAX_CLIENTS; i++) {
+		WS_client_t *c = WS_clients[i];
+		if (c == NULL) continue;
+		connected++;
+		if ((c->subscriptions & WS_SUB_OUTPUT) == 0 || length == 0) continue;
+		//queue is full: this client is too slow, drop the message
+		if (xRingbufferSend(c->txq, p_data, length, 0) != pdTRUE)
+			c->txdropped++;
+	}
+	xSemaphoreGive(WS_hubMutex);
+
+	return connected ? ERR_OK : ERR_CONN;
+}
+
+void WS_telemetry_push(const adcTelemetry_t *sample) {
+	//called in ADC task context, don't wait
+	if (WS_hubMutex == NULL || xSemaphoreTake(WS_hubMutex, 0) != pdTRUE)
+		return;
+
+	for (uint8_t i = 0; i < WS_MAX_CLIENTS; i++) {
+		WS_client_t *c = WS_clients[i];
+		if (c == NULL) continue;
+		uint32_t interval = c->telemetry_interval;
+		if (interval == 0 || c->telemetry_q == NULL)
+			continue;
+
+		//decimate to the requested rate
+		if ((int32_t)(sample->timestamp - c->telemetry_next) < 0)
+			continue;
+		c->telemetry_next += interval;
+		//resync if we are more than one interval behind (e.g. rate changed)
+		if ((int32_t)(sample->timestamp - c->telemetry_next) >= 0)
+			c->telemetry_next = sample->timestamp + interval;
+
+		//drop the oldest sample if the client is too slow
+		if (xQueueSend(c->telemetry_q, sample, 0) != pdTRUE) {
+			adcTelemetry_t old;
+			xQueueReceive(c->telemetry_q, &old, 0);
+			c->telemetry_dropped++;
+			xQueueSend(c->telemetry_q, sample, 0);
+		}
+	}
+	xSemaphoreGive(WS_hubMutex);
+}
+
+/** \brief Register/remove the ADC telemetry callback, depending on subscriptions
+ * \note WS_hubMutex must be held */
+static void WS_telemetry_update_stream(void) {
+	for (uint8_t i = 0; i < WS_MAX_CLIENTS; i++) {
+		if (WS_clients[i] != NULL && WS_clients[i]->telemetry_interval != 0) {
+			halAdcSetTelemetryStream(WS_telemetry_push);
+			return;
+		}
+	}
+	halAdcSetTelemetryStream(NULL);
+}
+
+/** \brief Start/stop the telemetry stream of a client
+ * \param c Client
+ * \param rate Samples per second, 0 to stop */
+static void WS_telemetry_set_rate(WS_client_t *c, uint16_t rate) {
+	if (rate > WS_TELEMETRY_MAX_RATE)
+		rate = WS_TELEMETRY_MAX_RATE;
+	if (rate != 0 && c->telemetry_q == NULL)
+		c->telemetry_q = xQueueCreate(WS_TELEMETRY_QUEUE, sizeof(adcTelemetry_t));
+	if (rate != 0 && c->telemetry_q == NULL) {
+		ESP_LOGE("WS","cannot create telemetry queue");
+		return;
+	}
+
+	xSemaphoreTake(WS_hubMutex, portMAX_DELAY);
+	if (rate == 0) {
+		c->telemetry_interval = 0;
+		c->subscriptions &= ~WS_SUB_TELEMETRY;
+		if (c->telemetry_q != NULL)
+			xQueueReset(c->telemetry_q);
+	} else {
+		c->telemetry_dropped = 0;
+		c->telemetry_next = (uint32_t)esp_timer_get_time();
+		c->telemetry_interval = 1000000 / rate;
+		c->subscriptions |= WS_SUB_TELEMETRY;
+		ESP_LOGI("WS","client %d: telemetry with %d Hz", c->slot, rate);
+	}
+	WS_telemetry_update_stream();
+	xSemaphoreGive(WS_hubMutex);
+}
+
+/** \brief Send all queued telemetry samples of a client in one binary frame */
+static err_t WS_telemetry_send(WS_client_t *c) {
+	if (c->telemetry_q == NULL || c->telemetry_interval == 0)
+		return ERR_OK;
+
+	char buf[WS_HDR_MAX_L + WS_TELEMETRY_HDR_L + WS_TELEMETRY_QUEUE * sizeof(adcTelemetry_t)];
+	char *msg = &buf[WS_HDR_MAX_L];
+	uint8_t count = 0;
+	adcTelemetry_t sample;
+	while ((count < WS_TELEMETRY_QUEUE) && (xQueueReceive(c->telemetry_q, &sample, 0) == pdTRUE)) {
+		memcpy(&msg[WS_TELEMETRY_HDR_L + count * sizeof(adcTelemetry_t)], &sample, sizeof(adcTelemetry_t));
+		count++;
+	}
+	if (count == 0)
+		return ERR_OK;
+
+	//header: type, count, send time & dropped samples (little endian)
+	uint32_t now = (uint32_t)esp_timer_get_time();
+	uint16_t dropped = (c->telemetry_dropped > 0xFFFF) ? 0xFFFF : c->telemetry_dropped;
+	msg[0] = WS_BIN_TELEMETRY;
+	msg[1] = count;
+	memcpy(&msg[2], &now, sizeof(now));
+	memcpy(&msg[6], &dropped, sizeof(dropped));
+
+	return WS_write_frame(c, buf, WS_OP_BIN, WS_TELEMETRY_HDR_L + count * sizeof(adcTelemetry_t));
 }
 
+/** \brief Handle an incoming binary message
+ * \param c Client
+ * \param data Unmasked payload
+ * \param length Payload length
+ * \see WS_BIN_TELEMETRY
+ * \see WS_BIN_PING
+ * \see WS_BIN_SUBSCRIBE */
+static void WS_handle_binary(WS_client_t *c, const uint8_t *data, size_t length) {
+	if (length == 0)
+		return;
+	switch (data[0]) {
+		case WS_BIN_TELEMETRY:
+			if (length >= 3)
+				WS_telemetry_set_rate(c, data[1] | (data[2] << 8));
+			break;
+		case WS_BIN_PING:
+			if (length <= WS_BIN_PING_L) {
+				char pong[WS_HDR_MAX_L + WS_BIN_PING_L];
+				memcpy(&pong[WS_HDR_MAX_L], data, length);
+				WS_write_frame(c, pong, WS_OP_BIN, length);
+			}
+			break;
+		case WS_BIN_SUBSCRIBE:
+			if (length >= 2) {
+				if (data[1] & WS_SUB_OUTPUT) c->subscriptions |= WS_SUB_OUTPUT;
+				else c->subscriptions &= ~WS_SUB_OUTPUT;
+				ESP_LOGI("WS","client %d: subscriptions 0x%02X", c->slot, c->subscriptions);
+			}
+			break;
+		default:
+			ESP_LOGW("WS","unknown binary message %d", data[0]);
+			break;
+	}
+}
 
-void ws_server_netconn_serve(struct netconn *conn) {
+/** \brief Send a received text line to the AT command queue
+ * 
+ * If the queue is full, pending output is sent while waiting
+ * (the command task might wait for sending). */
+static void WS_rx_command(WS_client_t *c, const uint8_t *line, size_t length) {
+	//payload will be freed in receiving task
+	atcmd_t incoming;
+	incoming.buf = malloc(length + 1);
+	if (incoming.buf == NULL)
+		return;
+	memcpy(incoming.buf, line, length);
+	incoming.buf[length] = 0;
+	incoming.len = length + 1;
+	uint16_t waited = 0;
+	while (xQueueSend(halSerialATCmds, &incoming, WS_BATCH_WINDOW_MS / portTICK_PERIOD_MS) != pdTRUE) {
+		WS_send_pending(c);
+		waited += WS_BATCH_WINDOW_MS;
+		if (waited >= WS_RX_QUEUE_WAIT_MS) {
+			ESP_LOGE("WS","AT cmd queue is full, cannot send cmd");
+			free(incoming.buf);
+			break;
+		}
+	}
+	ESP_LOGD("WS","Sent incoming command: %.*s", (int) length, line);
+}
+
+/** \brief Callback of the frame parser (lines, binary messages & pings)
+ * \see WS_rx_cb_t */
+static void WS_rx_event(void *ctx, WS_OPCODES opcode, const uint8_t *data, size_t length) {
+	WS_client_t *c = (WS_client_t *) ctx;
+	switch (opcode) {
+		case WS_OP_TXT:
+			WS_rx_command(c, data, length);
+			break;
+		case WS_OP_BIN:
+			WS_handle_binary(c, data, length);
+			break;
+		case WS_OP_PIN: {
+			char pong[WS_HDR_MAX_L + WS_STD_LEN];
+			memcpy(&pong[WS_HDR_MAX_L], data, length);
+			WS_write_frame(c, pong, WS_OP_PON, length);
+			break;
+		}
+		default:
+			break;
+	}
+}
+
+/** \brief Receive the HTTP upgrade request & send the handshake
+ * \return ESP_OK if the websocket is open, ESP_FAIL otherwise */
+static esp_err_t WS_handshake(struct netconn *conn) {
 
 	//Netbuf
-	struct netbuf *inbuf;
+	struct netbuf *inbuf = NULL;
 
 	//message buffer
 	char *buf;
@@ -123,196 +390,211 @@ void ws_server_netconn_serve(struct netconn *conn) {
 	//pointer to buffer (multi purpose)
 	char* p_buf;
 
-	//Pointer to SHA1 input
-	char* p_SHA1_Inp;
-
-	//Pointer to SHA1 result
-	char* p_SHA1_result;
-
 	//multi purpose number buffer
 	uint16_t i;
 
+	//length of the base64 encoded key
+	size_t outlen = 0;
+
 	//will point to payload (send and receive
 	char* p_payload;
 
-	//Frame header pointer
-	WS_frame_header_t* p_frame_hdr;
-
-	//allocate memory for SHA1 input
-	p_SHA1_Inp = malloc(WS_CLIENT_KEY_L + sizeof(WS_sec_conKey));
-
-	//allocate memory for SHA1 result
-	p_SHA1_result = malloc(SHA1_RES_L);
-
-	//Check if malloc suceeded
-	if ((p_SHA1_Inp != NULL) && (p_SHA1_result != NULL)) {
-
-		//receive handshake request
-		if (netconn_recv(conn, &inbuf) == ERR_OK) {
-
-			//read buffer
-			netbuf_data(inbuf, (void**) &buf, &i);
-
-			//write static key into SHA1 Input
-			for (i = 0; i < sizeof(WS_sec_conKey); i++)
-				p_SHA1_Inp[i + WS_CLIENT_KEY_L] = WS_sec_conKey[i];
-
-			//find Client Sec-WebSocket-Key:
-			p_buf = strstr(buf, WS_sec_WS_keys);
-
-			//check if needle "Sec-WebSocket-Key:" was found
-			if (p_buf != NULL) {
-
-				//get Client Key
-				for (i = 0; i < WS_CLIENT_KEY_L; i++)
-					p_SHA1_Inp[i] = *(p_buf + sizeof(WS_sec_WS_keys) + i);
-
-				// calculate hash
-				mbedtls_sha1_ret((unsigned char*) p_SHA1_Inp, strlen(p_SHA1_Inp),
-						(unsigned char*) p_SHA1_result);
-						
-				//length calculation from old base64 wpa utils
-				size_t olen = SHA1_RES_L * 4 / 3 + 4; /* 3-byte blocks to 4-byte */
-				olen += olen / 72; /* line feeds */
-				olen++; /* nul termination */
-				olen++; //just to be sure...
-				//WPA utils did the malloc, mbedTLS requires us to do this
-				p_buf = malloc(olen);
-				//do the base64 stuff
-				if(p_buf != NULL)
-				{
-					size_t outlen;
-					if(mbedtls_base64_encode((unsigned char*)p_buf,olen, \
-						(size_t*) &i, (unsigned char*) p_SHA1_result,SHA1_RES_L) != 0)
-					{
-						ESP_LOGE("WS","Base64: too less memory");
-					}
-				}
-
-				//free SHA1 input
-				free(p_SHA1_Inp);
-
-				//free SHA1 result
-				free(p_SHA1_result);
-
-				//allocate memory for handshake
-				p_payload = malloc(sizeof(WS_srv_hs) + i - WS_SPRINTF_ARG_L);
-
-				//check if malloc suceeded
-				if (p_payload != NULL) {
-
-					//prepare handshake
-					sprintf(p_payload, WS_srv_hs, i - 1, p_buf);
-
-					//send handshake
-                    netconn_write(conn, p_payload, strlen(p_payload),
-							NETCONN_COPY);
-
-					//free base 64 encoded sec key
-					free(p_buf);
-
-					//free handshake memory
-					free(p_payload);
-
-					//set pointer to open WebSocket connection
-					WS_conn = conn;
-
-					//Wait for new data
-					while (netconn_recv(conn, &inbuf) == ERR_OK) {
-
-						//read data from inbuf
-						netbuf_data(inbuf, (void**) &buf, &i);
-
-						//get pointer to header
-						p_frame_hdr = (WS_frame_header_t*) buf;
-
-						//check if clients wants to close the connection
-						if (p_frame_hdr->opcode == WS_OP_CLS)
-							break;
-
-						//get payload length
-                                                uint64_t payloadLen = 0;
-                                                uint8_t offset = 0;
-                                                //determine payload length type.
-                                                //according to RFC6455
-                                                switch(p_frame_hdr->payload_length)
-                                                {
-                                                        //next 2 bytes are used as 16bit payload length
-                                                        case 126:
-                                                                payloadLen = buf[sizeof(WS_frame_header_t)+1];
-                                                                payloadLen += buf[sizeof(WS_frame_header_t)]<<8;
-                                                                ESP_LOGI("WS","16bit payload length: %llu",payloadLen);
-                                                                offset = 2;
-                                                                break;
-                                                        //next 4 bytes are used as 64bit payload length
-                                                        case 127:
-                                                                ESP_LOGE("WS","Error: 64bit length fields not supported (too less memory in ESP32)!");
-                                                                break;
-                                                        //short frames 0-125 bytes
-                                                        default: 
-                                                                payloadLen = p_frame_hdr->payload_length;
-                                                                offset = 0;
-                                                                break;
-                                                }
-
-                                                //get beginning of mask or payload
-                                                p_buf = (char*) &buf[sizeof(WS_frame_header_t)+offset];
-
-                                                //check if content is masked
-                                                if (p_frame_hdr->mask) {
-
-                                                        //allocate memory for decoded message
-                                                        p_payload = malloc(payloadLen + 1);
-
-                                                        //check if malloc succeeded
-                                                        if (p_payload != NULL) {
-
-                                                                //decode playload
-                                                                for (i = 0; i < payloadLen;
-                                                                                i++)
-                                                                        p_payload[i] = (p_buf + WS_MASK_L)[i]
-                                                                                        ^ p_buf[i % WS_MASK_L];
-                                                                                        
-                                                                //add \0 terminator
-                                                                p_payload[payloadLen] = 0;
-                                                        }
-                                                } else {
-                                                        //content is not masked
-                                                        p_payload = p_buf;
-                                                }
-
-                                                //do stuff
-                                                if ((p_payload != NULL)	&& (p_frame_hdr->opcode == WS_OP_TXT)) {
-
-                                                        //save incoming buffer pointer & length to an AT command struct
-                                                        atcmd_t incoming;
-                                                        //payload will be freed in receiving task
-                                                        incoming.buf = (uint8_t *)p_payload;
-                                                        incoming.len = p_frame_hdr->payload_length;
-                                                        
-                                                        //send message
-                                                        ESP_LOGI("websocket","Sent incoming command: %s",p_payload);
-                                                        xQueueSendFromISR(halSerialATCmds,&incoming,0);
-                                                }
-						//free input buffer
-						netbuf_delete(inbuf);
-
-					} //while(netconn_recv(conn, &inbuf)==ERR_OK)
-				} //p_payload!=NULL
-			} //check if needle "Sec-WebSocket-Key:" was found
-		} //receive handshake
-	} //p_SHA1_Inp!=NULL&p_SHA1_result!=NULL
-
-	//release pointer to open WebSocket connection
-	WS_conn = NULL;
+	//result
+	esp_err_t ret = ESP_FAIL;
+
+	//SHA1 input & result
+	char p_SHA1_Inp[WS_CLIENT_KEY_L + sizeof(WS_sec_conKey)];
+	char p_SHA1_result[SHA1_RES_L];
+
+	//receive handshake request
+	if (netconn_recv(conn, &inbuf) != ERR_OK)
+		return ESP_FAIL;
+
+	//read buffer
+	netbuf_data(inbuf, (void**) &buf, &i);
+
+	//write static key into SHA1 Input
+	for (i = 0; i < sizeof(WS_sec_conKey); i++)
+		p_SHA1_Inp[i + WS_CLIENT_KEY_L] = WS_sec_conKey[i];
+
+	//find Client Sec-WebSocket-Key:
+	p_buf = strstr(buf, WS_sec_WS_keys);
+
+	//check if needle "Sec-WebSocket-Key:" was found
+	if (p_buf != NULL) {
+
+		//get Client Key
+		for (i = 0; i < WS_CLIENT_KEY_L; i++)
+			p_SHA1_Inp[i] = *(p_buf + sizeof(WS_sec_WS_keys) + i);
+
+		// calculate hash
+		mbedtls_sha1_ret((unsigned char*) p_SHA1_Inp, strlen(p_SHA1_Inp),
+				(unsigned char*) p_SHA1_result);
+
+		//length calculation from old base64 wpa utils
+		size_t olen = SHA1_RES_L * 4 / 3 + 4; /* 3-byte blocks to 4-byte */
+		olen += olen / 72; /* line feeds */
+		olen++; /* nul termination */
+		olen++; //just to be sure...
+		//WPA utils did the malloc, mbedTLS requires us to do this
+		char p_key[olen];
+		//do the base64 stuff
+		if(mbedtls_base64_encode((unsigned char*)p_key,olen, \
+			&outlen, (unsigned char*) p_SHA1_result,SHA1_RES_L) != 0)
+		{
+			ESP_LOGE("WS","Base64: too less memory");
+		} else {
+			//allocate memory for handshake
+			p_payload = malloc(sizeof(WS_srv_hs) + outlen - WS_SPRINTF_ARG_L);
+
+			//check if malloc suceeded
+			if (p_payload != NULL) {
+
+				//prepare handshake
+				sprintf(p_payload, WS_srv_hs, (int) outlen, p_key);
+
+				//send handshake
+				if (netconn_write(conn, p_payload, strlen(p_payload), NETCONN_COPY) == ERR_OK)
+					ret = ESP_OK;
+
+				//free handshake memory
+				free(p_payload);
+			}
+		}
+	} //check if needle "Sec-WebSocket-Key:" was found
 
 	//delete buffer
 	netbuf_delete(inbuf);
+	return ret;
+}
+
+/** \brief Remove a client from the hub & free it */
+static void WS_client_remove(WS_client_t *c) {
+	xSemaphoreTake(WS_hubMutex, portMAX_DELAY);
+	WS_clients[c->slot] = NULL;
+	c->telemetry_interval = 0;
+	WS_telemetry_update_stream();
+	xSemaphoreGive(WS_hubMutex);
+
+	ESP_LOGI("WS","client %d closed, sent %" PRIu32 " messages in %" PRIu32 " frames, dropped %" PRIu32, \
+		c->slot, c->stat_msgs, c->stat_frames, c->txdropped);
 
 	// Close the connection
-	netconn_close(conn);
+	netconn_close(c->conn);
 
 	//Delete connection
-	netconn_delete(conn);
+	netconn_delete(c->conn);
+
+	if (c->txq != NULL) vRingbufferDelete(c->txq);
+	if (c->telemetry_q != NULL) vQueueDelete(c->telemetry_q);
+	free(c);
+}
 
-} 
+/** \brief Task serving one websocket client */
+static void WS_client_task(void *pvParameters) {
+	WS_client_t *c = (WS_client_t *) pvParameters;
+	struct netbuf *inbuf = NULL;
+
+	if (WS_handshake(c->conn) == ESP_OK) {
+		//wake up regularly to send pending messages
+		netconn_set_recvtimeout(c->conn, WS_BATCH_WINDOW_MS);
+
+		//Wait for new data
+		while (c->closing == 0) {
+			err_t recvresult = netconn_recv(c->conn, &inbuf);
+			if (recvresult == ERR_OK) {
+				//feed all parts of this netbuf to the frame parser
+				esp_err_t parsed = ESP_OK;
+				void *data;
+				u16_t datalen;
+				netbuf_first(inbuf);
+				do {
+					netbuf_data(inbuf, &data, &datalen);
+					parsed = WS_rx_parse(&c->rx, (uint8_t *) data, datalen);
+				} while ((parsed == ESP_OK) && (netbuf_next(inbuf) >= 0));
+
+				//free input buffer
+				netbuf_delete(inbuf);
+				inbuf = NULL;
+
+				//close requested by client or protocol error
+				if (parsed != ESP_OK)
+					break;
+			} else if (recvresult != ERR_TIMEOUT) {
+				break;
+			}
+
+			//send queued output & telemetry of this client
+			if (WS_send_pending(c) != ERR_OK || WS_telemetry_send(c) != ERR_OK)
+				break;
+		}
+
+		//answer a close request
+		if (c->rx.closed) {
+			char cls[WS_HDR_MAX_L];
+			WS_write_frame(c, cls, WS_OP_CLS, 0);
+		}
+	}
+
+	WS_client_remove(c);
+	vTaskDelete(NULL);
+}
+
+esp_err_t WS_client_add(struct netconn *conn) {
+	if (WS_hubMutex == NULL)
+		WS_hubMutex = xSemaphoreCreateMutex();
+	if (WS_hubMutex == NULL)
+		return ESP_FAIL;
+
+	WS_client_t *c = calloc(1, sizeof(WS_client_t));
+	if (c == NULL) {
+		ESP_LOGE("WS","no memory for client");
+		return ESP_FAIL;
+	}
+	c->conn = conn;
+	c->subscriptions = WS_SUB_OUTPUT;
+	WS_rx_init(&c->rx, WS_rx_event, c);
+	c->txq = xRingbufferCreate(WS_CLIENT_TXQ_SIZE, RINGBUF_TYPE_NOSPLIT);
+	if (c->txq == NULL) {
+		ESP_LOGE("WS","no memory for client queue");
+		free(c);
+		return ESP_FAIL;
+	}
+
+	//find a free slot
+	xSemaphoreTake(WS_hubMutex, portMAX_DELAY);
+	for (c->slot = 0; c->slot < WS_MAX_CLIENTS; c->slot++) {
+		if (WS_clients[c->slot] == NULL) break;
+	}
+	if (c->slot == WS_MAX_CLIENTS) {
+		xSemaphoreGive(WS_hubMutex);
+		ESP_LOGW("WS","no free client slot");
+		vRingbufferDelete(c->txq);
+		free(c);
+		return ESP_FAIL;
+	}
+	WS_clients[c->slot] = c;
+	xSemaphoreGive(WS_hubMutex);
+
+	if (xTaskCreatePinnedToCore(WS_client_task, "ws_client", WS_CLIENT_STACKSIZE, c, WS_CLIENT_PRIORITY, &c->task, TASK_CORE_SYSTEM) != pdPASS) {
+		ESP_LOGE("WS","cannot create client task");
+		xSemaphoreTake(WS_hubMutex, portMAX_DELAY);
+		WS_clients[c->slot] = NULL;
+		xSemaphoreGive(WS_hubMutex);
+		vRingbufferDelete(c->txq);
+		free(c);
+		return ESP_FAIL;
+	}
+	ESP_LOGI("WS","client %d connected", c->slot);
+	return ESP_OK;
+}
+
+void WS_close_all(void) {
+	if (WS_hubMutex == NULL)
+		return;
+	xSemaphoreTake(WS_hubMutex, portMAX_DELAY);
+	for (uint8_t i = 0; i < WS_MAX_CLIENTS; i++) {
+		if (WS_clients[i] != NULL) WS_clients[i]->closing = 1;
+	}
+	xSemaphoreGive(WS_hubMutex);
+}
@@ -59,15 +59,64 @@
 #include <freertos/event_groups.h>
 #include <freertos/queue.h>
 #include <freertos/task.h>
+#include <freertos/semphr.h>
+#include <freertos/ringbuf.h>
 #include <esp_log.h>
+#include "esp_timer.h"
 //common definitions & data for all of these functional tasks
 #include "common.h"
 //command structs & queues are declared there
 #include "hal_serial.h"
+//sensor samples for binary telemetry
+#include "hal_adc.h"
 #include <inttypes.h>
+//frame parser, opcodes & WS_MASK_L
+#include "ws_rx.h"
 
 
-#define WS_MASK_L		0x4		/**< \brief Length of MASK field in WebSocket Header*/
+/** \brief Count of websocket clients which can be connected at the same time */
+#define WS_MAX_CLIENTS		3
+/** \brief Stack size for each client task */
+#define WS_CLIENT_STACKSIZE	4096
+/** \brief Priority of the client tasks */
+#define WS_CLIENT_PRIORITY	5
+/** \brief Size of the outbound queue of each client [bytes], messages are dropped if full */
+#define WS_CLIENT_TXQ_SIZE	2048
+
+/** \brief Maximum size of coalesced outbound messages (one frame)
+ * 
+ * Small messages (lines) are collected and sent as one text frame,
+ * separated by '\n'. Larger messages are sent as their own frame. */
+#define WS_BATCH_SIZE		512
+/** \brief Maximum time [ms] a message is held back for coalescing */
+#define WS_BATCH_WINDOW_MS	10
+/** \brief Maximum ticks to wait for the client list */
+#define WS_TX_WAIT			20
+
+/** \brief Subscription: serial output (command responses) as text frames, default on */
+#define WS_SUB_OUTPUT		0x01
+/** \brief Subscription: sensor telemetry, set by WS_BIN_TELEMETRY */
+#define WS_SUB_TELEMETRY	0x02
+
+/** \brief Binary message type: sensor telemetry
+ * 
+ * Client -> device: [0x01][rate (uint16, Hz)], rate 0 stops the stream.<br>
+ * Device -> client: [0x01][count][send time (uint32, us)][dropped (uint16)]
+ * followed by count adcTelemetry_t samples. All values little endian.
+ * \see adcTelemetry_t */
+#define WS_BIN_TELEMETRY	0x01
+/** \brief Binary message type: ping, the message (max. WS_BIN_PING_L bytes) is sent back */
+#define WS_BIN_PING			0x02
+/** \brief Maximum length of a binary ping message */
+#define WS_BIN_PING_L		16
+/** \brief Binary message type: subscriptions, [0x03][WS_SUB_OUTPUT or 0] */
+#define WS_BIN_SUBSCRIBE	0x03
+/** \brief Queued telemetry samples, the oldest one is dropped if full */
+#define WS_TELEMETRY_QUEUE	16
+/** \brief Maximum telemetry rate [Hz] (ADC task runs with 100Hz) */
+#define WS_TELEMETRY_MAX_RATE	100
+/** \brief Maximum time [ms] to wait for space in the AT command queue */
+#define WS_RX_QUEUE_WAIT_MS	1000
 
 
 /** \brief Websocket frame header type*/
@@ -89,7 +138,39 @@ typedef struct{
 
 
 
-void ws_server_netconn_serve(struct netconn *conn);
+/** \brief Add a new websocket connection to the hub
+ * 
+ * A task is created for this client, which does the handshake and
+ * serves the connection until it is closed.
+ * \param conn Accepted connection
+ * \return ESP_OK if the client is added, ESP_FAIL if all WS_MAX_CLIENTS
+ * slots are used or no memory is available (conn is not closed)*/
+esp_err_t WS_client_add(struct netconn *conn);
+
+/** \brief Close all websocket clients (e.g. wifi is disabled)
+ * \note The connections are closed by the client tasks within WS_BATCH_WINDOW_MS */
+void WS_close_all(void);
+
+/** \brief Send a text message to all websocket clients
+ * 
+ * The message is copied to the queue of each client which subscribed
+ * to WS_SUB_OUTPUT, it never waits for a client. If a client's queue
+ * is full, the message is dropped for this client.
+ * The client tasks coalesce queued messages into as few frames as possible.
+ * Live values (VALUES:...) are sent in their own frame,
+ * because the GUI handles them per message.
+ * \param p_data Message (no line ending)
+ * \param length Length of the message
+ * \return ERR_OK (ESP_OK) if a client is connected, lwIP error otherwise */
 esp_err_t WS_write_data(char* p_data, size_t length);
 
+/** \brief Queue one sensor sample for the binary telemetry stream
+ * 
+ * Registered via halAdcSetTelemetryStream while any client is subscribed.
+ * Samples are decimated to each client's requested rate, if a client's
+ * queue is full the oldest sample is dropped.
+ * \param sample Sensor sample
+ * \see WS_BIN_TELEMETRY */
+void WS_telemetry_push(const adcTelemetry_t *sample);
+
 #endif  /*_WEBSOCKET_H_*/
@@ -0,0 +1,203 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ * Copyright 2019 Benjamin Aigner <aignerb@technikum-wien.at,
+ * beni@asterics-foundation.org>
+ */
+/** @file
+ * @brief Incremental parser for received websocket frames
+ *
+ * The frame header is collected first (2 to 14 bytes), afterwards the
+ * payload is unmasked & processed without buffering the whole frame.
+ * Control frames may be sent between the fragments of a message.
+ *
+ * @see ws_rx.h
+ **/
+
+#include "ws_rx.h"
+
+#define LOG_TAG "ws_rx"
+
+/** \brief Initialize the parser, the next byte is the start of a frame
+ * \param rx Receive state
+ * \param cb Callback for lines, binary messages & pings
+ * \param ctx Context pointer for cb */
+void WS_rx_init(WS_rx_t *rx, WS_rx_cb_t cb, void *ctx) {
+	memset(rx, 0, sizeof(WS_rx_t));
+	rx->hdrneed = 2;
+	rx->cb = cb;
+	rx->ctx = ctx;
+}
+
+/** \brief Pass a received text line to the callback */
+static void WS_rx_line(WS_rx_t *rx) {
+	if (rx->overflow) {
+		ESP_LOGW(LOG_TAG,"AT cmd too long, discarding");
+	} else if (rx->linelen > 0) {
+		rx->cb(rx->ctx, WS_OP_TXT, rx->line, rx->linelen);
+	}
+	rx->linelen = 0;
+	rx->overflow = 0;
+}
+
+/** \brief Evaluate a complete frame header
+ * \return ESP_OK if valid, ESP_FAIL on a protocol error */
+static esp_err_t WS_rx_frame_start(WS_rx_t *rx) {
+	uint8_t pos = 2;
+	uint8_t length = rx->hdr[1] & 0x7F;
+
+	rx->opcode = rx->hdr[0] & 0x0F;
+	rx->fin = rx->hdr[0] >> 7;
+	if (length == 126) {
+		rx->remaining = (rx->hdr[2] << 8) | rx->hdr[3];
+		pos = 4;
+	} else if (length == 127) {
+		rx->remaining = 0;
+		for (pos = 2; pos < 10; pos++)
+			rx->remaining = (rx->remaining << 8) | rx->hdr[pos];
+	} else {
+		rx->remaining = length;
+	}
+	if (rx->hdr[1] & 0x80)
+		memcpy(rx->mask, &rx->hdr[pos], WS_MASK_L);
+	else
+		memset(rx->mask, 0, WS_MASK_L);
+	rx->maskpos = 0;
+
+	//control frames: max. 125 bytes, not fragmented
+	if (rx->opcode & 0x08) {
+		rx->ctrllen = 0;
+		if (rx->opcode != WS_OP_CLS && rx->opcode != WS_OP_PIN && rx->opcode != WS_OP_PON) {
+			ESP_LOGE(LOG_TAG,"unknown opcode %d", rx->opcode);
+			return ESP_FAIL;
+		}
+		if (rx->remaining > WS_STD_LEN || rx->fin == 0) {
+			ESP_LOGE(LOG_TAG,"invalid control frame");
+			return ESP_FAIL;
+		}
+		return ESP_OK;
+	}
+	if (rx->opcode == WS_OP_CON) {
+		if (rx->msgopcode == 0) {
+			ESP_LOGE(LOG_TAG,"continuation without message");
+			return ESP_FAIL;
+		}
+		return ESP_OK;
+	}
+	if (rx->opcode != WS_OP_TXT && rx->opcode != WS_OP_BIN) {
+		ESP_LOGE(LOG_TAG,"unknown opcode %d", rx->opcode);
+		return ESP_FAIL;
+	}
+	if (rx->msgopcode != 0) {
+		ESP_LOGE(LOG_TAG,"new message before previous one is finished");
+		return ESP_FAIL;
+	}
+	rx->msgopcode = rx->opcode;
+	rx->binlen = 0;
+	return ESP_OK;
+}
+
+/** \brief Process one unmasked payload byte of the current frame */
+static void WS_rx_payload(WS_rx_t *rx, uint8_t data) {
+	if (rx->opcode & 0x08) {
+		rx->ctrl[rx->ctrllen++] = data;
+	} else if (rx->msgopcode == WS_OP_TXT) {
+		//each line is one AT command
+		if (data == '\r' || data == '\n') {
+			WS_rx_line(rx);
+		} else if (rx->linelen < ATCMD_LENGTH - 1) {
+			rx->line[rx->linelen++] = data;
+		} else {
+			rx->overflow = 1;
+		}
+	} else if (rx->binlen < WS_RX_BIN_L) {
+		rx->bin[rx->binlen++] = data;
+	}
+}
+
+/** \brief Current frame is complete
+ * \return ESP_OK, ESP_FAIL if the connection should be closed */
+static esp_err_t WS_rx_frame_end(WS_rx_t *rx) {
+	//next: header of the following frame
+	rx->hdrlen = 0;
+	rx->hdrneed = 2;
+
+	switch (rx->opcode) {
+		case WS_OP_CLS:
+			rx->closed = 1;
+			return ESP_FAIL;
+		case WS_OP_PIN:
+			rx->cb(rx->ctx, WS_OP_PIN, rx->ctrl, rx->ctrllen);
+			return ESP_OK;
+		case WS_OP_PON:
+			return ESP_OK;
+		default:
+			break;
+	}
+
+	//end of a data message
+	if (rx->fin) {
+		//a message without line ending is a complete command
+		if (rx->msgopcode == WS_OP_TXT)
+			WS_rx_line(rx);
+		else
+			rx->cb(rx->ctx, WS_OP_BIN, rx->bin, rx->binlen);
+		rx->msgopcode = 0;
+	}
+	return ESP_OK;
+}
+
+/** \brief Parse received bytes, might contain any part of one or more frames
+ * \param rx Receive state
+ * \param data Received bytes
+ * \param len Count of received bytes
+ * \return ESP_OK, ESP_FAIL if the connection should be closed
+ * (rx->closed is set if the client sent a close frame, otherwise it is a
+ * protocol error) */
+esp_err_t WS_rx_parse(WS_rx_t *rx, const uint8_t *data, size_t len) {
+	while (len > 0) {
+		//collect the frame header
+		if (rx->hdrlen < rx->hdrneed) {
+			rx->hdr[rx->hdrlen++] = *data++;
+			len--;
+			//now the complete header length is known
+			if (rx->hdrlen == 2) {
+				uint8_t length = rx->hdr[1] & 0x7F;
+				rx->hdrneed = 2 + ((length == 126) ? 2 : ((length == 127) ? 8 : 0));
+				if (rx->hdr[1] & 0x80)
+					rx->hdrneed += WS_MASK_L;
+			}
+			if (rx->hdrlen == rx->hdrneed) {
+				if (WS_rx_frame_start(rx) != ESP_OK)
+					return ESP_FAIL;
+				if (rx->remaining == 0 && WS_rx_frame_end(rx) != ESP_OK)
+					return ESP_FAIL;
+			}
+			continue;
+		}
+
+		//payload of the current frame
+		size_t chunk = (len < rx->remaining) ? len : (size_t) rx->remaining;
+		for (size_t i = 0; i < chunk; i++)
+			WS_rx_payload(rx, data[i] ^ rx->mask[rx->maskpos++ % WS_MASK_L]);
+		data += chunk;
+		len -= chunk;
+		rx->remaining -= chunk;
+		if (rx->remaining == 0 && WS_rx_frame_end(rx) != ESP_OK)
+			return ESP_FAIL;
+	}
+	return ESP_OK;
+}
@@ -0,0 +1,109 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ * Copyright 2019 Benjamin Aigner <aignerb@technikum-wien.at,
+ * beni@asterics-foundation.org>
+ */
+/** @file
+ * @brief Incremental parser for received websocket frames
+ *
+ * Frames are parsed byte by byte as they arrive, therefore frames can
+ * be split across TCP segments, several frames can be in one segment
+ * and messages can be fragmented (continuation frames, RFC 6455).
+ * Text messages are split into lines (each one is an AT command),
+ * binary messages are collected up to WS_RX_BIN_L bytes. Both and
+ * received pings are passed to a callback.
+ *
+ * @note This module has no dependencies to FreeRTOS or lwIP, it is
+ * tested on a host (test/test_ws_parser.c).
+ * @see websocket.c
+ **/
+
+#ifndef _WS_RX_H_
+#define _WS_RX_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "esp_err.h"
+#include "esp_log.h"
+//ATCMD_LENGTH is defined here
+#include "common.h"
+
+#define WS_MASK_L		0x4		/**< \brief Length of MASK field in WebSocket Header*/
+#define WS_STD_LEN		125		/**< \brief Maximum Length of standard length frames*/
+/** \brief Maximum length of incoming binary messages, longer ones are truncated */
+#define WS_RX_BIN_L		32
+
+/** \brief Opcode according to RFC 6455*/
+typedef enum {
+	WS_OP_CON = 0x0, 				/*!< Continuation Frame*/
+	WS_OP_TXT = 0x1, 				/*!< Text Frame*/
+	WS_OP_BIN = 0x2, 				/*!< Binary Frame*/
+	WS_OP_CLS = 0x8, 				/*!< Connection Close Frame*/
+	WS_OP_PIN = 0x9, 				/*!< Ping Frame*/
+	WS_OP_PON = 0xa 				/*!< Pong Frame*/
+} WS_OPCODES;
+
+/** \brief Callback for received data
+ * \param ctx Context pointer, given to WS_rx_init
+ * \param opcode WS_OP_TXT: one text line (without line ending),<br>
+ * WS_OP_BIN: a complete binary message (truncated to WS_RX_BIN_L),<br>
+ * WS_OP_PIN: payload of a ping, which should be answered by a pong
+ * \param data Unmasked data, only valid during the call
+ * \param length Length of data */
+typedef void (*WS_rx_cb_t)(void *ctx, WS_OPCODES opcode, const uint8_t *data, size_t length);
+
+/** \brief Receive state of the incremental frame parser
+ * \see WS_rx_init */
+typedef struct {
+	uint8_t hdr[14];			/**< \brief Header of the current frame*/
+	uint8_t hdrlen;				/**< \brief Received header bytes*/
+	uint8_t hdrneed;			/**< \brief Header length (known after 2 bytes)*/
+	uint8_t opcode;				/**< \brief Opcode of the current frame*/
+	uint8_t fin;				/**< \brief FIN flag of the current frame*/
+	uint64_t remaining;			/**< \brief Remaining payload bytes of the current frame*/
+	uint8_t mask[WS_MASK_L];	/**< \brief Masking key of the current frame*/
+	uint8_t maskpos;			/**< \brief Position in the masking key*/
+	uint8_t msgopcode;			/**< \brief Opcode of the current data message, 0 if none*/
+	uint8_t closed;				/**< \brief Set if the client sent a close frame*/
+	uint8_t line[ATCMD_LENGTH];	/**< \brief Current text line*/
+	uint16_t linelen;			/**< \brief Length of the current line*/
+	uint8_t overflow;			/**< \brief Set if the current line is too long*/
+	uint8_t ctrl[WS_STD_LEN];	/**< \brief Payload of the current control frame*/
+	uint8_t ctrllen;			/**< \brief Length of ctrl*/
+	uint8_t bin[WS_RX_BIN_L];	/**< \brief Current binary message*/
+	uint8_t binlen;				/**< \brief Length of bin*/
+	WS_rx_cb_t cb;				/**< \brief Callback for lines, binary messages & pings*/
+	void *ctx;					/**< \brief Context pointer for cb*/
+} WS_rx_t;
+
+/** \brief Initialize the parser, the next byte is the start of a frame
+ * \param rx Receive state
+ * \param cb Callback for lines, binary messages & pings
+ * \param ctx Context pointer for cb */
+void WS_rx_init(WS_rx_t *rx, WS_rx_cb_t cb, void *ctx);
+
+/** \brief Parse received bytes, might contain any part of one or more frames
+ * \param rx Receive state
+ * \param data Received bytes
+ * \param len Count of received bytes
+ * \return ESP_OK, ESP_FAIL if the connection should be closed
+ * (rx->closed is set if the client sent a close frame, otherwise it is a
+ * protocol error) */
+esp_err_t WS_rx_parse(WS_rx_t *rx, const uint8_t *data, size_t len);
+
+#endif /* _WS_RX_H_ */
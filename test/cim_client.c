@@ -0,0 +1,200 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ * Copyright 2019 Benjamin Aigner <aignerb@technikum-wien.at,
+ * beni@asterics-foundation.org>
+ */
+/** @file
+ * @brief HOST TOOL - minimal CIM client (same requests as the ARE)
+ *
+ * Usage: cim_client <tty> [period ms] [seconds]
+ *
+ * Requests the feature list, sets the report period, starts the
+ * sensor reports and counts the received frames. On exit, the reports
+ * are stopped and frames/s, serial gaps, resync bytes & the CPU load
+ * of this client are printed.
+ * Works with a FLipMouse on the USB serial port (115200 baud) or with
+ * the device simulation of test_cim_packet (make bench).
+ * @see task_cim.h
+ **/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <termios.h>
+#include <time.h>
+#include <sys/resource.h>
+#include "cim_packet.h"
+
+/* Feature addresses as used by the ARE plugin, see task_cim.h.
+ * task_cim.h itself needs FreeRTOS & cannot be included on the host. */
+/** @brief Feature: report period */
+#define CIM_FEATURE_PERIOD 0x0001
+/** @brief Feature: sensor frame (periodic events) */
+#define CIM_FEATURE_SENSORS 0x0002
+/** @brief Default report period [ms] */
+#define CIM_PERIOD_DEFAULT 20
+
+/** @brief Receive state of the client */
+typedef struct cim_stream {
+  int fd;
+  uint8_t buf[1024];
+  int have;
+  /** Bytes skipped to find the next header */
+  long resync;
+} cim_stream_t;
+
+static double now(void)
+{
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static double cputime(void)
+{
+  struct rusage ru;
+  getrusage(RUSAGE_SELF, &ru);
+  return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec * 1e-6 + \
+    ru.ru_stime.tv_sec + ru.ru_stime.tv_usec * 1e-6;
+}
+
+static int cim_send(int fd, uint8_t serial, uint16_t feature, uint16_t code,
+  const void *data, uint16_t length)
+{
+  uint8_t b[CIM_MAX_PACKET_LENGTH];
+  uint32_t n = cim_packet_build(b, sizeof(b), serial, feature, code, data, length);
+  return (n != 0 && write(fd, b, n) == (ssize_t)n) ? 0 : -1;
+}
+
+/** @brief Receive the next packet
+ * @param s Stream
+ * @param p Parsed packet, data points into out
+ * @param out Buffer for the packet (CIM_MAX_PACKET_LENGTH)
+ * @param timeout_ms Timeout
+ * @return 0 on success, -1 on a timeout or a closed tty */
+static int cim_receive(cim_stream_t *s, cim_packet_t *p, uint8_t *out, int timeout_ms)
+{
+  double end = now() + timeout_ms / 1000.0;
+  while(1)
+  {
+    //parse buffered bytes first
+    while(s->have >= CIM_HEADER_LENGTH)
+    {
+      int32_t len = cim_packet_datalength(s->buf);
+      if(len < 0)
+      {
+        memmove(s->buf, s->buf + 1, --s->have);
+        s->resync++;
+        continue;
+      }
+      if(s->have < CIM_HEADER_LENGTH + len) break;
+      memcpy(out, s->buf, CIM_HEADER_LENGTH + len);
+      s->have -= CIM_HEADER_LENGTH + len;
+      memmove(s->buf, s->buf + CIM_HEADER_LENGTH + len, s->have);
+      if(cim_packet_parse(out, CIM_HEADER_LENGTH + len, p) == 0) return 0;
+    }
+    int left = (int)((end - now()) * 1000);
+    if(left <= 0) return -1;
+    struct pollfd pfd = { s->fd, POLLIN, 0 };
+    if(poll(&pfd, 1, left) <= 0) return -1;
+    int r = read(s->fd, s->buf + s->have, sizeof(s->buf) - s->have);
+    if(r <= 0) return -1;
+    s->have += r;
+  }
+}
+
+/** @brief Send a request & wait for its reply (events are skipped) */
+static int cim_request(cim_stream_t *s, uint8_t serial, uint16_t feature,
+  uint16_t code, const void *data, uint16_t length, cim_packet_t *reply, uint8_t *out)
+{
+  if(cim_send(s->fd, serial, feature, code, data, length) != 0) return -1;
+  while(cim_receive(s, reply, out, 1000) == 0)
+  {
+    if(reply->code == CIM_REPLY_EVENT || reply->serial != serial) continue;
+    if((reply->code & 0xFF) != code) return -1;
+    return (reply->code & 0xFF00) ? -1 : 0;
+  }
+  return -1;
+}
+
+int main(int argc, char **argv)
+{
+  if(argc < 2)
+  {
+    fprintf(stderr, "usage: %s <tty> [period ms] [seconds]\n", argv[0]);
+    return 2;
+  }
+  uint16_t period = argc > 2 ? atoi(argv[2]) : CIM_PERIOD_DEFAULT;
+  int secs = argc > 3 ? atoi(argv[3]) : 3;
+
+  cim_stream_t s = { 0 };
+  s.fd = open(argv[1], O_RDWR | O_NOCTTY);
+  if(s.fd < 0) { perror(argv[1]); return 1; }
+  struct termios t;
+  if(tcgetattr(s.fd, &t) == 0)
+  {
+    cfmakeraw(&t);
+    cfsetspeed(&t, B115200);
+    tcsetattr(s.fd, TCSANOW, &t);
+  }
+
+  cim_packet_t p;
+  uint8_t out[CIM_MAX_PACKET_LENGTH];
+  uint8_t serial = 0;
+
+  if(cim_request(&s, serial++, 0, CIM_CMD_FEATURELIST, NULL, 0, &p, out) != 0 || p.length < 2)
+  {
+    fprintf(stderr, "no feature list\n");
+    return 1;
+  }
+  printf("CIM ID 0x%04X, features:", p.data[0] | (p.data[1] << 8));
+  for(int i = 2; i + 1 < p.length; i += 2) printf(" 0x%04X", p.data[i] | (p.data[i+1] << 8));
+  printf("\n");
+
+  uint8_t per[2] = { period & 0xFF, period >> 8 };
+  if(cim_request(&s, serial++, CIM_FEATURE_PERIOD, CIM_CMD_WRITE, per, 2, &p, out) != 0 || \
+    cim_request(&s, serial++, 0, CIM_CMD_START, NULL, 0, &p, out) != 0)
+  {
+    fprintf(stderr, "cannot start reports\n");
+    return 1;
+  }
+
+  long frames = 0, gaps = 0;
+  int first = 1;
+  uint8_t last = 0;
+  double t0 = now(), c0 = cputime();
+  while(now() - t0 < secs)
+  {
+    if(cim_receive(&s, &p, out, 1000) != 0) break;
+    if(p.code != CIM_REPLY_EVENT || p.feature != CIM_FEATURE_SENSORS) continue;
+    if(!first && (uint8_t)(last + 1) != p.serial) gaps++;
+    first = 0;
+    last = p.serial;
+    frames++;
+  }
+  double el = now() - t0, cpu = cputime() - c0;
+  cim_request(&s, serial++, 0, CIM_CMD_STOP, NULL, 0, &p, out);
+
+  printf("client: %ld frames in %.2fs = %.1f frames/s (period %d ms), gaps %ld, resync bytes %ld, cpu %.3f%%\n", \
+    frames, el, frames / el, period, gaps, s.resync, 100 * cpu / el);
+  close(s.fd);
+  return frames > 0 ? 0 : 1;
+}
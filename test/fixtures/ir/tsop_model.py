@@ -0,0 +1,246 @@
+#!/usr/bin/env python3
+#
+# Creates the IR capture fixtures in this directory.
+#
+# Each capture is written in the format of the FLipMouse hex dump
+# (fct_infrared_record with serial output): one rmt_item32_t per line
+# as %08X, level 1 is a mark (already inverted by the receive task).
+# A header comment holds the expected decoding ("# expect: ...").
+#
+# The waveforms are built from the protocol specifications (not from
+# infrared_protocols.c) and passed through a model of a TSOP38238
+# receiver sampled by the RMT (800kHz, 1.25us ticks):
+#  * marks are quantized to whole 38kHz carrier periods,
+#  * marks are extended by the receiver delay (per capture 40-110us),
+#    the following space is shortened by the same amount,
+#  * +-1 carrier period of jitter on every edge,
+#  * a space longer than the RMT idle threshold ends a ringbuffer item
+#    (duration 0), the recording ends with the last mark.
+# Dumps recorded with a device can be added in the same format.
+#
+# Usage: python3 tsop_model.py   (rewrites the *.txt fixtures)
+
+import random
+
+TICK_US = 1.25
+CARRIER_US = 1e6 / 38000
+# irtimeout 20ms, truncated to the 16bit RMT idle register
+IDLE_US = ((20 * 1000 * 8) & 0xFFFF) * TICK_US
+MAX_TICKS = 32767
+
+
+def nec_bits(data, nbits):
+    out = []
+    for i in range(nbits):
+        out += [(1, 560), (0, 1690 if data >> i & 1 else 560)]
+    return out
+
+
+def nec(address, command):
+    data = address | command << 16 | (~command & 0xFF) << 24
+    return [(1, 9000), (0, 4500)] + nec_bits(data, 32) + [(1, 560)]
+
+
+def samsung(address, command):
+    data = address | command << 16 | (~command & 0xFF) << 24
+    return [(1, 4500), (0, 4500)] + nec_bits(data, 32) + [(1, 560)]
+
+
+def sirc(address, command, bits, frames=3):
+    data = command & 0x7F | address << 7
+    out = []
+    for f in range(frames):
+        frame = [(1, 2400), (0, 600)]
+        for i in range(bits):
+            frame += [(1, 1200 if data >> i & 1 else 600), (0, 600)]
+        length = sum(d for _, d in frame[:-1])
+        if f:
+            out.append((0, 45000 - prev))
+        out += frame[:-1]
+        prev = length
+    return out
+
+
+def biphase(first, t):
+    return [(first, t), (first ^ 1, t)]
+
+
+def rc5(address, command, toggle):
+    data = 1 << 13 | ((command >> 6 & 1) ^ 1) << 12 | toggle << 11 | \
+        (address & 0x1F) << 6 | command & 0x3F
+    out = []
+    for j in range(13, -1, -1):
+        out += biphase((data >> j & 1) ^ 1, 889)
+    return out
+
+
+def rc6(address, command, toggle):
+    data = address << 8 | command
+    out = [(1, 2666), (0, 889)] + biphase(1, 444)
+    for _ in range(3):
+        out += biphase(0, 444)
+    out += biphase(toggle, 889)
+    for j in range(15, -1, -1):
+        out += biphase(data >> j & 1, 444)
+    return out
+
+
+def pulse_distance(header, data, nbits, mark, zero, one):
+    """Generic pulse distance frame, LSB first, data is a list of bytes"""
+    out = list(header)
+    for i in range(nbits):
+        bit = data[i // 8] >> (i % 8) & 1
+        out += [(1, mark), (0, one if bit else zero)]
+    return out + [(1, mark)]
+
+
+def jvc(address, command):
+    data = [address, command]
+    return pulse_distance([(1, 8400), (0, 4200)], data, 16, 526, 526, 1578)
+
+
+def kaseikyo(data):
+    return pulse_distance([(1, 3456), (0, 1728)], data, 48, 432, 432, 1296)
+
+
+def ac_frames(frames, header, gap):
+    """Air condition remote: several long frames, separated by gap"""
+    out = []
+    for i, data in enumerate(frames):
+        if i:
+            out.append((0, gap))
+        out += pulse_distance(header, data, len(data) * 8, 430, 430, 1290)
+    return out
+
+
+def daikin():
+    rnd = random.Random(100)
+    frames = [[0x11, 0xDA, 0x27, 0x00, 0xC5, 0x00, 0x00, 0xD7],
+              [0x11, 0xDA, 0x27, 0x00, 0x42, 0x49, 0x05, 0xA2],
+              [0x11, 0xDA, 0x27, 0x00, 0x00] + [rnd.randrange(256) for _ in range(14)]]
+    preamble = []
+    for _ in range(5):
+        preamble += [(1, 430), (0, 430)]
+    preamble += [(1, 430), (0, 25000)]
+    return preamble + ac_frames(frames, [(1, 3440), (0, 1720)], 35000)
+
+
+def ac_long():
+    rnd = random.Random(200)
+    frames = [[0x01, 0x10, 0x30, 0x40, 0xBF] + [rnd.randrange(256) for _ in range(57)],
+              [0x01, 0x10, 0x30, 0x40, 0xBF] + [rnd.randrange(256) for _ in range(57)]]
+    return ac_frames(frames, [(1, 3300), (0, 1700)], 10000)
+
+
+def noisy(pulses, seed):
+    """Ambient light (CFL, sunlight): short spurious marks in spaces"""
+    rnd = random.Random(seed)
+    out = []
+    for level, us in pulses:
+        if level == 0 and us > 400 and rnd.random() < 0.3:
+            a = rnd.uniform(50, us - 250)
+            g = rnd.uniform(30, 200)
+            out += [(0, a), (1, g), (0, us - a - g)]
+        else:
+            out.append((level, us))
+    return out
+
+
+def merge(pulses):
+    """Merge neighbouring pulses with the same level, drop leading/trailing spaces"""
+    out = []
+    for level, us in pulses:
+        if out and out[-1][0] == level:
+            out[-1] = (level, out[-1][1] + us)
+        else:
+            out.append((level, us))
+    while out and out[0][0] == 0:
+        out.pop(0)
+    while out and out[-1][0] == 0:
+        out.pop()
+    return out
+
+
+def tsop(pulses, seed):
+    """Receiver & RMT model, returns (level0, ticks0, level1, ticks1) items"""
+    rnd = random.Random(seed)
+    skew = rnd.uniform(40, 110)
+    halves = []
+    carry = 0.0
+    for level, us in merge(pulses):
+        if level == 1:
+            n = max(1, round(us / CARRIER_US))
+            out = n * CARRIER_US + skew + rnd.uniform(-CARRIER_US, CARRIER_US)
+            carry = out - us
+        else:
+            out = us - carry
+            carry = 0.0
+        if level == 0 and out >= IDLE_US:
+            # end of a ringbuffer item, the space is not recorded
+            halves.append((0, 0))
+            continue
+        ticks = int(round(out / TICK_US))
+        while ticks > 0:
+            halves.append((level, min(ticks, MAX_TICKS)))
+            ticks -= MAX_TICKS
+    # RMT item pairs, the last one is terminated by a duration of 0
+    items = []
+    i = 0
+    while i < len(halves):
+        h0 = halves[i]
+        h1 = halves[i + 1] if i + 1 < len(halves) else (0, 0)
+        if h0[1] == 0:
+            i += 1
+            continue
+        if h1[1] == 0 and i + 1 < len(halves):
+            items.append((h0[0], h0[1], 0, 0))
+            i += 2
+            continue
+        items.append((h0[0], h0[1], h1[0], h1[1]))
+        i += 2
+    return items
+
+
+def write(name, description, expect, pulses, seed):
+    items = tsop(pulses, seed)
+    with open(name + ".txt", "w") as f:
+        f.write("# %s\n" % description)
+        f.write("# expect: %s\n" % expect)
+        for l0, d0, l1, d1 in items:
+            f.write("%08X\n" % (d0 | l0 << 15 | d1 << 16 | l1 << 31))
+
+
+def expect(protocol, address, command, bits=0, toggle=0, repeats=0):
+    return "%s address=0x%04X command=0x%02X bits=%d toggle=%d repeats=%d" % \
+        (protocol, address, command, bits, toggle, repeats)
+
+
+PROTOCOLS = [
+    ("nec_tv_power", "NEC TV remote, power", expect("NEC", 0xBF40, 0x12), nec(0xBF40, 0x12)),
+    ("nec_ext_volup", "NEC extended address, volume up", expect("NEC", 0x7A83, 0x1A), nec(0x7A83, 0x1A)),
+    ("samsung_power", "Samsung TV, power", expect("Samsung", 0x0707, 0x02), samsung(0x0707, 0x02)),
+    ("samsung_mute", "Samsung TV, mute", expect("Samsung", 0x0707, 0x0F), samsung(0x0707, 0x0F)),
+    ("sirc12_power", "Sony 12bit TV power (3 frames)", expect("SIRC", 0x01, 0x15, 12, 0, 2), sirc(0x01, 0x15, 12)),
+    ("sirc15_play", "Sony 15bit, play (3 frames)", expect("SIRC", 0x1A, 0x32, 15, 0, 2), sirc(0x1A, 0x32, 15)),
+    ("sirc20_menu", "Sony 20bit, menu (3 frames)", expect("SIRC", 0x1A3A, 0x0E, 20, 0, 2), sirc(0x1A3A, 0x0E, 20)),
+    ("rc5_volup_t0", "Philips RC5, volume up, toggle 0", expect("RC5", 0x00, 0x10, 0, 0), rc5(0x00, 0x10, 0)),
+    ("rc5_volup_t1", "Philips RC5, volume up, toggle 1", expect("RC5", 0x00, 0x10, 0, 1), rc5(0x00, 0x10, 1)),
+    ("rc5x_cmd70", "Philips RC5x, command 70", expect("RC5", 0x05, 0x46, 0, 0), rc5(0x05, 0x46, 0)),
+    ("rc6_power_t0", "Philips RC6 mode 0, power, toggle 0", expect("RC6", 0x00, 0x0C, 0, 0), rc6(0x00, 0x0C, 0)),
+    ("rc6_ok_t1", "Philips RC6 mode 0, ok, toggle 1", expect("RC6", 0x00, 0x5C, 0, 1), rc6(0x00, 0x5C, 1)),
+]
+
+RAW = [
+    ("raw_ac_long", "Air condition, 2 frames of 62 bytes (~1000 edges)", "RAW", ac_long()),
+    ("raw_ac_daikin", "Daikin style air condition, 3 frames", "RAW", daikin()),
+    ("raw_jvc", "JVC, volume up", "RAW", jvc(0x03, 0x78)),
+    ("raw_kaseikyo", "Panasonic (Kaseikyo), power", "RAW", kaseikyo([0x02, 0x20, 0x80, 0x00, 0x3D, 0xBD])),
+    ("raw_nec_noisy", "NEC under fluorescent light", "RAW", noisy(nec(0xBF40, 0x12), 7)),
+    ("raw_rc6_noisy", "RC6 in sunlight", "RAW", noisy(rc6(0x00, 0x0C, 0), 8)),
+]
+
+CAPTURES = PROTOCOLS + RAW
+
+if __name__ == "__main__":
+    for seed, (name, description, exp, pulses) in enumerate(CAPTURES):
+        write(name, description, exp, pulses, seed + 1)
@@ -0,0 +1,26 @@
+/** @file
+ * @brief HOST TEST - RMT item layout (same as the ESP32)
+ *
+ * The TX functions are only declared, a test which uses them provides
+ * a simulated channel (see test_ir_hold.c). */
+#ifndef _STUB_RMT_H_
+#define _STUB_RMT_H_
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+typedef int rmt_channel_t;
+typedef struct {
+  union {
+    struct {
+      uint32_t duration0 :15;
+      uint32_t level0 :1;
+      uint32_t duration1 :15;
+      uint32_t level1 :1;
+    };
+    uint32_t val;
+  };
+} rmt_item32_t;
+esp_err_t rmt_wait_tx_done(rmt_channel_t channel, TickType_t wait_time);
+esp_err_t rmt_write_items(rmt_channel_t channel, const rmt_item32_t *rmt_item, int item_num, bool wait_tx_done);
+#endif
@@ -0,0 +1,8 @@
+/** @file
+ * @brief HOST TEST - event loop declarations */
+#ifndef _STUB_ESP_EVENT_H_
+#define _STUB_ESP_EVENT_H_
+#include "esp_err.h"
+typedef const char* esp_event_base_t;
+#define ESP_EVENT_DECLARE_BASE(id) extern esp_event_base_t id
+#endif
@@ -0,0 +1,20 @@
+/** @file
+ * @brief HOST TEST - logging to stdout (errors & warnings, with -DTEST_VERBOSE) */
+#ifndef _STUB_ESP_LOG_H_
+#define _STUB_ESP_LOG_H_
+#include <stdio.h>
+#include "esp_err.h"
+typedef enum { ESP_LOG_NONE, ESP_LOG_ERROR, ESP_LOG_WARN, ESP_LOG_INFO, \
+  ESP_LOG_DEBUG, ESP_LOG_VERBOSE } esp_log_level_t;
+#ifdef TEST_VERBOSE
+#define ESP_LOGE(tag,fmt,...) printf("E %s: " fmt "\n",tag,##__VA_ARGS__)
+#define ESP_LOGW(tag,fmt,...) printf("W %s: " fmt "\n",tag,##__VA_ARGS__)
+#else
+#define ESP_LOGE(tag,fmt,...) do {} while(0)
+#define ESP_LOGW(tag,fmt,...) do {} while(0)
+#endif
+#define ESP_LOGI(tag,fmt,...) do {} while(0)
+#define ESP_LOGD(tag,fmt,...) do {} while(0)
+#define ESP_LOGV(tag,fmt,...) do {} while(0)
+#define esp_log_level_set(tag,level) do {} while(0)
+#endif
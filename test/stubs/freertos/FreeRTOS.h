@@ -0,0 +1,35 @@
+/** @file
+ * @brief HOST TEST - minimal FreeRTOS declarations
+ *
+ * Only types & macros which are used in the declarations of common.h and
+ * rtos_alloc.h. The tested modules don't call any RTOS function.
+ **/
+#ifndef _STUB_FREERTOS_H_
+#define _STUB_FREERTOS_H_
+#include <stdint.h>
+#include <stddef.h>
+typedef void* QueueHandle_t;
+typedef void* SemaphoreHandle_t;
+typedef void* EventGroupHandle_t;
+typedef void* TaskHandle_t;
+typedef void* TimerHandle_t;
+typedef uint32_t TickType_t;
+typedef uint32_t EventBits_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t StackType_t;
+typedef struct { int dummy; } StaticTask_t;
+typedef struct { int dummy; } StaticQueue_t;
+typedef struct { int dummy; } StaticTimer_t;
+typedef struct { int dummy; } StaticEventGroup_t;
+typedef StaticQueue_t StaticSemaphore_t;
+typedef struct { int dummy; } portMUX_TYPE;
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define portMAX_DELAY 0xFFFFFFFF
+#define portTICK_PERIOD_MS 10
+#define tskIDLE_PRIORITY 0
+#define configMAX_PRIORITIES 25
+#define portNUM_PROCESSORS 2
+#endif
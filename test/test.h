@@ -0,0 +1,47 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ * Copyright 2019 Benjamin Aigner <aignerb@technikum-wien.at,
+ * beni@asterics-foundation.org>
+ */
+/** @file
+ * @brief HOST TEST - minimal check macros for the host tests
+ *
+ * Each test program includes this file once. Failed checks are printed
+ * and counted, TEST_RESULT is the exit code of main.
+ **/
+
+#ifndef _TEST_H_
+#define _TEST_H_
+
+#include <stdio.h>
+#include <string.h>
+
+/** @brief Count of failed checks */
+static int test_failed = 0;
+/** @brief Count of all checks */
+static int test_count = 0;
+
+/** @brief Check a condition, print file & line if it fails */
+#define CHECK(cond) do { test_count++; if(!(cond)) { test_failed++; \
+  printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); } } while(0)
+
+/** @brief Print the result & return the exit code (0 on success)
+ * @param name Name of the test */
+#define TEST_RESULT(name) (printf("%s: %d/%d checks passed\n", name, \
+  test_count - test_failed, test_count), test_failed != 0)
+
+#endif /* _TEST_H_ */
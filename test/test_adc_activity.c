@@ -0,0 +1,152 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ * Copyright 2019 Benjamin Aigner <aignerb@technikum-wien.at,
+ * beni@asterics-foundation.org>
+ */
+/** @file
+ * @brief HOST TEST - replay of the adaptive ADC sampling
+ *
+ * A synthetic sensor trace (noise around the rest position) is replayed
+ * with the same parameters as hal_adc.c. An event (movement or a small
+ * pressure change) is placed at every millisecond of one idle period,
+ * the additional wake-up latency compared to full rate sampling must
+ * stay below the idle period.
+ * @see adc_activity.h
+ **/
+
+#include "test.h"
+#include "adc_activity.h"
+
+/** @brief Same values as hal_adc.h */
+#define PERIOD 10
+#define IDLE_PERIOD 50
+#define IDLE_TIMEOUT 10000
+#define IDLE_NOISE 10
+
+/** @brief Event types */
+#define EV_MOVE 0
+#define EV_PRESSURE 1
+
+/** @brief Create one sample of the trace
+ * @param t Time [ms]
+ * @param t_ev Time of the event [ms]
+ * @param kind Event type
+ * @param raw Raw values (up, down, left, right, pressure)
+ * @param n Sample number (noise seed)
+ * @return Activity as detected by the ADC task (movement out of the deadzone) */
+static uint8_t sample(uint32_t t, uint32_t t_ev, uint8_t kind, int32_t *raw, uint32_t n)
+{
+  //+-5 noise around the rest position
+  for(uint8_t i = 0; i<ADC_ACTIVITY_CHANNELS; i++)
+  {
+    raw[i] = (i == 4 ? 512 : 500) + ((n * 1103515245u + i * 12345u) >> 16) % 11 - 5;
+  }
+  if(t < t_ev) return 0;
+  //movement is detected by the task, a small sip only by the noise floor
+  if(kind == EV_MOVE) { raw[2] += 60; return 1; }
+  raw[4] -= 30;
+  return 0;
+}
+
+static void test_wakeup(void)
+{
+  int32_t worst = 0;
+  for(uint8_t kind = EV_MOVE; kind <= EV_PRESSURE; kind++)
+  {
+    for(uint32_t t_ev = 20000; t_ev < 20000 + IDLE_PERIOD; t_ev++)
+    {
+      adc_activity_t a;
+      int32_t raw[ADC_ACTIVITY_CHANNELS];
+      uint32_t t = 0, n = 0;
+      int32_t detected = -1;
+      adc_activity_init(&a, PERIOD, IDLE_PERIOD, IDLE_TIMEOUT, IDLE_NOISE);
+      while(t < 30000)
+      {
+        uint8_t active = sample(t, t_ev, kind, raw, n++);
+        uint16_t p = adc_activity_update(&a, raw, active);
+        //idle before the event, full rate directly afterwards
+        if(t + PERIOD < t_ev) CHECK(a.idle == (t >= IDLE_TIMEOUT));
+        if(t >= t_ev && detected < 0)
+        {
+          detected = t;
+          CHECK(a.idle == 0 && p == PERIOD);
+        }
+        t += p;
+      }
+      //latency compared to full rate sampling
+      int32_t latency = detected - (int32_t)(((t_ev + PERIOD - 1) / PERIOD) * PERIOD);
+      if(latency > worst) worst = latency;
+    }
+  }
+  printf("adc_activity: worst additional wake-up latency %d ms (bound %d ms)\n", \
+    worst, IDLE_PERIOD - PERIOD);
+  CHECK(worst <= IDLE_PERIOD - PERIOD);
+}
+
+static void test_dutycycle(void)
+{
+  adc_activity_t a;
+  int32_t raw[ADC_ACTIVITY_CHANNELS];
+  uint32_t t = 0, n = 0;
+  adc_activity_init(&a, PERIOD, IDLE_PERIOD, IDLE_TIMEOUT, IDLE_NOISE);
+  //1h without activity
+  while(t < 3600000)
+  {
+    sample(t, UINT32_MAX, EV_MOVE, raw, n++);
+    t += adc_activity_update(&a, raw, 0);
+  }
+  uint32_t full = 3600000 / PERIOD;
+  printf("adc_activity: 1h idle: %u samples (I2C reads) vs %u at full rate (%.1f%% saved)\n", \
+    n, full, 100.0 * (full - n) / full);
+  CHECK(n < full / 4);
+}
+
+static void test_timeout(void)
+{
+  adc_activity_t a;
+  int32_t raw[ADC_ACTIVITY_CHANNELS] = {500, 500, 500, 500, 512};
+  uint32_t t;
+
+  //0 disables the idle mode
+  adc_activity_init(&a, PERIOD, IDLE_PERIOD, 0, IDLE_NOISE);
+  for(t = 0; t < 100000; t += adc_activity_update(&a, raw, 0));
+  CHECK(a.idle == 0);
+
+  //timeout changed at runtime (as halAdcNextPeriod does), counted from
+  //the last activity
+  a.timeout = 1000;
+  CHECK(adc_activity_update(&a, raw, 0) == IDLE_PERIOD);
+  adc_activity_update(&a, raw, 1);
+  for(t = 0; t < 1000 - PERIOD; t += adc_activity_update(&a, raw, 0));
+  CHECK(a.idle == 0);
+  adc_activity_update(&a, raw, 0);
+  CHECK(a.idle == 1 && adc_activity_update(&a, raw, 0) == IDLE_PERIOD);
+
+  //drift within the noise floor keeps the idle mode
+  raw[0] += IDLE_NOISE;
+  CHECK(adc_activity_update(&a, raw, 0) == IDLE_PERIOD);
+  raw[0] += 1;
+  CHECK(adc_activity_update(&a, raw, 0) == PERIOD && a.idle == 0);
+}
+
+int main(void)
+{
+  test_wakeup();
+  test_dutycycle();
+  test_timeout();
+  return TEST_RESULT("adc_activity");
+}
@@ -0,0 +1,208 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ * Copyright 2019 Benjamin Aigner <aignerb@technikum-wien.at,
+ * beni@asterics-foundation.org>
+ */
+/** @file
+ * @brief HOST TEST - CIM packet framing & streaming benchmark
+ *
+ * Without arguments, the packet build/parse functions are tested.
+ *
+ * With "bench [period ms] [seconds]", a pseudo-terminal is opened and
+ * the FLipMouse side is simulated on the master (same replies & report
+ * timing as task_cim). cim_client is started on the slave and reports
+ * the received frame rate & its CPU load.
+ * @see cim_packet.h
+ * @see cim_client.c
+ **/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <termios.h>
+#include <time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include "test.h"
+#include "cim_packet.h"
+
+/** @brief Same size as adcTelemetry_t (hal_adc.h) */
+#define SENSOR_FRAME_LENGTH 18
+
+static void test_packet(void)
+{
+  uint8_t b[CIM_MAX_PACKET_LENGTH + 8];
+  uint8_t d[4] = {1, 2, 3, 4};
+  cim_packet_t p;
+
+  //round trip
+  uint32_t n = cim_packet_build(b, sizeof(b), 7, 0x0002, CIM_CMD_WRITE, d, 4);
+  CHECK(n == CIM_HEADER_LENGTH + 4);
+  CHECK(b[0] == '@' && b[1] == 'T');
+  CHECK(cim_packet_datalength(b) == 4);
+  CHECK(cim_packet_parse(b, n, &p) == 0);
+  CHECK(p.areid == CIM_ARE_ID && p.serial == 7 && p.feature == 0x0002);
+  CHECK(p.code == CIM_CMD_WRITE && p.length == 4 && p.data[3] == 4);
+  //little endian fields
+  CHECK(b[CIM_OFFSET_CODE] == (CIM_CMD_WRITE & 0xFF) && b[CIM_OFFSET_CODE+1] == 0);
+  CHECK(b[CIM_OFFSET_LENGTH] == 4 && b[CIM_OFFSET_LENGTH+1] == 0);
+
+  //length mismatch
+  CHECK(cim_packet_parse(b, n - 1, &p) == -1);
+  CHECK(cim_packet_parse(b, n + 1, &p) == -1);
+  CHECK(cim_packet_parse(b, CIM_HEADER_LENGTH - 1, &p) == -1);
+
+  //invalid header
+  b[0] = 'A';
+  CHECK(cim_packet_datalength(b) == -1);
+
+  //no data
+  n = cim_packet_build(b, sizeof(b), 0, 0, CIM_CMD_FEATURELIST, NULL, 0);
+  CHECK(n == CIM_HEADER_LENGTH && cim_packet_parse(b, n, &p) == 0 && p.data == NULL);
+
+  //too long
+  b[CIM_OFFSET_LENGTH] = CIM_MAX_DATA_LENGTH + 1;
+  CHECK(cim_packet_datalength(b) == -1);
+  CHECK(cim_packet_build(b, CIM_HEADER_LENGTH - 1, 0, 0, 0, NULL, 0) == 0);
+  CHECK(cim_packet_build(b, sizeof(b), 0, 0, 0, d, CIM_MAX_PACKET_LENGTH) == 0);
+
+  //error flags don't collide with the command byte
+  CHECK(((CIM_REPLY_ERR_FEATURE | CIM_REPLY_ERR_ARE_VERSION | \
+    CIM_REPLY_ERR_DATA | CIM_REPLY_ERR_CMD) & 0xFF) == 0);
+}
+
+static double now(void)
+{
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+/** @brief Simulated device: answer requests, send reports like task_cim
+ * @return Exit status of the client */
+static int device(int fd, pid_t client)
+{
+  uint8_t rx[1024], tx[CIM_MAX_PACKET_LENGTH], frame[SENSOR_FRAME_LENGTH] = {0};
+  int have = 0, streaming = 0;
+  uint16_t period = 20;
+  uint8_t serial = 0;
+  long sent = 0;
+  double next = now(), t0 = now();
+  cim_packet_t p;
+  int status = 1;
+
+  while(waitpid(client, &status, WNOHANG) == 0)
+  {
+    int wait = streaming ? (int)((next - now()) * 1000 + 0.999) : 10;
+    struct pollfd pfd = { fd, POLLIN, 0 };
+    if(poll(&pfd, 1, wait < 0 ? 0 : wait) > 0)
+    {
+      int r = read(fd, rx + have, sizeof(rx) - have);
+      if(r > 0) have += r;
+      while(have >= CIM_HEADER_LENGTH)
+      {
+        int32_t len = cim_packet_datalength(rx);
+        if(len < 0) { memmove(rx, rx + 1, --have); continue; }
+        if(have < CIM_HEADER_LENGTH + len) break;
+        uint16_t code = 0;
+        uint8_t list[2 + 5*2] = {0x01, 0xA4, 0x00,0x00, 0x01,0x00, 0x02,0x00, 0x03,0x00, 0x10,0x00};
+        const void *data = NULL;
+        uint16_t dlen = 0;
+        cim_packet_parse(rx, CIM_HEADER_LENGTH + len, &p);
+        code = p.code;
+        switch(p.code)
+        {
+          case CIM_CMD_FEATURELIST: data = list; dlen = sizeof(list); break;
+          case CIM_CMD_WRITE:
+            if(p.feature == 0x0001 && p.length == 2) period = p.data[0] | (p.data[1] << 8);
+            else code |= CIM_REPLY_ERR_DATA;
+            break;
+          case CIM_CMD_START: streaming = 1; next = now(); t0 = now(); break;
+          case CIM_CMD_STOP: streaming = 0; break;
+          default: code |= CIM_REPLY_ERR_CMD; break;
+        }
+        uint32_t n = cim_packet_build(tx, sizeof(tx), p.serial, p.feature, code, data, dlen);
+        if(write(fd, tx, n) != (ssize_t)n) break;
+        have -= CIM_HEADER_LENGTH + len;
+        memmove(rx, rx + CIM_HEADER_LENGTH + len, have);
+      }
+    }
+    //periodic reports, no bursts after a stall (as task_cim)
+    if(streaming && now() >= next)
+    {
+      uint32_t ts = (uint32_t)(now() * 1e6);
+      memcpy(frame, &ts, sizeof(ts));
+      uint32_t n = cim_packet_build(tx, sizeof(tx), serial++, 0x0002, CIM_REPLY_EVENT, \
+        frame, sizeof(frame));
+      if(write(fd, tx, n) != (ssize_t)n) break;
+      sent++;
+      next += period / 1000.0;
+      if(next < now()) next = now() + period / 1000.0;
+    }
+  }
+  struct rusage ru;
+  getrusage(RUSAGE_SELF, &ru);
+  double el = now() - t0;
+  printf("device: %ld frames sent, %d B/frame, cpu %.3f%%\n", sent, \
+    CIM_HEADER_LENGTH + SENSOR_FRAME_LENGTH, 100 * (ru.ru_utime.tv_sec + \
+    ru.ru_utime.tv_usec * 1e-6 + ru.ru_stime.tv_sec + ru.ru_stime.tv_usec * 1e-6) / el);
+  return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+}
+
+static int bench(const char *period, const char *secs)
+{
+  int m = posix_openpt(O_RDWR | O_NOCTTY);
+  if(m < 0 || grantpt(m) != 0 || unlockpt(m) != 0) { perror("pty"); return 1; }
+  //keep the slave open, the master is not readable without it
+  char name[64];
+  snprintf(name, sizeof(name), "%s", ptsname(m));
+  int s = open(name, O_RDWR | O_NOCTTY);
+  struct termios t;
+  tcgetattr(s, &t);
+  cfmakeraw(&t);
+  tcsetattr(s, TCSANOW, &t);
+  tcgetattr(m, &t);
+  cfmakeraw(&t);
+  tcsetattr(m, TCSANOW, &t);
+
+  fflush(stdout);
+  pid_t c = fork();
+  if(c == 0)
+  {
+    close(m);
+    execl("./cim_client", "cim_client", name, period, secs, (char*)NULL);
+    perror("cim_client");
+    _exit(1);
+  }
+  int ret = device(m, c);
+  close(s);
+  close(m);
+  return ret;
+}
+
+int main(int argc, char **argv)
+{
+  if(argc > 1 && strcmp(argv[1], "bench") == 0)
+  {
+    return bench(argc > 2 ? argv[2] : "10", argc > 3 ? argv[3] : "3");
+  }
+  test_packet();
+  return TEST_RESULT("cim_packet");
+}
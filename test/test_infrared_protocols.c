@@ -0,0 +1,381 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ * Copyright 2019 Benjamin Aigner <aignerb@technikum-wien.at,
+ * beni@asterics-foundation.org>
+ */
+/** @file
+ * @brief HOST TEST - IR protocol recognition & synthesis
+ *
+ * Each protocol is encoded, distorted like a TSOP receiver does (longer
+ * marks, shorter spaces, jitter) and decoded again. Random edges must
+ * not be recognized. The captures in fixtures/ir (hex dumps as printed by
+ * fct_infrared_record) must decode to the command in their "# expect:"
+ * line. All captures are packed like raw commands in halStorageStoreIR,
+ * the packed/raw size is printed & the unpack speed is compared to the
+ * rate the RMT receiver fills the ringbuffer. The storage size of a decoded command is compared
+ * to the raw edges & the synthesis time is measured.
+ * @see infrared_protocols.h
+ **/
+
+#include <stdlib.h>
+#include <time.h>
+#include <glob.h>
+#include "test.h"
+#include "infrared_protocols.h"
+
+/** @brief Maximum edges of one test capture */
+#define MAX_EDGES 512
+
+/** @brief Mark extension of a TSOP receiver [RMT ticks] (~50us) */
+#define TSOP_SKEW (5*IR_PROTOCOL_TICK_10_US)
+/** @brief Additional jitter [RMT ticks] (+-25us) */
+#define TSOP_JITTER (2*IR_PROTOCOL_TICK_10_US + IR_PROTOCOL_TICK_10_US/2)
+
+/** @brief Maximum edges of a fixture capture (TASK_HAL_IR_RECV_MAXIMUM_EDGES) */
+#define CAPTURE_MAX_EDGES 1024
+/** @brief Directory of the capture fixtures (relative to test/) */
+#define CAPTURE_GLOB "fixtures/ir/*.txt"
+/** @brief Longest capture, used for the unpack benchmark */
+#define CAPTURE_LONG "fixtures/ir/raw_ac_long.txt"
+
+static rmt_item32_t edges[MAX_EDGES];
+static long rawbytes = 0, codebytes = 0;
+
+/** @brief Distort a synthesized waveform like a recording */
+static void distort(rmt_item32_t *items, uint16_t count, uint32_t seed)
+{
+  for(uint16_t i = 0; i<count; i++)
+  {
+    int32_t j0 = (int32_t)((seed + i * 7) % (2*TSOP_JITTER+1)) - TSOP_JITTER;
+    int32_t j1 = (int32_t)((seed + i * 13) % (2*TSOP_JITTER+1)) - TSOP_JITTER;
+    //level 1 is a mark, gets longer; the following space gets shorter
+    if(items[i].duration0 > 2*TSOP_SKEW) items[i].duration0 += TSOP_SKEW + j0;
+    if(items[i].duration1 > 2*TSOP_SKEW) items[i].duration1 -= TSOP_SKEW - j1;
+  }
+}
+
+/** @brief Encode, distort & decode one command */
+static void roundtrip(uint8_t protocol, uint16_t address, uint16_t command,
+  uint8_t bits, uint8_t repeats, uint8_t toggle)
+{
+  irCode_t in = {protocol, bits, repeats, toggle, address, command};
+  irCode_t out;
+  uint16_t count = ir_protocol_encode(&in, NULL, 0);
+  CHECK(count != 0 && count <= MAX_EDGES);
+  if(count == 0 || count > MAX_EDGES) return;
+  CHECK(ir_protocol_encode(&in, edges, MAX_EDGES) == count);
+  //too small buffer
+  CHECK(ir_protocol_encode(&in, edges, count - 1) == 0);
+  CHECK(ir_protocol_encode(&in, edges, MAX_EDGES) == count);
+  distort(edges, count, address ^ command);
+
+  CHECK(ir_protocol_decode(edges, count, &out) == ESP_OK);
+  CHECK(out.protocol == protocol && out.address == address && out.command == command);
+  CHECK(out.toggle == toggle && out.bits == bits);
+  //SIRC is always sent 3 times
+  CHECK(out.repeats == ((protocol == IR_PROTO_SIRC && repeats < 2) ? 2 : repeats));
+  CHECK(ir_protocol_encode_repeat(&out, NULL, 0) != 0);
+  CHECK(ir_protocol_period(protocol) != 0);
+
+  rawbytes += count * sizeof(rmt_item32_t);
+  codebytes += sizeof(irCode_t);
+}
+
+static void test_protocols(void)
+{
+  roundtrip(IR_PROTO_NEC, 0x12ED, 0x45, 0, 0, 0);
+  roundtrip(IR_PROTO_NEC, 0x1234, 0xA5, 0, 3, 0);
+  roundtrip(IR_PROTO_SAMSUNG, 0x0707, 0x02, 0, 1, 0);
+  roundtrip(IR_PROTO_SIRC, 0x01, 0x15, 12, 2, 0);
+  roundtrip(IR_PROTO_SIRC, 0x1A, 0x7F, 15, 2, 0);
+  roundtrip(IR_PROTO_SIRC, 0x1ABC, 0x00, 20, 4, 0);
+  for(uint16_t c = 0; c<64; c += 21)
+  {
+    for(uint8_t t = 0; t<2; t++)
+    {
+      roundtrip(IR_PROTO_RC5, 0x05, c, 0, 0, t);
+      roundtrip(IR_PROTO_RC5, 0x1F, c | 1, 0, 2, t);
+    }
+  }
+  for(uint16_t c = 0; c<256; c += 51)
+  {
+    for(uint8_t t = 0; t<2; t++)
+    {
+      roundtrip(IR_PROTO_RC6, 0x00, c, 0, 0, t);
+      roundtrip(IR_PROTO_RC6, 0xFF, c ^ 0xFF, 0, 1, t);
+    }
+  }
+}
+
+/** @brief Random edges must not be recognized */
+static void test_noise(void)
+{
+  irCode_t out;
+  srand(1);
+  for(uint8_t k = 0; k<50; k++)
+  {
+    uint16_t count = 20 + rand() % 100;
+    for(uint16_t i = 0; i<count; i++)
+    {
+      edges[i].level0 = 1;
+      edges[i].duration0 = 100 + rand() % 2000;
+      edges[i].level1 = 0;
+      edges[i].duration1 = 100 + rand() % 2000;
+    }
+    CHECK(ir_protocol_decode(edges, count, &out) == ESP_FAIL && out.protocol == IR_PROTO_RAW);
+  }
+  //too short
+  CHECK(ir_protocol_decode(edges, 3, &out) == ESP_FAIL);
+}
+
+/** @brief Packed raw edges (unknown protocols) & corrupt packed data */
+static void test_pack(void)
+{
+  //one repeat: a recording has no filler items for long gaps
+  irCode_t in = {IR_PROTO_NEC, 0, 1, 0, 0x12ED, 0x45};
+  static rmt_item32_t out[MAX_EDGES];
+  uint8_t packed[MAX_EDGES * sizeof(rmt_item32_t)];
+  uint16_t count = ir_protocol_encode(&in, edges, MAX_EDGES);
+  distort(edges, count, 3);
+  uint16_t len = ir_raw_pack(edges, count, packed, sizeof(packed));
+  CHECK(len != 0 && len < count * sizeof(rmt_item32_t));
+  CHECK(ir_raw_unpack(packed, len, NULL, 0) == count);
+  CHECK(ir_raw_unpack(packed, len, out, MAX_EDGES) == count);
+  //quantized durations still decode
+  irCode_t dec;
+  CHECK(ir_protocol_decode(out, count, &dec) == ESP_OK && dec.command == 0x45);
+  //truncated, too small buffer, bad dictionary index
+  CHECK(ir_raw_unpack(packed, len - 1, out, MAX_EDGES) == 0);
+  CHECK(ir_raw_unpack(packed, 3, out, MAX_EDGES) == 0);
+  CHECK(ir_raw_unpack(packed, len, out, count - 1) == 0);
+  packed[4 + 2*packed[3]] = 0xEE;
+  CHECK(ir_raw_unpack(packed, len, out, MAX_EDGES) == 0);
+}
+
+/** @brief Decoded commands are limited to IR_PROTOCOL_MAX_REPEATS */
+static void test_max_repeats(void)
+{
+  irCode_t in = {IR_PROTO_NEC, 0, 40, 0, 0x12ED, 0x45};
+  irCode_t out;
+  uint16_t count = ir_protocol_encode(&in, edges, MAX_EDGES);
+  CHECK(count != 0);
+  CHECK(ir_protocol_decode(edges, count, &out) == ESP_OK);
+  CHECK(out.command == 0x45 && out.repeats == IR_PROTOCOL_MAX_REPEATS);
+  //a clamped command must fit into the receive buffer
+  in.protocol = IR_PROTO_SIRC; in.bits = 20;
+  in.repeats = IR_PROTOCOL_MAX_REPEATS;
+  CHECK(ir_protocol_encode(&in, NULL, 0) <= CAPTURE_MAX_EDGES);
+}
+
+/** @brief Load one capture fixture
+ * @param file Path of the fixture
+ * @param items Buffer for the edges, CAPTURE_MAX_EDGES items
+ * @param expect Expected decoding (text after "# expect: ")
+ * @param len Size of the expect buffer
+ * @return Count of items, 0 on errors */
+static uint16_t capture_load(const char *file, rmt_item32_t *items, char *expect, size_t len)
+{
+  char line[128];
+  uint16_t count = 0;
+  unsigned int val;
+  FILE *f = fopen(file, "r");
+  if(f == NULL) return 0;
+  expect[0] = 0;
+  while(fgets(line, sizeof(line), f) != NULL)
+  {
+    if(strncmp(line, "# expect: ", 10) == 0)
+    {
+      snprintf(expect, len, "%s", line + 10);
+      expect[strcspn(expect, "\r\n")] = 0;
+      continue;
+    }
+    if(line[0] == '#' || sscanf(line, "%8x", &val) != 1) continue;
+    if(count == CAPTURE_MAX_EDGES) { count = 0; break; }
+    items[count++].val = val;
+  }
+  fclose(f);
+  return count;
+}
+
+/** @brief Recorded captures decode to the expected command */
+static void test_captures(void)
+{
+  static rmt_item32_t items[CAPTURE_MAX_EDGES];
+  static rmt_item32_t synth[CAPTURE_MAX_EDGES];
+  char expect[128], name[16];
+  glob_t g;
+  uint16_t protocols = 0;
+
+  CHECK(glob(CAPTURE_GLOB, 0, NULL, &g) == 0);
+  for(size_t i = 0; i < g.gl_pathc; i++)
+  {
+    irCode_t out, again;
+    unsigned int address, command, bits, toggle, repeats;
+    uint16_t count = capture_load(g.gl_pathv[i], items, expect, sizeof(expect));
+    CHECK(count != 0);
+    if(count == 0) continue;
+
+    //unknown protocols must not be recognized
+    if(strcmp(expect, "RAW") == 0)
+    {
+      CHECK(ir_protocol_decode(items, count, &out) == ESP_FAIL);
+      continue;
+    }
+    CHECK(sscanf(expect, "%15s address=%x command=%x bits=%u toggle=%u repeats=%u", \
+      name, &address, &command, &bits, &toggle, &repeats) == 6);
+    CHECK(ir_protocol_decode(items, count, &out) == ESP_OK);
+    if(strcmp(ir_protocol_name(out.protocol), name) != 0 || out.address != address || \
+      out.command != command || out.bits != bits || out.toggle != toggle || \
+      out.repeats != repeats)
+    {
+      CHECK(0);
+      printf("%s: expected %s, got %s address=0x%04X command=0x%02X bits=%u toggle=%u repeats=%u\n", \
+        g.gl_pathv[i], expect, ir_protocol_name(out.protocol), out.address, out.command, \
+        out.bits, out.toggle, out.repeats);
+      continue;
+    }
+    protocols |= 1 << out.protocol;
+    //the synthesized waveform must decode to the same command
+    uint16_t scount = ir_protocol_encode(&out, synth, CAPTURE_MAX_EDGES);
+    CHECK(scount != 0);
+    CHECK(ir_protocol_decode(synth, scount, &again) == ESP_OK);
+    CHECK(memcmp(&out, &again, sizeof(irCode_t)) == 0);
+  }
+  //at least one capture of each protocol
+  CHECK(protocols == ((1 << IR_PROTO_NEC) | (1 << IR_PROTO_RC5) | (1 << IR_PROTO_RC6) | \
+    (1 << IR_PROTO_SIRC) | (1 << IR_PROTO_SAMSUNG)));
+  globfree(&g);
+}
+
+/** @brief Unpacked edges are within the dictionary tolerance of the capture */
+static int capture_match(const rmt_item32_t *a, const rmt_item32_t *b, uint16_t count)
+{
+  for(uint16_t i = 0; i < count; i++)
+  {
+    int32_t d0 = (int32_t)a[i].duration0 - b[i].duration0;
+    int32_t d1 = (int32_t)a[i].duration1 - b[i].duration1;
+    if(a[i].level0 != b[i].level0 || a[i].level1 != b[i].level1) return 0;
+    if(abs(d0) > a[i].duration0/4 + 4 || abs(d1) > a[i].duration1/4 + 4) return 0;
+    if((a[i].duration1 == 0) != (b[i].duration1 == 0)) return 0;
+  }
+  return 1;
+}
+
+/** @brief Pack all captures like halStorageStoreIR does for raw commands
+ *
+ * Captures which cannot be packed are stored with 4 bytes per item,
+ * they are included in the total ratio. */
+static void test_capture_pack(void)
+{
+  static rmt_item32_t items[CAPTURE_MAX_EDGES];
+  static rmt_item32_t unpacked[CAPTURE_MAX_EDGES];
+  static uint8_t packed[CAPTURE_MAX_EDGES * sizeof(rmt_item32_t)];
+  char expect[128];
+  long raw = 0, stored = 0;
+  int rejected = 0;
+  glob_t g;
+
+  CHECK(glob(CAPTURE_GLOB, 0, NULL, &g) == 0);
+  for(size_t i = 0; i < g.gl_pathc; i++)
+  {
+    irCode_t a, b;
+    uint16_t count = capture_load(g.gl_pathv[i], items, expect, sizeof(expect));
+    if(count == 0) continue;
+    uint16_t rawlen = count * sizeof(rmt_item32_t);
+    //same limit as halStorageStoreIR: only stored packed if smaller
+    uint16_t len = ir_raw_pack(items, count, packed, rawlen);
+    raw += rawlen;
+    stored += len ? len : rawlen;
+    if(len == 0)
+    {
+      rejected++;
+      printf("infrared_protocols: %-32s %4u items %5u B, not packed\n", \
+        strrchr(g.gl_pathv[i], '/') + 1, count, rawlen);
+      continue;
+    }
+    printf("infrared_protocols: %-32s %4u items %5u B, packed %4u B (%.2f)\n", \
+      strrchr(g.gl_pathv[i], '/') + 1, count, rawlen, len, (double)len / rawlen);
+    CHECK(ir_raw_unpack(packed, len, unpacked, CAPTURE_MAX_EDGES) == count);
+    CHECK(capture_match(items, unpacked, count));
+    //packing must not change the decoding
+    esp_err_t ret = ir_protocol_decode(items, count, &a);
+    CHECK(ir_protocol_decode(unpacked, count, &b) == ret);
+    CHECK(ret != ESP_OK || memcmp(&a, &b, sizeof(irCode_t)) == 0);
+  }
+  globfree(&g);
+  CHECK(raw != 0);
+  if(raw == 0) return;
+  printf("infrared_protocols: captures %ld B raw, %ld B stored (%.2f), %d not packed\n", \
+    raw, stored, (double)stored / raw, rejected);
+}
+
+/** @brief Unpack speed vs. the rate of received items
+ *
+ * The longest capture is unpacked repeatedly. The RMT fill rate is the
+ * count of items divided by the duration of the signal. */
+static void bench_unpack(void)
+{
+  static rmt_item32_t items[CAPTURE_MAX_EDGES];
+  static uint8_t packed[CAPTURE_MAX_EDGES * sizeof(rmt_item32_t)];
+  char expect[128];
+  uint64_t ticks = 0;
+  uint16_t count = capture_load(CAPTURE_LONG, items, expect, sizeof(expect));
+  CHECK(count != 0);
+  if(count == 0) return;
+  uint16_t len = ir_raw_pack(items, count, packed, sizeof(packed));
+  CHECK(len != 0);
+  if(len == 0) return;
+  for(uint16_t i = 0; i < count; i++) ticks += items[i].duration0 + items[i].duration1;
+
+  const uint32_t loops = 20000;
+  volatile uint32_t sum = 0;
+  clock_t t = clock();
+  for(uint32_t i = 0; i<loops; i++) sum += ir_raw_unpack(packed, len, items, CAPTURE_MAX_EDGES);
+  double s = (double)(clock() - t) / CLOCKS_PER_SEC;
+  double unpack = (double)loops * count / s;
+  //1 tick = 10us / IR_PROTOCOL_TICK_10_US
+  double fill = count / (ticks * 10e-6 / IR_PROTOCOL_TICK_10_US);
+  printf("infrared_protocols: unpack %.1f M items/s on the host, RMT fills %.0f items/s (%.0fx)\n", \
+    unpack / 1e6, fill, unpack / fill);
+}
+
+/** @brief Synthesis time of one NEC frame (replaces loading raw edges) */
+static void bench_encode(void)
+{
+  irCode_t in = {IR_PROTO_NEC, 0, 0, 0, 0x12ED, 0x45};
+  const uint32_t loops = 200000;
+  volatile uint32_t sum = 0;
+  clock_t t = clock();
+  for(uint32_t i = 0; i<loops; i++) sum += ir_protocol_encode(&in, edges, MAX_EDGES);
+  double us = (double)(clock() - t) / CLOCKS_PER_SEC * 1e6 / loops;
+  printf("infrared_protocols: %.2f us to synthesize one NEC frame on the host\n", us);
+  printf("infrared_protocols: storage %ld B raw edges vs %ld B decoded (%.1fx)\n", \
+    rawbytes, codebytes, (double)rawbytes / codebytes);
+}
+
+int main(void)
+{
+  test_protocols();
+  test_noise();
+  test_pack();
+  test_max_repeats();
+  test_captures();
+  test_capture_pack();
+  bench_encode();
+  bench_unpack();
+  return TEST_RESULT("infrared_protocols");
+}
@@ -0,0 +1,258 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ * Copyright 2019 Benjamin Aigner <aignerb@technikum-wien.at,
+ * beni@asterics-foundation.org>
+ */
+/** @file
+ * @brief HOST TEST - repeat scheduling of held IR commands
+ *
+ * The RMT channel is simulated: a written frame keeps the channel busy
+ * for its duration, rmt_wait_tx_done only returns ESP_OK if the channel
+ * is idle (or gets idle within the wait time). The periodic timer is
+ * simulated by calling ir_hold_tick at multiples of the interval, the
+ * first full frame is written at t=0 (as fct_infrared_hold_start).
+ * @see ir_hold.h
+ **/
+
+#include "test.h"
+#include "ir_hold.h"
+
+/** @brief Simulated time [us] */
+static uint64_t now = 0;
+/** @brief End of the current transmission [us] */
+static uint64_t busy_until = 0;
+/** @brief Count of written frames */
+static uint32_t writes = 0;
+/** @brief Frames written while the channel was busy (must not happen) */
+static uint32_t collisions = 0;
+/** @brief Start time of the last written frame [us] */
+static uint64_t last_write = 0;
+/** @brief Last written frame */
+static const rmt_item32_t *last_items = NULL;
+
+/** @brief Duration of a waveform [us] */
+static uint64_t duration(const rmt_item32_t *items, int count)
+{
+  uint64_t ticks = 0;
+  for(int i = 0; i<count; i++) ticks += items[i].duration0 + items[i].duration1;
+  return ticks * 10 / IR_PROTOCOL_TICK_10_US;
+}
+
+esp_err_t rmt_wait_tx_done(rmt_channel_t channel, TickType_t wait_time)
+{
+  if(now >= busy_until) return ESP_OK;
+  //blocking wait: time passes
+  if(busy_until - now <= (uint64_t)wait_time * portTICK_PERIOD_MS * 1000)
+  {
+    now = busy_until;
+    return ESP_OK;
+  }
+  return ESP_ERR_TIMEOUT;
+}
+
+esp_err_t rmt_write_items(rmt_channel_t channel, const rmt_item32_t *rmt_item, int item_num, bool wait_tx_done)
+{
+  if(now < busy_until) collisions++;
+  busy_until = now + duration(rmt_item, item_num);
+  last_write = now;
+  last_items = rmt_item;
+  writes++;
+  return ESP_OK;
+}
+
+/** @brief Reset the simulated channel */
+static void rmt_reset(void)
+{
+  now = busy_until = last_write = 0;
+  writes = collisions = 0;
+  last_items = NULL;
+}
+
+/** @brief Hold a command for a time, like fct_infrared_hold_start/stop
+ * @param code Command (full frame is synthesized)
+ * @param irrepeat "AT IN" value [ms]
+ * @param hold Hold time [ms]
+ * @param h Hold state, stopped afterwards
+ * @return Count of sent repeat frames */
+static uint32_t hold(const irCode_t *code, uint16_t irrepeat, uint32_t hold, ir_hold_t *h)
+{
+  static rmt_item32_t full[512];
+  uint16_t fullcount = ir_protocol_encode(code, full, 512);
+  uint16_t count;
+  rmt_item32_t *frame = ir_hold_create_frame(code, full, fullcount, &count);
+  uint32_t interval = ir_hold_interval(code->protocol, irrepeat);
+  uint64_t t0 = now;
+  uint32_t sent = 0;
+
+  ir_hold_start(h, frame, count, 3);
+  //first full frame
+  rmt_write_items(0, full, fullcount, false);
+  for(uint64_t tick = t0 + interval; tick < t0 + hold * 1000ULL; tick += interval)
+  {
+    if(now < tick) now = tick;
+    if(ir_hold_tick(h))
+    {
+      sent++;
+      //sent exactly on the timer tick with the repeat frame
+      CHECK(last_write == tick && last_items == frame);
+    }
+  }
+  now = t0 + hold * 1000ULL;
+  CHECK(ir_hold_stop(h, 3, 50) == 1);
+  return sent;
+}
+
+static void test_frames(void)
+{
+  rmt_item32_t full[512];
+  uint16_t count;
+  irCode_t out;
+  const irCode_t codes[] = {
+    {IR_PROTO_SAMSUNG, 0, 0, 0, 0x0707, 0x02},
+    {IR_PROTO_SIRC, 12, 0, 0, 0x01, 0x15},
+    {IR_PROTO_RC5, 0, 0, 1, 0x05, 0x21},
+    {IR_PROTO_RC6, 0, 0, 1, 0x00, 0x33},
+  };
+
+  //NEC: short repeat code (9ms mark, 2.25ms space, 560us mark)
+  irCode_t nec = {IR_PROTO_NEC, 0, 0, 0, 0x12ED, 0x45};
+  uint16_t fullcount = ir_protocol_encode(&nec, full, 512);
+  rmt_item32_t *frame = ir_hold_create_frame(&nec, full, fullcount, &count);
+  CHECK(frame != NULL && count < 4 && count < fullcount);
+  CHECK(frame[0].duration0 == 900 * IR_PROTOCOL_TICK_10_US);
+  CHECK(frame[0].duration1 == 225 * IR_PROTOCOL_TICK_10_US);
+  CHECK(ir_protocol_decode(frame, count, &out) != ESP_OK || out.command != 0x45);
+  free(frame);
+
+  //other protocols: one full frame with the same toggle bit
+  for(uint8_t i = 0; i<sizeof(codes)/sizeof(codes[0]); i++)
+  {
+    fullcount = ir_protocol_encode(&codes[i], full, 512);
+    frame = ir_hold_create_frame(&codes[i], full, fullcount, &count);
+    CHECK(frame != NULL && count > 8 && count <= fullcount);
+    CHECK(ir_protocol_decode(frame, count, &out) == ESP_OK);
+    CHECK(out.protocol == codes[i].protocol && out.command == codes[i].command && \
+      out.address == codes[i].address && out.toggle == codes[i].toggle);
+    free(frame);
+  }
+
+  //raw: copy of the full waveform
+  irCode_t raw = {IR_PROTO_RAW, 0, 0, 0, 0, 0};
+  fullcount = ir_protocol_encode(&nec, full, 512);
+  frame = ir_hold_create_frame(&raw, full, fullcount, &count);
+  CHECK(frame != NULL && frame != full && count == fullcount);
+  CHECK(frame != NULL && memcmp(frame, full, sizeof(rmt_item32_t) * count) == 0);
+  free(frame);
+  CHECK(ir_hold_create_frame(&raw, NULL, 0, &count) == NULL && count == 0);
+}
+
+static void test_interval(void)
+{
+  CHECK(ir_hold_interval(IR_PROTO_NEC, 0) == 108000);
+  CHECK(ir_hold_interval(IR_PROTO_SAMSUNG, 0) == 108000);
+  CHECK(ir_hold_interval(IR_PROTO_SIRC, 0) == 45000);
+  CHECK(ir_hold_interval(IR_PROTO_RAW, 0) == IR_HOLD_DEFAULT_INTERVAL * 1000);
+  //"AT IN" overrides the protocol period
+  CHECK(ir_hold_interval(IR_PROTO_NEC, 200) == 200000);
+  CHECK(ir_hold_interval(IR_PROTO_RAW, 150) == 150000);
+}
+
+static void test_timing(void)
+{
+  ir_hold_t h;
+  irCode_t nec = {IR_PROTO_NEC, 0, 0, 0, 0x12ED, 0x45};
+  irCode_t sirc = {IR_PROTO_SIRC, 12, 0, 0, 0x01, 0x15};
+
+  //NEC held 1s: repeat codes at 108, 216,... 972ms
+  rmt_reset();
+  ir_hold_init(&h, 0);
+  CHECK(hold(&nec, 0, 1000, &h) == 9 && h.skipped == 0);
+  CHECK(collisions == 0 && writes == 10);
+
+  //"AT IN 200": 200, 400, 600, 800ms
+  rmt_reset();
+  ir_hold_init(&h, 0);
+  CHECK(hold(&nec, 200, 1000, &h) == 4 && collisions == 0);
+
+  //SIRC: the first frame is sent 3 times (~3*45ms), the ticks at 45ms
+  //and 90ms are skipped, afterwards one frame every 45ms
+  rmt_reset();
+  ir_hold_init(&h, 0);
+  uint32_t sent = hold(&sirc, 0, 1000, &h);
+  CHECK(h.skipped == 2 && sent == 22 - 2);
+  CHECK(collisions == 0);
+}
+
+static void test_busy(void)
+{
+  ir_hold_t h;
+  rmt_item32_t other[64];
+  irCode_t nec = {IR_PROTO_NEC, 0, 0, 0, 0x12ED, 0x45};
+  rmt_item32_t full[512];
+  uint16_t count;
+
+  rmt_reset();
+  ir_hold_init(&h, 0);
+  uint16_t fullcount = ir_protocol_encode(&nec, full, 512);
+  rmt_item32_t *frame = ir_hold_create_frame(&nec, full, fullcount, &count);
+  ir_hold_start(&h, frame, count, 5);
+
+  //another command occupies the channel from 100ms to 250ms
+  for(uint8_t i = 0; i<64; i++)
+  {
+    other[i].val = 0;
+    other[i].level0 = 1;
+    other[i].duration0 = 1000;
+    other[i].duration1 = 1000 * 3 / 2;
+  }
+  now = 100000;
+  rmt_write_items(0, other, 60, false);
+  CHECK(busy_until == 100000 + 60 * 2500 * 10 / IR_PROTOCOL_TICK_10_US);
+  now = 108000;
+  CHECK(ir_hold_tick(&h) == 0 && h.skipped == 1 && writes == 1);
+  now = 216000;
+  CHECK(ir_hold_tick(&h) == 0 && h.skipped == 2 && writes == 1);
+  now = 324000;
+  CHECK(ir_hold_tick(&h) == 1 && writes == 2 && last_items == frame);
+  CHECK(collisions == 0);
+
+  //other VB released: still repeating
+  CHECK(ir_hold_stop(&h, 6, 50) == 0 && h.frame == frame);
+
+  //release while the repeat frame is sent, no wait: kept as stale frame
+  CHECK(ir_hold_stop(&h, 5, 0) == 1);
+  CHECK(h.frame == NULL && h.stale == frame && h.vb == IR_HOLD_ALL);
+  //no frame after release (timer might fire once more)
+  now = 432000;
+  CHECK(ir_hold_tick(&h) == 0 && writes == 2);
+  //freed as soon as the channel is idle
+  ir_hold_free_stale(&h);
+  CHECK(h.stale == NULL);
+
+  //stop without a held command
+  CHECK(ir_hold_stop(&h, IR_HOLD_ALL, 50) == 0);
+  CHECK(ir_hold_tick(&h) == 0 && writes == 2);
+}
+
+int main(void)
+{
+  test_frames();
+  test_interval();
+  test_timing();
+  test_busy();
+  return TEST_RESULT("ir_hold");
+}
@@ -0,0 +1,157 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ * Copyright 2019 Benjamin Aigner <aignerb@technikum-wien.at,
+ * beni@asterics-foundation.org>
+ */
+/** @file
+ * @brief HOST TEST - IR receive buffer with long recordings
+ *
+ * Synthetic edge streams longer than the former fixed buffer (256
+ * edges) are fed in ringbuffer blocks of varying size, with the same
+ * parameters as halIOIRRecvTask. The edges must arrive inverted & in
+ * order, the buffer must grow in chunks and overflow beyond the cap.
+ * @see ir_recv_buffer.h
+ **/
+
+#include <time.h>
+#include "test.h"
+#include "ir_recv_buffer.h"
+
+/** @brief Same values as hal_io.h */
+#define CHUNK 64
+#define MAXIMUM 1024
+#define LEVEL_MASK ((1UL<<15) | (1UL<<31))
+
+static rmt_item32_t stream[MAXIMUM + 64];
+
+/** @brief Create a synthetic edge stream (active low, as the TSOP) */
+static void make_stream(uint16_t count)
+{
+  for(uint16_t i = 0; i<count; i++)
+  {
+    stream[i].duration0 = 100 + i;
+    stream[i].level0 = 0;
+    stream[i].duration1 = 200 + (i * 7) % 1000;
+    stream[i].level1 = 1;
+  }
+}
+
+/** @brief Feed a stream in blocks & count the reallocations
+ * @return Result of the last append */
+static esp_err_t feed(ir_recv_buffer_t *b, uint16_t count, uint16_t block, uint16_t *grows)
+{
+  esp_err_t ret = ESP_OK;
+  uint16_t off = 0, k = 0;
+  *grows = 0;
+  while(off < count && ret == ESP_OK)
+  {
+    //varying block sizes, like the RMT ringbuffer items
+    uint16_t n = 1 + (block + k++ * 37) % block;
+    if(off + n > count) n = count - off;
+    uint16_t allocated = b->allocated;
+    ret = ir_recv_buffer_append(b, &stream[off], n);
+    if(b->allocated != allocated) (*grows)++;
+    off += n;
+  }
+  return ret;
+}
+
+static void test_long(void)
+{
+  const uint16_t counts[] = {6, 255, 256, 257, 300, 700, MAXIMUM - 1, MAXIMUM};
+  const uint16_t blocks[] = {1, 17, 64, 200};
+  for(uint8_t c = 0; c<sizeof(counts)/sizeof(counts[0]); c++)
+  {
+    for(uint8_t k = 0; k<sizeof(blocks)/sizeof(blocks[0]); k++)
+    {
+      ir_recv_buffer_t b;
+      uint16_t grows;
+      uint8_t ok = 1;
+      make_stream(counts[c]);
+      ir_recv_buffer_init(&b, CHUNK, MAXIMUM, LEVEL_MASK);
+      CHECK(feed(&b, counts[c], blocks[k], &grows) == ESP_OK);
+      CHECK(b.count == counts[c] && b.buffer != NULL);
+      //grown in whole chunks (or up to the cap)
+      CHECK(b.allocated >= b.count && (b.allocated % CHUNK == 0 || b.allocated == MAXIMUM));
+      CHECK(b.allocated - b.count < CHUNK + blocks[k]);
+      CHECK(grows <= (counts[c] + CHUNK - 1) / CHUNK);
+      //inverted & in order
+      for(uint16_t i = 0; i<b.count; i++)
+      {
+        if(b.buffer[i].level0 != 1 || b.buffer[i].level1 != 0 || \
+          b.buffer[i].duration0 != stream[i].duration0 || \
+          b.buffer[i].duration1 != stream[i].duration1) ok = 0;
+      }
+      CHECK(ok);
+      ir_recv_buffer_free(&b);
+      CHECK(b.buffer == NULL && b.count == 0 && b.allocated == 0);
+    }
+  }
+}
+
+static void test_overflow(void)
+{
+  ir_recv_buffer_t b;
+  uint16_t grows;
+  make_stream(MAXIMUM + 1);
+  ir_recv_buffer_init(&b, CHUNK, MAXIMUM, LEVEL_MASK);
+  CHECK(feed(&b, MAXIMUM + 1, 50, &grows) == ESP_ERR_INVALID_SIZE);
+  //buffer is freed on an error
+  CHECK(b.buffer == NULL && b.count == 0 && b.allocated == 0);
+
+  //one block above the cap
+  ir_recv_buffer_init(&b, CHUNK, MAXIMUM, LEVEL_MASK);
+  CHECK(ir_recv_buffer_append(&b, stream, MAXIMUM + 1) == ESP_ERR_INVALID_SIZE);
+  CHECK(b.buffer == NULL);
+
+  //empty block & cap not a multiple of the chunk
+  ir_recv_buffer_init(&b, CHUNK, 100, 0);
+  CHECK(ir_recv_buffer_append(&b, stream, 0) == ESP_OK && b.count == 0);
+  CHECK(ir_recv_buffer_append(&b, stream, 70) == ESP_OK && b.allocated == 100);
+  CHECK(ir_recv_buffer_append(&b, stream, 30) == ESP_OK && b.count == 100);
+  CHECK(b.buffer[99].val == stream[29].val);
+  CHECK(ir_recv_buffer_append(&b, stream, 1) == ESP_ERR_INVALID_SIZE);
+}
+
+/** @brief Cost of receiving a full recording in 64 edge blocks */
+static void bench_append(void)
+{
+  struct timespec a, c;
+  const uint32_t loops = 20000;
+  volatile uint32_t sum = 0;
+  make_stream(MAXIMUM);
+  clock_gettime(CLOCK_MONOTONIC, &a);
+  for(uint32_t l = 0; l<loops; l++)
+  {
+    ir_recv_buffer_t b;
+    ir_recv_buffer_init(&b, CHUNK, MAXIMUM, LEVEL_MASK);
+    for(uint16_t off = 0; off<MAXIMUM; off += 64) ir_recv_buffer_append(&b, &stream[off], 64);
+    sum += b.count;
+    ir_recv_buffer_free(&b);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &c);
+  double us = ((c.tv_sec - a.tv_sec) * 1e9 + (c.tv_nsec - a.tv_nsec)) / 1000.0 / loops;
+  printf("ir_recv_buffer: %.2f us to receive %d edges on the host\n", us, MAXIMUM);
+}
+
+int main(void)
+{
+  test_long();
+  test_overflow();
+  bench_append();
+  return TEST_RESULT("ir_recv_buffer");
+}
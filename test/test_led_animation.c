@@ -0,0 +1,157 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ * Copyright 2019 Benjamin Aigner <aignerb@technikum-wien.at,
+ * beni@asterics-foundation.org>
+ */
+/** @file
+ * @brief HOST TEST - LED animation frame generation
+ *
+ * Checks the frames of each animation mode at characteristic points in
+ * time & measures the cost of one frame for 64 pixels.
+ * @see led_animation.h
+ **/
+
+#include <time.h>
+#include "test.h"
+#include "led_animation.h"
+
+/** @brief Maximum count of pixels (LED_NEOPIXEL_COUNT) */
+#define PIXELS 64
+
+static uint8_t rgb[PIXELS*3];
+
+/** @brief Start an animation */
+static void start(led_anim_state_t *st, uint8_t mode, uint8_t r, uint8_t g,
+  uint8_t b, uint16_t period, uint8_t count, uint8_t duty)
+{
+  led_anim_t a = {mode, r, g, b, period, count, duty};
+  led_anim_start(st, &a);
+}
+
+/** @brief Check if all pixels have the same color */
+static int all(uint16_t count, uint8_t r, uint8_t g, uint8_t b)
+{
+  for(uint16_t i = 0; i<count; i++)
+  {
+    if(rgb[i*3] != r || rgb[i*3+1] != g || rgb[i*3+2] != b) return 0;
+  }
+  return 1;
+}
+
+static void test_steady(void)
+{
+  led_anim_state_t st = {0};
+  start(&st, LED_ANIM_STEADY, 255, 10, 1, 0, 0, 0);
+  CHECK(led_anim_frame(&st, 0, rgb, 8) == 0 && all(8, 255, 10, 1));
+  CHECK(led_anim_frame(&st, 0, rgb, 0) == 0);
+  //period 0 is replaced by the default
+  CHECK(st.anim.period == LED_ANIM_DEFAULT_PERIOD);
+}
+
+static void test_fade(void)
+{
+  led_anim_state_t st = {0};
+  start(&st, LED_ANIM_STEADY, 200, 0, 0, 0, 0, 0);
+  led_anim_frame(&st, 0, rgb, 4);
+  //fade starts at the last color
+  start(&st, LED_ANIM_FADE, 0, 255, 0, 1000, 0, 0);
+  CHECK(led_anim_frame(&st, 0, rgb, 4) == 1 && all(4, 200, 0, 0));
+  CHECK(led_anim_frame(&st, 500, rgb, 4) == 1 && all(4, 100, 127, 0));
+  CHECK(led_anim_frame(&st, 1000, rgb, 4) == 0 && all(4, 0, 255, 0));
+}
+
+static void test_pulse(void)
+{
+  led_anim_state_t st = {0};
+  start(&st, LED_ANIM_PULSE, 0, 0, 200, 400, 2, 0);
+  CHECK(led_anim_frame(&st, 0, rgb, 4) == 1 && all(4, 0, 0, 0));
+  CHECK(led_anim_frame(&st, 200, rgb, 4) == 1 && all(4, 0, 0, 200));
+  //squared triangle: half level gives a quarter brightness
+  CHECK(led_anim_frame(&st, 100, rgb, 4) == 1 && all(4, 0, 0, 50));
+  CHECK(led_anim_frame(&st, 600, rgb, 4) == 1 && all(4, 0, 0, 200));
+  CHECK(led_anim_frame(&st, 800, rgb, 4) == 0 && all(4, 0, 0, 200));
+  //endless
+  start(&st, LED_ANIM_PULSE, 0, 0, 200, 400, 0, 0);
+  CHECK(led_anim_frame(&st, 400*1000, rgb, 4) == 1);
+}
+
+static void test_blink(void)
+{
+  led_anim_state_t st = {0};
+  //3 blinks, 75% on
+  start(&st, LED_ANIM_BLINK, 255, 255, 0, 200, 3, 192);
+  CHECK(led_anim_frame(&st, 0, rgb, 4) == 1 && all(4, 255, 255, 0));
+  CHECK(led_anim_frame(&st, 149, rgb, 4) == 1 && all(4, 255, 255, 0));
+  CHECK(led_anim_frame(&st, 150, rgb, 4) == 1 && all(4, 0, 0, 0));
+  CHECK(led_anim_frame(&st, 450, rgb, 4) == 1 && all(4, 255, 255, 0));
+  CHECK(led_anim_frame(&st, 599, rgb, 4) == 1 && all(4, 0, 0, 0));
+  //afterwards steady
+  CHECK(led_anim_frame(&st, 600, rgb, 4) == 0 && all(4, 255, 255, 0));
+  //default duty 50%
+  start(&st, LED_ANIM_BLINK, 255, 255, 0, 200, 3, 0);
+  CHECK(led_anim_frame(&st, 99, rgb, 4) == 1 && all(4, 255, 255, 0));
+  CHECK(led_anim_frame(&st, 100, rgb, 4) == 1 && all(4, 0, 0, 0));
+}
+
+static void test_circle(void)
+{
+  led_anim_state_t st = {0};
+  start(&st, LED_ANIM_CIRCLE, 9, 8, 7, 800, 0, 0);
+  CHECK(led_anim_frame(&st, 0, rgb, 8) == 1);
+  for(uint8_t i = 0; i<8; i++) CHECK((rgb[i*3] == 9) == (i < 3));
+  //phase 160/256 -> pixels 5,6,7
+  CHECK(led_anim_frame(&st, 500, rgb, 8) == 1);
+  for(uint8_t i = 0; i<8; i++) CHECK((rgb[i*3] == 9) == (i >= 5));
+  //wraps around
+  CHECK(led_anim_frame(&st, 700, rgb, 8) == 1);
+  CHECK(rgb[7*3] == 9 && rgb[0] == 9 && rgb[1*3] == 9 && rgb[6*3] == 0);
+  //up to 3 pixels: steady
+  CHECK(led_anim_frame(&st, 500, rgb, 3) == 0 && all(3, 9, 8, 7));
+}
+
+/** @brief Measure the cost of one frame for 64 pixels */
+static void bench_frame(void)
+{
+  led_anim_state_t st = {0};
+  struct timespec a, b;
+  volatile uint32_t sum = 0;
+  const uint8_t modes[] = {LED_ANIM_FADE, LED_ANIM_PULSE, LED_ANIM_BLINK, LED_ANIM_CIRCLE};
+  const uint32_t frames = 100000;
+
+  clock_gettime(CLOCK_MONOTONIC, &a);
+  for(uint8_t m = 0; m<sizeof(modes); m++)
+  {
+    start(&st, modes[m], 100, 150, 200, 1000, 0, 0);
+    for(uint32_t k = 0; k<frames; k++) sum += led_anim_frame(&st, k % 1000, rgb, PIXELS);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &b);
+  double us = ((b.tv_sec - a.tv_sec) * 1e9 + (b.tv_nsec - a.tv_nsec)) / 1000.0 / (frames * sizeof(modes));
+  printf("led_animation: %.3f us/frame for %d pixels on the host (budget %d us on the ESP32)\n", \
+    us, PIXELS, LED_ANIM_FRAME_BUDGET_US);
+  CHECK(us < LED_ANIM_FRAME_BUDGET_US);
+}
+
+int main(void)
+{
+  test_steady();
+  test_fade();
+  test_pulse();
+  test_blink();
+  test_circle();
+  bench_frame();
+  return TEST_RESULT("led_animation");
+}
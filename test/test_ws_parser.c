@@ -0,0 +1,284 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ * Copyright 2019 Benjamin Aigner <aignerb@technikum-wien.at,
+ * beni@asterics-foundation.org>
+ */
+/** @file
+ * @brief HOST TEST - incremental websocket frame parser
+ *
+ * Client frames (masked) are fed to the parser in segments of any size,
+ * like they arrive from lwIP. Checked are headers split across segments,
+ * several frames in one segment, 16/64 bit payload lengths, control
+ * frames between the fragments of a message and the protocol errors,
+ * which close the connection.
+ * @see ws_rx.h
+ **/
+
+#include <stdlib.h>
+#include "test.h"
+#include "ws_rx.h"
+
+/** @brief Maximum count of recorded callback events */
+#define MAX_EVENTS 16
+/** @brief Recorded bytes per event */
+#define EVENT_DATA 64
+
+/** @brief One recorded callback */
+typedef struct {
+  WS_OPCODES opcode;
+  size_t length;
+  uint8_t data[EVENT_DATA];
+} event_t;
+
+static event_t events[MAX_EVENTS];
+static int eventcount = 0;
+/** @brief All events, including the ones which are not recorded */
+static long eventtotal = 0;
+static long linebytes = 0;
+
+static WS_rx_t rx;
+static uint8_t stream[80000];
+
+/** @brief Parser callback, records the event */
+static void record(void *ctx, WS_OPCODES opcode, const uint8_t *data, size_t length)
+{
+  CHECK(ctx == &rx);
+  eventtotal++;
+  if(opcode == WS_OP_TXT) linebytes += length;
+  if(eventcount == MAX_EVENTS) return;
+  events[eventcount].opcode = opcode;
+  events[eventcount].length = length;
+  memcpy(events[eventcount].data, data, length < EVENT_DATA ? length : EVENT_DATA);
+  eventcount++;
+}
+
+static void reset(void)
+{
+  WS_rx_init(&rx, record, &rx);
+  eventcount = 0;
+  eventtotal = 0;
+  linebytes = 0;
+}
+
+/** @brief Check a recorded event */
+static int event_is(int i, WS_OPCODES opcode, const char *data)
+{
+  size_t len = strlen(data);
+  return i < eventcount && events[i].opcode == opcode && events[i].length == len && \
+    memcmp(events[i].data, data, len) == 0;
+}
+
+/** @brief Build a masked client frame
+ * @param buf Output buffer
+ * @param fin FIN flag
+ * @param opcode Opcode
+ * @param payload Payload (unmasked)
+ * @param len Payload length
+ * @param lenbytes Size of the extended length: 0 (automatic), 2 or 8
+ * @return Frame length */
+static size_t frame(uint8_t *buf, uint8_t fin, uint8_t opcode, const void *payload, \
+  uint64_t len, uint8_t lenbytes)
+{
+  static const uint8_t key[WS_MASK_L] = {0x37, 0xFA, 0x21, 0x3D};
+  const uint8_t *p = payload;
+  size_t pos = 2;
+  if(lenbytes == 0) lenbytes = (len < 126) ? 0 : ((len <= 0xFFFF) ? 2 : 8);
+  buf[0] = (fin << 7) | opcode;
+  buf[1] = 0x80 | ((lenbytes == 0) ? len : ((lenbytes == 2) ? 126 : 127));
+  for(int i = lenbytes - 1; i >= 0; i--) buf[pos++] = (len >> (8 * i)) & 0xFF;
+  memcpy(&buf[pos], key, WS_MASK_L);
+  pos += WS_MASK_L;
+  for(uint64_t i = 0; i < len; i++) buf[pos++] = p[i] ^ key[i % WS_MASK_L];
+  return pos;
+}
+
+/** @brief Feed a stream in segments of a given size
+ * @return Result of the last parsed segment */
+static esp_err_t feed(const uint8_t *data, size_t len, size_t segment)
+{
+  esp_err_t ret = ESP_OK;
+  for(size_t off = 0; off < len && ret == ESP_OK; off += segment)
+    ret = WS_rx_parse(&rx, &data[off], (len - off < segment) ? len - off : segment);
+  return ret;
+}
+
+/** @brief Header & payload split at every position */
+static void test_split_header(void)
+{
+  const char *cmd = "AT MX 10";
+  size_t len = frame(stream, 1, WS_OP_TXT, cmd, strlen(cmd), 0);
+  for(size_t split = 1; split < len; split++)
+  {
+    reset();
+    CHECK(WS_rx_parse(&rx, stream, split) == ESP_OK);
+    //nothing before the frame is complete
+    CHECK(eventcount == 0);
+    CHECK(WS_rx_parse(&rx, &stream[split], len - split) == ESP_OK);
+    CHECK(eventcount == 1 && event_is(0, WS_OP_TXT, cmd));
+  }
+  //byte by byte, 16 bit length header split as well
+  memset(&stream[200], 'A', 300);
+  len = frame(stream, 1, WS_OP_TXT, &stream[200], 300, 0);
+  reset();
+  CHECK(feed(stream, len, 1) == ESP_OK);
+  CHECK(eventcount == 1 && events[0].length == 300);
+}
+
+/** @brief Several frames & lines in one segment */
+static void test_multiple(void)
+{
+  const uint8_t bin[] = {0x02, 1, 2, 3};
+  size_t len = frame(stream, 1, WS_OP_TXT, "AT A\r\nAT B", 10, 0);
+  len += frame(&stream[len], 1, WS_OP_BIN, bin, sizeof(bin), 0);
+  len += frame(&stream[len], 1, WS_OP_TXT, "AT C\n", 5, 0);
+  //empty frame
+  len += frame(&stream[len], 1, WS_OP_TXT, "", 0, 0);
+  len += frame(&stream[len], 1, WS_OP_PIN, "hi", 2, 0);
+  for(size_t segment = 1; segment <= len; segment++)
+  {
+    reset();
+    CHECK(feed(stream, len, segment) == ESP_OK);
+    CHECK(eventcount == 5);
+    CHECK(event_is(0, WS_OP_TXT, "AT A") && event_is(1, WS_OP_TXT, "AT B"));
+    CHECK(events[2].opcode == WS_OP_BIN && events[2].length == sizeof(bin) && \
+      memcmp(events[2].data, bin, sizeof(bin)) == 0);
+    CHECK(event_is(3, WS_OP_TXT, "AT C") && event_is(4, WS_OP_PIN, "hi"));
+  }
+}
+
+/** @brief 16 & 64 bit payload lengths */
+static void test_lengths(void)
+{
+  static uint8_t payload[70000];
+  size_t len;
+
+  //64 bit length field for a short frame is valid
+  reset();
+  len = frame(stream, 1, WS_OP_TXT, "AT ID", 5, 8);
+  CHECK(feed(stream, len, len) == ESP_OK && event_is(0, WS_OP_TXT, "AT ID"));
+  reset();
+  len = frame(stream, 1, WS_OP_TXT, "AT ID", 5, 2);
+  CHECK(feed(stream, len, len) == ESP_OK && event_is(0, WS_OP_TXT, "AT ID"));
+
+  //16 bit: one line (125 < length <= 0xFFFF)
+  memset(payload, 'B', 1000);
+  reset();
+  len = frame(stream, 1, WS_OP_TXT, payload, 1000, 0);
+  CHECK(stream[1] == (0x80 | 126));
+  CHECK(feed(stream, len, 536) == ESP_OK);
+  CHECK(eventcount == 1 && events[0].length == 1000);
+
+  //64 bit: 700 lines of 99 bytes, in TCP segments
+  for(size_t i = 0; i < sizeof(payload); i++) payload[i] = (i % 100 == 99) ? '\n' : 'a' + i % 26;
+  reset();
+  len = frame(stream, 1, WS_OP_TXT, payload, sizeof(payload), 0);
+  CHECK(stream[1] == (0x80 | 127));
+  CHECK(feed(stream, len, 1460) == ESP_OK);
+  CHECK(eventtotal == 700 && linebytes == 700 * 99);
+  CHECK(events[0].length == 99 && memcmp(events[0].data, payload, EVENT_DATA) == 0);
+
+  //64 bit binary message is truncated
+  reset();
+  len = frame(stream, 1, WS_OP_BIN, payload, sizeof(payload), 0);
+  CHECK(feed(stream, len, 1460) == ESP_OK);
+  CHECK(eventcount == 1 && events[0].opcode == WS_OP_BIN && events[0].length == WS_RX_BIN_L);
+
+  //a line longer than ATCMD_LENGTH is discarded, the following one is not
+  memset(payload, 'C', ATCMD_LENGTH + 10);
+  memcpy(&payload[ATCMD_LENGTH + 10], "\nAT D", 5);
+  reset();
+  len = frame(stream, 1, WS_OP_TXT, payload, ATCMD_LENGTH + 15, 0);
+  CHECK(feed(stream, len, 100) == ESP_OK);
+  CHECK(eventcount == 1 && event_is(0, WS_OP_TXT, "AT D"));
+}
+
+/** @brief Control frames between the fragments of a message */
+static void test_fragments(void)
+{
+  const uint8_t bin[] = {0x03, 0x01};
+  size_t len = frame(stream, 0, WS_OP_TXT, "AT M", 4, 0);
+  len += frame(&stream[len], 1, WS_OP_PIN, "p1", 2, 0);
+  len += frame(&stream[len], 0, WS_OP_CON, "X 1", 3, 0);
+  len += frame(&stream[len], 1, WS_OP_PON, "", 0, 0);
+  len += frame(&stream[len], 1, WS_OP_CON, "0\nAT B", 6, 0);
+  //binary message, fragmented
+  len += frame(&stream[len], 0, WS_OP_BIN, bin, 1, 0);
+  len += frame(&stream[len], 1, WS_OP_PIN, "p2", 2, 0);
+  len += frame(&stream[len], 1, WS_OP_CON, &bin[1], 1, 0);
+  for(size_t segment = 1; segment <= len; segment += 3)
+  {
+    reset();
+    CHECK(feed(stream, len, segment) == ESP_OK);
+    CHECK(eventcount == 5);
+    CHECK(event_is(0, WS_OP_PIN, "p1") && event_is(1, WS_OP_TXT, "AT MX 10"));
+    CHECK(event_is(2, WS_OP_TXT, "AT B") && event_is(3, WS_OP_PIN, "p2"));
+    CHECK(events[4].opcode == WS_OP_BIN && events[4].length == 2 && \
+      memcmp(events[4].data, bin, 2) == 0);
+  }
+}
+
+/** @brief Feed a stream, which must fail with a protocol error */
+static void protocol_error(size_t len)
+{
+  reset();
+  CHECK(feed(stream, len, 1) == ESP_FAIL && rx.closed == 0);
+  reset();
+  CHECK(feed(stream, len, len) == ESP_FAIL && rx.closed == 0);
+}
+
+/** @brief Protocol errors & close frames end the connection */
+static void test_close(void)
+{
+  uint8_t ctrl[200];
+  size_t len;
+  memset(ctrl, 0, sizeof(ctrl));
+
+  //continuation without a message
+  protocol_error(frame(stream, 1, WS_OP_CON, "AT", 2, 0));
+  //new message before the previous one is finished
+  len = frame(stream, 0, WS_OP_TXT, "AT", 2, 0);
+  protocol_error(len + frame(&stream[len], 1, WS_OP_BIN, "AT", 2, 0));
+  //reserved opcodes
+  protocol_error(frame(stream, 1, 0x3, "AT", 2, 0));
+  protocol_error(frame(stream, 1, 0xB, "", 0, 0));
+  //fragmented control frame
+  protocol_error(frame(stream, 0, WS_OP_PIN, "p", 1, 0));
+  //control frame too long (16 bit length)
+  protocol_error(frame(stream, 1, WS_OP_PIN, ctrl, WS_STD_LEN + 1, 0));
+
+  //close frame: data before it is processed, everything after it is ignored
+  len = frame(stream, 1, WS_OP_TXT, "AT A", 4, 0);
+  len += frame(&stream[len], 1, WS_OP_CLS, "\x03\xE8", 2, 0);
+  size_t closelen = len;
+  len += frame(&stream[len], 1, WS_OP_TXT, "AT B", 4, 0);
+  reset();
+  CHECK(feed(stream, len, len) == ESP_FAIL && rx.closed == 1);
+  CHECK(eventcount == 1 && event_is(0, WS_OP_TXT, "AT A"));
+  reset();
+  CHECK(feed(stream, closelen - 1, 1) == ESP_OK && rx.closed == 0);
+  CHECK(WS_rx_parse(&rx, &stream[closelen - 1], 1) == ESP_FAIL && rx.closed == 1);
+}
+
+int main(void)
+{
+  test_split_header();
+  test_multiple();
+  test_lengths();
+  test_fragments();
+  test_close();
+  return TEST_RESULT("ws_parser");
+}
@@ -0,0 +1,91 @@
+#!/usr/bin/env python
+#
+# Generate the embedded web GUI asset table (C header) from the
+# precompressed files in minified_gz.
+#
+# Usage: python makeassets.py <minified_gz folder> <output header>
+#
+# For each device folder (flipmouse/fabi) a table of all *.gz files is
+# generated, containing the URL, content type, gzip data and an ETag
+# (hash of the gzip data). The tables are selected via DEVICE_FLIPMOUSE
+# or DEVICE_FABI (common.h) at compile time.
+#
+# This file is part of the FLipMouse/FABI firmware and licensed under GPLv3.
+
+import hashlib
+import os
+import sys
+
+#device folder -> define in common.h
+DEVICES = [("flipmouse", "DEVICE_FLIPMOUSE"), ("fabi", "DEVICE_FABI")]
+
+#file extension -> content type
+TYPES = {
+    ".htm": "text/html",
+    ".html": "text/html",
+    ".css": "text/css",
+    ".js": "text/javascript",
+    ".ico": "image/x-icon",
+    ".png": "image/png",
+    ".svg": "image/svg+xml",
+    ".json": "application/json",
+}
+
+
+def collect(folder):
+    assets = []
+    for root, dirs, files in os.walk(folder):
+        dirs.sort()
+        for name in sorted(files):
+            if not name.endswith(".gz"):
+                continue
+            path = os.path.join(root, name)
+            url = "/" + os.path.relpath(path, folder).replace(os.sep, "/")[:-3]
+            ext = os.path.splitext(url)[1].lower()
+            with open(path, "rb") as f:
+                data = bytearray(f.read())
+            assets.append((url, TYPES.get(ext, "text/plain"), data))
+    return assets
+
+
+def write_device(out, folder, define):
+    assets = collect(folder)
+    out.write("#ifdef %s\n" % define)
+    total = 0
+    for i, (url, ctype, data) in enumerate(assets):
+        out.write("//%s (%d bytes)\n" % (url, len(data)))
+        out.write("static const uint8_t webgui_asset_%d[] = {\n" % i)
+        for pos in range(0, len(data), 16):
+            out.write("  " + ",".join("0x%02x" % b for b in data[pos:pos + 16]) + ",\n")
+        out.write("};\n")
+        total += len(data)
+    out.write("\n/** @brief Embedded assets, %d files, %d bytes */\n" % (len(assets), total))
+    out.write("static const webgui_asset_t webgui_assets[] = {\n")
+    for i, (url, ctype, data) in enumerate(assets):
+        etag = hashlib.sha1(bytes(data)).hexdigest()[:16]
+        out.write("  {\"%s\", \"%s\", webgui_asset_%d, %d, \"\\\"%s\\\"\"},\n" %
+                  (url, ctype, i, len(data), etag))
+    #avoid an empty initializer if no assets are found
+    if len(assets) == 0:
+        out.write("  {NULL, NULL, NULL, 0, NULL},\n")
+    out.write("};\n")
+    out.write("#define WEBGUI_ASSETS_COUNT %d\n" % len(assets))
+    out.write("#endif\n\n")
+    return len(assets), total
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.stderr.write("Usage: %s <minified_gz folder> <output header>\n" % sys.argv[0])
+        sys.exit(1)
+    src, dst = sys.argv[1], sys.argv[2]
+    with open(dst, "w") as out:
+        out.write("/* Generated by webgui/makeassets.py from %s, do not edit! */\n\n" %
+                  os.path.basename(os.path.normpath(src)))
+        for folder, define in DEVICES:
+            count, total = write_device(out, os.path.join(src, folder), define)
+            print("webgui assets (%s): %d files, %d bytes" % (folder, count, total))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,108 @@
+#!/usr/bin/env python3
+#
+# Latency test for the MQTT inbound control channel (see
+# taskMQTTControlInit in function_tasks/task_smarthome.h).
+#
+# Publishes "press"/"release" to <base>/vb/<nr> via a broker (e.g.
+# mqtt_standin.py) and waits for the answer of the device on
+# <base>/ack. The device needs a matching VB action, e.g.:
+#   AT MC <base>
+#   AT BM <nr>
+#   AT MQ <base>/ack:pressed
+# The time from publishing the control message until the answer is
+# received is the message->action latency (including the publish of the
+# answer). Missing answers are counted as lost.
+#
+# Usage: python3 mqtt_control_test.py [broker] [base topic] [vb] [count]
+#
+# This file is part of the FLipMouse/FABI firmware and licensed under GPLv3.
+
+import socket
+import struct
+import sys
+import time
+
+CONNECT, PUBLISH, SUBSCRIBE = 1, 3, 8
+#interval between two presses, must be above the device rate limit
+INTERVAL = 0.25
+TIMEOUT = 2.0
+
+
+def encode_packet(first, body):
+    length = len(body)
+    header = bytearray([first])
+    while True:
+        byte = length & 0x7F
+        length >>= 7
+        header.append(byte | 0x80 if length else byte)
+        if not length:
+            return bytes(header) + body
+
+
+def mqtt_string(text):
+    raw = text.encode("utf-8")
+    return struct.pack(">H", len(raw)) + raw
+
+
+def read_packet(sock):
+    first = sock.recv(1)
+    if not first:
+        raise IOError("connection closed")
+    length, shift = 0, 0
+    while True:
+        byte = bytearray(sock.recv(1))[0]
+        length |= (byte & 0x7F) << shift
+        shift += 7
+        if not byte & 0x80:
+            break
+    body = b""
+    while len(body) < length:
+        body += sock.recv(length - len(body))
+    return bytearray(first)[0] >> 4, body
+
+
+def publish(sock, topic, payload):
+    sock.sendall(encode_packet(PUBLISH << 4, mqtt_string(topic) + payload.encode("utf-8")))
+
+
+def main():
+    broker = sys.argv[1] if len(sys.argv) > 1 else "localhost"
+    base = sys.argv[2] if len(sys.argv) > 2 else "flipmouse"
+    vb = int(sys.argv[3]) if len(sys.argv) > 3 else 0
+    count = int(sys.argv[4]) if len(sys.argv) > 4 else 20
+    host, _, port = broker.partition(":")
+
+    sock = socket.create_connection((host, int(port or 1883)), timeout=TIMEOUT)
+    sock.sendall(encode_packet(CONNECT << 4, mqtt_string("MQTT") + b"\x04\x02\x00\x3c" +
+                               mqtt_string("controltest")))
+    read_packet(sock)
+    sock.sendall(encode_packet((SUBSCRIBE << 4) | 0x02, b"\x00\x01" + mqtt_string(base + "/ack") + b"\x00"))
+    read_packet(sock)
+
+    latencies = []
+    for _ in range(count):
+        start = time.time()
+        publish(sock, "%s/vb/%d" % (base, vb), "press")
+        while time.time() - start < TIMEOUT:
+            try:
+                ptype, body = read_packet(sock)
+            except socket.timeout:
+                break
+            if ptype == PUBLISH:
+                topic = body[2:2 + struct.unpack(">H", bytes(body[:2]))[0]].decode("utf-8", "replace")
+                if topic == base + "/ack":
+                    latencies.append(time.time() - start)
+                    break
+        publish(sock, "%s/vb/%d" % (base, vb), "release")
+        time.sleep(INTERVAL)
+    sock.close()
+
+    print("%d control messages, %d answered, %d lost" % (count, len(latencies), count - len(latencies)))
+    if latencies:
+        latencies.sort()
+        print("message->action latency [ms]: median %.1f, max %.1f" %
+              (latencies[len(latencies) // 2] * 1000.0, latencies[-1] * 1000.0))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,205 @@
+#!/usr/bin/env python3
+#
+# Minimal MQTT 3.1.1 stand-in broker for testing MQTT publish actions
+# (see taskMQTTPublishAction in function_tasks/task_smarthome.h).
+#
+# Accepts clients, acknowledges CONNECT, SUBSCRIBE, PINGREQ and QoS 1
+# PUBLISH packets and logs each received message with the time since
+# the previous one. Messages are forwarded (QoS 0) to all clients with a
+# matching subscription, e.g. for the inbound control channel (see
+# taskMQTTControlInit and mqtt_control_test.py).
+# To test the outbox of the device, all clients are disconnected every
+# [interval] seconds and new connections are refused for [downtime]
+# seconds. Messages triggered on the device during the downtime must
+# arrive in order after the reconnect.
+# On exit (Ctrl+C) the count of received messages, duplicates (DUP flag
+# set) and forced disconnects is printed. Compare it with the count of
+# triggers for the loss rate; the device logs the trigger->publish
+# latency (log tag "MQTT", debug level) for each message.
+#
+# Usage: python3 mqtt_standin.py [port] [interval in s, 0: never] [downtime in s]
+# and set the broker on the device with "AT MH mqtt://<pc ip>:<port>".
+#
+# This file is part of the FLipMouse/FABI firmware and licensed under GPLv3.
+
+import socket
+import struct
+import sys
+import threading
+import time
+
+CONNECT, CONNACK, PUBLISH, PUBACK = 1, 2, 3, 4
+SUBSCRIBE, SUBACK, PINGREQ, PINGRESP, DISCONNECT = 8, 9, 12, 13, 14
+
+lock = threading.Lock()
+clients = []
+#socket -> list of topic filters
+subscriptions = {}
+stats = {"messages": 0, "duplicates": 0, "disconnects": 0, "last": None}
+state = {"down_until": 0.0}
+
+
+def recv_exact(sock, n):
+    data = b""
+    while len(data) < n:
+        chunk = sock.recv(n - len(data))
+        if not chunk:
+            raise IOError("connection closed")
+        data += chunk
+    return data
+
+
+def read_packet(sock):
+    first = recv_exact(sock, 1)[0]
+    length, shift = 0, 0
+    while True:
+        byte = recv_exact(sock, 1)[0]
+        length |= (byte & 0x7F) << shift
+        shift += 7
+        if not byte & 0x80:
+            break
+    return first >> 4, first & 0x0F, recv_exact(sock, length)
+
+
+def encode_packet(ptype, body):
+    length = len(body)
+    header = bytearray([ptype << 4])
+    while True:
+        byte = length & 0x7F
+        length >>= 7
+        header.append(byte | 0x80 if length else byte)
+        if not length:
+            return bytes(header) + body
+
+
+def matches(pattern, topic):
+    pattern, topic = pattern.split("/"), topic.split("/")
+    for i, level in enumerate(pattern):
+        if level == "#":
+            return True
+        if i >= len(topic) or (level != "+" and level != topic[i]):
+            return False
+    return len(pattern) == len(topic)
+
+
+def forward(topic, payload):
+    raw = topic.encode("utf-8")
+    packet = encode_packet(PUBLISH, struct.pack(">H", len(raw)) + raw + payload)
+    with lock:
+        receivers = [s for s, filters in subscriptions.items() if any(matches(f, topic) for f in filters)]
+    for sock in receivers:
+        try:
+            sock.sendall(packet)
+        except OSError:
+            pass
+
+
+def handle_publish(sock, flags, body):
+    qos = (flags >> 1) & 0x03
+    topiclen = struct.unpack(">H", body[:2])[0]
+    topic = body[2:2 + topiclen].decode("utf-8", "replace")
+    pos = 2 + topiclen
+    if qos:
+        msgid = struct.unpack(">H", body[pos:pos + 2])[0]
+        pos += 2
+        sock.sendall(struct.pack(">BBH", PUBACK << 4, 2, msgid))
+    forward(topic, body[pos:])
+    payload = body[pos:].decode("utf-8", "replace")
+    now = time.time()
+    with lock:
+        stats["messages"] += 1
+        if flags & 0x08:
+            stats["duplicates"] += 1
+        delta = (now - stats["last"]) * 1000.0 if stats["last"] else 0.0
+        stats["last"] = now
+        count = stats["messages"]
+    print("#%d %s: %s (QoS %d%s), %.1fms since last message" %
+          (count, topic, payload, qos, ", DUP" if flags & 0x08 else "", delta))
+    sys.stdout.flush()
+
+
+def client(sock, addr):
+    with lock:
+        clients.append(sock)
+    try:
+        while True:
+            ptype, flags, body = read_packet(sock)
+            if ptype == CONNECT:
+                print("client %s connected" % addr[0])
+                sock.sendall(bytes(bytearray([CONNACK << 4, 2, 0, 0])))
+            elif ptype == PUBLISH:
+                handle_publish(sock, flags, body)
+            elif ptype == SUBSCRIBE:
+                #grant QoS 0 for all requested topics
+                msgid = body[:2]
+                filters = []
+                pos = 2
+                while pos < len(body):
+                    length = struct.unpack(">H", body[pos:pos + 2])[0]
+                    filters.append(body[pos + 2:pos + 2 + length].decode("utf-8", "replace"))
+                    pos += 2 + length + 1
+                with lock:
+                    subscriptions.setdefault(sock, []).extend(filters)
+                print("client %s subscribed %s" % (addr[0], ", ".join(filters)))
+                sock.sendall(encode_packet(SUBACK, msgid + b"\x00" * len(filters)))
+            elif ptype == PINGREQ:
+                sock.sendall(bytes(bytearray([PINGRESP << 4, 0])))
+            elif ptype == DISCONNECT:
+                break
+    except (IOError, OSError):
+        pass
+    finally:
+        with lock:
+            if sock in clients:
+                clients.remove(sock)
+            subscriptions.pop(sock, None)
+        sock.close()
+
+
+def disconnector(interval, downtime):
+    while True:
+        time.sleep(interval)
+        with lock:
+            victims = list(clients)
+            state["down_until"] = time.time() + downtime
+            stats["disconnects"] += 1
+        print("forced disconnect of %d client(s), refusing connections for %.1fs" % (len(victims), downtime))
+        sys.stdout.flush()
+        for sock in victims:
+            try:
+                sock.shutdown(socket.SHUT_RDWR)
+            except OSError:
+                pass
+
+
+def main():
+    port = int(sys.argv[1]) if len(sys.argv) > 1 else 1883
+    interval = float(sys.argv[2]) if len(sys.argv) > 2 else 30.0
+    downtime = float(sys.argv[3]) if len(sys.argv) > 3 else 5.0
+
+    server = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    server.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    server.bind(("", port))
+    server.listen(4)
+    print("MQTT stand-in listening on port %d" % port)
+    if interval > 0:
+        t = threading.Thread(target=disconnector, args=(interval, downtime))
+        t.daemon = True
+        t.start()
+    try:
+        while True:
+            sock, addr = server.accept()
+            if time.time() < state["down_until"]:
+                sock.close()
+                continue
+            t = threading.Thread(target=client, args=(sock, addr))
+            t.daemon = True
+            t.start()
+    except KeyboardInterrupt:
+        pass
+    print("%d messages received (%d duplicates), %d forced disconnects" %
+          (stats["messages"], stats["duplicates"], stats["disconnects"]))
+
+
+if __name__ == "__main__":
+    main()
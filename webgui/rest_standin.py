@@ -0,0 +1,83 @@
+#!/usr/bin/env python3
+#
+# Local stand-in for a home-automation REST endpoint (see taskREST in
+# function_tasks/task_smarthome.h).
+#
+# Answers each GET with a short "OK" using HTTP/1.1 keep-alive and logs
+# for every request the connection it arrived on, the count of requests
+# on this connection and the time since the previous request. If the
+# device reuses its pooled connection, repeated triggers show up on the
+# same connection without a new TCP handshake.
+# The device logs the trigger->request latency and request duration
+# (log tag "REST", debug level) for each call.
+#
+# Usage: python3 rest_standin.py [port]
+# then trigger e.g. "AT RE http://<pc ip>:<port>/switch?on" on the device.
+#
+# This file is part of the FLipMouse/FABI firmware and licensed under GPLv3.
+
+import sys
+import threading
+import time
+
+try:
+    from http.server import BaseHTTPRequestHandler, HTTPServer
+    from socketserver import ThreadingMixIn
+except ImportError:
+    from BaseHTTPServer import BaseHTTPRequestHandler, HTTPServer
+    from SocketServer import ThreadingMixIn
+
+lock = threading.Lock()
+stats = {"connections": 0, "requests": 0, "last": None}
+
+
+class Handler(BaseHTTPRequestHandler):
+    #default is HTTP/1.0, which closes the connection after each request
+    protocol_version = "HTTP/1.1"
+
+    def setup(self):
+        BaseHTTPRequestHandler.setup(self)
+        with lock:
+            stats["connections"] += 1
+            self.connection_id = stats["connections"]
+        self.count = 0
+
+    def do_GET(self):
+        now = time.time()
+        self.count += 1
+        with lock:
+            stats["requests"] += 1
+            delta = (now - stats["last"]) * 1000.0 if stats["last"] else 0.0
+            stats["last"] = now
+            total = stats["requests"]
+        body = b"OK"
+        self.send_response(200)
+        self.send_header("Content-Type", "text/plain")
+        self.send_header("Content-Length", str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+        print("#%d %s: connection %d, request %d on it, %.1fms since last request" %
+              (total, self.path, self.connection_id, self.count, delta))
+        sys.stdout.flush()
+
+    def log_message(self, format, *args):
+        pass
+
+
+class Server(ThreadingMixIn, HTTPServer):
+    daemon_threads = True
+
+
+def main():
+    port = int(sys.argv[1]) if len(sys.argv) > 1 else 8080
+    server = Server(("", port), Handler)
+    print("REST stand-in listening on port %d" % port)
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+    print("%d requests on %d connections" % (stats["requests"], stats["connections"]))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,141 @@
+#!/usr/bin/env python3
+#
+# Test client for the binary websocket telemetry (see helper/websocket.h).
+#
+# Connects to the websocket of a FLipMouse/FABI (WiFi hotspot), subscribes
+# to the sensor telemetry with the given rate and measures the achieved
+# sample rate, dropped samples and the delay from sampling to reception.
+#
+# The end-to-end delay is estimated as device side queueing time (send
+# time - sample time, both from the device clock) plus half of the round
+# trip time of binary pings.
+#
+# Usage: python3 telemetry_client.py [host] [rate in Hz] [duration in s]
+#
+# This file is part of the FLipMouse/FABI firmware and licensed under GPLv3.
+
+import base64
+import os
+import socket
+import struct
+import sys
+import time
+
+WS_PORT = 1804
+WS_BIN_TELEMETRY = 0x01
+WS_BIN_PING = 0x02
+SAMPLE = struct.Struct("<IHHHHHhh")
+TELEMETRY_HDR = struct.Struct("<BBIH")
+
+
+def handshake(sock, host):
+    key = base64.b64encode(os.urandom(16)).decode()
+    req = ("GET / HTTP/1.1\r\nHost: %s\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+           "Sec-WebSocket-Key: %s\r\nSec-WebSocket-Version: 13\r\n\r\n" % (host, key))
+    sock.sendall(req.encode())
+    resp = b""
+    while b"\r\n\r\n" not in resp:
+        data = sock.recv(1024)
+        if not data:
+            raise IOError("connection closed during handshake")
+        resp += data
+    if b" 101 " not in resp.split(b"\r\n")[0]:
+        raise IOError("handshake failed: %r" % resp)
+    return resp.split(b"\r\n\r\n", 1)[1]
+
+
+def send_frame(sock, opcode, payload):
+    #client frames are always masked
+    mask = os.urandom(4)
+    hdr = bytearray([0x80 | opcode])
+    if len(payload) < 126:
+        hdr.append(0x80 | len(payload))
+    else:
+        hdr.append(0x80 | 126)
+        hdr += struct.pack(">H", len(payload))
+    masked = bytes(b ^ mask[i % 4] for i, b in enumerate(payload))
+    sock.sendall(bytes(hdr) + mask + masked)
+
+
+class FrameReader(object):
+    def __init__(self, sock, data):
+        self.sock = sock
+        self.buf = bytearray(data)
+
+    def _need(self, n):
+        while len(self.buf) < n:
+            data = self.sock.recv(4096)
+            if not data:
+                raise IOError("connection closed")
+            self.buf += data
+
+    def read(self):
+        self._need(2)
+        opcode = self.buf[0] & 0x0F
+        length = self.buf[1] & 0x7F
+        pos = 2
+        if length == 126:
+            self._need(4)
+            length = struct.unpack(">H", bytes(self.buf[2:4]))[0]
+            pos = 4
+        self._need(pos + length)
+        payload = bytes(self.buf[pos:pos + length])
+        del self.buf[:pos + length]
+        return opcode, payload
+
+
+def main():
+    host = sys.argv[1] if len(sys.argv) > 1 else "192.168.4.1"
+    rate = int(sys.argv[2]) if len(sys.argv) > 2 else 50
+    duration = float(sys.argv[3]) if len(sys.argv) > 3 else 10.0
+
+    sock = socket.create_connection((host, WS_PORT), timeout=5)
+    reader = FrameReader(sock, handshake(sock, host))
+    send_frame(sock, 0x2, struct.pack("<BH", WS_BIN_TELEMETRY, rate))
+
+    samples = 0
+    frames = 0
+    dropped = 0
+    ages = []
+    rtts = []
+    start = time.time()
+    nextping = start
+    while time.time() - start < duration:
+        now = time.time()
+        if now >= nextping:
+            send_frame(sock, 0x2, struct.pack("<Bd", WS_BIN_PING, now))
+            nextping = now + 1.0
+        opcode, payload = reader.read()
+        if opcode == 0x1:
+            #text output of the device (serial mirror), ignored
+            continue
+        if opcode != 0x2 or len(payload) == 0:
+            continue
+        if payload[0] == WS_BIN_PING and len(payload) == 9:
+            rtts.append(time.time() - struct.unpack("<Bd", payload)[1])
+        elif payload[0] == WS_BIN_TELEMETRY:
+            _, count, sendtime, dropped = TELEMETRY_HDR.unpack_from(payload)
+            frames += 1
+            for i in range(count):
+                sample = SAMPLE.unpack_from(payload, TELEMETRY_HDR.size + i * SAMPLE.size)
+                ages.append(((sendtime - sample[0]) & 0xFFFFFFFF) / 1000.0)
+                samples += 1
+
+    elapsed = time.time() - start
+    send_frame(sock, 0x2, struct.pack("<BH", WS_BIN_TELEMETRY, 0))
+    sock.close()
+
+    print("requested %d Hz, received %d samples in %d frames in %.1fs" % (rate, samples, frames, elapsed))
+    print("achieved rate: %.1f Hz, dropped on device: %d" % (samples / elapsed, dropped))
+    if ages:
+        ages.sort()
+        print("device queueing [ms]: median %.1f, max %.1f" % (ages[len(ages) // 2], ages[-1]))
+    if rtts:
+        rtt = sorted(rtts)[len(rtts) // 2] * 1000.0
+        print("ping rtt [ms]: median %.1f" % rtt)
+        if ages:
+            print("estimated end-to-end delay [ms]: %.1f" % (ages[len(ages) // 2] + rtt / 2))
+
+
+if __name__ == "__main__":
+    main()
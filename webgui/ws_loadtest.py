@@ -0,0 +1,96 @@
+#!/usr/bin/env python3
+#
+# Load test for the websocket hub (see helper/websocket.h).
+#
+# Opens several websocket clients to a FLipMouse/FABI at the same time.
+# Each active client sends a number of AT commands (pipelined, without
+# waiting for answers) and counts the received output lines. Output is
+# broadcast, so each client should receive the answers for the commands
+# of all clients. Optionally a "stalled" client is opened, which never
+# reads from its socket: the other clients must not be slowed down.
+#
+# Usage: python3 ws_loadtest.py [host] [clients] [commands] [stalled (0/1)] [telemetry rate]
+#
+# This file is part of the FLipMouse/FABI firmware and licensed under GPLv3.
+
+import socket
+import struct
+import sys
+import threading
+import time
+
+from telemetry_client import WS_PORT, WS_BIN_TELEMETRY, FrameReader, handshake, send_frame
+
+#command with a short, well-known answer
+COMMAND = b"AT ID"
+
+
+def connect(host):
+    sock = socket.create_connection((host, WS_PORT), timeout=10)
+    reader = FrameReader(sock, handshake(sock, host))
+    return sock, reader
+
+
+def client(host, index, commands, expected, telemetry, results, barrier):
+    result = {"lines": 0, "frames": 0, "telemetry": 0, "time": 0.0, "error": None}
+    results[index] = result
+    try:
+        sock, reader = connect(host)
+        if telemetry:
+            send_frame(sock, 0x2, struct.pack("<BH", WS_BIN_TELEMETRY, telemetry))
+        barrier.wait()
+        start = time.time()
+        #all commands in one go, the device has to handle pipelined frames
+        for _ in range(commands):
+            send_frame(sock, 0x1, COMMAND)
+        while result["lines"] < expected:
+            opcode, payload = reader.read()
+            if opcode == 0x1:
+                result["frames"] += 1
+                result["lines"] += payload.count(b"\n") + 1
+            elif opcode == 0x2 and payload and payload[0] == WS_BIN_TELEMETRY:
+                result["telemetry"] += payload[1]
+        result["time"] = time.time() - start
+        sock.close()
+    except Exception as e:
+        result["error"] = str(e)
+
+
+def main():
+    host = sys.argv[1] if len(sys.argv) > 1 else "192.168.4.1"
+    clients = int(sys.argv[2]) if len(sys.argv) > 2 else 2
+    commands = int(sys.argv[3]) if len(sys.argv) > 3 else 50
+    stalled = int(sys.argv[4]) if len(sys.argv) > 4 else 1
+    telemetry = int(sys.argv[5]) if len(sys.argv) > 5 else 0
+
+    stalledsock = None
+    if stalled:
+        #connected, subscribed to output, but never reads
+        stalledsock, _ = connect(host)
+        stalledsock.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 1024)
+
+    results = [None] * clients
+    barrier = threading.Barrier(clients)
+    threads = []
+    for i in range(clients):
+        t = threading.Thread(target=client, args=(host, i, commands, clients * commands,
+                                                  telemetry if i == 0 else 0, results, barrier))
+        t.start()
+        threads.append(t)
+    for t in threads:
+        t.join(60)
+
+    print("%d clients x %d commands, stalled client: %s" % (clients, commands, "yes" if stalled else "no"))
+    for i, r in enumerate(results):
+        if r is None or r["error"]:
+            print("client %d: error %s" % (i, r["error"] if r else "timeout"))
+            continue
+        print("client %d: %d lines in %d frames, %.2fs (%.1f lines/s, %.1f lines/frame), telemetry samples: %d" %
+              (i, r["lines"], r["frames"], r["time"], r["lines"] / max(r["time"], 1e-6),
+               r["lines"] / max(r["frames"], 1), r["telemetry"]))
+    if stalledsock:
+        stalledsock.close()
+
+
+if __name__ == "__main__":
+    main()